@@ -10,6 +10,7 @@
 
 #include "or_data_interface.h"
 #include "or_configuration_interface.h"
+#include "or_label_table.hpp"
 
 using namespace std;
 using namespace cv;
@@ -42,8 +43,7 @@ public:
     void on_object_recognition_data(recognition_data *recognition_data, int array_size,
                                     or_configuration_interface *or_configuration)
     {
-        std::string objName = or_configuration->query_object_name_by_id(
-                                  recognition_data[0].label);
+        const std::string& objName = m_labels.get(or_configuration).name(recognition_data[0].label);
         float confidence = recognition_data[0].probability;
         std::stringstream textToWrite;
         textToWrite.precision(2);
@@ -70,9 +70,10 @@ public:
              << setw(28) << "Object Center" << "Coordinate" << endl;
         cout << left << setw(18) << "-----" << setw(18) << "----------"
              << setw(28) << "---------------" << "------------" << endl;
+        const or_label_table& labels = m_labels.get(or_configuration);
         for (int i = 0; i < array_size; i++)
         {
-            string objName = or_configuration->query_object_name_by_id(localization_data[i].label);
+            const string& objName = labels.name(localization_data[i].label);
             float confidence = localization_data[i].probability;
             rs::core::rect rect = localization_data[i].roi;
             std::stringstream confidenceText;
@@ -119,9 +120,10 @@ public:
                  << setw(28) << "Object Center" << "Coordinate" << endl;
             cout << left << setw(18) << "-----" << setw(18) << "----------"
                  << setw(28) << "---------------" << "------------" << endl;
+            const or_label_table& labels = m_labels.get(or_configuration);
             for (int i = 0; i < array_size; i++)
             {
-                string objName = or_configuration->query_object_name_by_id(localization_data[i].label);
+                const string& objName = labels.name(localization_data[i].label);
                 objects_names.emplace_back(objName);
                 float confidence = localization_data[i].probability;
                 rs::core::rect rect = localization_data[i].roi;
@@ -238,6 +240,7 @@ public:
 protected:
     cv::Mat m_color;
     rs::core::image_info m_colorInfo;
+    or_label_table_cache m_labels;
     static const string IMAGE_WINDOW_NAME;
 };
 
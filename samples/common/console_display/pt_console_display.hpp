@@ -10,6 +10,8 @@
 #include "opencv2/opencv.hpp"
 #include "opencv2/highgui/highgui.hpp"
 
+#include "pt_snapshot.hpp"
+
 using namespace std;
 using namespace rs::person_tracking;
 
@@ -23,9 +25,7 @@ public:
         // Initialize input variables
         prevPeopleInFrame = -1;
         prevPeopleTotal = -1;
-        lastPersonCount = 0;
         totalPersonIncrements = 0;
-        id_set = nullptr;
         need_create_window = true;
 
         prevX = 0.0;
@@ -37,27 +37,15 @@ public:
 
     int on_person_count_update(person_tracking_video_module_interface *ptModule)
     {
-        int numPeopleInFrame = 0;
-        set<int> *new_ids = nullptr;
-
-        new_ids = get_person_ids(ptModule->QueryOutput());
-        numPeopleInFrame = ptModule->QueryOutput()->QueryNumberOfPeople();
-
-        if (numPeopleInFrame > lastPersonCount)
-            totalPersonIncrements += (numPeopleInFrame - lastPersonCount);
-        else if (numPeopleInFrame == lastPersonCount && id_set != nullptr)
-        {
-            set<int> diff;
-            set_difference(id_set->begin(), id_set->end(), new_ids->begin(), new_ids->end(),
-                           inserter(diff, diff.begin()));
-            totalPersonIncrements += diff.size();
-        }
-
-        if (id_set != nullptr)
-            delete id_set;
-        id_set = new_ids;
+        extract_pt_snapshot(ptModule, snapshot, pt_snapshot_tracking);
+        return on_person_count_update(snapshot);
+    }
 
-        lastPersonCount = numPeopleInFrame;
+    // Same as above, for a snapshot of the frame that other displays read too
+    int on_person_count_update(const pt_snapshot &frameSnapshot)
+    {
+        int numPeopleInFrame = frameSnapshot.size();
+        totalPersonIncrements = personCounter.update(frameSnapshot);
 
         if (numPeopleInFrame != prevPeopleInFrame || totalPersonIncrements != prevPeopleTotal)
         {
@@ -175,24 +163,6 @@ public:
         }
     }
 
-    std::set<int> *get_person_ids(Intel::RealSense::PersonTracking::PersonTrackingData *trackingData)
-    {
-        set<int> *id_set = new set<int>;
-        for (int index = 0; index < trackingData->QueryNumberOfPeople(); ++index)
-        {
-            Intel::RealSense::PersonTracking::PersonTrackingData::Person *personData = trackingData->QueryPersonData(
-                        Intel::RealSense::PersonTracking::PersonTrackingData::ACCESS_ORDER_BY_INDEX, index);
-            if (personData)
-            {
-                Intel::RealSense::PersonTracking::PersonTrackingData::PersonTracking *personTrackingData = personData->QueryTracking();
-
-                int id = personTrackingData->QueryId();
-                id_set->insert(id);
-            }
-        }
-        return id_set;
-    }
-
     std::string orientation_to_string(
         Intel::RealSense::PersonTracking::PersonTrackingData::PersonTracking::PersonOrientation orientation)
     {
@@ -310,10 +280,10 @@ public:
     }
 
 protected:
-    std::set<int> *id_set;
+    pt_snapshot snapshot;
+    pt_person_counter personCounter;
     int prevPeopleInFrame;
     int prevPeopleTotal;
-    int lastPersonCount;
     int totalPersonIncrements;
 
     int prevPid;
@@ -0,0 +1,284 @@
+// License: Apache 2.0. See LICENSE file in root directory.
+// Copyright(c) 2017 Intel Corporation. All Rights Reserved.
+
+#pragma once
+
+#include <opencv2/opencv.hpp>
+#include <opencv2/imgproc.hpp>
+#include <opencv2/core.hpp>
+#include <cmath>
+#include <cstdint>
+#include <list>
+#include <string>
+#include <unordered_map>
+#include <utility>
+
+namespace gui_display
+{
+
+// Font and line parameters of the labels, like the arguments of cv::putText and cv::rectangle
+struct label_style
+{
+    int font;
+    double font_scale;
+    int text_thickness;
+    int text_line_type;
+    int box_line_type;
+
+    bool operator==(const label_style& other) const
+    {
+        return font == other.font && font_scale == other.font_scale && text_thickness == other.text_thickness &&
+               text_line_type == other.text_line_type && box_line_type == other.box_line_type;
+    }
+};
+
+// Labels, a filled box with a text in it, rendered once and copied onto the image afterwards.
+//
+// cv::putText rasterizes the Hershey strokes of every character each time it is called. A label
+// is rendered instead into a sprite with a mask of the pixels it covers, and drawing it again
+// copies the sprite through the mask, which sets the same pixels as drawing it directly. Texts
+// with digits, as the distances and percentages that change from frame to frame, are put together
+// from a sprite per character, so every new number doesn't need a sprite of its own. Sprites that
+// weren't drawn recently are evicted when they take more than max_bytes.
+//
+// A mask doesn't keep the partly covered pixels of antialiased text, so antialiased labels are
+// drawn directly, see supports(). Not thread safe.
+class label_sprite_cache
+{
+public:
+    explicit label_sprite_cache(size_t max_bytes = 4 << 20) :
+        m_max_bytes(max_bytes),
+        m_bytes(0),
+        m_text_height(0),
+        m_baseline(0),
+        m_hits(0),
+        m_misses(0)
+    {
+        m_style.font = -1;
+    }
+
+    // Whether labels can be drawn from sprites, box_shift is the shift of cv::rectangle
+    static bool supports(const label_style& style, int box_shift)
+    {
+        return style.text_line_type != cv::LINE_AA && box_shift == 0;
+    }
+
+    // Sprites of another style are dropped
+    void set_style(const label_style& style)
+    {
+        if (style == m_style)
+        {
+            return;
+        }
+        clear();
+        m_style = style;
+
+        // The height and baseline of a text only depend on the font
+        int baseline = 0;
+        m_text_height = cv::getTextSize("", style.font, style.font_scale, style.text_thickness, &baseline).height;
+        m_baseline = baseline + style.text_thickness;
+    }
+
+    // Height of any text, as cv::getTextSize returns it
+    int text_height() const
+    {
+        return m_text_height;
+    }
+
+    // Draws the label box of text the way or_gui_display::draw_text does, text_origin is the bottom left
+    // of the text. color_index identifies the two colors, which are the same for every draw with it.
+    void draw(cv::Mat& image, const std::string& text, cv::Point text_origin, int color_index,
+              const cv::Scalar& background, const cv::Scalar& foreground)
+    {
+        bool has_digits = false;
+        for (char c : text)
+        {
+            has_digits = has_digits || (c >= '0' && c <= '9');
+        }
+        if (!has_digits)
+        {
+            blit(image, get_label(text, color_index, background, foreground), text_origin);
+            return;
+        }
+
+        // The box, then each character where cv::putText would put it
+        double advance = 0;
+        for (char c : text)
+        {
+            advance += get_glyph(c, color_index, foreground).advance;
+        }
+        int width = static_cast<int>(std::lround(advance + m_style.text_thickness));
+        cv::rectangle(image, text_origin + cv::Point(0, m_baseline), text_origin + cv::Point(width, -m_text_height),
+                      background, -1, m_style.box_line_type, 0);
+        advance = 0;
+        for (char c : text)
+        {
+            const sprite& glyph = get_glyph(c, color_index, foreground);
+            blit(image, glyph, text_origin + cv::Point(static_cast<int>(std::lround(advance)), 0));
+            advance += glyph.advance;
+        }
+    }
+
+    void clear()
+    {
+        m_sprites.clear();
+        m_recent.clear();
+        m_bytes = 0;
+    }
+
+    size_t size_bytes() const
+    {
+        return m_bytes;
+    }
+
+    uint64_t hits() const
+    {
+        return m_hits;
+    }
+
+    uint64_t misses() const
+    {
+        return m_misses;
+    }
+
+private:
+    struct sprite
+    {
+        cv::Mat pixels;
+        cv::Mat mask;
+        cv::Point origin;          // of the text, in the sprite
+        double advance;            // of a character sprite
+        size_t bytes;
+        std::list<std::string>::iterator recent;
+    };
+
+    // The label of text, including the box
+    const sprite& get_label(const std::string& text, int color_index, const cv::Scalar& background, const cv::Scalar& foreground)
+    {
+        std::string key = make_key('L', color_index, text);
+        sprite* found = find(key);
+        if (found)
+        {
+            return *found;
+        }
+
+        int baseline = 0;
+        cv::Size size = cv::getTextSize(text, m_style.font, m_style.font_scale, m_style.text_thickness, &baseline);
+        sprite& label = render(key, text, size.width, foreground);
+        cv::Point boxBottomLeft = label.origin + cv::Point(0, m_baseline);
+        cv::Point boxTopRight = label.origin + cv::Point(size.width, -m_text_height);
+        cv::rectangle(label.pixels, boxBottomLeft, boxTopRight, background, -1, m_style.box_line_type, 0);
+        cv::rectangle(label.mask, boxBottomLeft, boxTopRight, cv::Scalar(255), -1, m_style.box_line_type, 0);
+        draw_text(label, text, foreground);
+        return label;
+    }
+
+    const sprite& get_glyph(char c, int color_index, const cv::Scalar& foreground)
+    {
+        std::string text(1, c);
+        std::string key = make_key('G', color_index, text);
+        sprite* found = find(key);
+        if (found)
+        {
+            return *found;
+        }
+
+        // getTextSize rounds the width, the advance of many copies of the character is exact enough
+        const int copies = 64;
+        int width = cv::getTextSize(std::string(copies, c), m_style.font, m_style.font_scale, m_style.text_thickness, nullptr).width;
+        double advance = static_cast<double>(width - m_style.text_thickness) / copies;
+        sprite& glyph = render(key, text, static_cast<int>(std::ceil(advance)), foreground);
+        glyph.advance = advance;
+        draw_text(glyph, text, foreground);
+        return glyph;
+    }
+
+    static std::string make_key(char kind, int color_index, const std::string& text)
+    {
+        std::string key;
+        key.reserve(text.size() + 6);
+        key += kind;
+        key.append(reinterpret_cast<const char*>(&color_index), sizeof(color_index));
+        key += text;
+        return key;
+    }
+
+    sprite* find(const std::string& key)
+    {
+        auto found = m_sprites.find(key);
+        if (found == m_sprites.end())
+        {
+            ++m_misses;
+            return nullptr;
+        }
+        ++m_hits;
+        m_recent.splice(m_recent.begin(), m_recent, found->second.recent);
+        return &found->second;
+    }
+
+    // A blank sprite for a text of width, with room around it for strokes beyond the box
+    sprite& render(const std::string& key, const std::string& text, int width, const cv::Scalar& foreground)
+    {
+        int margin = m_text_height / 2 + m_style.text_thickness;
+        int rows = m_text_height + m_baseline + 2 * margin + 1;
+        int cols = width + 2 * margin + 1;
+
+        m_recent.push_front(key);
+        sprite& s = m_sprites[key];
+        s.pixels.create(rows, cols, CV_8UC3);
+        s.pixels = cv::Scalar(0, 0, 0);
+        s.mask.create(rows, cols, CV_8UC1);
+        s.mask = cv::Scalar(0);
+        s.origin = cv::Point(margin, margin + m_text_height);
+        s.advance = 0;
+        s.bytes = s.pixels.total() * (s.pixels.elemSize() + s.mask.elemSize()) + key.size() + sizeof(sprite);
+        s.recent = m_recent.begin();
+        m_bytes += s.bytes;
+        evict(key);
+        return s;
+    }
+
+    void draw_text(sprite& s, const std::string& text, const cv::Scalar& foreground)
+    {
+        cv::putText(s.pixels, text, s.origin, m_style.font, m_style.font_scale, foreground, m_style.text_thickness, m_style.text_line_type);
+        cv::putText(s.mask, text, s.origin, m_style.font, m_style.font_scale, cv::Scalar(255), m_style.text_thickness, m_style.text_line_type);
+    }
+
+    // Evicts the least recently drawn sprites but keep
+    void evict(const std::string& keep)
+    {
+        while (m_bytes > m_max_bytes && m_recent.size() > 1 && m_recent.back() != keep)
+        {
+            auto oldest = m_sprites.find(m_recent.back());
+            m_bytes -= oldest->second.bytes;
+            m_sprites.erase(oldest);
+            m_recent.pop_back();
+        }
+    }
+
+    // Copies the pixels of s that are inside image, with its text origin at text_origin
+    static void blit(cv::Mat& image, const sprite& s, cv::Point text_origin)
+    {
+        cv::Point topLeft = text_origin - s.origin;
+        cv::Rect target = cv::Rect(topLeft.x, topLeft.y, s.pixels.cols, s.pixels.rows) & cv::Rect(0, 0, image.cols, image.rows);
+        if (target.area() == 0)
+        {
+            return;
+        }
+        cv::Rect source = target - topLeft;
+        cv::Mat destination = image(target);
+        s.pixels(source).copyTo(destination, s.mask(source));
+    }
+
+    size_t m_max_bytes;
+    size_t m_bytes;
+    label_style m_style;
+    int m_text_height;
+    int m_baseline;                   // below the text, including the thickness, as draw_text draws the box
+    std::unordered_map<std::string, sprite> m_sprites;
+    std::list<std::string> m_recent;  // keys, most recently drawn first
+    uint64_t m_hits;
+    uint64_t m_misses;
+};
+
+}
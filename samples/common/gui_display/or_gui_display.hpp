@@ -9,9 +9,20 @@
 #include <opencv2/core.hpp>
 #include <iostream>
 #include <iomanip>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
 
 #include "or_data_interface.h"
 #include "or_configuration_interface.h"
+#include "or_label_table.hpp"
+#include "metrics_registry.hpp"
+#include "label_sprite_cache.hpp"
 
 using namespace std;
 using namespace cv;
@@ -21,20 +32,60 @@ using namespace rs::object_recognition;
 namespace gui_display
 {
 
+// A rectangle to draw over the color image, with its title above it unless the title is empty
+struct gui_overlay
+{
+    cv::Rect rect;
+    int class_id;
+    std::string title;
+};
+
+// Overlays are posted per layer, posting a layer replaces what was posted to it before
+enum gui_overlay_layer
+{
+    gui_overlay_results,
+    gui_overlay_selection,
+    gui_overlay_layer_count
+};
+
 class or_gui_display
 {
 public:
-    or_gui_display()
+    or_gui_display() :
+        m_refresh_rate(0),
+        m_rendering(false),
+        m_new_frame(false),
+        m_overlays_changed(false),
+        m_mouse_callback(nullptr),
+        m_mouse_callback_param(nullptr),
+        m_mouse_callback_changed(false),
+        m_last_key(-1)
+    {
+        // The colors are looked up for every drawn rectangle and title
+        for (int i = 0; i < m_max_classes; i++)
+        {
+            m_colors[i] = cv::Scalar(m_color_arr[i][0], m_color_arr[i][1], m_color_arr[i][2], m_color_arr[i][3]);
+            m_text_colors[i] = cv::Scalar(m_text_arr[i][0], m_text_arr[i][1], m_text_arr[i][2], m_text_arr[i][3]);
+        }
+    }
+
+    ~or_gui_display()
     {
+        stop_rendering();
     }
 
     /**
          * @brief GUI initialization function. Sets default values to private parameters.
          *
+         * @remark With a refresh rate the window belongs to a render thread, which shows the last posted color
+         * image and overlays at that rate, however long processing takes. Images and results are then posted with
+         * post_color_image and post_results instead of being drawn and shown.
+         *
          * @param[in] color_info Information of a color frame from the camera. will be the size of the final window.
          * @param[in] window_name The name of the display window.
+         * @param[in] refresh_rate Frames per second of the render thread, 0 to draw and show from the calling thread.
          */
-    bool initialize(rs::core::image_info color_info, cv::String window_name)
+    bool initialize(rs::core::image_info color_info, cv::String window_name, double refresh_rate = 0)
     {
         m_rect_thickness = 3;
         m_rect_line_type = 8;
@@ -44,13 +95,120 @@ public:
         m_font_scale = 0.75;
         m_text_line_type = 5;
         m_window_name = window_name;
-        cv::namedWindow(window_name,cv::WINDOW_AUTOSIZE);
-        cv::moveWindow(window_name, 0, 0);
         m_image.create(color_info.height, color_info.width, CV_8UC3);
         m_image = 0;
+
+        if (refresh_rate <= 0)
+        {
+            cv::namedWindow(window_name,cv::WINDOW_AUTOSIZE);
+            cv::moveWindow(window_name, 0, 0);
+            return true;
+        }
+
+        // HighGUI isn't thread safe, the render thread creates the window and is the only one to use it
+        m_refresh_rate = refresh_rate;
+        m_posted_image.create(color_info.height, color_info.width, CV_8UC3);
+        m_ready_image.create(color_info.height, color_info.width, CV_8UC3);
+        m_render_source.create(color_info.height, color_info.width, CV_8UC3);
+        register_render_metrics();
+        m_rendering = true;
+        m_render_thread = std::thread(&or_gui_display::render_loop, this);
         return true;
     }
 
+    /**
+         * @brief Stops the render thread, if there is one. Called by the destructor.
+         */
+    void stop_rendering()
+    {
+        m_rendering = false;
+        if (m_render_thread.joinable())
+        {
+            m_render_thread.join();
+        }
+    }
+
+    /**
+         * @brief Sets the mouse callback of the window. With a render thread it is called on that thread.
+         */
+    void set_mouse_callback(cv::MouseCallback callback, void* param)
+    {
+        if (!m_render_thread.joinable())
+        {
+            cv::setMouseCallback(m_window_name, callback, param);
+            return;
+        }
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_mouse_callback = callback;
+        m_mouse_callback_param = param;
+        m_mouse_callback_changed = true;
+    }
+
+    /**
+         * @brief Posts the color image to show next, with a render thread. A posted image that is replaced before
+         * it was shown counts as dropped.
+         *
+         * @param[in] color_img RGB color image of the size given to initialize.
+         */
+    void post_color_image(rs::core::image_interface *color_img)
+    {
+        // The conversion to BGR is left to the render thread
+        memcpy(m_posted_image.data, color_img->query_data(), m_posted_image.elemSize() * m_posted_image.total());
+
+        std::lock_guard<std::mutex> lock(m_mutex);
+        cv::swap(m_posted_image, m_ready_image);
+        if (m_new_frame)
+        {
+            m_dropped_frames->inc();
+        }
+        m_new_frame = true;
+    }
+
+    /**
+         * @brief Replaces the overlays of a layer, with a render thread. overlays is left with the previous ones,
+         * for reuse.
+         */
+    void post_overlays(std::vector<gui_overlay>& overlays, gui_overlay_layer layer = gui_overlay_results)
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_overlays[layer].swap(overlays);
+        m_overlays_changed = true;
+    }
+
+    /**
+         * @brief Posts the tracked objects as the results layer, with a render thread. Like draw_results for tracking
+         * data.
+         *
+         * @param[in] tracking_data The output of the OR Tracking process.
+         * @param[in] array_size The size of the tracking_data array.
+         */
+    void post_results(rs::object_recognition::tracking_data* trackingData, int arraySize)
+    {
+        m_results.resize(arraySize);
+        for (int i = 0; i < arraySize; i++)
+        {
+            m_results[i].rect = cv::Rect(trackingData[i].roi.x, trackingData[i].roi.y, trackingData[i].roi.width, trackingData[i].roi.height);
+            m_results[i].class_id = i;
+            m_results[i].title = get_3D_location_string(trackingData[i].object_center.coordinates);
+        }
+        post_overlays(m_results, gui_overlay_results);
+    }
+
+    /**
+         * @brief Prints how many frames the render thread showed and dropped, and how long rendering took.
+         */
+    void print_render_stats() const
+    {
+        if (!m_rendered_frames)
+        {
+            return;
+        }
+        double renders = static_cast<double>(m_render_seconds->count());
+        cout << "gui: rendered " << m_rendered_frames->value() << " frames, dropped " << m_dropped_frames->value()
+             << ", mean render time " << fixed << setprecision(2)
+             << (renders > 0 ? m_render_seconds->sum() / renders * 1000 : 0.0) << " ms" << endl;
+    }
+
 
     /**
          * @brief Sets new thickness for the drawn bounding rectangles.
@@ -251,25 +409,7 @@ public:
      */
     void draw_text(cv::String text, cv::Point originPoint, int classID)
     {
-        // Getting the rectangle color
-        cv::Scalar color = get_color(classID);
-
-        // Getting title text size
-        int baseline=0;
-        cv::Size nameTextSize = cv::getTextSize(text, m_text_font, m_font_scale, m_text_thickness, &baseline);
-        baseline += m_text_thickness;
-
-        // Getting beginning point of text
-        cv::Point textOrigin(originPoint.x, originPoint.y - nameTextSize.height / 2);
-
-        // Draw the box
-        int filledRectangle = -1;
-        cv::Point originShifted = textOrigin + cv::Point(0, baseline);
-        cv::Point opositeToOrigin = textOrigin + cv::Point(nameTextSize.width, -nameTextSize.height);
-        cv::rectangle(m_image, originShifted, opositeToOrigin, color, filledRectangle, m_rect_line_type, m_rect_shift);
-
-        // Then put the text itself
-        cv::putText(m_image, text, textOrigin, m_text_font, m_font_scale, get_text_color(classID), m_text_thickness, m_text_line_type);
+        draw_text(m_image, text, originPoint, classID);
     }
 
     /**
@@ -282,14 +422,7 @@ public:
      */
     void draw_rect_no_text(cv::Point topLeftPoint, int width, int height, int classID)
     {
-        // Translating the given data to two opposite corners of the rectangle
-        cv::Point* bottomRightPoint = new cv::Point(topLeftPoint.x + width, topLeftPoint.y + height);
-
-        // Getting the rectangle color
-        cv::Scalar color = get_color(classID);
-
-        // Drawing the rectangle
-        cv::rectangle(m_image, topLeftPoint, *bottomRightPoint, color, m_rect_thickness, m_rect_line_type, m_rect_shift);
+        draw_rect_no_text(m_image, topLeftPoint, width, height, classID);
     }
 
 
@@ -307,22 +440,72 @@ public:
      * @return True if rectangle was drawn successfully , false otherwise.
      */
     bool draw_rect(cv::String name, int classID, int x, int y, int width, int height)
+    {
+        return draw_rect(m_image, name, classID, x, y, width, height);
+    }
+
+    // The drawing functions above, drawing on image
+    void draw_text(cv::Mat& image, const cv::String& text, cv::Point originPoint, int classID)
+    {
+        // Labels are drawn from rendered sprites where they look the same
+        if (use_label_sprites())
+        {
+            cv::Point textOrigin(originPoint.x, originPoint.y - m_label_sprites.text_height() / 2);
+            m_label_sprites.draw(image, text, textOrigin, color_index(classID), get_color(classID), get_text_color(classID));
+            return;
+        }
+
+        // Getting the rectangle color
+        cv::Scalar color = get_color(classID);
+
+        // Getting title text size
+        int baseline=0;
+        cv::Size nameTextSize = cv::getTextSize(text, m_text_font, m_font_scale, m_text_thickness, &baseline);
+        baseline += m_text_thickness;
+
+        // Getting beginning point of text
+        cv::Point textOrigin(originPoint.x, originPoint.y - nameTextSize.height / 2);
+
+        // Draw the box
+        int filledRectangle = -1;
+        cv::Point originShifted = textOrigin + cv::Point(0, baseline);
+        cv::Point opositeToOrigin = textOrigin + cv::Point(nameTextSize.width, -nameTextSize.height);
+        cv::rectangle(image, originShifted, opositeToOrigin, color, filledRectangle, m_rect_line_type, m_rect_shift);
+
+        // Then put the text itself
+        cv::putText(image, text, textOrigin, m_text_font, m_font_scale, get_text_color(classID), m_text_thickness, m_text_line_type);
+    }
+
+    void draw_rect_no_text(cv::Mat& image, cv::Point topLeftPoint, int width, int height, int classID)
+    {
+        // Translating the given data to two opposite corners of the rectangle
+        cv::Point bottomRightPoint(topLeftPoint.x + width, topLeftPoint.y + height);
+
+        // Getting the rectangle color
+        cv::Scalar color = get_color(classID);
+
+        // Drawing the rectangle
+        cv::rectangle(image, topLeftPoint, bottomRightPoint, color, m_rect_thickness, m_rect_line_type, m_rect_shift);
+    }
+
+    bool draw_rect(cv::Mat& image, const cv::String& name, int classID, int x, int y, int width, int height)
     {
         if (x ==0 || y == 0)
         {
             return false;
         }
-        // Getting title text size
+        // Getting title text height, which is the same for any text
         int baseline=0;
-        cv::Size nameTextSize = cv::getTextSize(name, m_text_font, m_font_scale, m_text_thickness, &baseline);
+        int nameTextHeight = use_label_sprites() ? m_label_sprites.text_height() :
+                             cv::getTextSize(name, m_text_font, m_font_scale, m_text_thickness, &baseline).height;
 
         int minCoordinateValue = 10;
-        cv::Point* topLeftPoint = new cv::Point(std::max(minCoordinateValue,x),
-                                                std::max(minCoordinateValue  + nameTextSize.height,y));
+        cv::Point topLeftPoint(std::max(minCoordinateValue,x),
+                               std::max(minCoordinateValue  + nameTextHeight,y));
 
-        draw_rect_no_text(*topLeftPoint, width + std::min(x,0), height  + std::min(y,0), classID);
+        draw_rect_no_text(image, topLeftPoint, width + std::min(x,0), height  + std::min(y,0), classID);
 
-        draw_text(name, *topLeftPoint, classID);
+        draw_text(image, name, topLeftPoint, classID);
 
         return true;
     }
@@ -380,10 +563,11 @@ public:
             draw_no_results();
             return false;
         }
+        const or_label_table& labels = m_labels.get(orConfiguration);
         for (int i = 0; i< arraySize; i++)
         {
             cv::String title = "";
-            cv::String objectName = orConfiguration->query_object_name_by_id(localizationData[i].label);
+            cv::String objectName = labels.name(localizationData[i].label);
 
             title = objectName + ": " + std::to_string((int)(localizationData[i].probability * 100)) + "%" +
                     " " + get_3D_location_string(localizationData[i].object_center.coordinates);
@@ -414,7 +598,7 @@ public:
 
         int mostProbableObject = 0;
         cv::String title = "";
-        cv::String objectName = orConfiguration->query_object_name_by_id(recognitionData[mostProbableObject].label);
+        cv::String objectName = m_labels.get(orConfiguration).name(recognitionData[mostProbableObject].label);
         title = objectName + ": " + std::to_string((int)(recognitionData[mostProbableObject].probability * 100)) + "%";
 
         rs::core::rect roi = orConfiguration->query_roi();
@@ -455,10 +639,10 @@ public:
 
             m_objects_IDs_for_tracking_localization.empty();
 
+            const or_label_table& labels = m_labels.get(orConfiguration);
             for (int i = 0 ; i < arraySize ; i++)
             {
-                std::string objectName = orConfiguration->query_object_name_by_id(localizationData[i].label);
-                objectsNames.emplace_back(objectName);
+                objectsNames.emplace_back(labels.name(localizationData[i].label));
                 m_objects_IDs_for_tracking_localization.emplace_back(localizationData[i].label);
             }
 
@@ -510,6 +694,11 @@ public:
      */
     char show_results()
     {
+        // The render thread shows the window, a key is returned once
+        if (m_render_thread.joinable())
+        {
+            return static_cast<char>(m_last_key.exchange(-1));
+        }
         cv::imshow(m_window_name, m_image);
         return cv::waitKey(1);
     }
@@ -525,15 +714,7 @@ public:
      */
     cv::Scalar get_color(int classID)
     {
-        if (classID > m_max_classes || classID < 1)
-        {
-            classID = m_max_classes;
-        }
-
-        return cv::Scalar(m_color_mat.at<unsigned char>(classID - 1, 0),
-                          m_color_mat.at<unsigned char>(classID - 1, 1),
-                          m_color_mat.at<unsigned char>(classID - 1, 2),
-                          m_color_mat.at<unsigned char>(classID - 1, 3));
+        return m_colors[color_index(classID)];
     }
     /**
      * @brief Gets an object ID and returns a text color that suits its unique color.
@@ -547,15 +728,7 @@ public:
      */
     cv::Scalar get_text_color(int classID)
     {
-        if (classID > m_max_classes || classID < 1)
-        {
-            classID = m_max_classes;
-        }
-
-        return cv::Scalar(m_text_mat.at<unsigned char>(classID - 1, 0),
-                          m_text_mat.at<unsigned char>(classID - 1, 1),
-                          m_text_mat.at<unsigned char>(classID - 1, 2),
-                          m_text_mat.at<unsigned char>(classID - 1, 3));
+        return m_text_colors[color_index(classID)];
     }
     /**
      * @brief Gets the 3D location as a string.
@@ -565,13 +738,128 @@ public:
      */
     std::string get_3D_location_string(const rs::core::point3dF32& location) const
     {
-        std::stringstream str_stream;
-        str_stream << std::fixed << std::setprecision(1) << (location.z / 1000);
-        std::string str = "@";
-        str += str_stream.str() + "m";
-        return str;
+        // Formatted for every drawn object, without a stream
+        char text[32];
+        snprintf(text, sizeof(text), "@%.1fm", location.z / 1000);
+        return text;
     }
 protected:
+    // The index of the colors of an object class, unrecognized objects get the last colors
+    static int color_index(int classID)
+    {
+        if (classID > m_max_classes || classID < 1)
+        {
+            classID = m_max_classes;
+        }
+        return classID - 1;
+    }
+
+    // Whether labels are drawn with m_label_sprites, whose style is updated to the current one
+    bool use_label_sprites()
+    {
+        label_style style = { m_text_font, m_font_scale, m_text_thickness, m_text_line_type, m_rect_line_type };
+        if (!label_sprite_cache::supports(style, m_rect_shift))
+        {
+            return false;
+        }
+        m_label_sprites.set_style(style);
+        return true;
+    }
+
+    void register_render_metrics()
+    {
+        static const std::vector<double> render_bounds = { 0.001, 0.002, 0.005, 0.01, 0.02, 0.05, 0.1 };
+        auto& registry = metrics_registry::get_instance();
+        metric_labels labels = { { "window", m_window_name } };
+        m_rendered_frames = &registry.get_counter("rs_gui_frames_rendered_total", "Frames shown by a GUI render thread", labels);
+        m_dropped_frames = &registry.get_counter("rs_gui_frames_dropped_total", "Color images replaced before a GUI render thread showed them", labels);
+        m_render_seconds = &registry.get_histogram("rs_gui_render_seconds", "Time to draw and show a frame of a GUI window", render_bounds, labels);
+    }
+
+    // Shows the last posted image and overlays at the refresh rate, until stop_rendering
+    void render_loop()
+    {
+        cv::namedWindow(m_window_name,cv::WINDOW_AUTOSIZE);
+        cv::moveWindow(m_window_name, 0, 0);
+
+        const auto period = std::chrono::duration_cast<std::chrono::steady_clock::duration>(
+                                std::chrono::duration<double>(1.0 / m_refresh_rate));
+        std::vector<gui_overlay> overlays[gui_overlay_layer_count];
+        auto next_frame = std::chrono::steady_clock::now();
+        bool has_image = false;
+        while (m_rendering)
+        {
+            bool new_frame;
+            bool changed;
+            {
+                std::lock_guard<std::mutex> lock(m_mutex);
+                if (m_mouse_callback_changed)
+                {
+                    cv::setMouseCallback(m_window_name, m_mouse_callback, m_mouse_callback_param);
+                    m_mouse_callback_changed = false;
+                }
+                new_frame = m_new_frame;
+                if (new_frame)
+                {
+                    cv::swap(m_ready_image, m_render_source);
+                    m_new_frame = false;
+                }
+                changed = new_frame || m_overlays_changed;
+                if (m_overlays_changed)
+                {
+                    for (int layer = 0; layer < gui_overlay_layer_count; layer++)
+                    {
+                        overlays[layer] = m_overlays[layer];
+                    }
+                    m_overlays_changed = false;
+                }
+            }
+
+            // Nothing new to show, only the window events are handled
+            has_image = has_image || new_frame;
+            if (changed && has_image)
+            {
+                auto start = std::chrono::steady_clock::now();
+
+                // opencv display working with BGR. The converted image is the canvas, the source stays clean
+                // for redrawing when only the overlays change
+                cv::cvtColor(m_render_source, m_image, CV_RGB2BGR);
+                for (auto& layer : overlays)
+                {
+                    for (auto& overlay : layer)
+                    {
+                        if (overlay.title.empty())
+                        {
+                            draw_rect_no_text(m_image, overlay.rect.tl(), overlay.rect.width, overlay.rect.height, overlay.class_id);
+                        }
+                        else
+                        {
+                            draw_rect(m_image, overlay.title, overlay.class_id, overlay.rect.x, overlay.rect.y,
+                                      overlay.rect.width, overlay.rect.height);
+                        }
+                    }
+                }
+                cv::imshow(m_window_name, m_image);
+                m_render_seconds->observe(std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count());
+                m_rendered_frames->inc();
+            }
+            int key = cv::waitKey(1);
+            if (key >= 0)
+            {
+                m_last_key = key;
+            }
+
+            // A late frame doesn't make the next ones come faster
+            next_frame += period;
+            auto now = std::chrono::steady_clock::now();
+            if (next_frame < now)
+            {
+                next_frame = now;
+            }
+            std::this_thread::sleep_until(next_frame);
+        }
+    }
+
     int m_rect_thickness;
     int m_rect_line_type;
     int m_rect_shift;
@@ -579,9 +867,32 @@ protected:
     int m_text_font;
     double m_font_scale;
     int m_text_line_type;
-    cv::Mat m_image;
+    cv::Mat m_image;                  // canvas, owned by the render thread if there is one
     cv::String m_window_name;
+
+    // Render thread. A posted image moves from m_posted_image to m_ready_image, then to m_render_source
+    // that the render thread converts and draws on m_image; the images are swapped, never copied.
+    double m_refresh_rate;
+    std::thread m_render_thread;
+    std::atomic<bool> m_rendering;
+    std::mutex m_mutex;
+    cv::Mat m_posted_image;           // by the posting thread only
+    cv::Mat m_ready_image;
+    cv::Mat m_render_source;          // by the render thread only
+    bool m_new_frame;
+    std::vector<gui_overlay> m_overlays[gui_overlay_layer_count];
+    bool m_overlays_changed;
+    std::vector<gui_overlay> m_results;
+    cv::MouseCallback m_mouse_callback;
+    void* m_mouse_callback_param;
+    bool m_mouse_callback_changed;
+    std::atomic<int> m_last_key;
+    metric_counter* m_rendered_frames = nullptr;
+    metric_counter* m_dropped_frames = nullptr;
+    metric_histogram* m_render_seconds = nullptr;
     std::vector<int> m_objects_IDs_for_tracking_localization;
+    or_label_table_cache m_labels;
+    label_sprite_cache m_label_sprites;   // used by the thread that draws
 
     static const int m_max_classes = 44;
 
@@ -680,8 +991,8 @@ protected:
         {255,255,255,0},
         {255,255,255,0}
     };
-    const cv::Mat m_color_mat = cv::Mat(m_max_classes, 4, CV_8UC1, const_cast<void*> ( (const void*) ( &m_color_arr) ));
-    const cv::Mat m_text_mat = cv::Mat(m_max_classes, 4, CV_8UC1, const_cast<void*> ( (const void*) ( &m_text_arr) ));
+    cv::Scalar m_colors[m_max_classes];
+    cv::Scalar m_text_colors[m_max_classes];
 };
 
 std::unique_ptr<gui_display::or_gui_display> make_gui_or_display()
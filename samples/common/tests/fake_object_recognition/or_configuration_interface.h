@@ -0,0 +1,7 @@
+// License: Apache 2.0. See LICENSE file in root directory.
+// Copyright(c) 2017 Intel Corporation. All Rights Reserved.
+
+#pragma once
+
+// The fake object recognition module declares all its classes in one header
+#include "or_video_module_impl.h"
@@ -0,0 +1,158 @@
+// License: Apache 2.0. See LICENSE file in root directory.
+// Copyright(c) 2017 Intel Corporation. All Rights Reserved.
+
+#pragma once
+
+//
+// A fake of the object recognition module for the tests, with the parts of its interface that
+// or_engine_pool uses. Localization finds one object whose label is the frame number of the color
+// image; tracking returns the tracking rois moved right by the frame number. Processing a frame
+// takes between 1 and 5 ms, depending on the frame number, so engines finish out of order.
+//
+
+#include <atomic>
+#include <chrono>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "rs_sdk.h"
+
+namespace rs
+{
+namespace object_recognition
+{
+enum class recognition_mode
+{
+    SINGLE_RECOGNITION,
+    LOCALIZATION,
+    TRACKING
+};
+
+struct localization_data
+{
+    int label;
+    float probability;
+    rs::core::rect roi;
+};
+
+struct tracking_data
+{
+    rs::core::rect roi;
+};
+
+class or_video_module_impl;
+
+class or_data_interface
+{
+public:
+    explicit or_data_interface(or_video_module_impl* module) : m_module(module) {}
+
+    rs::core::status query_localization_result(localization_data** data, int& count);
+    rs::core::status query_tracking_result(tracking_data** data, int& count);
+
+private:
+    or_video_module_impl* m_module;
+};
+
+class or_configuration_interface
+{
+public:
+    explicit or_configuration_interface(or_video_module_impl* module) : m_module(module) {}
+
+    void set_recognition_mode(recognition_mode mode);
+    void set_tracking_rois(const rs::core::rect* rois, int count);
+
+    rs::core::status apply_changes()
+    {
+        return rs::core::status_no_error;
+    }
+
+    std::string query_object_name_by_id(int id)
+    {
+        return "object " + std::to_string(id);
+    }
+
+private:
+    or_video_module_impl* m_module;
+};
+
+class or_video_module_impl
+{
+public:
+    or_video_module_impl() : m_mode(recognition_mode::LOCALIZATION), m_output(this), m_configuration(this), m_busy(false) {}
+
+    rs::core::status set_module_config(rs::core::video_module_interface::actual_module_config& config)
+    {
+        return rs::core::status_no_error;
+    }
+
+    or_data_interface* create_output()
+    {
+        return &m_output;
+    }
+
+    or_configuration_interface* create_active_configuration()
+    {
+        return &m_configuration;
+    }
+
+    // Fails if the engine is already processing a frame, as the real one isn't thread safe
+    rs::core::status process_sample_set(rs::core::correlated_sample_set& sample_set)
+    {
+        if (m_busy.exchange(true))
+        {
+            return rs::core::status_process_failed;
+        }
+        int frame = static_cast<int>(sample_set[rs::core::stream_type::color]->query_frame_number());
+        std::this_thread::sleep_for(std::chrono::milliseconds(1 + (frame * 7) % 5));
+
+        m_localization.assign(1, localization_data { frame, 0.9f, { frame, 0, 10, 10 } });
+        m_tracking.clear();
+        for (rs::core::rect roi : m_rois)
+        {
+            roi.x += frame;
+            m_tracking.push_back(tracking_data { roi });
+        }
+        m_busy = false;
+        return rs::core::status_no_error;
+    }
+
+private:
+    friend class or_data_interface;
+    friend class or_configuration_interface;
+
+    recognition_mode m_mode;
+    std::vector<rs::core::rect> m_rois;
+    std::vector<localization_data> m_localization;
+    std::vector<tracking_data> m_tracking;
+    or_data_interface m_output;
+    or_configuration_interface m_configuration;
+    std::atomic<bool> m_busy;
+};
+
+inline rs::core::status or_data_interface::query_localization_result(localization_data** data, int& count)
+{
+    *data = m_module->m_localization.data();
+    count = static_cast<int>(m_module->m_localization.size());
+    return rs::core::status_no_error;
+}
+
+inline rs::core::status or_data_interface::query_tracking_result(tracking_data** data, int& count)
+{
+    *data = m_module->m_tracking.data();
+    count = static_cast<int>(m_module->m_tracking.size());
+    return rs::core::status_no_error;
+}
+
+inline void or_configuration_interface::set_recognition_mode(recognition_mode mode)
+{
+    m_module->m_mode = mode;
+}
+
+inline void or_configuration_interface::set_tracking_rois(const rs::core::rect* rois, int count)
+{
+    m_module->m_rois.assign(rois, rois + count);
+}
+}
+}
@@ -0,0 +1,218 @@
+// License: Apache 2.0. See LICENSE file in root directory.
+// Copyright(c) 2017 Intel Corporation. All Rights Reserved.
+
+//
+// or_engine_pool_test: Runs or_engine_pool over the fake object recognition module in
+// fake_object_recognition, whose engines finish their frames out of order, and checks that the
+// results come out in the order the frames were accepted, that tracking results are merged in roi
+// order with the rois the frame was accepted with, that an engine without rois doesn't count the
+// frames it passes on as processed, and that every image is released.
+//
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <iostream>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "or_engine_pool.hpp"
+
+using namespace std;
+using namespace rs::core;
+using namespace rs::object_recognition;
+
+namespace
+{
+int failures = 0;
+atomic<int> live_images(0);
+
+void check(bool condition, const string& what)
+{
+    if (!condition)
+    {
+        cout << "FAILED: " << what << endl;
+        ++failures;
+    }
+}
+
+class image_counter : public release_interface
+{
+public:
+    explicit image_counter(uint8_t* data) : m_data(data)
+    {
+        ++live_images;
+    }
+
+    int release() const override
+    {
+        delete[] m_data;
+        --live_images;
+        delete this;
+        return 0;
+    }
+
+private:
+    uint8_t* m_data;
+};
+
+image_interface* make_image(stream_type stream, uint64_t frame_number)
+{
+    image_info info = {};
+    info.width = 4;
+    info.height = 4;
+    info.format = stream == stream_type::color ? pixel_format::rgb8 : pixel_format::z16;
+    info.pitch = info.width * (stream == stream_type::color ? 3 : 2);
+    uint8_t* data = new uint8_t[info.pitch * info.height]();
+    return image_interface::create_instance_from_raw_data(&info, image_interface::image_data_with_data_releaser(data, new image_counter(data)),
+                                                          stream, image_interface::flag::any, frame_number * 33.0, frame_number);
+}
+
+// The results the pool delivered, with the frame number each accepted frame had
+struct collector
+{
+    mutex m;
+    condition_variable delivered;
+    vector<or_frame_result> results;
+    vector<int> accepted_frames;
+
+    void on_result(or_frame_result& result)
+    {
+        lock_guard<mutex> lock(m);
+        results.push_back(result);
+        delivered.notify_all();
+    }
+
+    bool wait_for(size_t count)
+    {
+        unique_lock<mutex> lock(m);
+        return delivered.wait_for(lock, chrono::seconds(10), [&] { return results.size() >= count; });
+    }
+};
+
+// Offers frames first_frame.. until count are accepted, like a capture loop that doesn't wait
+void submit_frames(or_engine_pool& pool, collector& results, int first_frame, int count)
+{
+    int accepted = 0;
+    for (int frame = first_frame; accepted < count; ++frame)
+    {
+        correlated_sample_set sample_set = {};
+        sample_set[stream_type::color] = make_image(stream_type::color, frame);
+        sample_set[stream_type::depth] = make_image(stream_type::depth, frame);
+        if (pool.submit(sample_set))
+        {
+            lock_guard<mutex> lock(results.m);
+            results.accepted_frames.push_back(frame);
+            ++accepted;
+        }
+        sample_set[stream_type::color]->release();
+        sample_set[stream_type::depth]->release();
+        this_thread::sleep_for(chrono::microseconds(500));
+    }
+}
+
+void test_localization()
+{
+    or_engine_pool pool;
+    video_module_interface::actual_module_config config = {};
+    check(pool.init(config, 4) == status_no_error, "init 4 engines");
+    collector results;
+    pool.set_result_handler([&](or_frame_result& result) { results.on_result(result); });
+    check(pool.configure(recognition_mode::LOCALIZATION, nullptr) == status_no_error, "configure localization");
+    pool.start();
+
+    const int frames = 200;
+    submit_frames(pool, results, 0, frames);
+    check(results.wait_for(frames), "all localization results delivered");
+    pool.stop();
+
+    uint64_t processed = 0;
+    bool all_busy = true;
+    for (size_t i = 0; i < pool.get_engine_count(); ++i)
+    {
+        processed += pool.query_engine_stats(i).processed;
+        all_busy = all_busy && pool.query_engine_stats(i).processed > 0;
+    }
+    check(processed == frames, "every accepted frame processed once");
+    check(all_busy, "every engine processed frames");
+
+    check(results.results.size() == frames, "one result per accepted frame");
+    for (size_t i = 0; i < results.results.size(); ++i)
+    {
+        const or_frame_result& result = results.results[i];
+        check(result.sequence == i, "results in the order the frames were accepted");
+        check(result.status == status_no_error, "localization succeeded");
+        check(result.localization.size() == 1 && result.localization[0].label == results.accepted_frames[i],
+              "localization result of frame " + to_string(results.accepted_frames[i]));
+        check(result.timestamp == results.accepted_frames[i] * 33.0, "timestamp of the color image");
+    }
+}
+
+void test_tracking()
+{
+    or_engine_pool pool;
+    video_module_interface::actual_module_config config = {};
+    check(pool.init(config, 2) == status_no_error, "init 2 engines");
+    collector results;
+    pool.set_result_handler([&](or_frame_result& result) { results.on_result(result); });
+    pool.start();
+
+    // Three rois over two engines: engine 0 tracks the first one, engine 1 the other two
+    const rect rois[] = { { 0, 0, 10, 10 }, { 100, 0, 10, 10 }, { 200, 0, 10, 10 } };
+    check(pool.start_tracking(rois, 3) == status_no_error, "start tracking");
+    const uint64_t first_generation = pool.query_tracking_generation();
+    const int frames = 50;
+    submit_frames(pool, results, 0, frames);
+    check(results.wait_for(frames), "all tracking results delivered");
+    const uint64_t engine0_processed = pool.query_engine_stats(0).processed;
+    check(engine0_processed == frames, "engine 0 tracked every frame");
+
+    // One roi over the same two engines: engine 0 has none and passes its frames on
+    const rect moved[] = { { 300, 0, 10, 10 } };
+    check(pool.update_tracking_rois(moved, 1) == status_no_error, "update tracking rois");
+    submit_frames(pool, results, 1000, frames);
+    check(results.wait_for(2 * frames), "all results after the update delivered");
+    pool.stop();
+    check(pool.query_engine_stats(0).processed == engine0_processed, "frames passed on aren't counted as processed");
+    check(pool.query_engine_stats(1).processed == 2 * frames, "engine 1 tracked every frame");
+
+    for (size_t i = 0; i < results.results.size(); ++i)
+    {
+        const or_frame_result& result = results.results[i];
+        const int frame = results.accepted_frames[i];
+        check(result.sequence == i, "tracking results in the order the frames were accepted");
+        check(result.status == status_no_error, "tracking succeeded");
+        bool updated = i >= frames;
+        check(result.tracking_generation == (updated ? first_generation + 1 : first_generation), "generation of the rois of the frame");
+        const rect* expected = updated ? moved : rois;
+        size_t expected_count = updated ? 1 : 3;
+        bool same = result.tracking.size() == expected_count;
+        for (size_t r = 0; same && r < expected_count; ++r)
+        {
+            same = result.tracking[r].roi.x == expected[r].x + frame;
+        }
+        check(same, "tracking results of frame " + to_string(frame) + " in roi order");
+    }
+
+    check(pool.configure(recognition_mode::LOCALIZATION, nullptr) == status_no_error, "back to localization");
+    check(pool.update_tracking_rois(moved, 1) != status_no_error, "updating rois needs tracking");
+}
+}
+
+int main()
+{
+    test_localization();
+    test_tracking();
+    check(live_images == 0, "every image released, " + to_string(live_images.load()) + " left");
+
+    if (failures)
+    {
+        cout << failures << " checks failed" << endl;
+        return 1;
+    }
+    cout << "or_engine_pool_test passed" << endl;
+    return 0;
+}
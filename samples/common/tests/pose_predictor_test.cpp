@@ -0,0 +1,159 @@
+// License: Apache 2.0. See LICENSE file in root directory.
+// Copyright(c) 2017 Intel Corporation. All Rights Reserved.
+
+//
+// pose_predictor_test: Replays a synthetic IMU trace through pose_predictor, the camera turning
+// at a constant rate about the gravity axis while moving at a constant velocity, and checks the
+// extrapolated poses against the closed form: the rotation follows the gyro past the anchor pose,
+// the position follows the velocity of the last two SLAM poses up to the horizon and is held
+// beyond it, and a late SLAM pose is re-anchored on with the newer samples replayed.
+//
+
+#include <chrono>
+#include <cmath>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include "pose_predictor.hpp"
+
+using namespace std;
+
+namespace
+{
+const double imu_period_ms = 5.0;
+const float yaw_rate = 1.0f;                     // rad/s about y, the gravity axis
+const float velocity = 1.0f;                     // m/s along x
+const float gravity = 9.81f;
+const double horizon_ms = 100.0;
+
+int failures = 0;
+
+void check(bool condition, const string& what)
+{
+    if (!condition)
+    {
+        cout << "FAILED: " << what << endl;
+        ++failures;
+    }
+}
+
+// Pose rotated by angle about y, at x along the x axis
+void make_pose(float angle, float x, float pose[12])
+{
+    float c = cos(angle);
+    float s = sin(angle);
+    float values[12] =
+    {
+        c,    0.0f, s,    x,
+        0.0f, 1.0f, 0.0f, 0.0f,
+        -s,   0.0f, c,    0.0f
+    };
+    copy(values, values + 12, pose);
+}
+
+void check_pose(const predicted_pose& predicted, float angle, float x, const string& what)
+{
+    float expected[12];
+    make_pose(angle, x, expected);
+    float error = 0.0f;
+    for (int i = 0; i < 12; ++i)
+    {
+        error = max(error, fabs(predicted.pose[i] - expected[i]));
+    }
+    check(error < 1e-4f, what + ": pose off by " + to_string(error));
+}
+
+// One gyro and one accel sample at each timestamp. At rest the accelerometer reads gravity, which
+// stays on the y axis of the camera as it only turns about y.
+vector<imu_sample> make_trace(double from_ms, double to_ms)
+{
+    vector<imu_sample> trace;
+    for (double t = from_ms + imu_period_ms; t <= to_ms + 1e-9; t += imu_period_ms)
+    {
+        imu_sample gyro = {};
+        gyro.timestamp = t;
+        gyro.type = rs::core::motion_type::gyro;
+        gyro.data[1] = yaw_rate;
+        trace.push_back(gyro);
+
+        imu_sample accel = {};
+        accel.timestamp = t;
+        accel.type = rs::core::motion_type::accel;
+        accel.data[1] = gravity;
+        trace.push_back(accel);
+    }
+    return trace;
+}
+
+float yaw_at(double t_ms)
+{
+    return static_cast<float>(yaw_rate * t_ms / 1000.0);
+}
+}
+
+int main()
+{
+    pose_predictor predictor(horizon_ms);
+    predicted_pose predicted;
+    check(!predictor.get_latest(predicted), "no pose before the first SLAM pose");
+    check(!predictor.wait_for_update(0, chrono::milliseconds(1)), "no update before the first SLAM pose");
+
+    // Two SLAM poses 100 ms apart give the velocity
+    float pose[12];
+    make_pose(0.0f, 0.0f, pose);
+    predictor.on_slam_pose(0.0, pose, 3);
+    make_pose(yaw_at(100.0), 0.1f, pose);
+    predictor.on_slam_pose(100.0, pose, 3);
+
+    uint32_t version = predictor.get_version();
+    check(predictor.get_latest(predicted), "pose after the SLAM poses");
+    check_pose(predicted, yaw_at(100.0), 0.1f, "anchor pose");
+
+    // Within the horizon: rotation and translation are extrapolated
+    vector<imu_sample> trace = make_trace(100.0, 150.0);
+    predictor.add_imu_samples(trace.data(), trace.size());
+    check(predictor.wait_for_update(version, chrono::milliseconds(1)), "update after IMU samples");
+    uint32_t loaded_version = 0;
+    check(predictor.get_latest(predicted, &loaded_version), "pose after IMU samples");
+    check(loaded_version == predictor.get_version() && loaded_version == version + trace.size(), "one version per IMU sample");
+
+    check(predicted.timestamp == 150.0 && predicted.anchor_timestamp == 100.0, "timestamps within the horizon");
+    check(predicted.imu_samples == trace.size(), "samples integrated within the horizon");
+    check_pose(predicted, yaw_at(150.0), 0.15f, "within the horizon");
+
+    // Beyond the horizon: the rotation keeps following the gyro, the position is held
+    trace = make_trace(150.0, 300.0);
+    predictor.add_imu_samples(trace.data(), trace.size());
+    predictor.get_latest(predicted);
+    check(predicted.timestamp == 300.0, "timestamp beyond the horizon");
+    check_pose(predicted, yaw_at(300.0), static_cast<float>(0.1 + velocity * horizon_ms / 1000.0), "beyond the horizon");
+
+    // A SLAM pose that arrives late is re-anchored on and the newer samples are replayed
+    make_pose(yaw_at(250.0), 0.25f, pose);
+    predictor.on_slam_pose(250.0, pose, 2);
+    predictor.get_latest(predicted);
+    check(predicted.anchor_timestamp == 250.0 && predicted.tracking == 2, "re-anchored on the late pose");
+    check(predicted.imu_samples == 2 * 10, "samples replayed after the late pose");
+    check_pose(predicted, yaw_at(300.0), 0.3f, "replayed after the late pose");
+
+    // Older poses are ignored
+    version = predictor.get_version();
+    predictor.on_slam_pose(200.0, pose, 3);
+    check(predictor.get_version() == version, "older SLAM pose ignored");
+
+    // A single sample from the motion callback publishes right away
+    trace = make_trace(300.0, 300.0 + imu_period_ms);
+    predictor.add_imu_sample(trace[0]);
+    check(predictor.get_version() == version + 1, "prediction published per sample");
+    predictor.get_latest(predicted);
+    check(predicted.timestamp == trace[0].timestamp, "timestamp of the single sample");
+
+    if (failures)
+    {
+        cout << failures << " checks failed" << endl;
+        return 1;
+    }
+    cout << "pose_predictor_test passed" << endl;
+    return 0;
+}
@@ -0,0 +1,56 @@
+// License: Apache 2.0. See LICENSE file in root directory.
+// Copyright(c) 2017 Intel Corporation. All Rights Reserved.
+
+#pragma once
+
+#include <cstddef>
+
+#include "rs/core/types.h"
+
+// A 4x4 affine transform, like the camera pose reported by SLAM, for transforming points without
+// going through cv::Mat. Only the top three rows are kept, the last one is always 0 0 0 1.
+class affine_transform
+{
+public:
+    // pose: 16 floats, row major. Points are multiplied by input_scale before they are transformed,
+    // 0.001 transforms points in millimeters, as the OR and PT modules report them, to meters.
+    static affine_transform from_pose(const float* pose, float input_scale = 1.0f)
+    {
+        affine_transform transform;
+        for (int row = 0; row < 3; ++row)
+        {
+            for (int column = 0; column < 3; ++column)
+            {
+                transform.m_rows[row][column] = pose[row * 4 + column] * input_scale;
+            }
+            transform.m_rows[row][3] = pose[row * 4 + 3];
+        }
+        return transform;
+    }
+
+    rs::core::point3dF32 apply(const rs::core::point3dF32& point) const
+    {
+        rs::core::point3dF32 result;
+        apply(&point, &result, 1);
+        return result;
+    }
+
+    // Transforms count points from in to out, which may be the same array. The loop has no
+    // branches or aliasing between the rows, so the compiler can vectorize it.
+    void apply(const rs::core::point3dF32* in, rs::core::point3dF32* out, size_t count) const
+    {
+        const float r00 = m_rows[0][0], r01 = m_rows[0][1], r02 = m_rows[0][2], t0 = m_rows[0][3];
+        const float r10 = m_rows[1][0], r11 = m_rows[1][1], r12 = m_rows[1][2], t1 = m_rows[1][3];
+        const float r20 = m_rows[2][0], r21 = m_rows[2][1], r22 = m_rows[2][2], t2 = m_rows[2][3];
+        for (size_t i = 0; i < count; ++i)
+        {
+            const float x = in[i].x, y = in[i].y, z = in[i].z;
+            out[i].x = r00 * x + r01 * y + r02 * z + t0;
+            out[i].y = r10 * x + r11 * y + r12 * z + t1;
+            out[i].z = r20 * x + r21 * y + r22 * z + t2;
+        }
+    }
+
+private:
+    float m_rows[3][4];
+};
@@ -0,0 +1,274 @@
+// License: Apache 2.0. See LICENSE file in root directory.
+// Copyright(c) 2017 Intel Corporation. All Rights Reserved.
+
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <rs_sdk.h>
+
+#include "pipeline_trace.hpp"
+
+// Holds a reference on each image of a sample set: copies add a reference, destruction releases it
+class sample_set_ref
+{
+public:
+    sample_set_ref() : m_set() {}
+
+    explicit sample_set_ref(const rs::core::correlated_sample_set& set) : m_set(set)
+    {
+        add_refs();
+    }
+
+    sample_set_ref(const sample_set_ref& other) : m_set(other.m_set)
+    {
+        add_refs();
+    }
+
+    sample_set_ref(sample_set_ref&& other) : m_set(other.m_set)
+    {
+        other.m_set = rs::core::correlated_sample_set();
+    }
+
+    sample_set_ref& operator=(sample_set_ref other)
+    {
+        std::swap(m_set, other.m_set);
+        return *this;
+    }
+
+    ~sample_set_ref()
+    {
+        reset();
+    }
+
+    void reset()
+    {
+        for (auto& image : m_set.images)
+        {
+            if (image)
+            {
+                image->release();
+                image = nullptr;
+            }
+        }
+    }
+
+    bool empty() const
+    {
+        for (auto image : m_set.images)
+        {
+            if (image)
+            {
+                return false;
+            }
+        }
+        return true;
+    }
+
+    rs::core::correlated_sample_set& get()
+    {
+        return m_set;
+    }
+
+private:
+    void add_refs()
+    {
+        for (auto image : m_set.images)
+        {
+            if (image)
+            {
+                image->add_ref();
+            }
+        }
+    }
+
+    rs::core::correlated_sample_set m_set;
+};
+
+// Hands every captured sample set to several consumers, so they all see the same frame.
+//
+// Consumers added with add_consumer() run on the capture thread inside dispatch(). Each worker
+// added with add_worker() has its own thread and a queue of queue_size sample sets; when a busy
+// worker's queue is full the oldest waiting set is dropped and counts as skipped, so a slow worker
+// (object recognition) never holds back the capture loop. With the default queue_size of 1 the
+// worker always processes the newest sample set.
+class frame_dispatcher
+{
+public:
+    typedef std::function<void(rs::core::correlated_sample_set& sample_set)> consumer;
+
+    frame_dispatcher() {}
+
+    frame_dispatcher(const frame_dispatcher&) = delete;
+    frame_dispatcher& operator=(const frame_dispatcher&) = delete;
+
+    ~frame_dispatcher()
+    {
+        stop();
+    }
+
+    void add_consumer(consumer callback)
+    {
+        m_consumers.push_back(callback);
+    }
+
+    void add_worker(const std::string& name, consumer callback, size_t queue_size = 1)
+    {
+        std::unique_ptr<worker> new_worker(new worker(name, callback, queue_size > 0 ? queue_size : 1));
+        new_worker->thread = std::thread(&frame_dispatcher::run_worker, new_worker.get());
+        m_workers.push_back(std::move(new_worker));
+    }
+
+    void dispatch(const rs::core::correlated_sample_set& sample_set)
+    {
+        for (auto& w : m_workers)
+        {
+            sample_set_ref ref(sample_set);
+            {
+                std::lock_guard<std::mutex> lock(w->mutex);
+                if (w->pending.size() == w->queue_size)
+                {
+                    w->pending.pop_front();
+                    ++w->skipped;
+                }
+                w->pending.push_back(std::move(ref));
+                if (w->pending.size() > w->max_queue_depth)
+                {
+                    w->max_queue_depth = w->pending.size();
+                }
+            }
+            w->wake.notify_one();
+        }
+
+        rs::core::correlated_sample_set inline_set = sample_set;
+        for (auto& callback : m_consumers)
+        {
+            callback(inline_set);
+        }
+    }
+
+    // Lets the workers finish the sample set they are processing and joins them;
+    // waiting sample sets are dropped
+    void stop()
+    {
+        for (auto& w : m_workers)
+        {
+            {
+                std::lock_guard<std::mutex> lock(w->mutex);
+                w->stopping = true;
+                w->pending.clear();
+            }
+            w->wake.notify_one();
+        }
+        for (auto& w : m_workers)
+        {
+            if (w->thread.joinable())
+            {
+                w->thread.join();
+            }
+        }
+    }
+
+    // Sample sets a worker processed, and the ones it skipped because it was busy
+    uint64_t get_processed(size_t worker_index) const
+    {
+        return m_workers[worker_index]->processed;
+    }
+
+    uint64_t get_skipped(size_t worker_index) const
+    {
+        return m_workers[worker_index]->skipped;
+    }
+
+    // Sample sets waiting for a worker, now and at most
+    size_t get_queue_depth(size_t worker_index) const
+    {
+        std::lock_guard<std::mutex> lock(m_workers[worker_index]->mutex);
+        return m_workers[worker_index]->pending.size();
+    }
+
+    size_t get_max_queue_depth(size_t worker_index) const
+    {
+        return m_workers[worker_index]->max_queue_depth;
+    }
+
+    // Fraction of the time since the worker started that it spent in its callback
+    double get_busy_ratio(size_t worker_index) const
+    {
+        const worker& w = *m_workers[worker_index];
+        int64_t elapsed_ns = now_ns() - w.start_ns;
+        return elapsed_ns > 0 ? static_cast<double>(w.busy_ns) / elapsed_ns : 0.0;
+    }
+
+private:
+    struct worker
+    {
+        worker(const std::string& worker_name, consumer worker_callback, size_t worker_queue_size) :
+            name(worker_name),
+            callback(worker_callback),
+            queue_size(worker_queue_size),
+            stopping(false),
+            processed(0),
+            skipped(0),
+            max_queue_depth(0),
+            busy_ns(0),
+            start_ns(now_ns())
+        {
+        }
+
+        const std::string name;
+        const consumer callback;
+        const size_t queue_size;
+        std::thread thread;
+        mutable std::mutex mutex;
+        std::condition_variable wake;
+        std::deque<sample_set_ref> pending;
+        bool stopping;
+        std::atomic<uint64_t> processed;
+        std::atomic<uint64_t> skipped;
+        std::atomic<size_t> max_queue_depth;
+        std::atomic<int64_t> busy_ns;
+        const int64_t start_ns;
+    };
+
+    static int64_t now_ns()
+    {
+        return std::chrono::duration_cast<std::chrono::nanoseconds>(
+                   std::chrono::steady_clock::now().time_since_epoch()).count();
+    }
+
+    static void run_worker(worker* w)
+    {
+        TRACE_THREAD_NAME(w->name);
+        while (true)
+        {
+            sample_set_ref current;
+            {
+                std::unique_lock<std::mutex> lock(w->mutex);
+                w->wake.wait(lock, [w] { return w->stopping || !w->pending.empty(); });
+                if (w->stopping)
+                {
+                    return;
+                }
+                current = std::move(w->pending.front());
+                w->pending.pop_front();
+            }
+            int64_t begin_ns = now_ns();
+            w->callback(current.get());
+            w->busy_ns += now_ns() - begin_ns;
+            ++w->processed;
+        }
+    }
+
+    std::vector<consumer> m_consumers;
+    std::vector<std::unique_ptr<worker>> m_workers;
+};
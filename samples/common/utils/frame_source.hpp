@@ -0,0 +1,482 @@
+// License: Apache 2.0. See LICENSE file in root directory.
+// Copyright(c) 2017 Intel Corporation. All Rights Reserved.
+
+#pragma once
+
+#include <chrono>
+#include <cmath>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <iostream>
+#include <map>
+#include <mutex>
+#include <vector>
+
+#include <librealsense/rs.hpp>
+#include <rs_sdk.h>
+#include <rs/utils/librealsense_conversion_utils.h>
+
+// Bytes per pixel of the formats the sources produce, 0 for the others
+inline int pixel_format_size(rs::core::pixel_format format)
+{
+    switch (format)
+    {
+    case rs::core::pixel_format::rgb8:
+    case rs::core::pixel_format::bgr8:
+        return 3;
+    case rs::core::pixel_format::rgba8:
+    case rs::core::pixel_format::bgra8:
+        return 4;
+    case rs::core::pixel_format::z16:
+    case rs::core::pixel_format::y16:
+    case rs::core::pixel_format::raw16:
+        return 2;
+    case rs::core::pixel_format::y8:
+    case rs::core::pixel_format::raw8:
+        return 1;
+    default:
+        return 0;
+    }
+}
+
+// Source of camera samples for the samples' capture paths: the live camera, or a synthetic or
+// recorded source that behaves like one. Images are delivered through per-stream callbacks on
+// the source's thread; an image is only valid during the callback unless the callback add_ref()s it.
+class frame_source
+{
+public:
+    typedef std::function<void(rs::core::image_interface* image)> image_callback;
+    typedef std::function<void(const rs::core::motion_sample& sample)> motion_callback;
+
+    virtual ~frame_source() {}
+
+    virtual const char* get_name() const = 0;
+
+    virtual bool supports_stream(rs::core::stream_type stream, int width, int height, rs::core::pixel_format format, int fps) = 0;
+    virtual bool enable_stream(rs::core::stream_type stream, int width, int height, rs::core::pixel_format format, int fps) = 0;
+    virtual void set_image_callback(rs::core::stream_type stream, image_callback callback) = 0;
+
+    virtual bool supports_motion() = 0;
+    virtual void enable_motion(motion_callback callback) = 0;
+
+    virtual rs::core::intrinsics get_intrinsics(rs::core::stream_type stream) = 0;
+    virtual rs::core::extrinsics get_extrinsics(rs::core::stream_type from, rs::core::stream_type to) = 0;
+    virtual rs::core::motion_device_intrinsics get_motion_intrinsics(rs::core::motion_type motion) = 0;
+    // Extrinsics from the motion module to an image stream
+    virtual rs::core::extrinsics get_motion_extrinsics(rs::core::stream_type stream) = 0;
+
+    virtual void start() = 0;
+    // No image or motion callback runs after stop() returns
+    virtual void stop() = 0;
+    virtual bool is_streaming() = 0;
+
+    // False if the source delivers samples as fast as they are consumed
+    virtual bool is_real_time() const
+    {
+        return true;
+    }
+
+    // The camera behind the source, nullptr if there is none
+    virtual rs::device* get_device()
+    {
+        return nullptr;
+    }
+};
+
+// frame_source over a librealsense device
+class device_frame_source : public frame_source
+{
+public:
+    explicit device_frame_source(rs::device* device) :
+        m_device(device),
+        m_motion_enabled(false),
+        m_sources(rs::source::video)
+    {
+    }
+
+    ~device_frame_source()
+    {
+        stop();
+    }
+
+    const char* get_name() const override
+    {
+        return m_device->get_name();
+    }
+
+    bool supports_stream(rs::core::stream_type stream, int width, int height, rs::core::pixel_format format, int fps) override
+    {
+        rs::stream lrs_stream = rs::utils::convert_stream_type(stream);
+        for (int i = 0; i < m_device->get_stream_mode_count(lrs_stream); i++)
+        {
+            int mode_width, mode_height, mode_fps;
+            rs::format mode_format;
+            m_device->get_stream_mode(lrs_stream, i, mode_width, mode_height, mode_format, mode_fps);
+            if (mode_width == width && mode_height == height && mode_fps == fps &&
+                rs::utils::convert_pixel_format(mode_format) == format)
+            {
+                return true;
+            }
+        }
+        return false;
+    }
+
+    bool enable_stream(rs::core::stream_type stream, int width, int height, rs::core::pixel_format format, int fps) override
+    {
+        m_device->enable_stream(rs::utils::convert_stream_type(stream), width, height, rs::utils::convert_pixel_format(format), fps);
+        m_enabled_streams.push_back(stream);
+        return true;
+    }
+
+    void set_image_callback(rs::core::stream_type stream, image_callback callback) override
+    {
+        m_image_callbacks[stream] = callback;
+    }
+
+    bool supports_motion() override
+    {
+        return m_device->supports(rs::capabilities::motion_events);
+    }
+
+    void enable_motion(motion_callback callback) override
+    {
+        m_motion_callback = callback;
+        m_motion_enabled = true;
+    }
+
+    rs::core::intrinsics get_intrinsics(rs::core::stream_type stream) override
+    {
+        return rs::utils::convert_intrinsics(m_device->get_stream_intrinsics(rs::utils::convert_stream_type(stream)));
+    }
+
+    rs::core::extrinsics get_extrinsics(rs::core::stream_type from, rs::core::stream_type to) override
+    {
+        return rs::utils::convert_extrinsics(m_device->get_extrinsics(rs::utils::convert_stream_type(from),
+                                                                      rs::utils::convert_stream_type(to)));
+    }
+
+    rs::core::motion_device_intrinsics get_motion_intrinsics(rs::core::motion_type motion) override
+    {
+        auto intrinsics = m_device->get_motion_intrinsics();
+        return rs::utils::convert_motion_device_intrinsics(motion == rs::core::motion_type::accel ? intrinsics.acc : intrinsics.gyro);
+    }
+
+    rs::core::extrinsics get_motion_extrinsics(rs::core::stream_type stream) override
+    {
+        return rs::utils::convert_extrinsics(m_device->get_motion_extrinsics_from(rs::utils::convert_stream_type(stream)));
+    }
+
+    void start() override
+    {
+        for (auto stream : m_enabled_streams)
+        {
+            auto callback = m_image_callbacks.find(stream);
+            if (callback == m_image_callbacks.end())
+            {
+                continue;
+            }
+            image_callback on_image = callback->second;
+            m_device->set_frame_callback(rs::utils::convert_stream_type(stream), [on_image](rs::frame frame)
+            {
+                auto image = rs::core::image_interface::create_instance_from_librealsense_frame(frame, rs::core::image_interface::flag::any);
+                on_image(image);
+                image->release();
+            });
+        }
+
+        rs::source sources = rs::source::video;
+        if (m_motion_enabled)
+        {
+            motion_callback on_motion = m_motion_callback;
+            m_device->enable_motion_tracking([on_motion](rs::motion_data entry)
+            {
+                rs::core::motion_sample sample = {};
+                switch (entry.timestamp_data.source_id)
+                {
+                case RS_EVENT_IMU_ACCEL:
+                    sample.type = rs::core::motion_type::accel;
+                    break;
+                case RS_EVENT_IMU_GYRO:
+                    sample.type = rs::core::motion_type::gyro;
+                    break;
+                default:
+                    return;
+                }
+                sample.timestamp = entry.timestamp_data.timestamp;
+                sample.frame_number = entry.timestamp_data.frame_number;
+                sample.data[0] = entry.axes[0];
+                sample.data[1] = entry.axes[1];
+                sample.data[2] = entry.axes[2];
+                on_motion(sample);
+            },
+            [](rs::timestamp_data entry) {});
+            sources = rs::source::all_sources;
+        }
+        m_sources = sources;
+        m_device->start(sources);
+    }
+
+    void stop() override
+    {
+        if (m_device->is_streaming())
+        {
+            m_device->stop(m_sources);
+        }
+    }
+
+    bool is_streaming() override
+    {
+        return m_device->is_streaming();
+    }
+
+    rs::device* get_device() override
+    {
+        return m_device;
+    }
+
+private:
+    rs::device* m_device;
+    std::vector<rs::core::stream_type> m_enabled_streams;
+    std::map<rs::core::stream_type, image_callback> m_image_callbacks;
+    motion_callback m_motion_callback;
+    bool m_motion_enabled;
+    rs::source m_sources;
+};
+
+// Pairs the color and depth images of a source into sample sets, for the samples that poll for
+// frames (the replacement of wait_for_frames() + get_frame_data()). Completed sets wait in a ring
+// of queue_size sets, filled from the source callbacks, so capturing the next frame overlaps with
+// processing the current one.
+//
+// An image is paired with the image of the other stream nearest to it in time, if that is within
+// half a frame period; the synthetic source gives both images of a frame number the same
+// timestamp. An image that can't get a partner anymore, because the other stream has moved past
+// it, is dropped and counted in get_unpaired().
+//
+// With a real-time source the newest images win: a full ring drops its oldest set, like a camera.
+// With a source that isn't real time the source is held back while the ring is full, so no frame
+// is dropped and the pipeline runs as fast as the consumer.
+class sample_set_reader
+{
+public:
+    explicit sample_set_reader(size_t queue_size = 1) :
+        m_source(nullptr),
+        m_queue_size(queue_size > 0 ? queue_size : 1),
+        m_stopped(false),
+        m_frame_period_ms(1000.0 / 30),
+        m_delivered(0),
+        m_dropped(0),
+        m_unpaired(0),
+        m_max_queue_depth(0)
+    {
+    }
+
+    ~sample_set_reader()
+    {
+        stop();
+    }
+
+    // Registers the color and depth callbacks, call before the source is started with the frame
+    // rate the streams were enabled with
+    void attach(frame_source* source, int frame_rate = 30)
+    {
+        m_source = source;
+        m_stopped = false;
+        m_frame_period_ms = 1000.0 / (frame_rate > 0 ? frame_rate : 30);
+        for (int i = 0; i < stream_count; ++i)
+        {
+            m_source->set_image_callback(stream_of(i), [this, i](rs::core::image_interface* image)
+            {
+                on_image(i, image);
+            });
+        }
+    }
+
+    // Fills sample_set with the oldest waiting color and depth images; the caller releases them.
+    // Returns false on timeout or after stop().
+    bool wait_for_sample_set(rs::core::correlated_sample_set& sample_set, int timeout_ms = 5000)
+    {
+        std::unique_lock<std::mutex> lock(m_mutex);
+        if (!m_ready.wait_for(lock, std::chrono::milliseconds(timeout_ms), [this] { return m_stopped || !m_sets.empty(); }) || m_stopped)
+        {
+            return false;
+        }
+        for (int i = 0; i < stream_count; ++i)
+        {
+            sample_set[stream_of(i)] = m_sets.front().images[i];
+        }
+        m_sets.pop_front();
+        ++m_delivered;
+        m_consumed.notify_all();
+        return true;
+    }
+
+    void stop()
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_stopped = true;
+        for (auto& pending : m_pending)
+        {
+            for (auto image : pending)
+            {
+                image->release();
+            }
+            pending.clear();
+        }
+        for (auto& set : m_sets)
+        {
+            set.release();
+        }
+        m_sets.clear();
+        m_ready.notify_all();
+        m_consumed.notify_all();
+    }
+
+    // Sample sets handed to the consumer, and the ones a real-time source overwrote
+    uint64_t get_delivered() const
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        return m_delivered;
+    }
+
+    uint64_t get_dropped() const
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        return m_dropped;
+    }
+
+    // Images dropped for want of an image of the other stream close enough in time
+    uint64_t get_unpaired() const
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        return m_unpaired;
+    }
+
+    // Completed sample sets waiting for the consumer, now and at most
+    size_t get_queue_depth() const
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        return m_sets.size();
+    }
+
+    size_t get_max_queue_depth() const
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        return m_max_queue_depth;
+    }
+
+private:
+    static const int stream_count = 2;
+    static const size_t max_pending = 4;   // images of a stream waiting for a partner
+
+    struct image_pair
+    {
+        rs::core::image_interface* images[stream_count];
+
+        void release()
+        {
+            for (auto image : images)
+            {
+                image->release();
+            }
+        }
+    };
+
+    static rs::core::stream_type stream_of(int index)
+    {
+        return index == 0 ? rs::core::stream_type::color : rs::core::stream_type::depth;
+    }
+
+    // Releases the first count pending images of stream index, which won't be paired
+    void drop_pending(int index, size_t count)
+    {
+        auto& pending = m_pending[index];
+        for (size_t i = 0; i < count; ++i)
+        {
+            pending.front()->release();
+            pending.pop_front();
+            ++m_unpaired;
+        }
+    }
+
+    void on_image(int index, rs::core::image_interface* image)
+    {
+        std::unique_lock<std::mutex> lock(m_mutex);
+        if (!m_source->is_real_time())
+        {
+            m_consumed.wait(lock, [this] { return m_stopped || m_sets.size() < m_queue_size; });
+        }
+        if (m_stopped)
+        {
+            return;
+        }
+
+        // The nearest image of the other stream; the ones before it are older than any image of
+        // this stream to come, so they won't be paired either way
+        const int other = 1 - index;
+        auto& candidates = m_pending[other];
+        const double timestamp = image->query_time_stamp();
+        size_t nearest = 0;
+        for (size_t i = 1; i < candidates.size(); ++i)
+        {
+            if (std::abs(candidates[i]->query_time_stamp() - timestamp) < std::abs(candidates[nearest]->query_time_stamp() - timestamp))
+            {
+                nearest = i;
+            }
+        }
+        bool paired = !candidates.empty() && std::abs(candidates[nearest]->query_time_stamp() - timestamp) <= m_frame_period_ms / 2;
+        if (!paired && !candidates.empty() && candidates[nearest]->query_time_stamp() > timestamp)
+        {
+            // The other stream is ahead, this image comes too late for a partner
+            ++m_unpaired;
+            return;
+        }
+        drop_pending(other, paired ? nearest : candidates.size());
+        if (!paired)
+        {
+            // Waits for its partner, which may come after later images of this stream when the
+            // streams are delivered on different threads
+            if (m_pending[index].size() == max_pending)
+            {
+                drop_pending(index, 1);
+            }
+            image->add_ref();
+            m_pending[index].push_back(image);
+            return;
+        }
+
+        image->add_ref();
+        image_pair set;
+        set.images[index] = image;
+        set.images[other] = candidates.front();
+        candidates.pop_front();
+
+        if (m_sets.size() == m_queue_size)
+        {
+            m_sets.front().release();
+            m_sets.pop_front();
+            ++m_dropped;
+        }
+        m_sets.push_back(set);
+        if (m_sets.size() > m_max_queue_depth)
+        {
+            m_max_queue_depth = m_sets.size();
+        }
+        m_ready.notify_one();
+    }
+
+    frame_source* m_source;
+    const size_t m_queue_size;
+    mutable std::mutex m_mutex;
+    std::condition_variable m_ready;
+    std::condition_variable m_consumed;
+    std::deque<rs::core::image_interface*> m_pending[stream_count];
+    std::deque<image_pair> m_sets;
+    bool m_stopped;
+    double m_frame_period_ms;
+    uint64_t m_delivered;
+    uint64_t m_dropped;
+    uint64_t m_unpaired;
+    size_t m_max_queue_depth;
+};
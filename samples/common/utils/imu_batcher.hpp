@@ -0,0 +1,143 @@
+// License: Apache 2.0. See LICENSE file in root directory.
+// Copyright(c) 2017 Intel Corporation. All Rights Reserved.
+
+#pragma once
+
+#include <atomic>
+#include <memory>
+#include <functional>
+#include <cstdint>
+
+#include <rs_sdk.h>
+
+// Compact motion sample (32 bytes) used for batched IMU delivery
+struct imu_sample
+{
+    double timestamp;               // ms, same clock domain as the camera frames
+    uint32_t frame_number;
+    rs::core::motion_type type;     // accel or gyro
+    float data[3];
+
+    rs::core::motion_sample to_motion_sample() const
+    {
+        rs::core::motion_sample sample = {};
+        sample.timestamp = timestamp;
+        sample.type = type;
+        sample.frame_number = frame_number;
+        sample.data[0] = data[0];
+        sample.data[1] = data[1];
+        sample.data[2] = data[2];
+        return sample;
+    }
+};
+
+// Collects accel and gyro samples from the motion callback and hands them to the consumer
+// in timestamp-ordered batches, so the consumer pays one call per batch instead of one per sample.
+//
+// A batch is flushed on the next motion sample after an image frame was marked (mark_frame),
+// once the batch spans flush_interval_ms, or when the buffer is full. add() and flush() must be
+// called from the motion callback thread, or once the source is stopped from the thread that
+// stopped it; mark_frame() may be called from any thread.
+//
+// Flushes only happen inside add(), so a partial batch waits for the next motion sample. Whoever
+// stops the source is responsible for the final flush() after it stopped, before the consumer
+// stops, otherwise the last samples are never delivered.
+class imu_batcher
+{
+public:
+    typedef std::function<void(const imu_sample* samples, size_t count)> batch_callback;
+
+    imu_batcher(batch_callback callback, double flush_interval_ms = 10.0, bool flush_on_frame = true,
+                size_t capacity = 64) :
+        m_callback(callback),
+        m_flush_interval_ms(flush_interval_ms),
+        m_flush_on_frame(flush_on_frame),
+        m_capacity(capacity),
+        m_samples(new imu_sample[capacity]),
+        m_count(0),
+        m_frame_pending(false),
+        m_batches(0),
+        m_total_samples(0)
+    {
+    }
+
+    imu_batcher(const imu_batcher&) = delete;
+    imu_batcher& operator=(const imu_batcher&) = delete;
+
+    void add(const imu_sample& sample)
+    {
+        m_samples[m_count++] = sample;
+
+        bool frame_arrived = m_flush_on_frame && m_frame_pending.exchange(false, std::memory_order_acq_rel);
+        if (frame_arrived || m_count == m_capacity ||
+                sample.timestamp - m_samples[0].timestamp >= m_flush_interval_ms)
+        {
+            flush();
+        }
+    }
+
+    // Signals that an image frame arrived, the pending batch goes out with the next motion sample
+    void mark_frame()
+    {
+        m_frame_pending.store(true, std::memory_order_release);
+    }
+
+    void flush()
+    {
+        if (m_count == 0)
+        {
+            return;
+        }
+
+        sort_by_timestamp();
+        m_callback(m_samples.get(), m_count);
+
+        m_batches.fetch_add(1, std::memory_order_relaxed);
+        m_total_samples.fetch_add(m_count, std::memory_order_relaxed);
+        m_count = 0;
+    }
+
+    uint64_t get_batch_count() const
+    {
+        return m_batches;
+    }
+
+    double get_average_batch_size() const
+    {
+        uint64_t batches = m_batches;
+        return batches ? static_cast<double>(m_total_samples) / batches : 0.0;
+    }
+
+private:
+    // Accel and gyro arrive interleaved and almost in order, so insertion sort is close to linear
+    void sort_by_timestamp()
+    {
+        imu_sample* samples = m_samples.get();
+        for (size_t i = 1; i < m_count; ++i)
+        {
+            if (samples[i].timestamp >= samples[i - 1].timestamp)
+            {
+                continue;
+            }
+            imu_sample sample = samples[i];
+            size_t j = i;
+            while (j > 0 && samples[j - 1].timestamp > sample.timestamp)
+            {
+                samples[j] = samples[j - 1];
+                --j;
+            }
+            samples[j] = sample;
+        }
+    }
+
+    batch_callback m_callback;
+    const double m_flush_interval_ms;
+    const bool m_flush_on_frame;
+    const size_t m_capacity;
+    std::unique_ptr<imu_sample[]> m_samples;
+    size_t m_count;
+
+    std::atomic_bool m_frame_pending;
+    std::atomic<uint64_t> m_batches;
+    std::atomic<uint64_t> m_total_samples;
+};
@@ -0,0 +1,509 @@
+// License: Apache 2.0. See LICENSE file in root directory.
+// Copyright(c) 2017 Intel Corporation. All Rights Reserved.
+
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <fstream>
+#include <functional>
+#include <iomanip>
+#include <iostream>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <utility>
+#include <vector>
+
+// Monotonic clock used by all latency measurements
+inline int64_t latency_clock_ns()
+{
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(
+               std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+// Latency distribution of one stage, in milliseconds
+struct latency_snapshot
+{
+    uint64_t count;
+    double mean;
+    double p50;
+    double p90;
+    double p99;
+    double p999;
+    double max;
+};
+
+// HdrHistogram-style latency recorder with a resolution of 1 us and ~1.5% relative precision up
+// to 100 s. Each recording thread gets its own set of counters, so record() is lock-free and
+// never contends with other threads; snapshot() merges the per-thread counters. When a thread
+// exits its counters are merged into a retired block and freed, so threads that are created per
+// frame don't grow the histogram.
+class latency_histogram
+{
+public:
+    static const int64_t max_trackable_us = 100 * 1000 * 1000;
+
+    latency_histogram() : m_state(std::make_shared<shared_state>()) {}
+
+    latency_histogram(const latency_histogram&) = delete;
+    latency_histogram& operator=(const latency_histogram&) = delete;
+
+    void record_us(int64_t value_us)
+    {
+        if (value_us < 0)
+        {
+            value_us = 0;
+        }
+        else if (value_us > max_trackable_us)
+        {
+            value_us = max_trackable_us;
+        }
+
+        // Only this thread writes to its counters, readers tolerate relaxed ordering
+        thread_counts& counts = local_counts();
+        std::atomic<uint64_t>& bucket = counts.buckets[bucket_index(value_us)];
+        bucket.store(bucket.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+        counts.count.store(counts.count.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+        counts.sum_us.store(counts.sum_us.load(std::memory_order_relaxed) + value_us, std::memory_order_relaxed);
+        if (value_us > counts.max_us.load(std::memory_order_relaxed))
+        {
+            counts.max_us.store(value_us, std::memory_order_relaxed);
+        }
+    }
+
+    void record_ns(int64_t value_ns)
+    {
+        record_us(value_ns / 1000);
+    }
+
+    // Records the time elapsed since start_ns (from latency_clock_ns)
+    void record_since(int64_t start_ns)
+    {
+        record_ns(latency_clock_ns() - start_ns);
+    }
+
+    latency_snapshot snapshot() const
+    {
+        std::unique_ptr<uint64_t[]> merged(new uint64_t[bucket_count]());
+        uint64_t count = 0;
+        int64_t sum_us = 0;
+        int64_t max_us = 0;
+        {
+            std::lock_guard<std::mutex> lock(m_state->mutex);
+            auto merge = [&](const thread_counts& counts)
+            {
+                for (int i = 0; i < bucket_count; ++i)
+                {
+                    merged[i] += counts.buckets[i].load(std::memory_order_relaxed);
+                }
+                count += counts.count.load(std::memory_order_relaxed);
+                sum_us += counts.sum_us.load(std::memory_order_relaxed);
+                max_us = std::max(max_us, counts.max_us.load(std::memory_order_relaxed));
+            };
+            merge(m_state->retired);
+            for (const auto& counts : m_state->threads)
+            {
+                merge(*counts);
+            }
+        }
+
+        latency_snapshot s = {};
+        s.count = count;
+        if (count == 0)
+        {
+            return s;
+        }
+        s.mean = sum_us / 1000.0 / count;
+        s.max = max_us / 1000.0;
+        s.p50 = std::min(percentile(merged.get(), count, 0.50), s.max);
+        s.p90 = std::min(percentile(merged.get(), count, 0.90), s.max);
+        s.p99 = std::min(percentile(merged.get(), count, 0.99), s.max);
+        s.p999 = std::min(percentile(merged.get(), count, 0.999), s.max);
+        return s;
+    }
+
+private:
+    // Values below 128 us have their own bucket, above that each power of two is split into 64
+    static const int sub_bucket_bits = 7;
+    static const int sub_bucket_count = 1 << sub_bucket_bits;
+    static const int sub_bucket_half = sub_bucket_count / 2;
+    static const int bucket_count = sub_bucket_count + 21 * sub_bucket_half;
+
+    struct thread_counts
+    {
+        thread_counts() : count(0), sum_us(0), max_us(0)
+        {
+            for (int i = 0; i < bucket_count; ++i)
+            {
+                buckets[i] = 0;
+            }
+        }
+
+        std::atomic<uint64_t> buckets[bucket_count];
+        std::atomic<uint64_t> count;
+        std::atomic<int64_t> sum_us;
+        std::atomic<int64_t> max_us;
+    };
+
+    // Counters of the live threads and the merged counters of the threads that exited. A thread
+    // holds a weak reference, so the histogram may be destroyed before the threads that recorded.
+    struct shared_state
+    {
+        std::mutex mutex;
+        std::vector<std::unique_ptr<thread_counts>> threads;
+        thread_counts retired;
+
+        void retire(thread_counts* counts)
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            for (int i = 0; i < bucket_count; ++i)
+            {
+                add(retired.buckets[i], counts->buckets[i].load(std::memory_order_relaxed));
+            }
+            add(retired.count, counts->count.load(std::memory_order_relaxed));
+            add(retired.sum_us, counts->sum_us.load(std::memory_order_relaxed));
+            retired.max_us.store(std::max(retired.max_us.load(std::memory_order_relaxed),
+                                          counts->max_us.load(std::memory_order_relaxed)), std::memory_order_relaxed);
+            threads.erase(std::find_if(threads.begin(), threads.end(),
+                                       [counts](const std::unique_ptr<thread_counts>& c) { return c.get() == counts; }));
+        }
+
+        template<typename T>
+        static void add(std::atomic<T>& target, T value)
+        {
+            target.store(target.load(std::memory_order_relaxed) + value, std::memory_order_relaxed);
+        }
+    };
+
+    // The counters a thread has in each histogram it recorded to, retired when the thread exits
+    struct counts_owner
+    {
+        std::vector<std::pair<std::weak_ptr<shared_state>, thread_counts*>> entries;
+
+        ~counts_owner()
+        {
+            for (auto& entry : entries)
+            {
+                if (auto state = entry.first.lock())
+                {
+                    state->retire(entry.second);
+                }
+            }
+        }
+    };
+
+    static int bucket_index(int64_t value_us)
+    {
+        if (value_us < sub_bucket_count)
+        {
+            return static_cast<int>(value_us);
+        }
+        int msb = 63 - __builtin_clzll(static_cast<uint64_t>(value_us));
+        int shift = msb - (sub_bucket_bits - 1);
+        int sub = static_cast<int>(value_us >> shift);
+        return sub_bucket_count + (shift - 1) * sub_bucket_half + (sub - sub_bucket_half);
+    }
+
+    // Middle of the bucket, in ms
+    static double bucket_value_ms(int index)
+    {
+        if (index < sub_bucket_count)
+        {
+            return index / 1000.0;
+        }
+        int shift = (index - sub_bucket_count) / sub_bucket_half + 1;
+        int64_t sub = (index - sub_bucket_count) % sub_bucket_half + sub_bucket_half;
+        int64_t low = sub << shift;
+        return (low + (int64_t(1) << (shift - 1))) / 1000.0;
+    }
+
+    static double percentile(const uint64_t* buckets, uint64_t count, double fraction)
+    {
+        uint64_t rank = static_cast<uint64_t>(fraction * count + 0.5);
+        if (rank == 0)
+        {
+            rank = 1;
+        }
+        uint64_t seen = 0;
+        for (int i = 0; i < bucket_count; ++i)
+        {
+            seen += buckets[i];
+            if (seen >= rank)
+            {
+                return bucket_value_ms(i);
+            }
+        }
+        return bucket_value_ms(bucket_count - 1);
+    }
+
+    // Counters of the calling thread, created on its first record
+    thread_counts& local_counts()
+    {
+        static thread_local counts_owner owner;
+        for (const auto& entry : owner.entries)
+        {
+            if (!entry.first.owner_before(m_state) && !m_state.owner_before(entry.first))
+            {
+                return *entry.second;
+            }
+        }
+
+        // Forget the counters of histograms that were destroyed, they freed them
+        owner.entries.erase(std::remove_if(owner.entries.begin(), owner.entries.end(),
+                                           [](const std::pair<std::weak_ptr<shared_state>, thread_counts*>& entry)
+                                           { return entry.first.expired(); }),
+                            owner.entries.end());
+
+        thread_counts* counts = new thread_counts();
+        {
+            std::lock_guard<std::mutex> lock(m_state->mutex);
+            m_state->threads.emplace_back(counts);
+        }
+        owner.entries.emplace_back(m_state, counts);
+        return *counts;
+    }
+
+    const std::shared_ptr<shared_state> m_state;
+};
+
+// Process-wide set of named latency stages. Histograms live as long as the process,
+// so a reference returned by get_histogram() stays valid.
+class latency_registry
+{
+public:
+    static latency_registry& get_instance()
+    {
+        static latency_registry instance;
+        return instance;
+    }
+
+    latency_histogram& get_histogram(const std::string& stage)
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        std::unique_ptr<latency_histogram>& histogram = m_histograms[stage];
+        if (!histogram)
+        {
+            histogram.reset(new latency_histogram());
+        }
+        return *histogram;
+    }
+
+    std::vector<std::pair<std::string, latency_snapshot>> snapshot_all() const
+    {
+        std::vector<std::pair<std::string, latency_snapshot>> snapshots;
+        std::lock_guard<std::mutex> lock(m_mutex);
+        for (const auto& histogram : m_histograms)
+        {
+            snapshots.emplace_back(histogram.first, histogram.second->snapshot());
+        }
+        return snapshots;
+    }
+
+private:
+    latency_registry() {}
+
+    mutable std::mutex m_mutex;
+    std::map<std::string, std::unique_ptr<latency_histogram>> m_histograms;
+};
+
+// Remembers when recent frames arrived from the camera, keyed by frame number, so a later
+// stage that only has the frame can measure its latency from the camera callback.
+class frame_arrival_tracker
+{
+public:
+    frame_arrival_tracker()
+    {
+        for (int i = 0; i < slot_count; ++i)
+        {
+            m_slots[i].frame_number = -1;
+            m_slots[i].arrival_ns = 0;
+        }
+    }
+
+    void record_arrival(int64_t frame_number)
+    {
+        slot& s = m_slots[frame_number % slot_count];
+        s.frame_number = -1;
+        s.arrival_ns = latency_clock_ns();
+        s.frame_number = frame_number;
+    }
+
+    // Returns false if the frame is unknown or its slot was reused by a newer frame
+    bool query_arrival(int64_t frame_number, int64_t& arrival_ns) const
+    {
+        const slot& s = m_slots[frame_number % slot_count];
+        if (s.frame_number != frame_number)
+        {
+            return false;
+        }
+        arrival_ns = s.arrival_ns;
+        return s.frame_number == frame_number;
+    }
+
+    // Records the latency from the arrival of frame_number into the histogram
+    bool record_latency(int64_t frame_number, latency_histogram& histogram) const
+    {
+        int64_t arrival_ns;
+        if (!query_arrival(frame_number, arrival_ns))
+        {
+            return false;
+        }
+        histogram.record_since(arrival_ns);
+        return true;
+    }
+
+private:
+    static const int slot_count = 128;
+
+    struct slot
+    {
+        std::atomic<int64_t> frame_number;
+        std::atomic<int64_t> arrival_ns;
+    };
+
+    slot m_slots[slot_count];
+};
+
+inline void print_latency_stats(const std::vector<std::pair<std::string, latency_snapshot>>& snapshots)
+{
+    std::cout << "latency (ms)         " << std::left << std::setw(10) << "count" << std::setw(9) << "p50"
+              << std::setw(9) << "p90" << std::setw(9) << "p99" << std::setw(9) << "p99.9" << "max\n";
+    for (const auto& stage : snapshots)
+    {
+        const latency_snapshot& s = stage.second;
+        std::cout << "  " << std::left << std::setw(19) << stage.first << std::setw(10) << s.count
+                  << std::fixed << std::setprecision(2) << std::setw(9) << s.p50 << std::setw(9) << s.p90
+                  << std::setw(9) << s.p99 << std::setw(9) << s.p999 << s.max << "\n";
+    }
+    std::cout.unsetf(std::ios_base::floatfield);
+}
+
+// Periodically exports the percentiles of all registered stages: to the console, as CSV rows
+// to a log file if one is given, and to an optional callback (e.g. a web display).
+class latency_reporter
+{
+public:
+    typedef std::function<void(const std::string& stage, const latency_snapshot& snapshot)> stage_callback;
+
+    latency_reporter(int period_ms = 5000, bool print_to_console = true) :
+        m_period_ms(period_ms),
+        m_print_to_console(print_to_console),
+        m_running(false),
+        m_start_ns(latency_clock_ns())
+    {
+    }
+
+    latency_reporter(const latency_reporter&) = delete;
+    latency_reporter& operator=(const latency_reporter&) = delete;
+
+    ~latency_reporter()
+    {
+        stop();
+    }
+
+    bool set_log_file(const std::string& path)
+    {
+        m_file.open(path, std::ios::out | std::ios::trunc);
+        if (!m_file.is_open())
+        {
+            std::cerr << "error: failed to open latency log file " << path << std::endl;
+            return false;
+        }
+        m_file << "time_s,stage,count,mean_ms,p50_ms,p90_ms,p99_ms,p99.9_ms,max_ms\n";
+        return true;
+    }
+
+    void set_stage_callback(stage_callback callback)
+    {
+        m_callback = callback;
+    }
+
+    void start()
+    {
+        if (m_running)
+        {
+            return;
+        }
+        m_running = true;
+        m_thread = std::thread([this]()
+        {
+            std::unique_lock<std::mutex> lock(m_mutex);
+            while (m_running)
+            {
+                m_wake.wait_for(lock, std::chrono::milliseconds(m_period_ms));
+                if (m_running)
+                {
+                    report();
+                }
+            }
+        });
+    }
+
+    // Stops the reporting thread and writes a final report
+    void stop()
+    {
+        if (!m_running)
+        {
+            return;
+        }
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            m_running = false;
+        }
+        m_wake.notify_one();
+        m_thread.join();
+        report();
+    }
+
+    void report()
+    {
+        auto snapshots = latency_registry::get_instance().snapshot_all();
+        if (snapshots.empty())
+        {
+            return;
+        }
+
+        if (m_print_to_console)
+        {
+            print_latency_stats(snapshots);
+        }
+
+        double time_s = (latency_clock_ns() - m_start_ns) / 1e9;
+        for (const auto& stage : snapshots)
+        {
+            const latency_snapshot& s = stage.second;
+            if (m_file.is_open())
+            {
+                m_file << time_s << "," << stage.first << "," << s.count << "," << s.mean << "," << s.p50 << ","
+                       << s.p90 << "," << s.p99 << "," << s.p999 << "," << s.max << "\n";
+            }
+            if (m_callback)
+            {
+                m_callback(stage.first, s);
+            }
+        }
+        if (m_file.is_open())
+        {
+            m_file.flush();
+        }
+    }
+
+private:
+    const int m_period_ms;
+    const bool m_print_to_console;
+    bool m_running;
+    const int64_t m_start_ns;
+
+    std::ofstream m_file;
+    stage_callback m_callback;
+
+    std::thread m_thread;
+    std::mutex m_mutex;
+    std::condition_variable m_wake;
+};
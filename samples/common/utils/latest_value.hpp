@@ -0,0 +1,95 @@
+// License: Apache 2.0. See LICENSE file in root directory.
+// Copyright(c) 2017 Intel Corporation. All Rights Reserved.
+
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <cstring>
+#include <type_traits>
+
+// Lock-free slot holding the most recently published value of a trivially copyable type.
+// Writes must be serialized (one writer at a time); any number of readers can poll it without
+// blocking the writer. Readers retry while a write is in progress, so they never see a torn value.
+//
+// The value is kept in relaxed atomic words rather than a plain T, so a reader copying it while
+// the writer overwrites it is a retried read and not a data race.
+template<typename T>
+class latest_value
+{
+    static_assert(std::is_trivially_copyable<T>::value, "latest_value requires a trivially copyable type");
+
+public:
+    latest_value() : m_sequence(0)
+    {
+        for (auto& word : m_words)
+        {
+            word.store(0, std::memory_order_relaxed);
+        }
+    }
+
+    latest_value(const latest_value&) = delete;
+    latest_value& operator=(const latest_value&) = delete;
+
+    void store(const T& value)
+    {
+        uint32_t words[word_count] = {};
+        std::memcpy(words, &value, sizeof(T));
+
+        uint32_t sequence = m_sequence.load(std::memory_order_relaxed);
+        m_sequence.store(sequence + 1, std::memory_order_relaxed);
+        // The odd sequence is visible before any of the new words
+        std::atomic_thread_fence(std::memory_order_release);
+        for (size_t i = 0; i < word_count; ++i)
+        {
+            m_words[i].store(words[i], std::memory_order_relaxed);
+        }
+        m_sequence.store(sequence + 2, std::memory_order_release);
+    }
+
+    // Returns false if nothing was published yet. version, if given, is set to the version() of
+    // the value returned.
+    bool load(T& value, uint32_t* version = nullptr) const
+    {
+        uint32_t words[word_count];
+        while (true)
+        {
+            uint32_t before = m_sequence.load(std::memory_order_acquire);
+            if (before == 0)
+            {
+                return false;
+            }
+            if (before & 1)
+            {
+                continue;
+            }
+            for (size_t i = 0; i < word_count; ++i)
+            {
+                words[i] = m_words[i].load(std::memory_order_relaxed);
+            }
+            // The words are read before the sequence is checked again
+            std::atomic_thread_fence(std::memory_order_acquire);
+            if (m_sequence.load(std::memory_order_relaxed) == before)
+            {
+                std::memcpy(&value, words, sizeof(T));
+                if (version)
+                {
+                    *version = before / 2;
+                }
+                return true;
+            }
+        }
+    }
+
+    // Number of values published so far, cheap way for a reader to detect a new value
+    uint32_t version() const
+    {
+        return m_sequence.load(std::memory_order_acquire) / 2;
+    }
+
+private:
+    static const size_t word_count = (sizeof(T) + sizeof(uint32_t) - 1) / sizeof(uint32_t);
+
+    std::atomic<uint32_t> m_sequence;
+    std::atomic<uint32_t> m_words[word_count];
+};
@@ -0,0 +1,350 @@
+// License: Apache 2.0. See LICENSE file in root directory.
+// Copyright(c) 2017 Intel Corporation. All Rights Reserved.
+
+#pragma once
+
+#include <atomic>
+#include <functional>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <sstream>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "latency_histogram.hpp"
+
+// Label set of one time series, e.g. { {"stream", "fisheye"} }
+typedef std::vector<std::pair<std::string, std::string>> metric_labels;
+
+// Monotonically increasing count
+class metric_counter
+{
+public:
+    metric_counter() : m_value(0) {}
+
+    void inc(uint64_t count = 1)
+    {
+        m_value.fetch_add(count, std::memory_order_relaxed);
+    }
+
+    uint64_t value() const
+    {
+        return m_value.load(std::memory_order_relaxed);
+    }
+
+private:
+    std::atomic<uint64_t> m_value;
+};
+
+// Value that can go up and down
+class metric_gauge
+{
+public:
+    metric_gauge() : m_value(0.0) {}
+
+    void set(double value)
+    {
+        m_value.store(value, std::memory_order_relaxed);
+    }
+
+    void add(double delta)
+    {
+        double current = m_value.load(std::memory_order_relaxed);
+        while (!m_value.compare_exchange_weak(current, current + delta, std::memory_order_relaxed)) {}
+    }
+
+    double value() const
+    {
+        return m_value.load(std::memory_order_relaxed);
+    }
+
+private:
+    std::atomic<double> m_value;
+};
+
+// Distribution over fixed upper bounds, rendered as a Prometheus histogram
+class metric_histogram
+{
+public:
+    explicit metric_histogram(const std::vector<double>& bounds) :
+        m_bounds(bounds),
+        m_buckets(new std::atomic<uint64_t>[bounds.size() + 1]),
+        m_count(0),
+        m_sum(0.0)
+    {
+        for (size_t i = 0; i <= m_bounds.size(); ++i)
+        {
+            m_buckets[i] = 0;
+        }
+    }
+
+    void observe(double value)
+    {
+        size_t i = 0;
+        while (i < m_bounds.size() && value > m_bounds[i])
+        {
+            ++i;
+        }
+        m_buckets[i].fetch_add(1, std::memory_order_relaxed);
+        m_count.fetch_add(1, std::memory_order_relaxed);
+        double sum = m_sum.load(std::memory_order_relaxed);
+        while (!m_sum.compare_exchange_weak(sum, sum + value, std::memory_order_relaxed)) {}
+    }
+
+    const std::vector<double>& bounds() const
+    {
+        return m_bounds;
+    }
+
+    // Count of the bucket with upper bound bounds()[index], index == bounds().size() is +Inf
+    uint64_t bucket(size_t index) const
+    {
+        return m_buckets[index].load(std::memory_order_relaxed);
+    }
+
+    uint64_t count() const
+    {
+        return m_count.load(std::memory_order_relaxed);
+    }
+
+    double sum() const
+    {
+        return m_sum.load(std::memory_order_relaxed);
+    }
+
+private:
+    const std::vector<double> m_bounds;
+    std::unique_ptr<std::atomic<uint64_t>[]> m_buckets;
+    std::atomic<uint64_t> m_count;
+    std::atomic<double> m_sum;
+};
+
+// Process-wide registry of counters, gauges and histograms, rendered in the Prometheus text format.
+//
+// Looking up a metric takes a lock, so hot paths look it up once and keep the reference; the
+// metrics are never removed, so references stay valid. Updating a metric is a relaxed atomic.
+// Objects that already keep their own statistics can instead add a collector, which is called
+// when the metrics are rendered and must be removed before the object goes away.
+class metrics_registry
+{
+public:
+    typedef std::function<void(std::ostream& out)> collector;
+
+    static metrics_registry& get_instance()
+    {
+        static metrics_registry instance;
+        return instance;
+    }
+
+    metric_counter& get_counter(const std::string& name, const std::string& help, const metric_labels& labels = metric_labels())
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        family& f = get_family(name, help, "counter");
+        std::unique_ptr<metric_counter>& counter = f.counters[format_labels(labels)];
+        if (!counter)
+        {
+            counter.reset(new metric_counter());
+        }
+        return *counter;
+    }
+
+    metric_gauge& get_gauge(const std::string& name, const std::string& help, const metric_labels& labels = metric_labels())
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        family& f = get_family(name, help, "gauge");
+        std::unique_ptr<metric_gauge>& gauge = f.gauges[format_labels(labels)];
+        if (!gauge)
+        {
+            gauge.reset(new metric_gauge());
+        }
+        return *gauge;
+    }
+
+    // The bounds of the first histogram registered under a name are used for all its series
+    metric_histogram& get_histogram(const std::string& name, const std::string& help, const std::vector<double>& bounds,
+                                    const metric_labels& labels = metric_labels())
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        family& f = get_family(name, help, "histogram");
+        if (f.bounds.empty())
+        {
+            f.bounds = bounds;
+        }
+        std::unique_ptr<metric_histogram>& histogram = f.histograms[format_labels(labels)];
+        if (!histogram)
+        {
+            histogram.reset(new metric_histogram(f.bounds));
+        }
+        return *histogram;
+    }
+
+    int add_collector(collector c)
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        int id = ++m_next_collector_id;
+        m_collectors[id] = c;
+        return id;
+    }
+
+    void remove_collector(int id)
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_collectors.erase(id);
+    }
+
+    std::string render_prometheus() const
+    {
+        std::ostringstream out;
+        out.precision(9);
+
+        std::lock_guard<std::mutex> lock(m_mutex);
+        for (const auto& entry : m_families)
+        {
+            const std::string& name = entry.first;
+            const family& f = entry.second;
+            write_header(out, name, f.type, f.help);
+            for (const auto& counter : f.counters)
+            {
+                out << name << counter.first << " " << counter.second->value() << "\n";
+            }
+            for (const auto& gauge : f.gauges)
+            {
+                out << name << gauge.first << " " << gauge.second->value() << "\n";
+            }
+            for (const auto& histogram : f.histograms)
+            {
+                write_histogram(out, name, histogram.first, *histogram.second);
+            }
+        }
+
+        write_latency_stages(out);
+
+        for (const auto& c : m_collectors)
+        {
+            c.second(out);
+        }
+        return out.str();
+    }
+
+    // Helpers for collectors
+    static void write_header(std::ostream& out, const std::string& name, const std::string& type, const std::string& help)
+    {
+        out << "# HELP " << name << " " << help << "\n";
+        out << "# TYPE " << name << " " << type << "\n";
+    }
+
+    static void write_sample(std::ostream& out, const std::string& name, const metric_labels& labels, double value)
+    {
+        out << name << format_labels(labels) << " " << value << "\n";
+    }
+
+    static std::string format_labels(const metric_labels& labels)
+    {
+        if (labels.empty())
+        {
+            return "";
+        }
+        std::string text = "{";
+        for (size_t i = 0; i < labels.size(); ++i)
+        {
+            if (i > 0)
+            {
+                text += ",";
+            }
+            text += labels[i].first + "=\"";
+            for (char c : labels[i].second)
+            {
+                if (c == '\\' || c == '"')
+                {
+                    text += '\\';
+                }
+                text += (c == '\n') ? ' ' : c;
+            }
+            text += "\"";
+        }
+        return text + "}";
+    }
+
+private:
+    struct family
+    {
+        std::string help;
+        std::string type;
+        std::vector<double> bounds;
+        std::map<std::string, std::unique_ptr<metric_counter>> counters;
+        std::map<std::string, std::unique_ptr<metric_gauge>> gauges;
+        std::map<std::string, std::unique_ptr<metric_histogram>> histograms;
+    };
+
+    metrics_registry() : m_next_collector_id(0) {}
+
+    family& get_family(const std::string& name, const std::string& help, const char* type)
+    {
+        family& f = m_families[name];
+        if (f.type.empty())
+        {
+            f.help = help;
+            f.type = type;
+        }
+        return f;
+    }
+
+    // Adds a label to an already formatted label set
+    static std::string append_label(const std::string& labels, const std::string& label)
+    {
+        if (labels.empty())
+        {
+            return "{" + label + "}";
+        }
+        return labels.substr(0, labels.size() - 1) + "," + label + "}";
+    }
+
+    static void write_histogram(std::ostream& out, const std::string& name, const std::string& labels, const metric_histogram& h)
+    {
+        uint64_t cumulative = 0;
+        for (size_t i = 0; i < h.bounds().size(); ++i)
+        {
+            cumulative += h.bucket(i);
+            std::ostringstream bound;
+            bound << h.bounds()[i];
+            out << name << "_bucket" << append_label(labels, "le=\"" + bound.str() + "\"") << " " << cumulative << "\n";
+        }
+        cumulative += h.bucket(h.bounds().size());
+        out << name << "_bucket" << append_label(labels, "le=\"+Inf\"") << " " << cumulative << "\n";
+        out << name << "_sum" << labels << " " << h.sum() << "\n";
+        out << name << "_count" << labels << " " << h.count() << "\n";
+    }
+
+    // The stage latencies of latency_registry, as a summary in seconds
+    static void write_latency_stages(std::ostream& out)
+    {
+        auto stages = latency_registry::get_instance().snapshot_all();
+        if (stages.empty())
+        {
+            return;
+        }
+        const std::string name = "rs_stage_latency_seconds";
+        write_header(out, name, "summary", "Latency of a pipeline stage since the camera frame arrived");
+        for (const auto& stage : stages)
+        {
+            const latency_snapshot& s = stage.second;
+            const std::pair<const char*, double> quantiles[] =
+            {
+                { "0.5", s.p50 }, { "0.9", s.p90 }, { "0.99", s.p99 }, { "0.999", s.p999 }
+            };
+            for (const auto& q : quantiles)
+            {
+                write_sample(out, name, { { "stage", stage.first }, { "quantile", q.first } }, q.second / 1000.0);
+            }
+            write_sample(out, name + "_sum", { { "stage", stage.first } }, s.mean * s.count / 1000.0);
+            write_sample(out, name + "_count", { { "stage", stage.first } }, static_cast<double>(s.count));
+        }
+    }
+
+    mutable std::mutex m_mutex;
+    std::map<std::string, family> m_families;
+    std::map<int, collector> m_collectors;
+    int m_next_collector_id;
+};
@@ -0,0 +1,91 @@
+// License: Apache 2.0. See LICENSE file in root directory.
+// Copyright(c) 2017 Intel Corporation. All Rights Reserved.
+
+#pragma once
+
+#include <cstdlib>
+#include <iostream>
+#include <memory>
+#include <sstream>
+#include <string>
+
+#include "frame_source.hpp"
+#include "stream_recording.hpp"
+#include "synthetic_frame_source.hpp"
+
+// Parses a speed option: a factor of real time, or "max"
+inline double parse_frame_source_speed(const std::string& speed)
+{
+    return speed == "max" ? 0.0 : std::atof(speed.c_str());
+}
+
+// Opens the source named by the RS_SAMPLES_FRAME_SOURCE environment variable, or the first
+// camera of ctx if it isn't set. Returns nullptr if there is no camera.
+//   RS_SAMPLES_FRAME_SOURCE=synthetic          synthetic camera at real time
+//   RS_SAMPLES_FRAME_SOURCE=synthetic:<speed>  at <speed> times real time
+//   RS_SAMPLES_FRAME_SOURCE=synthetic:max      as fast as the pipeline consumes the images
+//   RS_SAMPLES_FRAME_SOURCE=recording:<file>[,speed=<speed>|max][,loop]
+//                                              plays a recording made with RS_SAMPLES_RECORD
+// With RS_SAMPLES_RECORD=<file> the samples of the opened source are recorded to <file>.
+// Throws std::runtime_error if a recording can't be read.
+inline std::unique_ptr<frame_source> open_frame_source(rs::core::context_interface& ctx)
+{
+    const char* env = std::getenv("RS_SAMPLES_FRAME_SOURCE");
+    std::string name = env ? env : "";
+    std::unique_ptr<frame_source> source;
+
+    if (name.compare(0, 9, "synthetic") == 0)
+    {
+        synthetic_source_config config;
+        if (name.size() > 10 && name[9] == ':')
+        {
+            config.speed = parse_frame_source_speed(name.substr(10));
+        }
+        std::cout << "Using the synthetic camera at " << (config.speed > 0.0 ? std::to_string(config.speed) + "x real time" : "max speed") << std::endl;
+        source.reset(new synthetic_frame_source(config));
+    }
+    else if (name.compare(0, 10, "recording:") == 0)
+    {
+        std::istringstream options(name.substr(10));
+        std::string path, option;
+        std::getline(options, path, ',');
+        playback_config config;
+        while (std::getline(options, option, ','))
+        {
+            if (option == "loop")
+            {
+                config.loop = true;
+            }
+            else if (option.compare(0, 6, "speed=") == 0)
+            {
+                config.speed = parse_frame_source_speed(option.substr(6));
+            }
+            else
+            {
+                std::cerr << "warning: unknown recording option '" << option << "'" << std::endl;
+            }
+        }
+        std::cout << "Playing " << path << " at " << (config.speed > 0.0 ? std::to_string(config.speed) + "x real time" : "max speed")
+                  << (config.loop ? ", looping" : "") << std::endl;
+        source.reset(new playback_frame_source(path, config));
+    }
+    else
+    {
+        if (!name.empty())
+        {
+            std::cerr << "warning: unknown RS_SAMPLES_FRAME_SOURCE '" << name << "', using the camera" << std::endl;
+        }
+        if (ctx.get_device_count() == 0)
+        {
+            return nullptr;
+        }
+        source.reset(new device_frame_source(ctx.get_device(0)));
+    }
+
+    const char* record_path = std::getenv("RS_SAMPLES_RECORD");
+    if (record_path && *record_path)
+    {
+        source.reset(new recording_frame_source(std::move(source), record_path));
+    }
+    return source;
+}
@@ -0,0 +1,648 @@
+// License: Apache 2.0. See LICENSE file in root directory.
+// Copyright(c) 2017 Intel Corporation. All Rights Reserved.
+
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdlib>
+#include <deque>
+#include <functional>
+#include <iomanip>
+#include <iostream>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "or_data_interface.h"
+#include "or_configuration_interface.h"
+#include "or_video_module_impl.h"
+#include "rs_sdk.h"
+
+#include "frame_dispatcher.hpp"
+#include "metrics_registry.hpp"
+#include "or_label_table.hpp"
+#include "pipeline_trace.hpp"
+
+// Results of one frame, copied out of the engines
+struct or_frame_result
+{
+    uint64_t sequence;                                                  // accepted frames are numbered from 0
+    double timestamp;                                                   // of the color image
+    rs::core::status status;
+    std::vector<rs::object_recognition::localization_data> localization;
+    std::vector<rs::object_recognition::tracking_data> tracking;        // in the order of the tracking rois
+    uint64_t tracking_generation;                                       // of the tracking rois the frame was tracked with
+};
+
+// Snapshot of the metrics of one engine of an or_engine_pool
+struct or_engine_stats
+{
+    uint64_t processed;       // frames the engine processed
+    double avg_process_ms;    // mean process_sample_set() time
+    double busy_ratio;        // fraction of the time since start() spent processing
+};
+
+// Runs several identically configured object recognition engines in parallel.
+//
+// In localization mode every accepted frame goes to one free engine, so N engines localize N frames
+// at a time. Tracking follows objects from frame to frame, so there the tracking rois are split
+// over the engines instead and every frame goes to all of them. Either way the results are passed
+// to the result handler in the order the frames were accepted: results that finish early wait in
+// a reorder buffer for the frames before them.
+//
+// A frame is only accepted when an engine can start on it right away, so results are never older
+// than one processing time; the samples simply offer every captured frame to submit().
+//
+// While tracking, update_tracking_rois() replaces the tracked objects without waiting: each engine
+// picks up the new rois before its next frame, and the results say which rois they were made with.
+class or_engine_pool
+{
+public:
+    typedef std::function<void(rs::object_recognition::or_configuration_interface* configuration)> configurator;
+    typedef std::function<void(or_frame_result& result)> result_handler;
+
+    // The number of engines set by the RS_SAMPLES_OR_ENGINES environment variable, 2 if it isn't set
+    static size_t default_engine_count()
+    {
+        const char* env = std::getenv("RS_SAMPLES_OR_ENGINES");
+        int count = env ? std::atoi(env) : 0;
+        return count > 0 ? static_cast<size_t>(count) : 2;
+    }
+
+    or_engine_pool() :
+        m_mode(rs::object_recognition::recognition_mode::LOCALIZATION),
+        m_running(false),
+        m_stopping(false),
+        m_next_sequence(0),
+        m_next_delivery(0),
+        m_rois_generation(0),
+        m_accepted(0),
+        m_rejected(0),
+        m_max_reorder_depth(0),
+        m_start_ns(now_ns()),
+        m_metrics_collector(-1)
+    {
+    }
+
+    or_engine_pool(const or_engine_pool&) = delete;
+    or_engine_pool& operator=(const or_engine_pool&) = delete;
+
+    ~or_engine_pool()
+    {
+        stop();
+        if (m_metrics_collector >= 0)
+        {
+            metrics_registry::get_instance().remove_collector(m_metrics_collector);
+        }
+    }
+
+    // Uses first, which is already set up with config and has the given output and configuration
+    // objects, as engine 0 and creates engine_count - 1 more engines with the same module config.
+    // The pool doesn't take ownership of first.
+    rs::core::status init(rs::object_recognition::or_video_module_impl& first,
+                          rs::object_recognition::or_data_interface* first_data,
+                          rs::object_recognition::or_configuration_interface* first_configuration,
+                          rs::core::video_module_interface::actual_module_config& config, size_t engine_count)
+    {
+        m_engines.clear();
+        std::unique_ptr<engine> e(new engine());
+        e->impl = &first;
+        e->data = first_data;
+        e->configuration = first_configuration;
+        m_engines.push_back(std::move(e));
+        return add_engines(config, std::max<size_t>(engine_count, 1) - 1);
+    }
+
+    // Creates engine_count engines set up with config
+    rs::core::status init(rs::core::video_module_interface::actual_module_config& config, size_t engine_count)
+    {
+        m_engines.clear();
+        return add_engines(config, std::max<size_t>(engine_count, 1));
+    }
+
+    size_t get_engine_count() const
+    {
+        return m_engines.size();
+    }
+
+    // The configuration of engine 0, for querying object names and the like
+    rs::object_recognition::or_configuration_interface* get_configuration() const
+    {
+        return m_engines.front()->configuration;
+    }
+
+    // Called in frame order on an engine thread. Don't call configure() or start_tracking() from it,
+    // update_tracking_rois() is fine.
+    void set_result_handler(result_handler handler)
+    {
+        m_handler = handler;
+    }
+
+    // Switches every engine to mode, calls configure on its configuration and applies the changes.
+    // Waits until the frames already accepted are delivered.
+    rs::core::status configure(rs::object_recognition::recognition_mode mode, configurator configure)
+    {
+        drain();
+        for (auto& e : m_engines)
+        {
+            e->configuration->set_recognition_mode(mode);
+            if (configure)
+            {
+                configure(e->configuration);
+            }
+            rs::core::status st = e->configuration->apply_changes();
+            if (st != rs::core::status_no_error)
+            {
+                return st;
+            }
+        }
+
+        std::lock_guard<std::mutex> lock(m_mutex);
+        for (auto& e : m_engines)
+        {
+            e->active = true;
+        }
+        m_mode = mode;
+        return rs::core::status_no_error;
+    }
+
+    // Switches to tracking of rois, which are split over the engines in consecutive groups.
+    // Waits until the frames already accepted are delivered.
+    rs::core::status start_tracking(const rs::core::rect* rois, int roi_count)
+    {
+        drain();
+        std::shared_ptr<const std::vector<rs::core::rect>> tracking_rois(new std::vector<rs::core::rect>(rois, rois + roi_count));
+        size_t engine_count = std::min<size_t>(m_engines.size(), std::max(roi_count, 1));
+        uint64_t generation;
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            generation = ++m_rois_generation;
+            m_rois = tracking_rois;
+        }
+        for (size_t i = 0; i < engine_count; ++i)
+        {
+            rs::core::status st = apply_tracking_rois(*m_engines[i], i, engine_count, *tracking_rois, generation);
+            if (st != rs::core::status_no_error)
+            {
+                return st;
+            }
+        }
+
+        std::lock_guard<std::mutex> lock(m_mutex);
+        for (size_t i = 0; i < m_engines.size(); ++i)
+        {
+            m_engines[i]->active = i < engine_count;
+            m_engines[i]->next_sequence = m_next_sequence;
+        }
+        m_mode = rs::object_recognition::recognition_mode::TRACKING;
+        return rs::core::status_no_error;
+    }
+
+    // Replaces the tracked rois without waiting for the engines. Frames accepted from now on are
+    // tracked with the new rois, split over the engines that start_tracking() used; an engine whose
+    // group is empty passes its frames on untouched. Fails if the pool isn't tracking.
+    rs::core::status update_tracking_rois(const rs::core::rect* rois, int roi_count)
+    {
+        std::shared_ptr<const std::vector<rs::core::rect>> tracking_rois(new std::vector<rs::core::rect>(rois, rois + roi_count));
+        std::lock_guard<std::mutex> lock(m_mutex);
+        if (!tracking())
+        {
+            return rs::core::status_process_failed;
+        }
+        ++m_rois_generation;
+        m_rois = tracking_rois;
+        return rs::core::status_no_error;
+    }
+
+    // Incremented by start_tracking() and update_tracking_rois(), see or_frame_result::tracking_generation
+    uint64_t query_tracking_generation() const
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        return m_rois_generation;
+    }
+
+    void start()
+    {
+        if (m_running)
+        {
+            return;
+        }
+        m_running = true;
+        m_stopping = false;
+        m_start_ns = now_ns();
+        m_next_delivery = m_next_sequence;
+        m_reorder.clear();
+        for (size_t i = 0; i < m_engines.size(); ++i)
+        {
+            m_engines[i]->thread = std::thread(&or_engine_pool::run_engine, this, i);
+        }
+    }
+
+    // Joins the engines after the frames they are processing; frames waiting for an engine are dropped
+    void stop()
+    {
+        if (!m_running)
+        {
+            return;
+        }
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            m_stopping = true;
+            m_jobs.clear();
+        }
+        m_work.notify_all();
+        m_idle.notify_all();
+        for (auto& e : m_engines)
+        {
+            if (e->thread.joinable())
+            {
+                e->thread.join();
+            }
+        }
+        m_running = false;
+    }
+
+    // Offers a frame to the engines, which take their own references on the images.
+    // Returns false if the engines are busy and the frame was not accepted.
+    bool submit(const rs::core::correlated_sample_set& sample_set)
+    {
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            if (m_stopping || !can_accept())
+            {
+                ++m_rejected;
+                return false;
+            }
+            std::shared_ptr<job> j(new job());
+            j->sequence = m_next_sequence++;
+            j->sample_set = sample_set_ref(sample_set);
+            j->engines = tracking() ? active_engine_count() : 1;
+            j->taken = 0;
+            j->remaining = j->engines;
+            j->result.sequence = j->sequence;
+            j->result.status = rs::core::status_no_error;
+            if (tracking())
+            {
+                j->rois = m_rois;
+                j->result.tracking_generation = m_rois_generation;
+            }
+            else
+            {
+                j->result.tracking_generation = 0;
+            }
+            rs::core::image_interface* color = sample_set[rs::core::stream_type::color];
+            j->result.timestamp = color ? color->query_time_stamp() : 0.0;
+            j->partial_tracking.resize(m_engines.size());
+            m_jobs.push_back(j);
+            ++m_accepted;
+        }
+        m_work.notify_all();
+        return true;
+    }
+
+    or_engine_stats query_engine_stats(size_t index) const
+    {
+        const engine& e = *m_engines[index];
+        or_engine_stats stats;
+        stats.processed = e.processed;
+        stats.avg_process_ms = stats.processed ? (e.busy_ns / 1e6) / stats.processed : 0.0;
+        int64_t elapsed_ns = now_ns() - m_start_ns;
+        stats.busy_ratio = elapsed_ns > 0 ? static_cast<double>(e.busy_ns) / elapsed_ns : 0.0;
+        return stats;
+    }
+
+    void print_stats() const
+    {
+        std::cout << "---------------------------------------------------------------------------------------------\n";
+        std::cout << "OR engines: " << m_accepted << " frames accepted, " << m_rejected << " offered while busy, "
+                  << "up to " << m_max_reorder_depth << " results waiting for an earlier frame\n";
+        std::cout << "            " << std::left << std::setw(10) << "engine" << std::setw(12) << "processed"
+                  << std::setw(16) << "avg time (ms)" << "busy\n";
+        for (size_t i = 0; i < m_engines.size(); ++i)
+        {
+            or_engine_stats stats = query_engine_stats(i);
+            std::cout << "            " << std::left << std::setw(10) << i << std::setw(12) << stats.processed
+                      << std::setw(16) << std::fixed << std::setprecision(1) << stats.avg_process_ms
+                      << std::setprecision(0) << stats.busy_ratio * 100 << "%\n";
+        }
+        std::cout << "---------------------------------------------------------------------------------------------\n";
+    }
+
+    // Writes the engine statistics in the Prometheus text format
+    void write_metrics(std::ostream& out) const
+    {
+        metrics_registry::write_header(out, "rs_or_engine_processed_total", "counter", "Frames processed by an object recognition engine");
+        for (size_t i = 0; i < m_engines.size(); ++i)
+        {
+            metrics_registry::write_sample(out, "rs_or_engine_processed_total", { { "engine", std::to_string(i) } },
+                                           static_cast<double>(query_engine_stats(i).processed));
+        }
+        metrics_registry::write_header(out, "rs_or_engine_busy_ratio", "gauge", "Fraction of the time an object recognition engine was processing");
+        for (size_t i = 0; i < m_engines.size(); ++i)
+        {
+            metrics_registry::write_sample(out, "rs_or_engine_busy_ratio", { { "engine", std::to_string(i) } },
+                                           query_engine_stats(i).busy_ratio);
+        }
+        metrics_registry::write_header(out, "rs_or_engine_rejected_total", "counter", "Frames offered while all object recognition engines were busy");
+        metrics_registry::write_sample(out, "rs_or_engine_rejected_total", {}, static_cast<double>(m_rejected));
+    }
+
+private:
+    struct engine
+    {
+        engine() : impl(nullptr), data(nullptr), configuration(nullptr), active(true), busy(false), next_sequence(0),
+            rois_generation(0), roi_count(0), processed(0), busy_ns(0) {}
+
+        std::unique_ptr<rs::object_recognition::or_video_module_impl> owned_impl;
+        rs::object_recognition::or_video_module_impl* impl;
+        rs::object_recognition::or_data_interface* data;
+        rs::object_recognition::or_configuration_interface* configuration;
+        std::thread thread;
+        bool active;                      // has tracking rois, always true in the other modes
+        bool busy;
+        uint64_t next_sequence;           // tracking: the first frame this engine hasn't taken yet
+        uint64_t rois_generation;         // tracking: of the rois applied to this engine
+        size_t roi_count;                 // tracking: size of this engine's group of rois
+        std::atomic<uint64_t> processed;
+        std::atomic<int64_t> busy_ns;
+    };
+
+    struct job
+    {
+        uint64_t sequence;
+        sample_set_ref sample_set;
+        size_t engines;                   // engines that process the frame
+        size_t taken;                     // engines that took the frame
+        size_t remaining;                 // engines that haven't finished the frame
+        std::shared_ptr<const std::vector<rs::core::rect>> rois;   // tracking: the rois to track the frame with
+        or_frame_result result;
+        std::vector<std::vector<rs::object_recognition::tracking_data>> partial_tracking;
+    };
+
+    static int64_t now_ns()
+    {
+        return std::chrono::duration_cast<std::chrono::nanoseconds>(
+                   std::chrono::steady_clock::now().time_since_epoch()).count();
+    }
+
+    rs::core::status add_engines(rs::core::video_module_interface::actual_module_config& config, size_t count)
+    {
+        for (size_t i = 0; i < count; ++i)
+        {
+            std::unique_ptr<engine> e(new engine());
+            e->owned_impl.reset(new rs::object_recognition::or_video_module_impl());
+            e->impl = e->owned_impl.get();
+            rs::core::status st = e->impl->set_module_config(config);
+            if (st != rs::core::status_no_error)
+            {
+                return st;
+            }
+            e->data = e->impl->create_output();
+            e->configuration = e->impl->create_active_configuration();
+            m_engines.push_back(std::move(e));
+        }
+
+        // The results are displayed with the object names of get_configuration()
+        or_label_table::of(get_configuration());
+
+        if (m_metrics_collector < 0)
+        {
+            m_metrics_collector = metrics_registry::get_instance().add_collector([this](std::ostream& out)
+            {
+                write_metrics(out);
+            });
+        }
+        return rs::core::status_no_error;
+    }
+
+    // Sets group index of engine_count consecutive groups of rois as the tracking rois of e
+    rs::core::status apply_tracking_rois(engine& e, size_t index, size_t engine_count,
+                                         const std::vector<rs::core::rect>& rois, uint64_t generation)
+    {
+        size_t begin = rois.size() * index / engine_count;
+        size_t end = rois.size() * (index + 1) / engine_count;
+        std::vector<rs::core::rect> group(rois.begin() + begin, rois.begin() + end);
+
+        e.rois_generation = generation;
+        e.roi_count = group.size();
+        if (group.empty())
+        {
+            return rs::core::status_no_error;
+        }
+        e.configuration->set_recognition_mode(rs::object_recognition::recognition_mode::TRACKING);
+        e.configuration->set_tracking_rois(group.data(), static_cast<int>(group.size()));
+        return e.configuration->apply_changes();
+    }
+
+    bool tracking() const
+    {
+        return m_mode == rs::object_recognition::recognition_mode::TRACKING;
+    }
+
+    size_t active_engine_count() const
+    {
+        size_t count = 0;
+        for (auto& e : m_engines)
+        {
+            count += e->active ? 1 : 0;
+        }
+        return count;
+    }
+
+    // Called with m_mutex held
+    bool can_accept() const
+    {
+        if (tracking())
+        {
+            // Every tracking engine takes every frame: allow one frame waiting for the slowest one
+            return m_jobs.empty() || m_jobs.back()->taken > 0;
+        }
+        size_t idle = 0;
+        for (auto& e : m_engines)
+        {
+            idle += e->busy ? 0 : 1;
+        }
+        return m_jobs.size() < idle;
+    }
+
+    // Called with m_mutex held: the next frame for engine index, or nullptr
+    std::shared_ptr<job> take_job(size_t index)
+    {
+        engine& e = *m_engines[index];
+        if (!e.active)
+        {
+            return nullptr;
+        }
+        if (!tracking())
+        {
+            if (m_jobs.empty())
+            {
+                return nullptr;
+            }
+            std::shared_ptr<job> j = m_jobs.front();
+            m_jobs.pop_front();
+            return j;
+        }
+
+        for (auto& j : m_jobs)
+        {
+            if (j->sequence >= e.next_sequence)
+            {
+                std::shared_ptr<job> taken = j;
+                e.next_sequence = j->sequence + 1;
+                ++j->taken;
+                while (!m_jobs.empty() && m_jobs.front()->taken == m_jobs.front()->engines)
+                {
+                    m_jobs.pop_front();
+                }
+                return taken;
+            }
+        }
+        return nullptr;
+    }
+
+    void run_engine(size_t index)
+    {
+        TRACE_THREAD_NAME("OR engine " + std::to_string(index));
+        engine& e = *m_engines[index];
+        while (true)
+        {
+            std::shared_ptr<job> j;
+            {
+                std::unique_lock<std::mutex> lock(m_mutex);
+                m_work.wait(lock, [&] { return m_stopping || (j = take_job(index)) != nullptr; });
+                if (m_stopping)
+                {
+                    return;
+                }
+                e.busy = true;
+            }
+
+            rs::core::status st = rs::core::status_no_error;
+            if (j->rois && j->result.tracking_generation != e.rois_generation)
+            {
+                // The tracking rois were updated since this engine's last frame
+                st = apply_tracking_rois(e, index, j->engines, *j->rois, j->result.tracking_generation);
+            }
+            if (st == rs::core::status_no_error && (!j->rois || e.roi_count > 0))
+            {
+                // An engine without rois passes the frame on, that isn't counted as processing
+                int64_t begin_ns = now_ns();
+                st = e.impl->process_sample_set(j->sample_set.get());
+                collect_result(e, index, *j, st);
+                e.busy_ns += now_ns() - begin_ns;
+                ++e.processed;
+            }
+            else if (st != rs::core::status_no_error)
+            {
+                std::lock_guard<std::mutex> lock(m_mutex);
+                j->result.status = st;
+            }
+
+            bool done;
+            {
+                std::lock_guard<std::mutex> lock(m_mutex);
+                e.busy = false;
+                done = --j->remaining == 0;
+            }
+            if (done)
+            {
+                j->sample_set.reset();
+                deliver(*j);
+            }
+        }
+    }
+
+    // Copies the engine output before the engine processes its next frame
+    void collect_result(engine& e, size_t index, job& j, rs::core::status st)
+    {
+        int count = 0;
+        if (st == rs::core::status_no_error && j.rois)
+        {
+            rs::object_recognition::tracking_data* data = nullptr;
+            st = e.data->query_tracking_result(&data, count);
+            if (st == rs::core::status_no_error && data)
+            {
+                j.partial_tracking[index].assign(data, data + count);
+            }
+        }
+        else if (st == rs::core::status_no_error)
+        {
+            rs::object_recognition::localization_data* data = nullptr;
+            st = e.data->query_localization_result(&data, count);
+            if (st == rs::core::status_no_error && data)
+            {
+                j.result.localization.assign(data, data + count);
+            }
+        }
+
+        if (st != rs::core::status_no_error)
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            j.result.status = st;
+        }
+    }
+
+    // Passes the results that are next in frame order to the handler
+    void deliver(job& j)
+    {
+        for (auto& partial : j.partial_tracking)
+        {
+            j.result.tracking.insert(j.result.tracking.end(), partial.begin(), partial.end());
+        }
+
+        std::lock_guard<std::mutex> lock(m_delivery_mutex);
+        m_reorder[j.sequence] = std::move(j.result);
+        m_max_reorder_depth = std::max<size_t>(m_max_reorder_depth, m_reorder.size() - 1);
+        while (!m_reorder.empty() && m_reorder.begin()->first == m_next_delivery)
+        {
+            if (m_handler)
+            {
+                m_handler(m_reorder.begin()->second);
+            }
+            m_reorder.erase(m_reorder.begin());
+            {
+                std::lock_guard<std::mutex> lock(m_mutex);
+                ++m_next_delivery;
+            }
+            m_idle.notify_all();
+        }
+    }
+
+    // Waits until every accepted frame is delivered
+    void drain()
+    {
+        std::unique_lock<std::mutex> lock(m_mutex);
+        m_idle.wait(lock, [this] { return m_stopping || !m_running || m_next_delivery == m_next_sequence; });
+    }
+
+    std::vector<std::unique_ptr<engine>> m_engines;
+    std::atomic<rs::object_recognition::recognition_mode> m_mode;     // set with m_mutex held
+    result_handler m_handler;
+
+    mutable std::mutex m_mutex;
+    std::condition_variable m_work;
+    std::condition_variable m_idle;
+    std::deque<std::shared_ptr<job>> m_jobs;
+    bool m_running;
+    bool m_stopping;
+    uint64_t m_next_sequence;
+    uint64_t m_next_delivery;
+    std::shared_ptr<const std::vector<rs::core::rect>> m_rois;
+    uint64_t m_rois_generation;
+
+    std::mutex m_delivery_mutex;
+    std::map<uint64_t, or_frame_result> m_reorder;
+
+    std::atomic<uint64_t> m_accepted;
+    std::atomic<uint64_t> m_rejected;
+    std::atomic<size_t> m_max_reorder_depth;
+    int64_t m_start_ns;
+    int m_metrics_collector;
+};
@@ -0,0 +1,107 @@
+// License: Apache 2.0. See LICENSE file in root directory.
+// Copyright(c) 2017 Intel Corporation. All Rights Reserved.
+
+#pragma once
+
+#include <atomic>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include "or_configuration_interface.h"
+
+// The object names of an OR configuration, queried once for all label ids.
+//
+// query_object_name_by_id is a library call that returns a new string; the displays name every
+// detection of every frame, so they look the names up here instead. The table doesn't change
+// after it is built, and the names it returns stay valid for the life of the process.
+class or_label_table
+{
+public:
+    explicit or_label_table(rs::object_recognition::or_configuration_interface* or_configuration) :
+        m_configuration(or_configuration)
+    {
+        // The label ids are consecutive, the first id without a name ends them
+        for (int id = 0; id < max_labels; ++id)
+        {
+            std::string name = or_configuration->query_object_name_by_id(id);
+            if (name.empty())
+            {
+                break;
+            }
+            m_names.push_back(std::move(name));
+        }
+    }
+
+    or_label_table(const or_label_table&) = delete;
+    or_label_table& operator=(const or_label_table&) = delete;
+
+    // The name of label, or an empty string for an id without one
+    const std::string& name(int label) const
+    {
+        static const std::string unknown;
+        return label >= 0 && label < static_cast<int>(m_names.size()) ? m_names[label] : unknown;
+    }
+
+    const std::vector<std::string>& names() const
+    {
+        return m_names;
+    }
+
+    int size() const
+    {
+        return static_cast<int>(m_names.size());
+    }
+
+    rs::object_recognition::or_configuration_interface* configuration() const
+    {
+        return m_configuration;
+    }
+
+    // The table of or_configuration, built the first time it is asked for. Each OR engine has its
+    // own configuration, so a sample has one table per engine at most.
+    static const or_label_table& of(rs::object_recognition::or_configuration_interface* or_configuration)
+    {
+        static std::mutex tables_mutex;
+        static std::map<rs::object_recognition::or_configuration_interface*, std::unique_ptr<or_label_table>> tables;
+
+        std::lock_guard<std::mutex> lock(tables_mutex);
+        std::unique_ptr<or_label_table>& table = tables[or_configuration];
+        if (!table)
+        {
+            table.reset(new or_label_table(or_configuration));
+        }
+        return *table;
+    }
+
+private:
+    static const int max_labels = 1024;
+
+    rs::object_recognition::or_configuration_interface* const m_configuration;
+    std::vector<std::string> m_names;
+};
+
+// Remembers the table a display last used, so per-frame lookups don't take the lock in
+// or_label_table::of(). A display is normally called with the same configuration every frame,
+// another configuration replaces the remembered table.
+class or_label_table_cache
+{
+public:
+    or_label_table_cache() : m_table(nullptr) {}
+
+    const or_label_table& get(rs::object_recognition::or_configuration_interface* or_configuration)
+    {
+        const or_label_table* table = m_table.load(std::memory_order_acquire);
+        if (!table || table->configuration() != or_configuration)
+        {
+            table = &or_label_table::of(or_configuration);
+            m_table.store(table, std::memory_order_release);
+        }
+        return *table;
+    }
+
+private:
+    std::atomic<const or_label_table*> m_table;
+};
@@ -3,6 +3,7 @@
 
 #pragma once
 
+#include <algorithm>
 #include <iostream>
 #include <opencv2/core.hpp>
 #include <opencv2/imgproc.hpp>
@@ -15,12 +16,16 @@
 #include <mutex>
 #include <condition_variable>
 #include <deque>
+#include <stdexcept>
 
 #include <librealsense/rs.hpp>
 #include "or_data_interface.h"
 #include "or_configuration_interface.h"
 #include "or_video_module_impl.h"
 #include "rs_sdk.h"
+#include "open_frame_source.hpp"
+#include "or_engine_pool.hpp"
+#include "or_label_table.hpp"
 
 #define ESC_KEY 27
 
@@ -37,7 +42,12 @@ public:
     }
     ~or_utils()
     {
-
+        // The reader lets go of the source before the source thread is joined
+        m_reader.stop();
+        if (m_source)
+        {
+            m_source->stop();
+        }
     }
 
     // Handling all camera initialization (projection, camera configuration, MW initialization)
@@ -53,16 +63,14 @@ public:
         if (m_ctx == nullptr)
             return rs::core::status_process_failed;
 
-        int deviceCount = m_ctx->get_device_count();
-        if (deviceCount  == 0)
+        // Get the camera, or the source selected by RS_SAMPLES_FRAME_SOURCE
+        m_source = open_frame_source(*m_ctx);
+        if (!m_source)
         {
             cout << "Error: Device is null. " << "There are no RealSense devices connected." << endl << "Please connect a RealSense device and restart the application" << endl;
             return rs::core::status_process_failed;
         }
 
-        // Get pointer to the camera
-        m_dev = m_ctx->get_device(0);
-
         // Request the first (index 0) supported module config.
         rs::core::video_module_interface::supported_module_config cfg;
         if(use_default_config)
@@ -88,15 +96,15 @@ public:
 
 
         // Enables streams according to the supported configuration
-        m_dev->enable_stream(rs::stream::color, cfg.image_streams_configs[(int)rs::stream::color].size.width,
-                             cfg.image_streams_configs[(int)rs::stream::color].size.height,
-                             rs::format::rgb8,
-                             cfg.image_streams_configs[(int)rs::stream::color].frame_rate);
+        m_source->enable_stream(stream_type::color, cfg.image_streams_configs[(int)rs::stream::color].size.width,
+                                cfg.image_streams_configs[(int)rs::stream::color].size.height,
+                                pixel_format::rgb8,
+                                cfg.image_streams_configs[(int)rs::stream::color].frame_rate);
 
-        m_dev->enable_stream(rs::stream::depth, cfg.image_streams_configs[(int)rs::stream::depth].size.width,
-                             cfg.image_streams_configs[(int)rs::stream::depth].size.height,
-                             rs::format::z16,
-                             cfg.image_streams_configs[(int)rs::stream::depth].frame_rate);
+        m_source->enable_stream(stream_type::depth, cfg.image_streams_configs[(int)rs::stream::depth].size.width,
+                                cfg.image_streams_configs[(int)rs::stream::depth].size.height,
+                                pixel_format::z16,
+                                cfg.image_streams_configs[(int)rs::stream::depth].frame_rate);
 
         // Handling color image info (for later using)
         colorInfo.height = cfg.image_streams_configs[(int)rs::stream::color].size.height;
@@ -111,41 +119,39 @@ public:
         depthInfo.format = rs::core::pixel_format::z16;
         depthInfo.pitch = depthInfo.width * 2;
 
-        // Start Camera device
-        m_dev->start();
+        // Start Camera device, images are paired into sample sets by the reader
+        m_reader.attach(m_source.get(), cfg.image_streams_configs[(int)rs::stream::color].frame_rate);
+        m_source->start();
 
-        // Enable auto exposure for color stream
-        m_dev->set_option(rs::option::color_enable_auto_exposure, 1);
+        if (rs::device* device = m_source->get_device())
+        {
+            // Enable auto exposure for color stream
+            device->set_option(rs::option::color_enable_auto_exposure, 1);
 
-        // Enable auto exposure for Depth camera stream
-        m_dev->set_option(rs::option::r200_lr_auto_exposure_enabled, 1);
+            // Enable auto exposure for Depth camera stream
+            device->set_option(rs::option::r200_lr_auto_exposure_enabled, 1);
+        }
 
         // Get the extrisics parameters from the camera
-        rs::extrinsics ext  = m_dev->get_extrinsics(rs::stream::depth, rs::stream::color);
-        rs::core::extrinsics core_ext;
+        rs::core::extrinsics core_ext = m_source->get_extrinsics(stream_type::depth, stream_type::color);
 
         // Get color intrinsics
-        rs::intrinsics colorInt = m_dev->get_stream_intrinsics(rs::stream::color);
-        rs::core::intrinsics core_colorInt;
+        rs::core::intrinsics core_colorInt = m_source->get_intrinsics(stream_type::color);
 
         // Get depth intrinsics
-        rs::intrinsics depthInt = m_dev->get_stream_intrinsics(rs::stream::depth);
-        rs::core::intrinsics core_depthInt;
+        rs::core::intrinsics core_depthInt = m_source->get_intrinsics(stream_type::depth);
 
         // After getting all parameters from the camera we need to set the actual_module_config
         rs::core::video_module_interface::actual_module_config actualConfig;
 
         //1. copy the extrinsics
-        memcpy(&actualConfig.image_streams_configs[(int)rs::stream::color].extrinsics, &ext, sizeof(rs::extrinsics));
-        core_ext =  rs::utils::convert_extrinsics(ext);
+        actualConfig.image_streams_configs[(int)rs::stream::color].extrinsics = core_ext;
 
         //2. copy the color intrinsics
-        memcpy(&actualConfig.image_streams_configs[(int)rs::stream::color].intrinsics, &colorInt, sizeof(rs::intrinsics));
-        core_colorInt = rs::utils::convert_intrinsics (colorInt);
+        actualConfig.image_streams_configs[(int)rs::stream::color].intrinsics = core_colorInt;
 
         //3. copy the depth intrinsics
-        memcpy(&actualConfig.image_streams_configs[(int)rs::stream::depth].intrinsics, &depthInt, sizeof(rs::intrinsics));
-        core_depthInt = rs::utils::convert_intrinsics(depthInt);
+        actualConfig.image_streams_configs[(int)rs::stream::depth].intrinsics = core_depthInt;
 
         // Handling projection
         rs::core::projection_interface* proj = rs::core::projection_interface::create_instance(&core_colorInt, &core_depthInt, &core_ext);
@@ -155,6 +161,7 @@ public:
         st=impl.set_module_config(actualConfig);
         if (st != rs::core::status_no_error)
             return st;
+        m_actual_config = actualConfig;
 
         // Create or data object
         *or_data = impl.create_output();
@@ -162,6 +169,9 @@ public:
         // Create or data object
         *or_configuration = impl.create_active_configuration();
 
+        // Query the object names once, the displays look them up for every detection
+        or_label_table::of(*or_configuration);
+
         m_sample_set = new rs::core::correlated_sample_set();
 
         m_sample_set->images[(int)rs::stream::color]=nullptr;
@@ -174,24 +184,19 @@ public:
     // Get rs::core::correlated_sample_set* from the camera (encapsulates all conversion staff)
     correlated_sample_set* get_sample_set(image_info& colorInfo,image_info& depthInfo)
     {
-        m_dev->wait_for_frames();
-
-        //get color and depth buffers
-        const void* colorBuffer =  m_dev->get_frame_data(rs::stream::color);
-        const void* depthBuffer = m_dev->get_frame_data(rs::stream::depth);
-
         // Release images from the previous frame
         release_images();
 
-        // Create images from buffers
-        rs::core::image_interface::image_data_with_data_releaser color_container(colorBuffer);
-        rs::core::image_interface::image_data_with_data_releaser depth_container(depthBuffer);
-        auto colorImg = rs::core::image_interface::create_instance_from_raw_data( &colorInfo, color_container, rs::core::stream_type::color, rs::core::image_interface::any,m_frame_number, (uint64_t)m_dev->get_frame_timestamp(rs::stream::color));
-        auto depthImg = rs::core::image_interface::create_instance_from_raw_data( &depthInfo, depth_container, rs::core::stream_type::depth, rs::core::image_interface::any,m_frame_number, (uint64_t)m_dev->get_frame_timestamp(rs::stream::depth));
-
-        // Build sample set with both images
-        m_sample_set->images[(int)rs::stream::color] = colorImg;
-        m_sample_set->images[(int)rs::stream::depth] = depthImg;
+        // Wait for the next color and depth images, like wait_for_frames() throws if the camera stopped
+        while (!m_reader.wait_for_sample_set(*m_sample_set))
+        {
+            if (!m_source->is_streaming())
+            {
+                throw std::runtime_error("frame source stopped streaming");
+            }
+            cerr << "warning: no frames from " << m_source->get_name() << " for 5 seconds" << endl;
+        }
+        m_color_buffer = const_cast<void*>(m_sample_set->images[(int)rs::stream::color]->query_data());
         m_frame_number++;
 
         return m_sample_set;
@@ -208,7 +213,8 @@ public:
     // Stop Camera device
     void stop_camera()
     {
-        m_dev->stop();
+        m_reader.stop();
+        m_source->stop();
         release_images();
         delete m_sample_set;
     }
@@ -228,6 +234,12 @@ public:
         return m_color_height;
     }
 
+    // The module config set by init_camera(), for setting up more OR engines the same way
+    rs::core::video_module_interface::actual_module_config& get_actual_module_config()
+    {
+        return m_actual_config;
+    }
+
     // Query suitable supported_module_config
     rs::core::status query_supported_config(or_video_module_impl& or_impl,
         video_module_interface::supported_module_config& supported_config)
@@ -260,20 +272,8 @@ public:
     void query_object_name_list(vector<string>& obj_name_list,
         rs::object_recognition::or_configuration_interface* or_configuration)
     {
-        int i = 0;
-        while(1)
-        {
-            string objName = or_configuration->query_object_name_by_id(i);
-            if(i > 50 || objName.empty())
-            {
-                break;
-            }
-            else
-            {
-                obj_name_list.push_back(objName);
-                i++;
-            }
-        }
+        const vector<string>& names = or_label_table::of(or_configuration).names();
+        obj_name_list.insert(obj_name_list.end(), names.begin(), names.begin() + std::min<size_t>(names.size(), 51));
     }
 
     bool user_request_exit(void)
@@ -302,7 +302,8 @@ public:
 
 protected:
     std::shared_ptr<rs::core::context_interface> m_ctx;
-    rs::device* m_dev;
+    sample_set_reader m_reader;
+    std::unique_ptr<frame_source> m_source;
     rs::core::correlated_sample_set* m_sample_set;
     rs::core::image_info m_colorInfo;
     void* m_color_buffer;
@@ -310,6 +311,7 @@ protected:
 
     int m_color_width;
     int m_color_height;
+    rs::core::video_module_interface::actual_module_config m_actual_config;
 
     void release_images()
     {
@@ -0,0 +1,306 @@
+// License: Apache 2.0. See LICENSE file in root directory.
+// Copyright(c) 2017 Intel Corporation. All Rights Reserved.
+
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+// Scoped trace spans of the sample pipeline, dumped as Chrome trace-event JSON
+// (chrome://tracing or ui.perfetto.dev).
+//
+// Each thread records into its own ring buffer, so recording a span is two clock reads and a
+// store, without locks. Recording is off until trace_recorder::enable() is called; until then a
+// span is a single relaxed load. Building without RS_SAMPLES_TRACING removes the spans entirely.
+//
+//     TRACE_SPAN("slam_process", frame_number, "fisheye");
+
+struct trace_event
+{
+    const char* name;       // string literal
+    const char* stream;     // string literal or nullptr
+    int64_t begin_ns;
+    int64_t end_ns;
+    int frame;              // -1 when the span isn't tied to a frame
+};
+
+// Single writer ring buffer, the oldest events are overwritten
+class trace_ring
+{
+public:
+    trace_ring(size_t capacity, int id) :
+        m_events(capacity),
+        m_head(0),
+        m_id(id)
+    {
+    }
+
+    void push(const trace_event& event)
+    {
+        uint64_t head = m_head.load(std::memory_order_relaxed);
+        m_events[head % m_events.size()] = event;
+        m_head.store(head + 1, std::memory_order_release);
+    }
+
+    // Copies the events still in the ring, oldest first. Safe while the owner keeps
+    // recording; events that may have been overwritten during the copy are skipped.
+    std::vector<trace_event> copy_events() const
+    {
+        const uint64_t capacity = m_events.size();
+        uint64_t head = m_head.load(std::memory_order_acquire);
+        uint64_t first = head > capacity ? head - capacity : 0;
+
+        std::vector<trace_event> events;
+        events.reserve(head - first);
+        for (uint64_t i = first; i < head; ++i)
+        {
+            events.push_back(m_events[i % capacity]);
+        }
+
+        uint64_t head_after = m_head.load(std::memory_order_acquire);
+        uint64_t valid_from = head_after >= capacity ? head_after - capacity + 1 : 0;
+        if (valid_from > first)
+        {
+            events.erase(events.begin(), events.begin() + std::min<uint64_t>(valid_from - first, events.size()));
+        }
+        return events;
+    }
+
+    int get_id() const
+    {
+        return m_id;
+    }
+
+    void set_name(const std::string& name)
+    {
+        m_name = name;
+    }
+
+    const std::string& get_name() const
+    {
+        return m_name;
+    }
+
+private:
+    std::vector<trace_event> m_events;
+    std::atomic<uint64_t> m_head;
+    const int m_id;
+    std::string m_name;
+};
+
+class trace_recorder
+{
+public:
+    static trace_recorder& get_instance()
+    {
+        static trace_recorder instance;
+        return instance;
+    }
+
+    static int64_t now_ns()
+    {
+        return std::chrono::duration_cast<std::chrono::nanoseconds>(
+                   std::chrono::steady_clock::now().time_since_epoch()).count();
+    }
+
+    // Starts recording; dump() writes the trace to path
+    void enable(const std::string& path, size_t events_per_thread = 32 * 1024)
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_path = path;
+        m_events_per_thread = events_per_thread;
+        m_start_ns = now_ns();
+        m_enabled.store(true, std::memory_order_release);
+    }
+
+    bool is_enabled() const
+    {
+        return m_enabled.load(std::memory_order_relaxed);
+    }
+
+    // Names the calling thread in the trace
+    void set_thread_name(const std::string& name)
+    {
+        if (!is_enabled())
+        {
+            return;
+        }
+        trace_ring& ring = thread_ring();
+        std::lock_guard<std::mutex> lock(m_mutex);
+        ring.set_name(name);
+    }
+
+    void record(const char* name, const char* stream, int frame, int64_t begin_ns, int64_t end_ns)
+    {
+        trace_event event = { name, stream, begin_ns, end_ns, frame };
+        thread_ring().push(event);
+    }
+
+    // Writes the recorded spans to the path given to enable(), returns false if not enabled
+    bool dump()
+    {
+        if (!is_enabled())
+        {
+            return false;
+        }
+        std::ofstream out(m_path);
+        if (!out)
+        {
+            std::cerr << "error: cannot write trace file " << m_path << std::endl;
+            return false;
+        }
+        write_chrome_trace(out);
+        std::cout << "Trace written to " << m_path << std::endl;
+        return true;
+    }
+
+    void write_chrome_trace(std::ostream& out)
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        out << std::fixed << std::setprecision(3);
+        out << "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n";
+        bool first = true;
+        for (const auto& ring : m_rings)
+        {
+            std::string thread_name = ring->get_name().empty() ? "thread " + std::to_string(ring->get_id()) : ring->get_name();
+            out << (first ? "" : ",\n")
+                << "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":" << ring->get_id()
+                << ",\"args\":{\"name\":\"" << thread_name << "\"}}";
+            first = false;
+
+            for (const trace_event& e : ring->copy_events())
+            {
+                out << ",\n{\"name\":\"" << e.name << "\",\"cat\":\"pipeline\",\"ph\":\"X\",\"pid\":1,\"tid\":" << ring->get_id()
+                    << ",\"ts\":" << (e.begin_ns - m_start_ns) / 1000.0
+                    << ",\"dur\":" << (e.end_ns - e.begin_ns) / 1000.0
+                    << ",\"args\":{\"frame\":" << e.frame;
+                if (e.stream)
+                {
+                    out << ",\"stream\":\"" << e.stream << "\"";
+                }
+                out << "}}";
+            }
+        }
+        out << "\n]}\n";
+    }
+
+private:
+    // Returns the ring of a thread to the pool when the thread exits, so the per-frame
+    // worker threads of OR and PT reuse rings instead of adding one per frame
+    struct ring_owner
+    {
+        trace_ring* ring = nullptr;
+
+        ~ring_owner()
+        {
+            if (ring)
+            {
+                trace_recorder::get_instance().release_ring(ring);
+            }
+        }
+    };
+
+    trace_recorder() : m_enabled(false), m_events_per_thread(0), m_start_ns(0) {}
+
+    trace_ring& thread_ring()
+    {
+        static thread_local ring_owner owner;
+        if (!owner.ring)
+        {
+            owner.ring = acquire_ring();
+        }
+        return *owner.ring;
+    }
+
+    trace_ring* acquire_ring()
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        if (!m_free_rings.empty())
+        {
+            trace_ring* ring = m_free_rings.back();
+            m_free_rings.pop_back();
+            return ring;
+        }
+        m_rings.emplace_back(new trace_ring(m_events_per_thread, (int)m_rings.size() + 1));
+        return m_rings.back().get();
+    }
+
+    void release_ring(trace_ring* ring)
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_free_rings.push_back(ring);
+    }
+
+    std::atomic<bool> m_enabled;
+    std::mutex m_mutex;
+    std::string m_path;
+    size_t m_events_per_thread;
+    int64_t m_start_ns;
+    std::vector<std::unique_ptr<trace_ring>> m_rings;
+    std::vector<trace_ring*> m_free_rings;
+};
+
+// Records the time from construction to destruction as one span
+class trace_span
+{
+public:
+    trace_span(const char* name, int frame = -1, const char* stream = nullptr) :
+        m_name(trace_recorder::get_instance().is_enabled() ? name : nullptr),
+        m_stream(stream),
+        m_frame(frame),
+        m_begin_ns(m_name ? trace_recorder::now_ns() : 0)
+    {
+    }
+
+    ~trace_span()
+    {
+        if (m_name)
+        {
+            trace_recorder::get_instance().record(m_name, m_stream, m_frame, m_begin_ns, trace_recorder::now_ns());
+        }
+    }
+
+    trace_span(const trace_span&) = delete;
+    trace_span& operator=(const trace_span&) = delete;
+
+private:
+    const char* m_name;
+    const char* m_stream;
+    int m_frame;
+    int64_t m_begin_ns;
+};
+
+#define RS_TRACE_CONCAT_IMPL(a, b) a##b
+#define RS_TRACE_CONCAT(a, b) RS_TRACE_CONCAT_IMPL(a, b)
+
+// Handles the -trace <file> command line switch, returns false if tracing was compiled out
+inline bool start_pipeline_trace(const std::string& path)
+{
+#ifdef RS_SAMPLES_TRACING
+    trace_recorder::get_instance().enable(path);
+    std::cout << "Recording pipeline trace to " << path << std::endl;
+    return true;
+#else
+    std::cerr << "warning: built without RS_SAMPLES_TRACING, ignoring -trace " << path << std::endl;
+    return false;
+#endif
+}
+
+#ifdef RS_SAMPLES_TRACING
+// The frame expression is only evaluated while recording
+#define TRACE_SPAN(name, frame, stream) \
+    trace_span RS_TRACE_CONCAT(trace_span_, __COUNTER__)(name, trace_recorder::get_instance().is_enabled() ? (int)(frame) : -1, stream)
+#define TRACE_THREAD_NAME(name) trace_recorder::get_instance().set_thread_name(name)
+#else
+#define TRACE_SPAN(name, frame, stream) do {} while (0)
+#define TRACE_THREAD_NAME(name) do {} while (0)
+#endif
@@ -0,0 +1,391 @@
+// License: Apache 2.0. See LICENSE file in root directory.
+// Copyright(c) 2017 Intel Corporation. All Rights Reserved.
+
+#pragma once
+
+#include <chrono>
+#include <cmath>
+#include <condition_variable>
+#include <cstring>
+#include <cstdint>
+#include <deque>
+#include <mutex>
+
+#include <rs_sdk.h>
+
+#include "imu_batcher.hpp"
+#include "latest_value.hpp"
+
+// Pose propagated with IMU data from the most recent SLAM pose
+struct predicted_pose
+{
+    double timestamp;           // ms, timestamp of the newest IMU sample applied
+    double anchor_timestamp;    // ms, timestamp of the SLAM pose it was propagated from
+    float pose[12];             // 3x4 row-major [R|t], same layout as PoseMatrix4f
+    int tracking;               // tracking accuracy reported with the anchor pose
+    uint32_t imu_samples;       // IMU samples integrated since the anchor
+};
+
+// Integrates gyro and accel samples forward from the last SLAM pose, so a pose is available at
+// IMU rate instead of at camera rate plus SLAM latency. Every sample publishes a new prediction.
+//
+// SLAM poses arrive late, so the predictor keeps a short history of IMU samples and when a new
+// pose arrives it re-anchors on it and replays the samples newer than the pose. Velocity comes
+// from the last two SLAM poses and gravity is estimated in the world frame from the accelerometer,
+// so no assumption about the orientation of the SLAM world frame is needed. Translation is only
+// extrapolated for max_horizon_ms after the anchor, beyond that the position is held.
+//
+// All time comes from the sample timestamps, so synthetic IMU traces can be replayed through
+// add_imu_samples() and on_slam_pose() to test it without a camera. The latest prediction is
+// published through a lock-free slot that any thread can poll with get_latest(), or wait for
+// with wait_for_update().
+class pose_predictor
+{
+public:
+    pose_predictor(double max_horizon_ms = 100.0) :
+        m_max_horizon_ms(max_horizon_ms),
+        m_has_anchor(false),
+        m_has_previous_anchor(false),
+        m_has_gravity(false)
+    {
+        rs::core::motion_device_intrinsics identity = {};
+        for (int i = 0; i < 3; ++i)
+        {
+            identity.data[i][i] = 1.0f;
+        }
+        m_accel_intrinsics = identity;
+        m_gyro_intrinsics = identity;
+
+        set_identity(m_imu_to_camera);
+        m_state = {};
+    }
+
+    pose_predictor(const pose_predictor&) = delete;
+    pose_predictor& operator=(const pose_predictor&) = delete;
+
+    // Scale, cross-axis and bias calibration of the motion sensors, as set in the SLAM config
+    void set_motion_intrinsics(const rs::core::motion_device_intrinsics& accel, const rs::core::motion_device_intrinsics& gyro)
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_accel_intrinsics = accel;
+        m_gyro_intrinsics = gyro;
+    }
+
+    // Row-major rotation from the IMU axes to the axes of the camera tracked by SLAM
+    void set_imu_to_camera_rotation(const float rotation[9])
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        std::memcpy(m_imu_to_camera, rotation, sizeof(m_imu_to_camera));
+    }
+
+    // Called with each IMU sample as it arrives from the motion callback, before it is batched for
+    // SLAM, and publishes a prediction that includes it. Accel and gyro may be slightly out of order
+    // with each other, each type is integrated against its own previous sample.
+    void add_imu_sample(const imu_sample& raw)
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        add_locked(raw);
+    }
+
+    // Adds a timestamp-ordered run of samples, e.g. a recorded trace, publishing after each one
+    void add_imu_samples(const imu_sample* samples, size_t count)
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        for (size_t i = 0; i < count; ++i)
+        {
+            add_locked(samples[i]);
+        }
+    }
+
+    // Called with each SLAM pose and the timestamp of the frame it was computed from.
+    // Poses with failed tracking should not be passed in.
+    void on_slam_pose(double timestamp, const float pose[12], int tracking)
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        if (m_has_anchor && timestamp <= m_anchor.timestamp)
+        {
+            return;
+        }
+
+        if (m_has_anchor)
+        {
+            m_previous_anchor = m_anchor;
+            m_has_previous_anchor = true;
+        }
+
+        m_anchor.timestamp = timestamp;
+        m_anchor.tracking = tracking;
+        std::memcpy(m_anchor.pose, pose, sizeof(m_anchor.pose));
+        m_has_anchor = true;
+
+        reset_state_to_anchor();
+
+        // Drop samples the anchor already accounts for, replay the rest on top of it
+        while (!m_history.empty() && m_history.front().timestamp <= timestamp)
+        {
+            m_history.pop_front();
+        }
+        for (const imu_sample& sample : m_history)
+        {
+            integrate(sample, false);
+        }
+
+        publish();
+    }
+
+    // version, if given, is set to the get_version() of the pose returned
+    bool get_latest(predicted_pose& pose, uint32_t* version = nullptr) const
+    {
+        return m_latest.load(pose, version);
+    }
+
+    // Waits until a prediction newer than version is published, returns false on timeout
+    bool wait_for_update(uint32_t version, std::chrono::milliseconds timeout)
+    {
+        std::unique_lock<std::mutex> lock(m_mutex);
+        return m_published.wait_for(lock, timeout, [&]() { return m_latest.version() != version; });
+    }
+
+    // Increments on every published prediction
+    uint32_t get_version() const
+    {
+        return m_latest.version();
+    }
+
+private:
+    static const size_t max_history_size = 1024;
+    static constexpr double max_sample_gap_ms = 50.0;
+    static constexpr float gravity_filter_gain = 0.01f;
+
+    struct anchor_pose
+    {
+        double timestamp;
+        float pose[12];
+        int tracking;
+    };
+
+    struct propagation_state
+    {
+        float rotation[9];      // row-major camera to world
+        float position[3];
+        float velocity[3];      // m/s, world frame
+        double last_gyro_timestamp;
+        double last_accel_timestamp;
+        double timestamp;
+        uint32_t imu_samples;
+    };
+
+    static void set_identity(float m[9])
+    {
+        for (int i = 0; i < 9; ++i)
+        {
+            m[i] = (i % 4 == 0) ? 1.0f : 0.0f;
+        }
+    }
+
+    static void multiply(const float a[9], const float v[3], float out[3])
+    {
+        for (int r = 0; r < 3; ++r)
+        {
+            out[r] = a[r * 3] * v[0] + a[r * 3 + 1] * v[1] + a[r * 3 + 2] * v[2];
+        }
+    }
+
+    static void apply_intrinsics(const rs::core::motion_device_intrinsics& intrinsics, const float in[3], float out[3])
+    {
+        for (int r = 0; r < 3; ++r)
+        {
+            out[r] = intrinsics.data[r][0] * in[0] + intrinsics.data[r][1] * in[1] + intrinsics.data[r][2] * in[2]
+                     - intrinsics.data[r][3];
+        }
+    }
+
+    // Returns the sample corrected by the sensor intrinsics and rotated into the camera axes
+    imu_sample calibrate(const imu_sample& raw) const
+    {
+        imu_sample sample = raw;
+        float corrected[3];
+        apply_intrinsics(raw.type == rs::core::motion_type::gyro ? m_gyro_intrinsics : m_accel_intrinsics, raw.data, corrected);
+        multiply(m_imu_to_camera, corrected, sample.data);
+        return sample;
+    }
+
+    void add_locked(const imu_sample& raw)
+    {
+        imu_sample sample = calibrate(raw);
+        m_history.push_back(sample);
+        if (m_history.size() > max_history_size)
+        {
+            m_history.pop_front();
+        }
+
+        if (m_has_anchor)
+        {
+            integrate(sample, true);
+            publish();
+        }
+    }
+
+    void reset_state_to_anchor()
+    {
+        const float* pose = m_anchor.pose;
+        for (int r = 0; r < 3; ++r)
+        {
+            m_state.rotation[r * 3] = pose[r * 4];
+            m_state.rotation[r * 3 + 1] = pose[r * 4 + 1];
+            m_state.rotation[r * 3 + 2] = pose[r * 4 + 2];
+            m_state.position[r] = pose[r * 4 + 3];
+            m_state.velocity[r] = 0.0f;
+        }
+
+        if (m_has_previous_anchor)
+        {
+            double dt = (m_anchor.timestamp - m_previous_anchor.timestamp) / 1000.0;
+            if (dt > 0.0 && dt < 0.2)
+            {
+                for (int r = 0; r < 3; ++r)
+                {
+                    m_state.velocity[r] = static_cast<float>((m_anchor.pose[r * 4 + 3] - m_previous_anchor.pose[r * 4 + 3]) / dt);
+                }
+            }
+        }
+
+        m_state.last_gyro_timestamp = m_anchor.timestamp;
+        m_state.last_accel_timestamp = m_anchor.timestamp;
+        m_state.timestamp = m_anchor.timestamp;
+        m_state.imu_samples = 0;
+    }
+
+    // Advances the state by one calibrated sample. Gravity is only refined by live samples,
+    // so replaying the history after a re-anchor doesn't count the same samples twice.
+    void integrate(const imu_sample& sample, bool live)
+    {
+        if (sample.timestamp <= m_anchor.timestamp)
+        {
+            return;
+        }
+
+        if (sample.type == rs::core::motion_type::gyro)
+        {
+            double dt_ms = sample.timestamp - m_state.last_gyro_timestamp;
+            m_state.last_gyro_timestamp = sample.timestamp;
+            if (dt_ms > 0.0 && dt_ms <= max_sample_gap_ms)
+            {
+                rotate(sample.data, static_cast<float>(dt_ms / 1000.0));
+            }
+        }
+        else
+        {
+            float accel_world[3];
+            multiply(m_state.rotation, sample.data, accel_world);
+            if (live)
+            {
+                update_gravity(accel_world);
+            }
+
+            double dt_ms = sample.timestamp - m_state.last_accel_timestamp;
+            m_state.last_accel_timestamp = sample.timestamp;
+            if (m_has_gravity && dt_ms > 0.0 && dt_ms <= max_sample_gap_ms &&
+                    sample.timestamp - m_anchor.timestamp <= m_max_horizon_ms)
+            {
+                float dt = static_cast<float>(dt_ms / 1000.0);
+                for (int r = 0; r < 3; ++r)
+                {
+                    float linear = accel_world[r] - m_gravity[r];
+                    m_state.position[r] += m_state.velocity[r] * dt + 0.5f * linear * dt * dt;
+                    m_state.velocity[r] += linear * dt;
+                }
+            }
+        }
+
+        if (sample.timestamp > m_state.timestamp)
+        {
+            m_state.timestamp = sample.timestamp;
+        }
+        ++m_state.imu_samples;
+    }
+
+    void update_gravity(const float accel_world[3])
+    {
+        if (!m_has_gravity)
+        {
+            std::memcpy(m_gravity, accel_world, sizeof(m_gravity));
+            m_has_gravity = true;
+            return;
+        }
+        for (int r = 0; r < 3; ++r)
+        {
+            m_gravity[r] += gravity_filter_gain * (accel_world[r] - m_gravity[r]);
+        }
+    }
+
+    // Applies the body-frame angular velocity (rad/s) over dt seconds: R = R * exp([w]x * dt)
+    void rotate(const float omega[3], float dt)
+    {
+        float angle = std::sqrt(omega[0] * omega[0] + omega[1] * omega[1] + omega[2] * omega[2]) * dt;
+        if (angle < 1e-9f)
+        {
+            return;
+        }
+        float axis[3] = { omega[0] * dt / angle, omega[1] * dt / angle, omega[2] * dt / angle };
+        float s = std::sin(angle);
+        float c = std::cos(angle);
+        float t = 1.0f - c;
+
+        float delta[9] =
+        {
+            t * axis[0] * axis[0] + c,           t * axis[0] * axis[1] - s * axis[2], t * axis[0] * axis[2] + s * axis[1],
+            t * axis[0] * axis[1] + s * axis[2], t * axis[1] * axis[1] + c,           t * axis[1] * axis[2] - s * axis[0],
+            t * axis[0] * axis[2] - s * axis[1], t * axis[1] * axis[2] + s * axis[0], t * axis[2] * axis[2] + c
+        };
+
+        float result[9];
+        for (int r = 0; r < 3; ++r)
+        {
+            for (int col = 0; col < 3; ++col)
+            {
+                result[r * 3 + col] = m_state.rotation[r * 3] * delta[col] +
+                                      m_state.rotation[r * 3 + 1] * delta[3 + col] +
+                                      m_state.rotation[r * 3 + 2] * delta[6 + col];
+            }
+        }
+        std::memcpy(m_state.rotation, result, sizeof(result));
+    }
+
+    void publish()
+    {
+        predicted_pose out;
+        out.timestamp = m_state.timestamp;
+        out.anchor_timestamp = m_anchor.timestamp;
+        out.tracking = m_anchor.tracking;
+        out.imu_samples = m_state.imu_samples;
+        for (int r = 0; r < 3; ++r)
+        {
+            out.pose[r * 4] = m_state.rotation[r * 3];
+            out.pose[r * 4 + 1] = m_state.rotation[r * 3 + 1];
+            out.pose[r * 4 + 2] = m_state.rotation[r * 3 + 2];
+            out.pose[r * 4 + 3] = m_state.position[r];
+        }
+        m_latest.store(out);
+        m_published.notify_all();
+    }
+
+    const double m_max_horizon_ms;
+
+    std::mutex m_mutex;
+    std::condition_variable m_published;
+    rs::core::motion_device_intrinsics m_accel_intrinsics;
+    rs::core::motion_device_intrinsics m_gyro_intrinsics;
+    float m_imu_to_camera[9];
+
+    std::deque<imu_sample> m_history;
+    anchor_pose m_anchor;
+    anchor_pose m_previous_anchor;
+    bool m_has_anchor;
+    bool m_has_previous_anchor;
+    float m_gravity[3];
+    bool m_has_gravity;
+    propagation_state m_state;
+
+    latest_value<predicted_pose> m_latest;
+};
@@ -0,0 +1,229 @@
+// License: Apache 2.0. See LICENSE file in root directory.
+// Copyright(c) 2017 Intel Corporation. All Rights Reserved.
+
+#pragma once
+
+#include <algorithm>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <iostream>
+#include <mutex>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+#include "person_tracking_video_module_factory.h"
+
+// Recognition ids of the tracked people, registered with person recognition on a worker thread.
+//
+// RegisterUser computes a descriptor of the person, which takes long enough that calling it for
+// every person on every frame slows down the frame loop. The cache registers each tracking id
+// once, when it first shows up, and retries with a growing delay when that fails. A frame only
+// looks the ids up. An id is forgotten when it leaves the frame, as the tracker doesn't reuse it
+// for the same person.
+//
+// The PT module isn't thread safe, and the person to register has to be in the output of the
+// last processed frame. So everything that uses the module, processing a frame and reading its
+// output included, has to hold lock_module(), and the worker registers people between frames.
+//
+// Limitation: RegisterUser itself runs with the module locked, there is no way to register from a
+// copy of the output. A frame that is ready while a person is being registered waits for it, so
+// each registration still delays one frame by its duration, instead of every frame by all of them.
+class pt_recognition_cache
+{
+public:
+    typedef std::chrono::steady_clock clock;
+
+    explicit pt_recognition_cache(rs::person_tracking::person_tracking_video_module_interface* ptModule,
+                                  clock::duration first_retry = std::chrono::milliseconds(200),
+                                  clock::duration max_retry = std::chrono::seconds(5)) :
+        m_module(ptModule), m_first_retry(first_retry), m_max_retry(max_retry), m_frame(0), m_stopping(false)
+    {
+        m_worker = std::thread(&pt_recognition_cache::worker, this);
+    }
+
+    pt_recognition_cache(const pt_recognition_cache&) = delete;
+    pt_recognition_cache& operator=(const pt_recognition_cache&) = delete;
+
+    ~pt_recognition_cache()
+    {
+        stop();
+    }
+
+    std::unique_lock<std::mutex> lock_module()
+    {
+        return std::unique_lock<std::mutex>(m_module_mutex);
+    }
+
+    // Called with lock_module() held once the ids of a frame are known. Sets rids to the
+    // recognition id of each tracking id, or -1 while the person isn't registered.
+    void update(const std::vector<int>& ids, std::vector<int>& rids)
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        ++m_frame;
+        rids.clear();
+        bool added = false;
+        for (int id : ids)
+        {
+            auto found = m_tracks.find(id);
+            if (found == m_tracks.end())
+            {
+                found = m_tracks.emplace(id, track(m_first_retry)).first;
+                added = true;
+            }
+            found->second.last_seen = m_frame;
+            rids.push_back(found->second.registered ? found->second.rid : -1);
+        }
+
+        for (auto track = m_tracks.begin(); track != m_tracks.end();)
+        {
+            if (track->second.last_seen != m_frame)
+            {
+                track = m_tracks.erase(track);
+            }
+            else
+            {
+                ++track;
+            }
+        }
+
+        if (added)
+        {
+            m_wake.notify_one();
+        }
+    }
+
+    void stop()
+    {
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            m_stopping = true;
+        }
+        m_wake.notify_one();
+        if (m_worker.joinable())
+        {
+            m_worker.join();
+        }
+    }
+
+private:
+    struct track
+    {
+        explicit track(clock::duration first_retry) :
+            rid(-1), registered(false), registering(false), retry_at(), backoff(first_retry), last_seen(0) {}
+
+        int rid;
+        bool registered;
+        bool registering;             // by the worker, right now
+        clock::time_point retry_at;
+        clock::duration backoff;
+        uint64_t last_seen;           // frame
+    };
+
+    void worker()
+    {
+        std::unique_lock<std::mutex> lock(m_mutex);
+        while (!m_stopping)
+        {
+            // The next track that is due for registration, or the time the first one will be
+            clock::time_point now = clock::now();
+            clock::time_point next_retry = clock::time_point::max();
+            int id = 0;
+            bool due = false;
+            for (auto& track : m_tracks)
+            {
+                if (track.second.registered || track.second.registering)
+                {
+                    continue;
+                }
+                if (track.second.retry_at <= now)
+                {
+                    id = track.first;
+                    due = true;
+                    break;
+                }
+                next_retry = std::min(next_retry, track.second.retry_at);
+            }
+            if (!due)
+            {
+                if (next_retry == clock::time_point::max())
+                {
+                    m_wake.wait(lock);
+                }
+                else
+                {
+                    m_wake.wait_until(lock, next_retry);
+                }
+                continue;
+            }
+
+            m_tracks.at(id).registering = true;
+            lock.unlock();
+            int rid = -1;
+            bool registered;
+            {
+                std::lock_guard<std::mutex> module_lock(m_module_mutex);
+                registered = register_person(id, rid);
+            }
+            lock.lock();
+
+            // The track may have left the frame meanwhile
+            auto found = m_tracks.find(id);
+            if (found == m_tracks.end())
+            {
+                continue;
+            }
+            found->second.registering = false;
+            if (registered)
+            {
+                found->second.registered = true;
+                found->second.rid = rid;
+            }
+            else
+            {
+                found->second.retry_at = clock::now() + found->second.backoff;
+                found->second.backoff = std::min(found->second.backoff * 2, m_max_retry);
+            }
+        }
+    }
+
+    // Called with the module locked
+    bool register_person(int id, int& rid)
+    {
+        typedef Intel::RealSense::PersonTracking::PersonTrackingData PersonTrackingData;
+
+        PersonTrackingData::Person* personData = m_module->QueryOutput()->QueryPersonData(PersonTrackingData::ACCESS_ORDER_BY_ID, id);
+        if (!personData)
+        {
+            return false;
+        }
+
+        int32_t outputRecognitionId;
+        int32_t outputTrackingId;
+        int32_t outDescriptorId;
+        auto status = personData->QueryRecognition()->RegisterUser(&outputRecognitionId, &outputTrackingId, &outDescriptorId);
+        if (status == PersonTrackingData::PersonRecognition::RegistrationSuccessful)
+        {
+            std::cout << "Registered person: " << outputRecognitionId << std::endl;
+        }
+        else if (status != PersonTrackingData::PersonRecognition::RegistrationFailedAlreadyRegistered)
+        {
+            return false;
+        }
+        rid = outputRecognitionId;
+        return true;
+    }
+
+    rs::person_tracking::person_tracking_video_module_interface* m_module;
+    clock::duration m_first_retry;
+    clock::duration m_max_retry;
+    std::mutex m_module_mutex;
+
+    std::mutex m_mutex;
+    std::condition_variable m_wake;
+    std::unordered_map<int, track> m_tracks;
+    uint64_t m_frame;
+    bool m_stopping;
+    std::thread m_worker;
+};
@@ -0,0 +1,336 @@
+// License: Apache 2.0. See LICENSE file in root directory.
+// Copyright(c) 2017 Intel Corporation. All Rights Reserved.
+
+#pragma once
+
+#include <algorithm>
+#include <cerrno>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <functional>
+#include <iostream>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "person_tracking_video_module_factory.h"
+#include "metrics_registry.hpp"
+
+// The person recognition database of a PT module, saved to and loaded from a file on a worker
+// thread.
+//
+// save() only marks the database as changed, so the UI thread that asks for it doesn't wait. Once
+// save_delay has passed the worker locks the module with lock_module, between two frames, copies
+// the database and unlocks it again before writing the copy; saves requested meanwhile are written
+// once. The copy is written to a temporary file that is synced and renamed over the database file,
+// so a crash leaves the previous database or the new one, never a partial one.
+//
+// Loading maps the file on the worker; apply_loaded deserializes the mapping on the thread that
+// owns the module, which doesn't wait for the disk then.
+class pt_recognition_database
+{
+public:
+    typedef Intel::RealSense::PersonTracking::PersonTrackingConfiguration configuration;
+    typedef std::chrono::steady_clock clock;
+    typedef std::function<std::unique_lock<std::mutex>()> module_locker;
+
+    pt_recognition_database(const std::string& path, configuration* config, module_locker lock_module,
+                            clock::duration save_delay = std::chrono::milliseconds(500)) :
+        m_path(path),
+        m_config(config),
+        m_lock_module(lock_module),
+        m_save_delay(save_delay),
+        m_save_pending(false),
+        m_load_requested(false),
+        m_loaded_data(nullptr),
+        m_loaded_size(0),
+        m_stopping(false)
+    {
+        static const std::vector<double> bounds = { 0.001, 0.005, 0.01, 0.05, 0.1, 0.5, 1 };
+        static const char* help = "Time to serialize, write, read or deserialize the person recognition database";
+        auto& registry = metrics_registry::get_instance();
+        m_save_requests = &registry.get_counter("rs_pt_recognition_db_save_requests_total", "Requests to save the person recognition database");
+        m_writes = &registry.get_counter("rs_pt_recognition_db_writes_total", "Person recognition database files written");
+        m_errors = &registry.get_counter("rs_pt_recognition_db_errors_total", "Person recognition database files that couldn't be written or read");
+        m_bytes = &registry.get_gauge("rs_pt_recognition_db_bytes", "Size of the person recognition database last written or read");
+        m_serialize_seconds = &registry.get_histogram("rs_pt_recognition_db_seconds", help, bounds, { { "operation", "serialize" } });
+        m_write_seconds = &registry.get_histogram("rs_pt_recognition_db_seconds", help, bounds, { { "operation", "write" } });
+        m_read_seconds = &registry.get_histogram("rs_pt_recognition_db_seconds", help, bounds, { { "operation", "read" } });
+        m_deserialize_seconds = &registry.get_histogram("rs_pt_recognition_db_seconds", help, bounds, { { "operation", "deserialize" } });
+
+        m_worker = std::thread(&pt_recognition_database::worker, this);
+    }
+
+    pt_recognition_database(const pt_recognition_database&) = delete;
+    pt_recognition_database& operator=(const pt_recognition_database&) = delete;
+
+    ~pt_recognition_database()
+    {
+        stop();
+        unmap_loaded();
+    }
+
+    // Has the worker save the database, from any thread
+    void save()
+    {
+        m_save_requests->inc();
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            if (!m_save_pending)
+            {
+                m_save_pending = true;
+                m_save_at = clock::now() + m_save_delay;
+            }
+        }
+        m_wake.notify_one();
+    }
+
+    // Has the worker read the file, for apply_loaded
+    void load()
+    {
+        std::cout << std::endl << "loading recognition id database: \033[4;36m" + m_path << "\033[0m" << std::endl << std::endl;
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            m_load_requested = true;
+        }
+        m_wake.notify_one();
+    }
+
+    // Called with the module locked, e.g. before each frame. Deserializes the file read since the
+    // last call into the database, returns true if there was one and it was valid.
+    bool apply_loaded(configuration* config)
+    {
+        uint8_t* data;
+        size_t size;
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            if (!m_loaded_data)
+            {
+                return false;
+            }
+            data = m_loaded_data;
+            size = m_loaded_size;
+            m_loaded_data = nullptr;
+        }
+
+        clock::time_point start = clock::now();
+        auto database = config->QueryRecognition()->QueryDatabase();
+        auto databaseUtils = config->QueryRecognition()->QueryDatabaseUtilities();
+        bool loaded = databaseUtils->DeserializeDatabase(database, data, static_cast<int>(size));
+        m_deserialize_seconds->observe(seconds_since(start));
+        munmap(data, size);
+        if (!loaded)
+        {
+            m_errors->inc();
+            std::cerr << "Error : Failed to load recognition id database " << m_path << std::endl;
+        }
+        return loaded;
+    }
+
+    // Writes a pending save and stops the worker
+    void stop()
+    {
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            m_stopping = true;
+        }
+        m_wake.notify_one();
+        if (m_worker.joinable())
+        {
+            m_worker.join();
+        }
+    }
+
+private:
+    static double seconds_since(clock::time_point start)
+    {
+        return std::chrono::duration<double>(clock::now() - start).count();
+    }
+
+    void worker()
+    {
+        std::unique_lock<std::mutex> lock(m_mutex);
+        while (true)
+        {
+            // A load reads what was saved before it
+            if (m_save_pending && (m_stopping || m_load_requested || clock::now() >= m_save_at))
+            {
+                m_save_pending = false;
+                lock.unlock();
+                serialize();
+                write_file(m_writing);
+                lock.lock();
+                continue;
+            }
+
+            if (m_load_requested)
+            {
+                m_load_requested = false;
+                lock.unlock();
+                size_t size = 0;
+                uint8_t* data = read_file(size);
+                lock.lock();
+                if (data)
+                {
+                    // A newer file replaces one that wasn't applied yet
+                    unmap_loaded();
+                    m_loaded_data = data;
+                    m_loaded_size = size;
+                }
+                continue;
+            }
+
+            if (m_stopping)
+            {
+                break;
+            }
+            if (m_save_pending)
+            {
+                m_wake.wait_until(lock, m_save_at);
+            }
+            else
+            {
+                m_wake.wait(lock);
+            }
+        }
+    }
+
+    // Copies the database into m_writing, with the module locked only for the copy
+    void serialize()
+    {
+        std::unique_lock<std::mutex> module_lock = m_lock_module();
+        clock::time_point start = clock::now();
+        auto database = m_config->QueryRecognition()->QueryDatabase();
+        auto databaseUtils = m_config->QueryRecognition()->QueryDatabaseUtilities();
+        m_writing.resize(databaseUtils->GetDatabaseMemorySize(database));
+        int32_t writtenSize = 0;
+        databaseUtils->SerializeDatabase(database, m_writing.data(), static_cast<int32_t>(m_writing.size()), &writtenSize);
+        m_writing.resize(std::min(m_writing.size(), static_cast<size_t>(std::max(writtenSize, 0))));
+        m_serialize_seconds->observe(seconds_since(start));
+    }
+
+    void write_file(const std::vector<uint8_t>& data)
+    {
+        clock::time_point start = clock::now();
+        std::string temporaryPath = m_path + ".tmp";
+        int fd = ::open(temporaryPath.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+        bool written = fd >= 0;
+        for (size_t offset = 0; written && offset < data.size();)
+        {
+            ssize_t count = ::write(fd, data.data() + offset, data.size() - offset);
+            if (count < 0 && errno == EINTR)
+            {
+                continue;
+            }
+            written = count > 0;
+            offset += written ? count : 0;
+        }
+        written = written && fsync(fd) == 0;
+        if (fd >= 0)
+        {
+            written = ::close(fd) == 0 && written;
+        }
+        written = written && std::rename(temporaryPath.c_str(), m_path.c_str()) == 0;
+        if (!written)
+        {
+            int error = errno;
+            ::unlink(temporaryPath.c_str());
+            m_errors->inc();
+            std::cerr << "Error : Failed to save recognition id database " << m_path << ": " << strerror(error) << std::endl;
+            return;
+        }
+        sync_directory();
+
+        m_write_seconds->observe(seconds_since(start));
+        m_writes->inc();
+        m_bytes->set(static_cast<double>(data.size()));
+        std::cout << std::endl << "saved recognition id database: \033[4;36m" + m_path << "\033[0m" << std::endl << std::endl;
+    }
+
+    // The rename is durable once the directory is synced
+    void sync_directory()
+    {
+        size_t slash = m_path.find_last_of('/');
+        std::string directory = slash == std::string::npos ? "." : (slash == 0 ? "/" : m_path.substr(0, slash));
+        int fd = ::open(directory.c_str(), O_RDONLY | O_DIRECTORY);
+        if (fd >= 0)
+        {
+            fsync(fd);
+            ::close(fd);
+        }
+    }
+
+    // Maps a private, writable copy of the file with its pages read in, as DeserializeDatabase takes
+    // a non-const buffer. nullptr if it can't be read.
+    uint8_t* read_file(size_t& size)
+    {
+        clock::time_point start = clock::now();
+        int fd = ::open(m_path.c_str(), O_RDONLY);
+        struct stat st;
+        void* data = MAP_FAILED;
+        if (fd >= 0 && fstat(fd, &st) == 0 && st.st_size > 0)
+        {
+            size = st.st_size;
+            data = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_POPULATE, fd, 0);
+        }
+        int error = errno;
+        if (fd >= 0)
+        {
+            ::close(fd);
+        }
+        if (data == MAP_FAILED)
+        {
+            m_errors->inc();
+            std::cerr << "Error : Failed to read recognition id database " << m_path << ": " << strerror(error) << std::endl;
+            return nullptr;
+        }
+
+        m_read_seconds->observe(seconds_since(start));
+        m_bytes->set(static_cast<double>(size));
+        return static_cast<uint8_t*>(data);
+    }
+
+    // Called with m_mutex locked, or when the worker is stopped
+    void unmap_loaded()
+    {
+        if (m_loaded_data)
+        {
+            munmap(m_loaded_data, m_loaded_size);
+            m_loaded_data = nullptr;
+        }
+    }
+
+    const std::string m_path;
+    configuration* const m_config;
+    const module_locker m_lock_module;
+    const clock::duration m_save_delay;
+
+    std::mutex m_mutex;
+    std::condition_variable m_wake;
+    std::vector<uint8_t> m_writing;       // by the worker only
+    bool m_save_pending;
+    clock::time_point m_save_at;
+    bool m_load_requested;
+    uint8_t* m_loaded_data;
+    size_t m_loaded_size;
+    bool m_stopping;
+    std::thread m_worker;
+
+    metric_counter* m_save_requests;
+    metric_counter* m_writes;
+    metric_counter* m_errors;
+    metric_gauge* m_bytes;
+    metric_histogram* m_serialize_seconds;
+    metric_histogram* m_write_seconds;
+    metric_histogram* m_read_seconds;
+    metric_histogram* m_deserialize_seconds;
+};
@@ -0,0 +1,243 @@
+// License: Apache 2.0. See LICENSE file in root directory.
+// Copyright(c) 2017 Intel Corporation. All Rights Reserved.
+
+#pragma once
+
+#include <algorithm>
+#include <cstdint>
+#include <iostream>
+#include <vector>
+
+#include "person_tracking_video_module_factory.h"
+#include "pt_recognition_cache.hpp"
+
+// What extract_pt_snapshot copies besides the tracking data of each person
+enum pt_snapshot_fields
+{
+    pt_snapshot_tracking    = 0,
+    pt_snapshot_head        = 1 << 0,    // head bounding box and pose
+    pt_snapshot_gestures    = 1 << 1,    // pointing gesture
+    pt_snapshot_recognition = 1 << 2     // registers each person with person recognition, if it is enabled
+};
+
+// The people of one PT frame, one array per field with an entry per person (or several for
+// points and boxes), in the order of the module output.
+//
+// The PT output is a tree of interfaces that every consumer used to walk on its own. The
+// snapshot is filled in one pass right after process_sample_set. It keeps its arrays from
+// frame to frame, so in steady state filling it doesn't allocate.
+struct pt_snapshot
+{
+    unsigned fields;
+    std::vector<int> ids;
+    std::vector<int> boxes;                     // x, y, w, h
+    std::vector<float> center_mass_image;       // x, y
+    std::vector<float> center_mass_world;       // x, y, z in camera coordinates, mm
+
+    // pt_snapshot_recognition
+    std::vector<int> recognition_ids;           // -1 for a person that isn't registered
+
+    // pt_snapshot_head
+    std::vector<uint8_t> has_head_box;
+    std::vector<int> head_boxes;                // x, y, w, h
+    std::vector<uint8_t> has_head_pose;
+    std::vector<float> head_poses;              // pitch, roll, yaw
+
+    // pt_snapshot_gestures
+    std::vector<uint8_t> pointing;
+    std::vector<float> pointing_color;          // origin x, y, direction x, y
+    std::vector<float> pointing_world;          // origin x, y, z, direction x, y, z
+
+    pt_snapshot() : fields(pt_snapshot_tracking) {}
+
+    int size() const
+    {
+        return static_cast<int>(ids.size());
+    }
+
+    void clear()
+    {
+        ids.clear();
+        boxes.clear();
+        center_mass_image.clear();
+        center_mass_world.clear();
+        recognition_ids.clear();
+        has_head_box.clear();
+        head_boxes.clear();
+        has_head_pose.clear();
+        head_poses.clear();
+        pointing.clear();
+        pointing_color.clear();
+        pointing_world.clear();
+    }
+};
+
+// Copies the people of the last processed frame into snapshot. fields is a combination of
+// pt_snapshot_fields. With a recognition_cache the recognition ids come from the cache, which
+// registers new people in the background, and the module has to be locked with it. Without one
+// each person is registered right away.
+inline void extract_pt_snapshot(rs::person_tracking::person_tracking_video_module_interface* ptModule,
+                                pt_snapshot& snapshot, unsigned fields,
+                                pt_recognition_cache* recognition_cache = nullptr)
+{
+    typedef Intel::RealSense::PersonTracking::PersonTrackingData PersonTrackingData;
+
+    snapshot.clear();
+    snapshot.fields = fields;
+
+    bool recognition = (fields & pt_snapshot_recognition) &&
+                       ptModule->QueryConfiguration()->QueryRecognition()->IsEnabled();
+    PersonTrackingData* trackingData = ptModule->QueryOutput();
+    int people = trackingData->QueryNumberOfPeople();
+    for (int index = 0; index < people; ++index)
+    {
+        PersonTrackingData::Person* personData = trackingData->QueryPersonData(PersonTrackingData::ACCESS_ORDER_BY_INDEX, index);
+        if (!personData)
+        {
+            continue;
+        }
+
+        PersonTrackingData::PersonTracking* personTrackingData = personData->QueryTracking();
+        PersonTrackingData::BoundingBox2D box = personTrackingData->Query2DBoundingBox();
+        PersonTrackingData::PointCombined centerMass = personTrackingData->QueryCenterMass();
+        snapshot.ids.push_back(personTrackingData->QueryId());
+        snapshot.boxes.insert(snapshot.boxes.end(), { box.rect.x, box.rect.y, box.rect.w, box.rect.h });
+        snapshot.center_mass_image.insert(snapshot.center_mass_image.end(),
+                                          { centerMass.image.point.x, centerMass.image.point.y });
+        snapshot.center_mass_world.insert(snapshot.center_mass_world.end(),
+                                          { centerMass.world.point.x, centerMass.world.point.y, centerMass.world.point.z });
+
+        if ((fields & pt_snapshot_recognition) && !recognition_cache)
+        {
+            int rid = -1;
+            if (recognition)
+            {
+                int32_t outputRecognitionId;
+                int32_t outputTrackingId;
+                int32_t outDescriptorId;
+                auto status = personData->QueryRecognition()->RegisterUser(&outputRecognitionId, &outputTrackingId, &outDescriptorId);
+                if (status == PersonTrackingData::PersonRecognition::RegistrationSuccessful)
+                {
+                    std::cout << "Registered person: " << outputRecognitionId << std::endl;
+                    rid = outputRecognitionId;
+                }
+                else if (status == PersonTrackingData::PersonRecognition::RegistrationFailedAlreadyRegistered)
+                {
+                    rid = outputRecognitionId;
+                }
+            }
+            snapshot.recognition_ids.push_back(rid);
+        }
+
+        if (fields & pt_snapshot_head)
+        {
+            PersonTrackingData::BoundingBox2D headBox = personTrackingData->QueryHeadBoundingBox();
+            snapshot.has_head_box.push_back(headBox.confidence != 0);
+            snapshot.head_boxes.insert(snapshot.head_boxes.end(), { headBox.rect.x, headBox.rect.y, headBox.rect.w, headBox.rect.h });
+
+            PersonTrackingData::PoseEulerAngles headAngles = {};
+            PersonTrackingData::PersonFace* face = personData->QueryFace();
+            bool hasHeadPose = face && face->QueryHeadPose(headAngles);
+            snapshot.has_head_pose.push_back(hasHeadPose);
+            snapshot.head_poses.insert(snapshot.head_poses.end(), { headAngles.pitch, headAngles.roll, headAngles.yaw });
+        }
+
+        if (fields & pt_snapshot_gestures)
+        {
+            PersonTrackingData::PersonGestures* personGestures = personData->QueryGestures();
+            bool pointing = personGestures && personGestures->IsPointing() && personGestures->QueryPointingInfo().confidence > 0;
+            snapshot.pointing.push_back(pointing);
+            if (pointing)
+            {
+                auto pointingInfo = personGestures->QueryPointingInfo();
+                auto& color = pointingInfo.colorPointingData;
+                auto& world = pointingInfo.worldPointingData;
+                snapshot.pointing_color.insert(snapshot.pointing_color.end(),
+                                               { color.origin.x, color.origin.y, color.direction.x, color.direction.y });
+                snapshot.pointing_world.insert(snapshot.pointing_world.end(),
+                                               { world.origin.x, world.origin.y, world.origin.z,
+                                                 world.direction.x, world.direction.y, world.direction.z });
+            }
+            else
+            {
+                snapshot.pointing_color.insert(snapshot.pointing_color.end(), 4, 0.0f);
+                snapshot.pointing_world.insert(snapshot.pointing_world.end(), 6, 0.0f);
+            }
+        }
+    }
+
+    if ((fields & pt_snapshot_recognition) && recognition_cache)
+    {
+        if (recognition)
+        {
+            recognition_cache->update(snapshot.ids, snapshot.recognition_ids);
+        }
+        else
+        {
+            snapshot.recognition_ids.assign(snapshot.ids.size(), -1);
+        }
+    }
+}
+
+// Cumulative count of the people that came into view. A frame with more people than the last one
+// adds the difference; a frame with as many people adds the ones whose id disappeared, as they
+// were replaced by somebody new.
+class pt_person_counter
+{
+public:
+    pt_person_counter() : m_last_count(0), m_total(0), m_has_previous(false) {}
+
+    // Returns the cumulative count including snapshot
+    int update(const pt_snapshot& snapshot)
+    {
+        m_current.assign(snapshot.ids.begin(), snapshot.ids.end());
+        std::sort(m_current.begin(), m_current.end());
+        m_current.erase(std::unique(m_current.begin(), m_current.end()), m_current.end());
+
+        int count = snapshot.size();
+        if (count > m_last_count)
+        {
+            m_total += count - m_last_count;
+        }
+        else if (count == m_last_count && m_has_previous)
+        {
+            m_total += count_missing(m_previous, m_current);
+        }
+
+        m_previous.swap(m_current);
+        m_has_previous = true;
+        m_last_count = count;
+        return m_total;
+    }
+
+    int get_total() const
+    {
+        return m_total;
+    }
+
+private:
+    // Number of ids in before that aren't in after, both sorted
+    static int count_missing(const std::vector<int>& before, const std::vector<int>& after)
+    {
+        int missing = 0;
+        auto next = after.begin();
+        for (int id : before)
+        {
+            while (next != after.end() && *next < id)
+            {
+                ++next;
+            }
+            if (next == after.end() || *next != id)
+            {
+                ++missing;
+            }
+        }
+        return missing;
+    }
+
+    int m_last_count;
+    int m_total;
+    bool m_has_previous;
+    std::vector<int> m_previous;
+    std::vector<int> m_current;
+};
@@ -7,6 +7,9 @@
 #include <opencv2/core.hpp>
 #include <memory>
 #include "rs_sdk.h"
+#include "open_frame_source.hpp"
+#include "frame_dispatcher.hpp"
+#include "metrics_registry.hpp"
 #include "or_data_interface.h"
 #include "or_configuration_interface.h"
 #include "or_video_module_impl.h"
@@ -18,8 +21,11 @@
 #include <sys/ioctl.h>
 #include <fstream>
 #include <iostream>
+#include <iomanip>
+#include <algorithm>
 
 #include <string>
+#include <stdexcept>
 #include <sys/stat.h>
 
 using namespace std;
@@ -44,16 +50,55 @@ extern "C"
     class device;
     }
 
+    // Snapshot of one stage of the person tracking pipeline
+    struct pt_stage_stats
+    {
+        const char* name;
+        uint64_t processed;       // sample sets the stage finished
+        uint64_t dropped;         // sample sets dropped because the stage's input queue was full
+        size_t queue_depth;       // sample sets waiting in the stage's input queue
+        size_t max_queue_depth;   // highest depth of the input queue
+        double busy_ratio;        // fraction of the time the stage was working, -1 if not measured
+    };
+
+    // The person tracking samples run as a pipeline of three stages with bounded queues in between:
+    //   capture   the frame source callbacks pair color and depth images into a ring of
+    //             capture_queue_size sample sets
+    //   tracking  the sample's main loop takes sets with GetNextFrame(), runs person tracking and
+    //             reads the module output, which is only valid until the next process_sample_set()
+    //   output    a thread started by set_output_handler() renders or encodes the color images
+    //             passed to output_frame(), with up to output_queue_size sets waiting
+    // so the throughput approaches the one of the slowest stage instead of the sum of all stages.
     class pt_utils
     {
     public:
-        pt_utils()
+        static const size_t capture_queue_size = 2;
+        static const size_t output_queue_size = 2;
+
+        pt_utils() :
+            m_reader(capture_queue_size),
+            m_has_output(false),
+            m_tracking_frames(0),
+            m_tracking_busy_ns(0),
+            m_tracking_begin_ns(0),
+            m_pipeline_start_ns(now_ns())
         {
-
+            m_metrics_collector = metrics_registry::get_instance().add_collector([this](std::ostream& out)
+            {
+                write_pipeline_metrics(out);
+            });
         }
         ~pt_utils()
         {
+            metrics_registry::get_instance().remove_collector(m_metrics_collector);
 
+            //the reader and the output stage let go of the source's images before the source stops
+            m_reader.stop();
+            m_output.stop();
+            if (m_source)
+            {
+                m_source->stop();
+            }
         }
 
         std::wstring GetDataFilesPath()
@@ -74,31 +119,8 @@ extern "C"
             return wstring(wc_person_tracking_data_files);
         }
 
-        bool IsStreamCompatible(rs::core::stream_type stream, rs::format  format,
-                                int width, int height, int frameRate)
-        {
-            bool frameRateOK = (frameRate == 30);
-            bool colorFormatOK = false;
-            bool resolutionOK = false;
-            switch (stream)
-            {
-            case rs::core::stream_type::color:
-                colorFormatOK = (format == rs::format::rgb8);
-                resolutionOK = (width == get_resolution_width(color_resolution)) && (height == get_resolution_height(color_resolution)); //VGA resolution for color
-                break;
-            case rs::core::stream_type::depth:
-                colorFormatOK =  (format == rs::format::z16);
-                resolutionOK = (width == get_resolution_width(depth_resolution)) && (height == get_resolution_height(depth_resolution)); //QVGA resolution for depth
-                break;
-            default:
-                return  false;
-            }
-
-            return  colorFormatOK && resolutionOK && frameRateOK;
-        }
-
         // Config Camera device with recommended configuration from PT
-        rs::core::video_module_interface::actual_module_config ConfigureCamera (rs::device* device)
+        rs::core::video_module_interface::actual_module_config ConfigureCamera (frame_source* source)
         {
             rs::core::video_module_interface::actual_module_config actualModuleConfig = {};
 
@@ -107,114 +129,150 @@ extern "C"
                                                              };
             for (auto &stream : possible_streams)
             {
-                rs::stream librealsenseStream = rs::utils::convert_stream_type(stream);
-                int streamModeCount = device->get_stream_mode_count(librealsenseStream);
-                int streamModeNb = 0;
-                for(streamModeNb = 0; streamModeNb < streamModeCount; ++streamModeNb)
-                {
-                    //add logic for choosing of stream mode
-                    int width, height, frame_rate;
-                    rs::format format;
-                    device->get_stream_mode(librealsenseStream, streamModeNb, width, height, format, frame_rate);
-
-                    if (IsStreamCompatible(stream, format, width, height, frame_rate))
-                    {
-                        cout << "\nenabling: stream:" << librealsenseStream << ", "<< width << "x" << height << "x" << frame_rate << ", format:" << format << endl;
-                        device->enable_stream(librealsenseStream, width, height, format, frame_rate);
-                        rs::core::video_module_interface::actual_image_stream_config &actualStreamConfig = actualModuleConfig[stream];
-                        actualStreamConfig.size.width = width;
-                        actualStreamConfig.size.height = height;
-                        actualStreamConfig.frame_rate = frame_rate;
-                        actualStreamConfig.intrinsics = rs::utils::convert_intrinsics(
-                                                            device->get_stream_intrinsics(librealsenseStream));
-                        actualStreamConfig.extrinsics = rs::utils::convert_extrinsics(
-                                                            device->get_extrinsics(rs::stream::depth, librealsenseStream));
-                        actualStreamConfig.is_enabled = true;
-                        break;
-                    }
-
-                }
-                if (streamModeNb >= streamModeCount)
+                //person tracking uses 30 fps rgb8 color and z16 depth at the selected resolutions
+                bool isColor = (stream == rs::core::stream_type::color);
+                int width = get_resolution_width(isColor ? color_resolution : depth_resolution);
+                int height = get_resolution_height(isColor ? color_resolution : depth_resolution);
+                int frame_rate = 30;
+                rs::core::pixel_format format = isColor ? rs::core::pixel_format::rgb8 : rs::core::pixel_format::z16;
+
+                if (!source->supports_stream(stream, width, height, format, frame_rate))
                 {
                     throw  runtime_error("camera is not support requested format");
                 }
+
+                cout << "\nenabling: stream:" << (isColor ? "color" : "depth") << ", "<< width << "x" << height << "x" << frame_rate << endl;
+                source->enable_stream(stream, width, height, format, frame_rate);
+                rs::core::video_module_interface::actual_image_stream_config &actualStreamConfig = actualModuleConfig[stream];
+                actualStreamConfig.size.width = width;
+                actualStreamConfig.size.height = height;
+                actualStreamConfig.frame_rate = frame_rate;
+                actualStreamConfig.intrinsics = source->get_intrinsics(stream);
+                actualStreamConfig.extrinsics = source->get_extrinsics(rs::core::stream_type::depth, stream);
+                actualStreamConfig.is_enabled = true;
             }
             return actualModuleConfig;
         }
 
+        // Get the next color and depth images, the caller releases them
         int GetNextFrame(rs::core::correlated_sample_set& sample_set)
         {
-            m_dev->wait_for_frames();
+            end_tracking_frame();
+            if (!m_reader.wait_for_sample_set(sample_set))
+            {
+                cerr << "no frames from " << m_source->get_name() << endl;
+                return -1;
+            }
+            begin_tracking_frame();
+            return 0;
+        }
+
+        // Starts the output stage: handler is called on the output thread for every sample set
+        // passed to output_frame(), or for the newest ones if it can't keep up
+        void set_output_handler(frame_dispatcher::consumer handler)
+        {
+            m_output.add_worker("pt output", handler, output_queue_size);
+            m_has_output = true;
+        }
 
-            for(auto &stream :
-                    {
-                        rs::core::stream_type::color,  rs::core::stream_type::depth
-                    })
+        // Queues the sample set for the output stage; the output stage takes its own references,
+        // so the caller still releases the images
+        void output_frame(rs::core::correlated_sample_set& sample_set)
+        {
+            if (m_has_output)
             {
-                rs::stream librealsense_stream = rs::utils::convert_stream_type(stream);
-                int height = m_dev->get_stream_height(librealsense_stream);
-                int width = m_dev->get_stream_width(librealsense_stream);
-                rs::core::image_info info =
-                {
-                    width,
-                    height,
-                    rs::utils::convert_pixel_format(m_dev->get_stream_format(librealsense_stream)),
-                    get_pixel_size(m_dev->get_stream_format(librealsense_stream)) * width
-                };
-
-                const void* frameData = m_dev->get_frame_data(librealsense_stream);
-                if (!frameData)
+                m_output.dispatch(sample_set);
+            }
+        }
+
+        pt_stage_stats query_stage_stats(int stage) const
+        {
+            pt_stage_stats stats = {};
+            switch (stage)
+            {
+            case 0:
+                stats.name = "capture";
+                stats.processed = m_reader.get_delivered() + m_reader.get_dropped() + m_reader.get_queue_depth();
+                stats.busy_ratio = -1.0;
+                break;
+            case 1:
+                stats.name = "tracking";
+                stats.processed = m_tracking_frames;
+                stats.dropped = m_reader.get_dropped();
+                stats.queue_depth = m_reader.get_queue_depth();
+                stats.max_queue_depth = m_reader.get_max_queue_depth();
+                stats.busy_ratio = static_cast<double>(m_tracking_busy_ns) / std::max<int64_t>(now_ns() - m_pipeline_start_ns, 1);
+                break;
+            default:
+                stats.name = "output";
+                stats.busy_ratio = -1.0;
+                if (m_has_output)
                 {
-                    cerr << "frame data for " << librealsense_stream << "is null" << endl;
-                    return -1;
+                    stats.processed = m_output.get_processed(0);
+                    stats.dropped = m_output.get_skipped(0);
+                    stats.queue_depth = m_output.get_queue_depth(0);
+                    stats.max_queue_depth = m_output.get_max_queue_depth(0);
+                    stats.busy_ratio = m_output.get_busy_ratio(0);
                 }
+                break;
+            }
+            return stats;
+        }
 
-                sample_set[stream] = rs::core::image_interface::create_instance_from_raw_data(
-                                         &info,
-                                         frameData,
-                                         stream,
-                                         rs::core::image_interface::flag::any,
-                                         m_dev->get_frame_timestamp(librealsense_stream),
-                                         m_dev->get_frame_number(librealsense_stream));
-
+        void print_pipeline_stats() const
+        {
+            cout << "---------------------------------------------------------------------------" << endl;
+            cout << "pipeline: " << left << setw(11) << "stage" << setw(12) << "processed" << setw(10) << "dropped"
+                 << setw(13) << "max queued" << "busy" << endl;
+            for (int stage = 0; stage < stage_count; ++stage)
+            {
+                pt_stage_stats stats = query_stage_stats(stage);
+                cout << "          " << left << setw(11) << stats.name << setw(12) << stats.processed
+                     << setw(10) << stats.dropped << setw(13) << stats.max_queue_depth;
+                if (stats.busy_ratio < 0)
+                {
+                    cout << "-" << endl;
+                }
+                else
+                {
+                    cout << fixed << setprecision(0) << stats.busy_ratio * 100 << "%" << endl;
+                }
             }
-            return 0;
+            cout << "---------------------------------------------------------------------------" << endl;
         }
 
-        int8_t get_pixel_size(rs::format format)
+        // Writes the stage statistics in the Prometheus text format
+        void write_pipeline_metrics(std::ostream& out) const
         {
-            switch(format)
+            pt_stage_stats stats[stage_count];
+            for (int stage = 0; stage < stage_count; ++stage)
             {
-            case rs::format::any:
-                return 0;
-            case rs::format::z16:
-                return 2;
-            case rs::format::disparity16:
-                return 2;
-            case rs::format::xyz32f:
-                return 4;
-            case rs::format::yuyv:
-                return 2;
-            case rs::format::rgb8:
-                return 3;
-            case rs::format::bgr8:
-                return 3;
-            case rs::format::rgba8:
-                return 4;
-            case rs::format::bgra8:
-                return 4;
-            case rs::format::y8:
-                return 1;
-            case rs::format::y16:
-                return 2;
-            case rs::format::raw8:
-                return 1;
-            case rs::format::raw10:
-                return 0;//not supported
-            case rs::format::raw16:
-                return 2;
+                stats[stage] = query_stage_stats(stage);
+            }
+
+            metrics_registry::write_header(out, "rs_pt_pipeline_processed_total", "counter", "Sample sets finished by a person tracking pipeline stage");
+            for (auto& s : stats)
+            {
+                metrics_registry::write_sample(out, "rs_pt_pipeline_processed_total", { { "stage", s.name } }, static_cast<double>(s.processed));
+            }
+            metrics_registry::write_header(out, "rs_pt_pipeline_dropped_total", "counter", "Sample sets dropped because the input queue of a stage was full");
+            for (auto& s : stats)
+            {
+                metrics_registry::write_sample(out, "rs_pt_pipeline_dropped_total", { { "stage", s.name } }, static_cast<double>(s.dropped));
+            }
+            metrics_registry::write_header(out, "rs_pt_pipeline_queue_depth", "gauge", "Sample sets waiting for a stage");
+            for (auto& s : stats)
+            {
+                metrics_registry::write_sample(out, "rs_pt_pipeline_queue_depth", { { "stage", s.name } }, static_cast<double>(s.queue_depth));
+            }
+            metrics_registry::write_header(out, "rs_pt_pipeline_busy_ratio", "gauge", "Fraction of the time a stage was working");
+            for (auto& s : stats)
+            {
+                if (s.busy_ratio >= 0)
+                {
+                    metrics_registry::write_sample(out, "rs_pt_pipeline_busy_ratio", { { "stage", s.name } }, s.busy_ratio);
+                }
             }
-            return 0;
         }
 
         rs::core::status init_camera(rs::core::image_info& colorInfo, rs::core::image_info& depthInfo,rs::core::video_module_interface::actual_module_config& actualModuleConfig, rs::object_recognition::or_video_module_impl& impl,rs::object_recognition::or_data_interface** or_data, rs::object_recognition::or_configuration_interface** or_configuration)
@@ -232,16 +290,14 @@ extern "C"
             if (m_ctx == nullptr)
                 return rs::core::status_process_failed;
 
-            int deviceCount = m_ctx->get_device_count();
-            if (deviceCount  == 0)
+            //get the camera, or the source selected by RS_SAMPLES_FRAME_SOURCE
+            m_source = open_frame_source(*m_ctx);
+            if (!m_source)
             {
                 printf("No RealSense device connected.\n\n");
                 return rs::core::status_process_failed;
             }
 
-            //get pointer the the camera
-            m_dev = m_ctx->get_device(0);
-
             //request the first (index 0) supported module config.
             rs::core::video_module_interface::supported_module_config cfg;
             st = impl.query_supported_module_config(0, cfg);
@@ -252,12 +308,13 @@ extern "C"
             }
 
             //configure camera to fit supported MW configuration
-            actualModuleConfig = ConfigureCamera(m_dev);
+            actualModuleConfig = ConfigureCamera(m_source.get());
+            m_reader.attach(m_source.get());
 
             //configure projection
-            rs::core::intrinsics color_intrin = rs::utils::convert_intrinsics(m_dev->get_stream_intrinsics(rs::stream::color));
-            rs::core::intrinsics depth_intrin = rs::utils::convert_intrinsics(m_dev->get_stream_intrinsics(rs::stream::depth));
-            rs::core::extrinsics extrinsics = rs::utils::convert_extrinsics(m_dev   ->get_extrinsics(rs::stream::depth, rs::stream::color));
+            rs::core::intrinsics color_intrin = m_source->get_intrinsics(rs::core::stream_type::color);
+            rs::core::intrinsics depth_intrin = m_source->get_intrinsics(rs::core::stream_type::depth);
+            rs::core::extrinsics extrinsics = m_source->get_extrinsics(rs::core::stream_type::depth, rs::core::stream_type::color);
             actualModuleConfig.projection = rs::core::projection_interface::create_instance(&color_intrin, &depth_intrin, &extrinsics);
 
             //setting the selected configuration (after projection)
@@ -284,13 +341,8 @@ extern "C"
             depthInfo.format = rs::core::pixel_format::z16;
             depthInfo.pitch = depthInfo.width * 2;
 
-            m_dev->start();
-
-            //enable auto exposure for color stream
-            m_dev->set_option(rs::option::color_enable_auto_exposure, 1);
-
-            //enable auto exposure for Depth camera stream
-            m_dev->set_option(rs::option::r200_lr_auto_exposure_enabled, 1);
+            m_source->start();
+            enable_auto_exposure();
 
             m_sample_set = new rs::core::correlated_sample_set();
 
@@ -313,29 +365,25 @@ extern "C"
             if (m_ctx == nullptr)
                 return rs::core::status_process_failed;
 
-            int deviceCount = m_ctx->get_device_count();
-            if (deviceCount  == 0)
+            //get the camera, or the source selected by RS_SAMPLES_FRAME_SOURCE
+            m_source = open_frame_source(*m_ctx);
+            if (!m_source)
             {
                 cerr << endl << "There are no RealSense devices connected" << endl;
                 return rs::core::status_process_failed;
             }
 
-            m_dev = m_ctx->get_device(0); //device memory managed by the context
-
             //configure camera and get parameters for person tracking video module
-            actualConfig = ConfigureCamera(m_dev);
+            actualConfig = ConfigureCamera(m_source.get());
+            m_reader.attach(m_source.get());
 
             //configure projection
-            rs::core::intrinsics color_intrin = rs::utils::convert_intrinsics(m_dev->get_stream_intrinsics(rs::stream::color));
-            rs::core::intrinsics depth_intrin = rs::utils::convert_intrinsics(m_dev->get_stream_intrinsics(rs::stream::depth));
-            rs::core::extrinsics extrinsics = rs::utils::convert_extrinsics(m_dev->get_extrinsics(rs::stream::depth, rs::stream::color));
+            rs::core::intrinsics color_intrin = m_source->get_intrinsics(rs::core::stream_type::color);
+            rs::core::intrinsics depth_intrin = m_source->get_intrinsics(rs::core::stream_type::depth);
+            rs::core::extrinsics extrinsics = m_source->get_extrinsics(rs::core::stream_type::depth, rs::core::stream_type::color);
             actualConfig.projection = rs::core::projection_interface::create_instance(&color_intrin, &depth_intrin, &extrinsics);
 
-            //enable auto exposure for color stream
-            m_dev->set_option(rs::option::color_enable_auto_exposure, 1);
-
-            //enable auto exposure for Depth camera stream
-            m_dev->set_option(rs::option::r200_lr_auto_exposure_enabled, 1);
+            enable_auto_exposure();
 
             return rs::core::status_no_error;
         }
@@ -372,36 +420,34 @@ extern "C"
         //start the device
         void start_camera()
         {
-            m_dev->start();
+            m_source->start();
         }
 
         //stop the device
         void stop_camera()
         {
-            m_dev->stop();
+            m_reader.stop();
+            m_output.stop();
+            m_source->stop();
         }
 
         rs::core::correlated_sample_set* get_sample_set(rs::core::image_info& colorInfo,rs::core::image_info& depthInfo)
         {
-            m_dev->wait_for_frames();
-
-            //get color and depth buffers
-            const void* colorBuffer =  m_dev->get_frame_data(rs::stream::color);
-            const void* depthBuffer = m_dev->get_frame_data(rs::stream::depth);
-            m_color_buffer = const_cast<void*>(colorBuffer);
-
             //release images from the previous frame
             release_images();
+            end_tracking_frame();
 
-            //create images from buffers
-            rs::core::image_interface::image_data_with_data_releaser color_container(colorBuffer);
-            rs::core::image_interface::image_data_with_data_releaser depth_container(depthBuffer);
-            auto colorImg = rs::core::image_interface::create_instance_from_raw_data( &colorInfo, color_container, rs::core::stream_type::color, rs::core::image_interface::any,m_frame_number, (uint64_t)m_dev->get_frame_timestamp(rs::stream::color) );
-            auto depthImg = rs::core::image_interface::create_instance_from_raw_data( &depthInfo, depth_container, rs::core::stream_type::depth, rs::core::image_interface::any,m_frame_number, (uint64_t)m_dev->get_frame_timestamp(rs::stream::depth) );
-
-            //create sample from both images
-            m_sample_set->images[(int)rs::stream::color] = colorImg;
-            m_sample_set->images[(int)rs::stream::depth] = depthImg;
+            //wait for the next color and depth images, like wait_for_frames() throws if the camera stopped
+            while (!m_reader.wait_for_sample_set(*m_sample_set))
+            {
+                if (!m_source->is_streaming())
+                {
+                    throw std::runtime_error("frame source stopped streaming");
+                }
+                cerr << "warning: no frames from " << m_source->get_name() << " for 5 seconds" << endl;
+            }
+            begin_tracking_frame();
+            m_color_buffer = const_cast<void*>(m_sample_set->images[(int)rs::stream::color]->query_data());
             m_frame_number++;
 
             return m_sample_set;
@@ -429,12 +475,55 @@ extern "C"
 
     protected:
         std::shared_ptr<rs::core::context_interface> m_ctx;
-        rs::device* m_dev;
+        sample_set_reader m_reader;
+        std::unique_ptr<frame_source> m_source;
         rs::core::correlated_sample_set* m_sample_set;
         rs::core::image_info m_colorInfo;
         int m_frame_number;
         void* m_color_buffer;
 
+        static const int stage_count = 3;
+        frame_dispatcher m_output;
+        bool m_has_output;
+        int m_metrics_collector;
+
+        //the tracking stage is busy from the moment it gets a sample set until it asks for the next one
+        std::atomic<uint64_t> m_tracking_frames;
+        std::atomic<int64_t> m_tracking_busy_ns;
+        int64_t m_tracking_begin_ns;
+        const int64_t m_pipeline_start_ns;
+
+        static int64_t now_ns()
+        {
+            return std::chrono::duration_cast<std::chrono::nanoseconds>(
+                       std::chrono::steady_clock::now().time_since_epoch()).count();
+        }
+
+        void begin_tracking_frame()
+        {
+            m_tracking_begin_ns = now_ns();
+        }
+
+        void end_tracking_frame()
+        {
+            if (m_tracking_begin_ns)
+            {
+                m_tracking_busy_ns += now_ns() - m_tracking_begin_ns;
+                m_tracking_begin_ns = 0;
+                ++m_tracking_frames;
+            }
+        }
+
+        //enable auto exposure for the color and depth streams, when there is a camera
+        void enable_auto_exposure()
+        {
+            if (rs::device* device = m_source->get_device())
+            {
+                device->set_option(rs::option::color_enable_auto_exposure, 1);
+                device->set_option(rs::option::r200_lr_auto_exposure_enabled, 1);
+            }
+        }
+
         enum Resolution {RESOLUTION_QVGA, RESOLUTION_VGA, RESOLUTION_HD, RESOLUTION_FULLHD};
         Resolution depth_resolution, color_resolution;
         std::string m_filename;
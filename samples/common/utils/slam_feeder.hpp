@@ -0,0 +1,461 @@
+// License: Apache 2.0. See LICENSE file in root directory.
+// Copyright(c) 2017 Intel Corporation. All Rights Reserved.
+
+#pragma once
+
+#include <atomic>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <chrono>
+#include <iostream>
+#include <iomanip>
+#include <string>
+
+#include <rs_sdk.h>
+
+#include "spsc_queue.hpp"
+#include "imu_batcher.hpp"
+#include "latency_histogram.hpp"
+#include "metrics_registry.hpp"
+#include "pipeline_trace.hpp"
+
+// Snapshot of the metrics of one slam_feeder input queue
+struct slam_feeder_stats
+{
+    uint64_t enqueued;        // samples accepted from the camera callback
+    uint64_t dropped;         // samples rejected because the queue was full
+    uint64_t processed;       // samples handed to the module
+    uint64_t out_of_order;    // samples older than the previously processed sample
+    size_t queue_depth;       // samples currently waiting
+    size_t max_queue_depth;   // highest depth seen by the feeder thread
+    double avg_latency_ms;    // mean time spent waiting in the feeder
+    double max_latency_ms;    // longest time spent waiting in the feeder
+};
+
+// Decouples a video module (typically SLAM) from the librealsense callback threads.
+//
+// Each source (fisheye, depth, accel, gyro) gets its own lock-free queue which is filled by the
+// camera callback of that source and returns immediately. A single feeder thread merges the
+// queues by timestamp and calls process_sample_set() on the module, so a slow SLAM step no
+// longer stalls the camera. The merge waits for every active source to have a sample queued,
+// but never holds a sample longer than max_hold_ms, so a stalled stream can't block the others.
+class slam_feeder
+{
+public:
+    enum source
+    {
+        fisheye_source = 0,
+        depth_source,
+        accel_source,
+        gyro_source,
+        source_count
+    };
+
+    slam_feeder(rs::core::video_module_interface* module, size_t image_queue_size = 8,
+                size_t motion_queue_size = 64, int max_hold_ms = 40) :
+        m_module(module),
+        m_max_hold_ns(static_cast<int64_t>(max_hold_ms) * 1000000),
+        m_running(false),
+        m_producers(0),
+        m_last_timestamp(0.0)
+    {
+        for (int i = 0; i < source_count; ++i)
+        {
+            size_t size = (i == accel_source || i == gyro_source) ? motion_queue_size : image_queue_size;
+            m_queues[i].reset(new spsc_queue<entry>(size));
+            m_seen[i] = false;
+            reset_counters(m_counters[i]);
+        }
+
+        m_metrics_collector = metrics_registry::get_instance().add_collector([this](std::ostream& out)
+        {
+            write_metrics(out);
+        });
+    }
+
+    slam_feeder(const slam_feeder&) = delete;
+    slam_feeder& operator=(const slam_feeder&) = delete;
+
+    ~slam_feeder()
+    {
+        metrics_registry::get_instance().remove_collector(m_metrics_collector);
+        stop();
+    }
+
+    void start()
+    {
+        if (m_running)
+        {
+            return;
+        }
+        m_running = true;
+        m_thread = std::thread(&slam_feeder::run, this);
+    }
+
+    // Stops accepting samples, feeds what is already queued and joins the feeder thread
+    void stop()
+    {
+        if (!m_running)
+        {
+            return;
+        }
+        m_running = false;
+
+        // Wait for callbacks that are in the middle of an enqueue
+        while (m_producers > 0)
+        {
+            std::this_thread::yield();
+        }
+
+        m_wake.notify_one();
+        if (m_thread.joinable())
+        {
+            m_thread.join();
+        }
+        drain(true);
+    }
+
+    // Called from an image stream callback. Takes its own reference on the image,
+    // so the caller releases its reference as before.
+    bool enqueue_image(rs::core::stream_type stream, rs::core::image_interface* image)
+    {
+        source src = (stream == rs::core::stream_type::depth) ? depth_source : fisheye_source;
+        if (!image || (stream != rs::core::stream_type::depth && stream != rs::core::stream_type::fisheye))
+        {
+            return false;
+        }
+
+        entry e = {};
+        e.timestamp = image->query_time_stamp();
+        e.enqueue_time_ns = now_ns();
+        e.stream = stream;
+        e.image = image;
+
+        if (src == fisheye_source)
+        {
+            m_fisheye_arrivals.record_arrival(image->query_frame_number());
+        }
+
+        image->add_ref();
+        if (!push(src, e))
+        {
+            image->release();
+            return false;
+        }
+        return true;
+    }
+
+    // Called from the motion callback
+    bool enqueue_motion(const rs::core::motion_sample& sample)
+    {
+        source src;
+        if (sample.type == rs::core::motion_type::accel)
+        {
+            src = accel_source;
+        }
+        else if (sample.type == rs::core::motion_type::gyro)
+        {
+            src = gyro_source;
+        }
+        else
+        {
+            return false;
+        }
+
+        entry e = {};
+        e.timestamp = sample.timestamp;
+        e.enqueue_time_ns = now_ns();
+        e.image = nullptr;
+        e.motion = sample;
+
+        return push(src, e);
+    }
+
+    // Called with a timestamp-ordered batch from imu_batcher. The feeder thread is woken once per batch.
+    size_t enqueue_motion_batch(const imu_sample* samples, size_t count)
+    {
+        ++m_producers;
+        if (!m_running)
+        {
+            --m_producers;
+            return 0;
+        }
+
+        size_t pushed = 0;
+        int64_t enqueue_time_ns = now_ns();
+        for (size_t i = 0; i < count; ++i)
+        {
+            source src = (samples[i].type == rs::core::motion_type::accel) ? accel_source : gyro_source;
+
+            entry e = {};
+            e.timestamp = samples[i].timestamp;
+            e.enqueue_time_ns = enqueue_time_ns;
+            e.image = nullptr;
+            e.motion = samples[i].to_motion_sample();
+
+            if (m_queues[src]->try_push(e))
+            {
+                m_counters[src].enqueued.fetch_add(1, std::memory_order_relaxed);
+                ++pushed;
+            }
+            else
+            {
+                m_counters[src].dropped.fetch_add(1, std::memory_order_relaxed);
+            }
+        }
+        --m_producers;
+
+        m_wake.notify_one();
+        return pushed;
+    }
+
+    // Camera callback times of recent fisheye frames, for measuring latency up to the module output
+    const frame_arrival_tracker& get_fisheye_arrivals() const
+    {
+        return m_fisheye_arrivals;
+    }
+
+    slam_feeder_stats query_stats(source src) const
+    {
+        const counters& c = m_counters[src];
+        slam_feeder_stats stats;
+        stats.enqueued = c.enqueued;
+        stats.dropped = c.dropped;
+        stats.processed = c.processed;
+        stats.out_of_order = c.out_of_order;
+        stats.queue_depth = m_queues[src]->size();
+        stats.max_queue_depth = c.max_queue_depth;
+        stats.avg_latency_ms = stats.processed ? (c.latency_sum_ns / 1e6) / stats.processed : 0.0;
+        stats.max_latency_ms = c.latency_max_ns / 1e6;
+        return stats;
+    }
+
+    // Writes the queue statistics in the Prometheus text format
+    void write_metrics(std::ostream& out) const
+    {
+        static const char* names[source_count] = { "fisheye", "depth", "accel", "gyro" };
+        static const char* counter_names[] = { "rs_slam_feeder_processed_total", "rs_slam_feeder_dropped_total" };
+        static const char* counter_help[] = { "Samples passed to SLAM", "Samples dropped because the queue was full" };
+
+        slam_feeder_stats stats[source_count];
+        for (int i = 0; i < source_count; ++i)
+        {
+            stats[i] = query_stats(static_cast<source>(i));
+        }
+
+        for (int c = 0; c < 2; ++c)
+        {
+            metrics_registry::write_header(out, counter_names[c], "counter", counter_help[c]);
+            for (int i = 0; i < source_count; ++i)
+            {
+                metrics_registry::write_sample(out, counter_names[c], { { "source", names[i] } },
+                                               static_cast<double>(c == 0 ? stats[i].processed : stats[i].dropped));
+            }
+        }
+        metrics_registry::write_header(out, "rs_slam_feeder_queue_depth", "gauge", "Samples waiting for SLAM");
+        for (int i = 0; i < source_count; ++i)
+        {
+            metrics_registry::write_sample(out, "rs_slam_feeder_queue_depth", { { "source", names[i] } },
+                                           static_cast<double>(stats[i].queue_depth));
+        }
+    }
+
+    void print_stats() const
+    {
+        static const char* names[source_count] = { "fisheye", "depth", "accelerometer", "gyroscope" };
+
+        std::cout << "---------------------------------------------------------------------------------------------\n";
+        std::cout << "slam feeder: " << std::left << std::setw(15) << "source" << std::setw(12) << "processed"
+                  << std::setw(10) << "dropped" << std::setw(14) << "out of order" << std::setw(11) << "max depth"
+                  << "latency avg/max (ms)\n";
+        for (int i = 0; i < source_count; ++i)
+        {
+            slam_feeder_stats stats = query_stats(static_cast<source>(i));
+            std::cout << "             " << std::left << std::setw(15) << names[i] << std::setw(12) << stats.processed
+                      << std::setw(10) << stats.dropped << std::setw(14) << stats.out_of_order
+                      << std::setw(11) << stats.max_queue_depth << std::fixed << std::setprecision(2)
+                      << stats.avg_latency_ms << "/" << stats.max_latency_ms << "\n";
+        }
+        std::cout << "---------------------------------------------------------------------------------------------\n";
+    }
+
+private:
+    struct entry
+    {
+        double timestamp;
+        int64_t enqueue_time_ns;
+        rs::core::stream_type stream;
+        rs::core::image_interface* image;
+        rs::core::motion_sample motion;
+    };
+
+    struct counters
+    {
+        std::atomic<uint64_t> enqueued;
+        std::atomic<uint64_t> dropped;
+        std::atomic<uint64_t> processed;
+        std::atomic<uint64_t> out_of_order;
+        std::atomic<size_t> max_queue_depth;
+        std::atomic<int64_t> latency_sum_ns;
+        std::atomic<int64_t> latency_max_ns;
+    };
+
+    static void reset_counters(counters& c)
+    {
+        c.enqueued = 0;
+        c.dropped = 0;
+        c.processed = 0;
+        c.out_of_order = 0;
+        c.max_queue_depth = 0;
+        c.latency_sum_ns = 0;
+        c.latency_max_ns = 0;
+    }
+
+    static int64_t now_ns()
+    {
+        return std::chrono::duration_cast<std::chrono::nanoseconds>(
+                   std::chrono::steady_clock::now().time_since_epoch()).count();
+    }
+
+    bool push(source src, entry& e)
+    {
+        ++m_producers;
+        if (!m_running)
+        {
+            --m_producers;
+            return false;
+        }
+
+        bool pushed = m_queues[src]->try_push(e);
+        if (pushed)
+        {
+            m_counters[src].enqueued.fetch_add(1, std::memory_order_relaxed);
+        }
+        else
+        {
+            m_counters[src].dropped.fetch_add(1, std::memory_order_relaxed);
+        }
+        --m_producers;
+
+        m_wake.notify_one();
+        return pushed;
+    }
+
+    void run()
+    {
+        TRACE_THREAD_NAME("slam feeder");
+        while (m_running)
+        {
+            {
+                std::unique_lock<std::mutex> lock(m_wake_mutex);
+                m_wake.wait_for(lock, std::chrono::milliseconds(2));
+            }
+            drain(false);
+        }
+    }
+
+    // Feeds queued samples in timestamp order. Unless flushing, stops as soon as an active
+    // source has nothing queued and the oldest candidate has not yet waited max_hold_ns.
+    void drain(bool flush)
+    {
+        while (true)
+        {
+            int next = -1;
+            bool source_missing = false;
+            for (int i = 0; i < source_count; ++i)
+            {
+                entry* head = m_queues[i]->front();
+                if (!head)
+                {
+                    source_missing |= m_seen[i];
+                    continue;
+                }
+                m_seen[i] = true;
+                if (next < 0 || head->timestamp < m_queues[next]->front()->timestamp)
+                {
+                    next = i;
+                }
+            }
+
+            if (next < 0)
+            {
+                return;
+            }
+
+            entry* head = m_queues[next]->front();
+            int64_t waited_ns = now_ns() - head->enqueue_time_ns;
+            if (!flush && source_missing && waited_ns < m_max_hold_ns)
+            {
+                return;
+            }
+
+            counters& c = m_counters[next];
+            size_t depth = m_queues[next]->size();
+            if (depth > c.max_queue_depth)
+            {
+                c.max_queue_depth = depth;
+            }
+
+            entry e = *head;
+            m_queues[next]->pop();
+            feed(e);
+
+            if (e.timestamp < m_last_timestamp)
+            {
+                c.out_of_order.fetch_add(1, std::memory_order_relaxed);
+            }
+            else
+            {
+                m_last_timestamp = e.timestamp;
+            }
+            c.processed.fetch_add(1, std::memory_order_relaxed);
+            c.latency_sum_ns.fetch_add(waited_ns, std::memory_order_relaxed);
+            if (waited_ns > c.latency_max_ns)
+            {
+                c.latency_max_ns = waited_ns;
+            }
+        }
+    }
+
+    void feed(entry& e)
+    {
+        rs::core::correlated_sample_set sample_set = {};
+        if (e.image)
+        {
+            TRACE_SPAN("slam_process", e.image->query_frame_number(), e.stream == rs::core::stream_type::depth ? "depth" : "fisheye");
+            sample_set[e.stream] = e.image;
+            if (m_module->process_sample_set(sample_set) < rs::core::status_no_error)
+            {
+                std::cerr << "error: failed to process image sample" << std::endl;
+            }
+            e.image->release();
+        }
+        else
+        {
+            TRACE_SPAN("slam_process", e.motion.frame_number, e.motion.type == rs::core::motion_type::accel ? "accel" : "gyro");
+            sample_set[e.motion.type] = e.motion;
+            if (m_module->process_sample_set(sample_set) < rs::core::status_no_error)
+            {
+                std::cerr << "error: failed to process motion sample" << std::endl;
+            }
+        }
+    }
+
+    rs::core::video_module_interface* m_module;
+    const int64_t m_max_hold_ns;
+
+    std::unique_ptr<spsc_queue<entry>> m_queues[source_count];
+    counters m_counters[source_count];
+    bool m_seen[source_count];
+    frame_arrival_tracker m_fisheye_arrivals;
+    int m_metrics_collector;
+
+    std::atomic_bool m_running;
+    std::atomic_int m_producers;
+    std::thread m_thread;
+    std::mutex m_wake_mutex;
+    std::condition_variable m_wake;
+
+    double m_last_timestamp;
+};
@@ -10,223 +10,106 @@
 #include <vector>
 #include <cmath>
 #include <cstring>
+#include <atomic>
+#include <mutex>
 
+#include "streaming_stats.hpp"
+
+// Monotonic milliseconds, not affected by system clock adjustments
 inline int64_t GetCurrentTimeInMiliSecods()
 {
-    auto now = std::chrono::system_clock::now().time_since_epoch();
+    auto now = std::chrono::steady_clock::now().time_since_epoch();
     return std::chrono::duration_cast<std::chrono::milliseconds>(now).count();
 }
 
+struct float_stats_snapshot
+{
+    stats_snapshot timestampIntervals;  // ms between consecutive sample timestamps
+    stats_snapshot callbackIntervals;   // ms between consecutive callbacks
+    uint64_t droppedFrames;
+    uint64_t junkTimestampFrames;
+};
+
+// Interval statistics of a sample stream. Constant memory and allocation free, so it can stay
+// enabled for long runs. Callbacks of several threads can report to the same instance: the
+// previous sample is updated under a mutex and the intervals are recorded after it is released.
 class float_stats
 {
 private:
-    std::unique_ptr<float[]> m_pfIntervalsInMiliSecondsFrontBuffer;
-    std::unique_ptr<float[]> m_pfCallbackIntervalsInMiliSecondsFrontBuffer;
-    const int m_iSize;
-    int m_iCount;
-    float m_fPreviousTimestamp;
     std::string m_collectionType;
-    int m_frameCounter;
-    uint64_t m_droppedFrames;
-    uint64_t m_junkTimestampFrameCount;
     const std::string m_latencyString;
-    const int64_t m_delta;
-    float m_fPreviousCallbackTime;
-    std::unique_ptr<float[]> m_pfIntervalsInMiliSecondsBackBuffer;
-    std::unique_ptr<float[]> m_pfCallbackIntervalsInMiliSecondsBackBuffer;
-    float*  m_pfIntervalsInMiliSecondsCurrentBuffer;
-    float*  m_pfCallbackIntervalsInMiliSecondsCurrentBuffer;
-    int const m_iCycle;
-    std::unique_ptr<uint64_t []> m_meanTimestampFrameCount;
-    std::unique_ptr<uint64_t []> m_meanCallbackFrameCount;
-    const int m_iMaxLatency;
-
+    const int m_iCycle;
 
-    std::vector<float> m_timestampStdDevs;
-    std::vector<float> m_callbackStdDevs;
-
-    std::vector<float> m_timestampMeans;
-    std::vector<float> m_callbackMeans;
-    std::thread 	   m_calculatetionThread;
-
-    static float mean(const float* pfIntervalsInMiliSeconds, const int iCount, uint64_t *meanFrameCounts, const int iMaxLatency)
-    {
-        float fSumInMillis = 0;
-        for (int i = 0; i < iCount; ++i)
-        {
-            fSumInMillis += pfIntervalsInMiliSeconds[i];
-        }
-        const float fMean = fSumInMillis / iCount;
+    std::mutex m_mutex;
+    int m_frameCounter;
+    float m_fPreviousTimestamp;
+    float m_fPreviousCallbackTime;
+    const int64_t m_delta;
 
-        for (int i = 0; i < iCount; ++i)
-        {
-            int iLatency = static_cast<int>(pfIntervalsInMiliSeconds[i] - fMean + 0.5f);
-            const int iIndex = (iLatency > iMaxLatency) ? (2 *  iMaxLatency) : (iLatency < (-iMaxLatency))? 0: (iLatency + iMaxLatency);
-            meanFrameCounts[iIndex]++;
-        }
-        return fMean;
-    }
+    std::atomic<uint64_t> m_droppedFrames;
+    std::atomic<uint64_t> m_junkTimestampFrameCount;
 
-    static float std_deviation(const float* pfIntervalsInMiliSeconds, const int iCount, const float fMean)
-    {
-        double std_dev = 0.0;
-        for (int i = 0; i < iCount; ++i)
-        {
-            std_dev += (fMean - pfIntervalsInMiliSeconds[i]) * (fMean - pfIntervalsInMiliSeconds[i]);
-        }
-        if(iCount)
-        {
-            std_dev /= iCount;
-        }
-        return static_cast<float>(sqrt(std_dev));
-    }
+    streaming_stats m_timestampIntervals;
+    streaming_stats m_callbackIntervals;
 
-    static float average(const std::vector<float>& vals, const float val)
+    static int64_t get_current_time_in_microseconds()
     {
-        double sum = 0.0F;
-        for(std::vector<float>::const_iterator itr = vals.begin(); itr != vals.end(); ++itr)
-        {
-            sum += (*itr);
-        }
-        int size  = static_cast<int>(vals.size());
-        if(val != 0)
-        {
-            ++size;
-            sum += val;
-        }
-        if (size!= 0)
-            sum = sum/size;
-        return sum;
+        auto now = std::chrono::steady_clock::now().time_since_epoch();
+        return std::chrono::duration_cast<std::chrono::microseconds>(now).count();
     }
 
-    static void calculate_stat(const float *pfIntervalsInMiliSeconds, const int iCount, float &fMean, float &fStdDev, uint64_t *fMeanFrameCounts, const int iMaxLatency)
+    float get_callback_time_in_miliseconds() const
     {
-        fMean   = mean(pfIntervalsInMiliSeconds, iCount, fMeanFrameCounts, iMaxLatency);
-        fStdDev = std_deviation(pfIntervalsInMiliSeconds, iCount, fMean);
+        return (get_current_time_in_microseconds() - m_delta) / 1000.0f;
     }
 
-    void calculate_stats(float &fMean, float &fStdDev, float &fLatencyMean, float &fLatencyStdDev)
+    void print_stat(const std::string& type, const stats_snapshot& stats)
     {
-        calculate_stat(m_pfIntervalsInMiliSecondsCurrentBuffer, m_iCount, fMean, fStdDev, m_meanTimestampFrameCount.get(), m_iMaxLatency);
-        calculate_stat(m_pfCallbackIntervalsInMiliSecondsCurrentBuffer, m_iCount, fLatencyMean, fLatencyStdDev, m_meanCallbackFrameCount.get(), m_iMaxLatency);
-
-        fMean = average(m_timestampMeans, fMean);
-        fStdDev = average(m_timestampStdDevs, fStdDev);
-        fLatencyMean = average(m_callbackMeans, fLatencyMean);
-        fLatencyStdDev = average(m_callbackStdDevs, fLatencyStdDev);
-    }
-
-    void print_stat(const std::string& type, const float fMean, const float fStdDev)
-    {
-        std::cout << type << ":" << "\tmean = " <<  fMean << "ms\t std dev = " << fStdDev << "+-ms" << "\n";
-    }
-
-    template <class T>
-    void print_stat(const std::string& type, T *values, const int iSize)
-    {
-        std::cout << type << "[time, frame count]"<< std::endl;
-        int i = 0;
-        for(; i < iSize; ++i)
-            if(values[i])
-                break;
-        int endLimit = iSize - 1;
-        for(; endLimit > i; --endLimit)
-            if(values[endLimit])
-                break;
-
-        for(; i <= endLimit; ++i)
-        {
-            std::cout << "[" << i-m_iMaxLatency <<", " << values[i] << "];\t";
-        }
-        std::cout << std::endl;
+        std::cout << type << ":" << "\tmean = " << stats.mean << "ms\t std dev = " << stats.stddev << "+-ms" <<
+                  "\tp50/p90/p99 = " << stats.p50 << "/" << stats.p90 << "/" << stats.p99 << "ms" <<
+                  "\tmin/max = " << stats.min << "/" << stats.max << "ms\n";
     }
 
     void print_stats()
     {
-        std::cout << "---------------------------------------------------------------------------------------------\n";
-        std::cout << m_collectionType << ": samples collected = " << m_iCount + (m_iSize * m_timestampMeans.size()) <<
-                  "\t dropped frames = " <<  m_droppedFrames	<<
-                  "\tjunk time stamp frames = " <<  m_junkTimestampFrameCount << "\n\t\t";
-
-        float fMean = 0.0f, fStdDev = 0.0f, fLatencyMean = 0.0f, fLatencyStdDev = 0.0f;
-        calculate_stats(fMean, fStdDev, fLatencyMean, fLatencyStdDev);
+        float_stats_snapshot stats = snapshot();
 
-        print_stat("time stamp", fMean, fStdDev);
-        std::cout << "\t\t";
-        print_stat(m_latencyString, fLatencyMean, fLatencyStdDev);
-        std::cout << "\t\t";
-        print_stat("time stamp array", m_meanTimestampFrameCount.get(), (m_iMaxLatency * 2) + 1);
+        std::cout << "---------------------------------------------------------------------------------------------\n";
+        std::cout << m_collectionType << ": samples collected = " << stats.timestampIntervals.count <<
+                  "\t dropped frames = " <<  stats.droppedFrames <<
+                  "\tjunk time stamp frames = " <<  stats.junkTimestampFrames << "\n\t\t";
+        print_stat("time stamp", stats.timestampIntervals);
         std::cout << "\t\t";
-        print_stat("callback array", m_meanCallbackFrameCount.get(), (m_iMaxLatency * 2) + 1);
+        print_stat(m_latencyString, stats.callbackIntervals);
         std::cout << "---------------------------------------------------------------------------------------------\n";
     }
 
-    void calculate_live_thread(float* pfIntervalsInMiliSecondsBuffer, float* pfCallbackIntervalsInMiliSecondsBuffer, int count)
-    {
-        float fMean = 0.0f, fStdDev = 0.0f, fLatencyMean = 0.0f, fLatencyStdDev = 0.0f;
-
-        calculate_stat(pfIntervalsInMiliSecondsBuffer, count, fMean, fStdDev, m_meanTimestampFrameCount.get(),m_iMaxLatency);
-        calculate_stat(pfCallbackIntervalsInMiliSecondsBuffer, count, fLatencyMean, fLatencyStdDev, m_meanCallbackFrameCount.get(), m_iMaxLatency);
-        m_timestampStdDevs.push_back(fStdDev);
-        m_callbackStdDevs.push_back(fLatencyStdDev);
-
-        m_timestampMeans.push_back(fMean);
-        m_callbackMeans.push_back(fLatencyMean);
-    }
-
-    void Switch()
-    {
-        float * pfIntervalsInMiliSecondsPreviousBuffer = m_pfIntervalsInMiliSecondsCurrentBuffer;
-        float * pfCallbackIntervalsInMiliSecondspreviousBuffer = m_pfCallbackIntervalsInMiliSecondsCurrentBuffer;
-
-        if(m_pfIntervalsInMiliSecondsCurrentBuffer == m_pfIntervalsInMiliSecondsFrontBuffer.get())
-        {
-            m_pfIntervalsInMiliSecondsCurrentBuffer = m_pfIntervalsInMiliSecondsBackBuffer.get();
-            m_pfCallbackIntervalsInMiliSecondsCurrentBuffer = m_pfCallbackIntervalsInMiliSecondsBackBuffer.get();
-        }
-        else
-        {
-            m_pfIntervalsInMiliSecondsCurrentBuffer = m_pfIntervalsInMiliSecondsFrontBuffer.get();
-            m_pfCallbackIntervalsInMiliSecondsCurrentBuffer = m_pfCallbackIntervalsInMiliSecondsFrontBuffer.get();
-        }
-
-        if(m_calculatetionThread.joinable())
-            m_calculatetionThread.join();
-        m_calculatetionThread = std::thread(&float_stats::calculate_live_thread, this, pfIntervalsInMiliSecondsPreviousBuffer, pfCallbackIntervalsInMiliSecondspreviousBuffer, m_iCount);
-        m_iCount = 0;
-    }
-
 public:
     float_stats(float_stats&) = delete;
     float_stats& operator=(float_stats&) = delete;
-    float_stats(const std::string collectionType, const int iMaxExpectedLatency, int iSize = 20000) : m_pfIntervalsInMiliSecondsFrontBuffer(new float[iSize]),
-        m_pfCallbackIntervalsInMiliSecondsFrontBuffer(new float[iSize]),
-        m_iSize(iSize), m_iCount(0), m_fPreviousTimestamp(0.0f), m_collectionType(collectionType),
-        m_frameCounter(-1), m_droppedFrames(0), m_junkTimestampFrameCount(0),  m_latencyString("callback latency"),
-        m_delta(GetCurrentTimeInMiliSecods()), m_fPreviousCallbackTime(0.0f),
-        m_pfIntervalsInMiliSecondsBackBuffer(new float[iSize]),
-        m_pfCallbackIntervalsInMiliSecondsBackBuffer(new float[iSize]),
-        m_pfIntervalsInMiliSecondsCurrentBuffer(nullptr),
-        m_pfCallbackIntervalsInMiliSecondsCurrentBuffer(nullptr),
-        m_iCycle(4096),
-        m_meanTimestampFrameCount(new uint64_t[(2 * iMaxExpectedLatency) + 1]),
-        m_meanCallbackFrameCount(new uint64_t[(2 * iMaxExpectedLatency) + 1]),
-        m_iMaxLatency(iMaxExpectedLatency)
-
-    {
-        m_pfIntervalsInMiliSecondsCurrentBuffer = m_pfIntervalsInMiliSecondsFrontBuffer.get();
-        m_pfCallbackIntervalsInMiliSecondsCurrentBuffer = m_pfCallbackIntervalsInMiliSecondsFrontBuffer.get();
-        memset(m_meanTimestampFrameCount.get(), 0, sizeof(uint64_t) * (2 * iMaxExpectedLatency + 1));
-        memset(m_meanCallbackFrameCount.get(), 0,  sizeof(uint64_t) * (2 * iMaxExpectedLatency + 1));
+    explicit float_stats(const std::string collectionType) :
+        m_collectionType(collectionType), m_latencyString("callback latency"), m_iCycle(4096),
+        m_frameCounter(-1), m_fPreviousTimestamp(0.0f), m_fPreviousCallbackTime(0.0f),
+        m_delta(get_current_time_in_microseconds()),
+        m_droppedFrames(0), m_junkTimestampFrameCount(0)
+    {
     }
 
     ~float_stats()
     {
-        if(m_calculatetionThread.joinable())
-            m_calculatetionThread.join();
         print_stats();
     }
 
+    float_stats_snapshot snapshot() const
+    {
+        float_stats_snapshot stats;
+        stats.timestampIntervals = m_timestampIntervals.snapshot();
+        stats.callbackIntervals = m_callbackIntervals.snapshot();
+        stats.droppedFrames = m_droppedFrames;
+        stats.junkTimestampFrames = m_junkTimestampFrameCount;
+        return stats;
+    }
+
     void add_frame_with_junk_time_stamp()
     {
         ++m_junkTimestampFrameCount;
@@ -234,72 +117,91 @@ public:
 
     void add_sample(const float fTimestampInMilisecods, const int iFrameCounter)
     {
-        const float callbackTime = static_cast<float>(GetCurrentTimeInMiliSecods() - m_delta);
-        if(m_iCount == m_iSize)
-            Switch();
-        if (/*m_iCount < m_iSize && */m_frameCounter != -1)
+        const float callbackTime = get_callback_time_in_miliseconds();
+
+        int iFrameGap = 0;
+        float fPreviousTimestamp;
+        float fPreviousCallbackTime;
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            if (m_frameCounter != -1)
+            {
+                const int expectedFrameCounter = (m_frameCounter + 1) % m_iCycle;
+                iFrameGap = (iFrameCounter % m_iCycle) - expectedFrameCounter + 1;
+            }
+            fPreviousTimestamp = m_fPreviousTimestamp;
+            fPreviousCallbackTime = m_fPreviousCallbackTime;
+            m_fPreviousTimestamp = fTimestampInMilisecods;
+            m_frameCounter = (iFrameCounter % m_iCycle);
+            m_fPreviousCallbackTime = callbackTime;
+        }
+
+        if (iFrameGap > 1)
         {
-            const int expectedFrameCounter = (m_frameCounter + 1) % m_iCycle;
-            const int iFrameGap = (iFrameCounter % m_iCycle) - expectedFrameCounter + 1;
-            m_droppedFrames = m_droppedFrames + (iFrameGap - 1);
+            m_droppedFrames += (iFrameGap - 1);
+        }
 
-            m_pfIntervalsInMiliSecondsCurrentBuffer[m_iCount] = (fTimestampInMilisecods - m_fPreviousTimestamp) / iFrameGap;
-            m_pfCallbackIntervalsInMiliSecondsCurrentBuffer[m_iCount] = (callbackTime - m_fPreviousCallbackTime) / iFrameGap;
-            ++m_iCount;
+        if (iFrameGap > 0)
+        {
+            m_timestampIntervals.record((fTimestampInMilisecods - fPreviousTimestamp) / iFrameGap);
+            m_callbackIntervals.record((callbackTime - fPreviousCallbackTime) / iFrameGap);
         }
-        m_fPreviousTimestamp = fTimestampInMilisecods;
-        m_frameCounter = (iFrameCounter % m_iCycle);
-        m_fPreviousCallbackTime = callbackTime;
     }
 
+    // Records a batch of count samples spread evenly between the two timestamps
     void add_samples(const float fMinTimestampInMilisecods, const float fMaxTimestampInMilisecods, const int count)
     {
         if(count > 0)
         {
-            const float callbackTime = static_cast<float>(GetCurrentTimeInMiliSecods() - m_delta);
-            if(m_iCount + count >= m_iSize)
-                Switch();
-            if (m_frameCounter != -1)
+            const float callbackTime = get_callback_time_in_miliseconds();
+
+            bool hasPrevious;
+            float fPreviousTimestamp;
+            float fPreviousCallbackTime;
+            {
+                std::lock_guard<std::mutex> lock(m_mutex);
+                hasPrevious = m_frameCounter != -1;
+                fPreviousTimestamp = m_fPreviousTimestamp;
+                fPreviousCallbackTime = m_fPreviousCallbackTime;
+                ++m_frameCounter;
+                m_fPreviousTimestamp = fMaxTimestampInMilisecods;
+                m_fPreviousCallbackTime = callbackTime;
+            }
+
+            if (hasPrevious)
             {
                 //callbackTime is for MaxTimestamp
-                float increament = (fMaxTimestampInMilisecods - fMinTimestampInMilisecods) / count;
-                float currentTimestamp = fMinTimestampInMilisecods;
-                float callbackIncreament = (callbackTime - m_fPreviousCallbackTime) / count;
-                float currentcallbackTime = callbackTime - ((count - 1)* callbackIncreament) ;
-                for(int i = 0; i < count; ++i)
+                const float timestampIncrement = (fMaxTimestampInMilisecods - fMinTimestampInMilisecods) / count;
+                const float callbackIncrement = (callbackTime - fPreviousCallbackTime) / count;
+                m_timestampIntervals.record(fMinTimestampInMilisecods - fPreviousTimestamp);
+                m_callbackIntervals.record(callbackIncrement);
+                for(int i = 1; i < count; ++i)
                 {
-                    m_pfIntervalsInMiliSecondsCurrentBuffer[m_iCount] = (currentTimestamp - m_fPreviousTimestamp);
-                    m_pfCallbackIntervalsInMiliSecondsCurrentBuffer[m_iCount] = (currentcallbackTime - m_fPreviousCallbackTime);
-                    m_fPreviousTimestamp = currentTimestamp;
-                    m_fPreviousCallbackTime = currentcallbackTime ;
-                    ++m_iCount;
-                    currentTimestamp+=increament;
-                    currentcallbackTime+=callbackIncreament;
+                    m_timestampIntervals.record(timestampIncrement);
+                    m_callbackIntervals.record(callbackIncrement);
                 }
             }
-            ++m_frameCounter;
-            m_fPreviousTimestamp = fMaxTimestampInMilisecods;
-            m_fPreviousCallbackTime = callbackTime;
         }
     }
 };
 
-template<int MAX_LIMIT = 30>
-class fps_counter
+// Counts samples of one stream and reports its rate. add_samples() is a single relaxed atomic
+// add, so it can be called from any callback thread. The rate is an exponentially weighted
+// moving average (time constant time_constant_s) over the intervals between get_fps() calls,
+// measured with the monotonic clock.
+class rate_meter
 {
 public:
-    int m_frameCount;
-    int64_t m_previousTime;
-    float m_fCurrentFPS;
-    std::string m_type;
-    int64_t m_timeSumInterval;
-    uint64_t m_frameCounter;
-
-    fps_counter(const std::string& type): m_frameCount(0), m_previousTime(0), m_fCurrentFPS(0.0f), m_type (type), m_timeSumInterval(0), m_frameCounter(0)
+    rate_meter(const std::string& type, double time_constant_s = 1.0) :
+        m_type(type), m_timeConstant(time_constant_s), m_frameCounter(0),
+        m_previousTime(get_current_time_in_nanoseconds()), m_previousFrameCount(0),
+        m_fCurrentFPS(0.0), m_hasRate(false)
     {
-
     }
 
+    rate_meter(const rate_meter&) = delete;
+    rate_meter& operator=(const rate_meter&) = delete;
+
     void add_sample()
     {
         add_samples(1);
@@ -309,35 +211,47 @@ public:
     {
         if(count > 0)
         {
-            m_frameCounter += count;
-            const auto currrenTime = GetCurrentTimeInMiliSecods();
-            if(m_previousTime == 0)
-            {
-                m_previousTime = currrenTime;
-                return;
-            }
+            m_frameCounter.fetch_add(count, std::memory_order_relaxed);
+        }
+    }
 
-            m_timeSumInterval += (currrenTime - m_previousTime);
-            m_previousTime = currrenTime;
-            m_frameCount += count;
+    // Updates the rate average at most every 100ms, readers in between get the last value
+    float get_fps() const
+    {
+        std::lock_guard<std::mutex> lock(m_readerMutex);
+        const int64_t currentTime = get_current_time_in_nanoseconds();
+        const int64_t elapsed = currentTime - m_previousTime;
+        if(elapsed < 100 * 1000 * 1000)
+        {
+            return static_cast<float>(m_fCurrentFPS);
+        }
 
-            if(m_frameCount >= MAX_LIMIT)
-            {
-                m_fCurrentFPS = (m_frameCount * 1000.0f) /m_timeSumInterval;
-                m_timeSumInterval = 0;
-                m_frameCount = 0;
-            }
+        const uint64_t frameCount = get_frame_count();
+        const double seconds = elapsed / 1e9;
+        const double instantFPS = (frameCount - m_previousFrameCount) / seconds;
+        if(m_hasRate)
+        {
+            const double weight = 1.0 - std::exp(-seconds / m_timeConstant);
+            m_fCurrentFPS += weight * (instantFPS - m_fCurrentFPS);
+        }
+        else
+        {
+            m_fCurrentFPS = instantFPS;
+            m_hasRate = true;
         }
+        m_previousTime = currentTime;
+        m_previousFrameCount = frameCount;
+        return static_cast<float>(m_fCurrentFPS);
     }
 
-    inline float get_fps() const
+    uint64_t get_frame_count() const
     {
-        return m_fCurrentFPS;
+        return m_frameCounter.load(std::memory_order_relaxed);
     }
 
-    uint64_t get_frame_count() const
+    const std::string& get_type() const
     {
-        return m_frameCounter;
+        return m_type;
     }
 
     void print_fps()
@@ -345,83 +259,142 @@ public:
         std::cout << m_type << " fps:"<< get_fps() << std::endl;
     }
 
-    ~fps_counter()
+private:
+    static int64_t get_current_time_in_nanoseconds()
     {
+        auto now = std::chrono::steady_clock::now().time_since_epoch();
+        return std::chrono::duration_cast<std::chrono::nanoseconds>(now).count();
     }
-};
 
+    const std::string m_type;
+    const double m_timeConstant;
+    std::atomic<uint64_t> m_frameCounter;
 
+    mutable std::mutex m_readerMutex;
+    mutable int64_t m_previousTime;
+    mutable uint64_t m_previousFrameCount;
+    mutable double m_fCurrentFPS;
+    mutable bool m_hasRate;
+};
+
+// Rate meters of the SLAM input streams. Each stream should be counted by exactly one producer:
+// the producer claims the meter once with register_stream() and then updates it directly.
+// A second registration of the same stream is reported, as it would count samples twice.
 class stream_stats
 {
-private:
-    fps_counter<> m_depthFPS;
-    fps_counter<> m_fisheyeFPS;
-
-    fps_counter<125> m_acclerometerFPS;
-    fps_counter<100> m_gyroscopeFPS;
-
 public:
+    enum stream_id
+    {
+        fisheye_stream = 0,
+        depth_stream,
+        accelerometer_stream,
+        gyroscope_stream,
+        stream_count
+    };
+
     stream_stats(): m_depthFPS("depth"), m_fisheyeFPS("fisheye"), m_acclerometerFPS("accelerometer"), m_gyroscopeFPS("gyroscope")
     {
+        for(int i = 0; i < stream_count; ++i)
+        {
+            m_registered[i] = false;
+        }
+    }
+
+    stream_stats(const stream_stats&) = delete;
+    stream_stats& operator=(const stream_stats&) = delete;
+
+    rate_meter& register_stream(stream_id id)
+    {
+        rate_meter& meter = get_meter(id);
+        if(m_registered[id].exchange(true))
+        {
+            std::cerr << "error: " << meter.get_type() << " stream is already measured by another producer" << std::endl;
+        }
+        return meter;
+    }
+
+    bool is_registered(stream_id id) const
+    {
+        return m_registered[id];
+    }
+
+    rate_meter& get_meter(stream_id id)
+    {
+        return const_cast<rate_meter&>(static_cast<const stream_stats*>(this)->get_meter(id));
+    }
+
+    const rate_meter& get_meter(stream_id id) const
+    {
+        switch(id)
+        {
+        case fisheye_stream:
+            return m_fisheyeFPS;
+        case depth_stream:
+            return m_depthFPS;
+        case accelerometer_stream:
+            return m_acclerometerFPS;
+        default:
+            return m_gyroscopeFPS;
+        }
     }
 
     void add_depth_samples(int count)
     {
-        add_samples(m_depthFPS, count);
+        m_depthFPS.add_samples(count);
     }
 
     void add_fisheye_samples(int count)
     {
-        add_samples(m_fisheyeFPS, count);
+        m_fisheyeFPS.add_samples(count);
     }
 
     void add_acceleromter_samples(int count)
     {
-        add_samples(m_acclerometerFPS, count);
+        m_acclerometerFPS.add_samples(count);
     }
     void add_gyroscope_samples(int count)
     {
-        return add_samples(m_gyroscopeFPS, count);
+        m_gyroscopeFPS.add_samples(count);
     }
 
     float get_gyroscope_fps() const
     {
-        return get_fps(m_gyroscopeFPS);
+        return m_gyroscopeFPS.get_fps();
     }
 
     float get_depth_fps() const
     {
-        return get_fps(m_depthFPS);
+        return m_depthFPS.get_fps();
     }
 
     float get_fisheye_fps() const
     {
-        return get_fps(m_fisheyeFPS);
+        return m_fisheyeFPS.get_fps();
     }
 
     float get_acceleromter_fps() const
     {
-        return get_fps(m_acclerometerFPS);
+        return m_acclerometerFPS.get_fps();
     }
 
     uint64_t get_fisheye_frame_count() const
     {
-        return get_frame_count(m_fisheyeFPS);
+        return m_fisheyeFPS.get_frame_count();
     }
 
     uint64_t  get_depth_frame_count() const
     {
-        return get_frame_count(m_depthFPS);
+        return m_depthFPS.get_frame_count();
     }
 
     uint64_t get_gyroscope_frame_count() const
     {
-        return get_frame_count(m_gyroscopeFPS);
+        return m_gyroscopeFPS.get_frame_count();
     }
 
     uint64_t  get_acceleromter_frame_count() const
     {
-        return get_frame_count(m_acclerometerFPS);
+        return m_acclerometerFPS.get_frame_count();
     }
 
     ~stream_stats()
@@ -429,23 +402,12 @@ public:
     }
 
 private:
-    template <int N>
-    static void add_samples(fps_counter<N> &fpsCounter, int count)
-    {
-        fpsCounter.add_samples(count);
-    }
-
-    template <int N>
-    static float get_fps(const fps_counter<N> &fpsCounter)
-    {
-        return fpsCounter.get_fps();
-    }
+    rate_meter m_depthFPS;
+    rate_meter m_fisheyeFPS;
+    rate_meter m_acclerometerFPS;
+    rate_meter m_gyroscopeFPS;
 
-    template <int N>
-    static uint64_t get_frame_count(const fps_counter<N> &fpsCounter)
-    {
-        return fpsCounter.get_frame_count();
-    }
+    std::atomic_bool m_registered[stream_count];
 };
 
 inline void print_stream_fps_stats(const std::string& type, const stream_stats& streamStats)
@@ -14,6 +14,10 @@
 #include <librealsense/slam/slam.h>
 #include <signal.h>
 #include "slam_stats.h"
+#include "frame_source.hpp"
+#include "slam_feeder.hpp"
+#include "pose_predictor.hpp"
+#include "pipeline_trace.hpp"
 
 #define ESC_KEY 27
 using namespace std;
@@ -74,139 +78,240 @@ inline void add_motion_sensor_samples(stream_stats & streamStats, const rs::core
     }
 }
 
-// Sets options and enables the required stream types (fisheye/depth)
-void configure_camera_for_slam(rs::device* camera, video_module_interface::supported_module_config supported_slam_config)
+// Claims the input rate meter of an image stream (depth/fisheye) for its producer
+inline rate_meter& register_stream_stats(stream_stats& streamStats, const rs::core::stream_type stream)
 {
-    camera->set_option(rs::option::fisheye_strobe, 1); // Needed to align image timestamps to common clock-domain with the motion events. Required for SLAM.
-    camera->set_option(rs::option::fisheye_external_trigger, 1); // This option causes the fisheye image to be aquired in-sync with the depth image. Required for SLAM.
-    
-    // Enable fisheye stream  
-    auto &fisheye_stream_config = supported_slam_config[stream_type::fisheye];
-    camera->enable_stream(rs::stream::fisheye, fisheye_stream_config.size.width, fisheye_stream_config.size.height, rs::format::raw8, fisheye_stream_config.frame_rate);
-    
-    // Enable depth stream
-    auto &depth_stream_config = supported_slam_config[stream_type::depth];
-    camera->enable_stream(rs::stream::depth, depth_stream_config.size.width, depth_stream_config.size.height, rs::format::z16, depth_stream_config.frame_rate);
+    return streamStats.register_stream(stream == rs::core::stream_type::depth ? stream_stats::depth_stream : stream_stats::fisheye_stream);
+}
+
+// Claims the input rate meter of a motion sensor (accel/gyro) for its producer
+inline rate_meter& register_motion_sensor_stats(stream_stats& streamStats, const rs::core::motion_type motion)
+{
+    return streamStats.register_stream(motion == rs::core::motion_type::accel ? stream_stats::accelerometer_stream : stream_stats::gyroscope_stream);
+}
+
+inline rs::source get_source_type(rs::core::video_module_interface::supported_module_config &supported_config)
+{
+    rs::source active_sources = static_cast<rs::source>(0);
+    for(int i = 0; i < (int) rs::core::stream_type::max; ++i)
+    {
+        if(supported_config[rs::core::stream_type(i)].is_enabled)
+        {
+            active_sources = rs::source::video;
+            break;
+        }
+    }
+
+    for(int i = (int) rs::core::motion_type::accel; i < (int) rs::core::motion_type::max; ++i)
+    {
+        if(supported_config[rs::core::motion_type(i)].is_enabled)
+        {
+            if(active_sources == rs::source::video)
+            {
+                active_sources = rs::source::all_sources;
+            }
+            else
+            {
+                active_sources = rs::source::motion_data;
+            }
+            break;
+        }
+    }
+    return active_sources;
+}
+
+inline bool check_motion_sensor_capability_if_required(frame_source* source, rs::source requestedSource)
+{
+    if(requestedSource == rs::source::all_sources || rs::source::motion_data == requestedSource)
+        return source->supports_motion();
+    return true;
+}
+
+// Checks that SLAM can run on the source: it has to be the camera SLAM supports and deliver motion data.
+// A synthetic or recorded source stands in for that camera, for them a different name is only a warning.
+inline bool check_source_for_slam(frame_source* source, video_module_interface::supported_module_config supported_slam_config)
+{
+    // Check to make sure the current device name (ex: Intel RealSense ZR300) is one that the SLAM module supports
+    if (strcmp(source->get_name(), supported_slam_config.device_name) != 0)
+    {
+        if (source->get_device())
+        {
+            cerr << "error : current device is not supported by the current module configuration" << endl;
+            return false;
+        }
+        cout << "warning: " << source->get_name() << " stands in for " << supported_slam_config.device_name << endl;
+    }
+
+    // Check to make sure that the current device supports motion data
+    if (!check_motion_sensor_capability_if_required(source, get_source_type(supported_slam_config)))
+    {
+        cerr << "error : current device does not support motion events" << endl; // if you get this, unplug and reconnect the camera
+        return false;
+    }
+    return true;
+}
+
+// Sets options and enables the required stream types (fisheye/depth). Returns false if the source lacks one.
+inline bool configure_camera_for_slam(frame_source* source, video_module_interface::supported_module_config supported_slam_config)
+{
+    if (rs::device* camera = source->get_device())
+    {
+        camera->set_option(rs::option::fisheye_strobe, 1); // Needed to align image timestamps to common clock-domain with the motion events. Required for SLAM.
+        camera->set_option(rs::option::fisheye_external_trigger, 1); // This option causes the fisheye image to be aquired in-sync with the depth image. Required for SLAM.
+    }
+
+    // Enable fisheye and depth streams
+    for (stream_type stream : { stream_type::fisheye, stream_type::depth })
+    {
+        auto &stream_config = supported_slam_config[stream];
+        pixel_format format = stream == stream_type::fisheye ? pixel_format::raw8 : pixel_format::z16;
+        if (!source->enable_stream(stream, stream_config.size.width, stream_config.size.height, format, stream_config.frame_rate))
+        {
+            cerr << "error : " << source->get_name() << " has no " << (stream == stream_type::depth ? "depth" : "fisheye") << " stream of "
+                 << stream_config.size.width << "x" << stream_config.size.height << endl;
+            return false;
+        }
+    }
+    return true;
 }
 
 // Create a callback for this stream type (depth/fisheye). This is where data from the camera gets passed to SLAM.
-void set_callback_for_image_stream(rs::device* camera, stream_type streamType, std::unique_ptr<slam> const &slam, stream_stats& inputStreamStats)
-{    
-    function<void(rs::frame)> callback = [streamType, &slam, &inputStreamStats](rs::frame frame)
+// The image is only queued here; the slam_feeder thread hands it to SLAM, so the camera callback never waits for SLAM.
+// If an imu_batcher is given, each image also flushes the IMU samples collected since the previous frame.
+void set_callback_for_image_stream(frame_source* source, stream_type streamType, slam_feeder& feeder, stream_stats& inputStreamStats,
+                                   imu_batcher* batcher = nullptr)
+{
+    rate_meter& inputMeter = register_stream_stats(inputStreamStats, streamType);
+    metric_counter& framesMetric = metrics_registry::get_instance().get_counter("rs_camera_frames_total", "Frames received from the camera",
+                                   { { "stream", streamType == stream_type::depth ? "depth" : "fisheye" } });
+    frame_source::image_callback callback = [streamType, &feeder, &inputMeter, &framesMetric, batcher](image_interface* image)
     {
+        TRACE_SPAN("camera_callback", image->query_frame_number(), streamType == stream_type::depth ? "depth" : "fisheye");
+
         // Check for correct timestamp domain
-        const auto timestampDomain = frame.get_frame_timestamp_domain();
-        if(rs::timestamp_domain::microcontroller != timestampDomain)
+        if(timestamp_domain::microcontroller != image->query_time_stamp_domain())
         {
-            cerr << "error: Junk time stamp in stream:" << (int)(streamType)<< "\twith frame counter:" << frame.get_frame_number() << endl;
+            cerr << "error: Junk time stamp in stream:" << (int)(streamType)<< "\twith frame counter:" << image->query_frame_number() << endl;
             return;
         }
 
-        // Construct a sample_set to pass to SLAM
-        correlated_sample_set sampleSet = {};
-        sampleSet[streamType] = image_interface::create_instance_from_librealsense_frame(frame, image_interface::flag::any);
-
         // Update input stream stats
-        add_stream_samples(inputStreamStats, streamType, 1);
+        inputMeter.add_sample();
+        framesMetric.inc();
+
+        // Queue the image for SLAM. The feeder keeps its own reference until SLAM has processed it,
+        // and counts the sample as dropped if its queue is full. The source releases its reference after the callback.
+        feeder.enqueue_image(streamType, image);
 
-        // Pass the sample_set containing the image to SLAM
-        if(slam->process_sample_set(sampleSet) < status_no_error)
+        if(batcher)
         {
-            cerr << "error: failed to process image sample" << endl;
+            batcher->mark_frame();
         }
-
-        // Now that the image has been processed, release it
-        sampleSet[streamType]->release();
     };
-    
-    // Convert the stream type from a RealSense SDK type to a librealsense type.
-    const rs::stream lrsStreamType = rs::utils::convert_stream_type(streamType); 
-    
+
     // Set the callback for this stream type
-    camera->set_frame_callback(lrsStreamType, callback);
+    source->set_image_callback(streamType, callback);
+}
+
+// Returns an imu_batcher consumer that passes each batch of IMU samples to the SLAM feeder.
+// Input stats are updated once per batch rather than once per sample.
+inline imu_batcher::batch_callback make_slam_imu_consumer(slam_feeder& feeder, stream_stats& inputStreamStats)
+{
+    rate_meter& accelMeter = register_motion_sensor_stats(inputStreamStats, motion_type::accel);
+    rate_meter& gyroMeter = register_motion_sensor_stats(inputStreamStats, motion_type::gyro);
+    auto& registry = metrics_registry::get_instance();
+    metric_counter& accelMetric = registry.get_counter("rs_camera_frames_total", "Frames received from the camera", { { "stream", "accel" } });
+    metric_counter& gyroMetric = registry.get_counter("rs_camera_frames_total", "Frames received from the camera", { { "stream", "gyro" } });
+    return [&feeder, &accelMeter, &gyroMeter, &accelMetric, &gyroMetric](const imu_sample* samples, size_t count)
+    {
+        TRACE_SPAN("imu_batch", count ? samples[0].frame_number : -1, "imu");
+
+        int accelCount = 0;
+        for(size_t i = 0; i < count; ++i)
+        {
+            if(samples[i].type == motion_type::accel)
+            {
+                ++accelCount;
+            }
+        }
+        accelMeter.add_samples(accelCount);
+        gyroMeter.add_samples((int)count - accelCount);
+        accelMetric.inc(accelCount);
+        gyroMetric.inc(count - accelCount);
+
+        feeder.enqueue_motion_batch(samples, count);
+    };
 }
 
 // Set a callback to receive motion data. This is where the IMU data gets passed to the SLAM module.
 // Unlike for the image streams, we use a single callback that handles both motion types (accel/gyro).
-void set_callback_for_motion_streams(rs::device* camera, std::unique_ptr<slam> const &slam, stream_stats& inputStreamStats)
+// Samples are collected by the imu_batcher and delivered in timestamp-ordered batches. The pose predictor,
+// if one is given, gets each sample right away so its predictions aren't delayed by the batching.
+void set_callback_for_motion_streams(frame_source* source, imu_batcher& batcher, pose_predictor* predictor = nullptr)
 {
-    std::function<void(rs::motion_data)> motion_callback = [&slam, &inputStreamStats](rs::motion_data entry)
+    frame_source::motion_callback motion_callback = [&batcher, predictor](const motion_sample& entry)
     {
-        // Convert the motion type from a librealsense type to a RealSense SDK type.
-        const motion_type motionType = rs_to_sdk_motion_type(entry.timestamp_data.source_id); 
-
-        // Construct a sample_set containing the motion data (either accel or gyro)
-        correlated_sample_set sample_set = {};
-        sample_set[motionType].timestamp = entry.timestamp_data.timestamp;
-        sample_set[motionType].type = motionType;
-        sample_set[motionType].frame_number = entry.timestamp_data.frame_number;
-        sample_set[motionType].data[0] = entry.axes[0];
-        sample_set[motionType].data[1] = entry.axes[1];
-        sample_set[motionType].data[2] = entry.axes[2];
-
-        // Update input motion sample stats
-        add_motion_sensor_samples(inputStreamStats, motionType, 1);
-
-        // Pass the sample_set to SLAM
-        if(slam->process_sample_set(sample_set) < status_no_error)
+        // Append a compact motion sample (either accel or gyro) to the current batch
+        imu_sample sample;
+        sample.timestamp = entry.timestamp;
+        sample.frame_number = entry.frame_number;
+        sample.type = entry.type;
+        sample.data[0] = entry.data[0];
+        sample.data[1] = entry.data[1];
+        sample.data[2] = entry.data[2];
+        if(predictor)
         {
-            cerr<<"error : failed to process motion sample" << endl;
+            predictor->add_imu_sample(sample);
         }
+        batcher.add(sample);
     };
 
-    // An empty callback for timestamp data. Not used in this case.
-    std::function<void(rs::timestamp_data)> timestamp_callback = [](rs::timestamp_data entry) { };
-
-    // Set the device to enable motion data, and set the callbacks for it
-    camera->enable_motion_tracking(motion_callback, timestamp_callback);
+    // Set the source to deliver motion data to the callback
+    source->enable_motion(motion_callback);
 }
 
 // Gets the stream config for a specific image stream type
-video_module_interface::actual_image_stream_config get_stream_config(rs::device* device, stream_type streamType, video_module_interface::supported_module_config supported_slam_config)
+video_module_interface::actual_image_stream_config get_stream_config(frame_source* source, stream_type streamType, video_module_interface::supported_module_config supported_slam_config)
 {
     video_module_interface::supported_image_stream_config supported_stream_config = supported_slam_config[streamType];
-    rs::stream lrsStreamType = rs::utils::convert_stream_type(streamType);
-    intrinsics stream_intrinsics = rs::utils::convert_intrinsics(device->get_stream_intrinsics(lrsStreamType));
-    
+
     video_module_interface::actual_image_stream_config actual_stream_config;
     actual_stream_config.size.width = supported_stream_config.size.width;
     actual_stream_config.size.height= supported_stream_config.size.height;
     actual_stream_config.frame_rate = supported_stream_config.frame_rate;
-    actual_stream_config.intrinsics = stream_intrinsics;
+    actual_stream_config.intrinsics = source->get_intrinsics(streamType);
     actual_stream_config.is_enabled = true;
     actual_stream_config.flags = rs::core::sample_flags::none;
-    
+
     if (streamType == stream_type::fisheye)
     {
-        // Read extrinsics from the device and set them in the fisheye stream config
-        actual_stream_config.extrinsics_motion = rs::utils::convert_extrinsics(device->get_motion_extrinsics_from(rs::stream::fisheye));
-        actual_stream_config.extrinsics = rs::utils::convert_extrinsics(device->get_extrinsics(rs::stream::depth, rs::stream::fisheye));
+        // Read extrinsics from the source and set them in the fisheye stream config
+        actual_stream_config.extrinsics_motion = source->get_motion_extrinsics(stream_type::fisheye);
+        actual_stream_config.extrinsics = source->get_extrinsics(stream_type::depth, stream_type::fisheye);
     }
-    
+
     return actual_stream_config;
 }
 
-video_module_interface::actual_module_config get_slam_config(rs::device* device, std::unique_ptr<slam> const &slam, video_module_interface::supported_module_config supported_slam_config)
+video_module_interface::actual_module_config get_slam_config(frame_source* source, video_module_interface::supported_module_config supported_slam_config)
 {
     // Construct the SLAM configuration that we will use
     video_module_interface::actual_module_config slam_config = {};
 
-    // Copy the device name to the SLAM config
-    auto device_name = device->get_name();
-    memcpy(slam_config.device_info.name, device_name, std::strlen(device_name));
-    
+    // Copy the name of the supported device to the SLAM config, a synthetic or recorded source stands in for it
+    strncpy(slam_config.device_info.name, supported_slam_config.device_name, sizeof(slam_config.device_info.name) - 1);
+
     // Set stream config for each image stream type
-    slam_config[stream_type::fisheye] = get_stream_config(device, stream_type::fisheye, supported_slam_config);
-    slam_config[stream_type::depth] = get_stream_config(device, stream_type::depth, supported_slam_config);
-    
+    slam_config[stream_type::fisheye] = get_stream_config(source, stream_type::fisheye, supported_slam_config);
+    slam_config[stream_type::depth] = get_stream_config(source, stream_type::depth, supported_slam_config);
+
     // Enable accelerometer and gyroscope in the SLAM config
     slam_config[motion_type::accel].is_enabled = true;
     slam_config[motion_type::gyro].is_enabled = true;
 
-    // Read intrinsics from the device and set them in the SLAM config
-    auto motion_intrinsics = device->get_motion_intrinsics();
-    slam_config[motion_type::accel].intrinsics = rs::utils::convert_motion_device_intrinsics(motion_intrinsics.acc);
-    slam_config[motion_type::gyro].intrinsics = rs::utils::convert_motion_device_intrinsics(motion_intrinsics.gyro);
+    // Read intrinsics from the source and set them in the SLAM config
+    slam_config[motion_type::accel].intrinsics = source->get_motion_intrinsics(motion_type::accel);
+    slam_config[motion_type::gyro].intrinsics = source->get_motion_intrinsics(motion_type::gyro);
 
     return slam_config;
 }
@@ -306,41 +411,3 @@ inline void clear_streams(rs::core::video_module_interface::supported_module_con
         supported_config[rs::core::motion_type(i)].is_enabled = false;
     }
 }
-
-inline rs::source get_source_type(rs::core::video_module_interface::supported_module_config &supported_config)
-{
-    rs::source active_sources = static_cast<rs::source>(0);
-    for(int i = 0; i < (int) rs::core::stream_type::max; ++i)
-    {
-        if(supported_config[rs::core::stream_type(i)].is_enabled)
-        {
-            active_sources = rs::source::video;
-            break;
-        }
-    }
-
-    for(int i = (int) rs::core::motion_type::accel; i < (int) rs::core::motion_type::max; ++i)
-    {
-        if(supported_config[rs::core::motion_type(i)].is_enabled)
-        {
-            if(active_sources == rs::source::video)
-            {
-                active_sources = rs::source::all_sources;
-            }
-            else
-            {
-                active_sources = rs::source::motion_data;
-            }
-            break;
-        }
-    }
-    return active_sources;
-}
-
-inline bool check_motion_sensor_capability_if_required(rs::device *device, rs::source requestedSource)
-{
-    if(requestedSource == rs::source::all_sources || rs::source::motion_data == requestedSource)
-        return device->supports(rs::capabilities::motion_events);
-    return true;
-}
-
@@ -0,0 +1,198 @@
+// License: Apache 2.0. See LICENSE file in root directory.
+// Copyright(c) 2017 Intel Corporation. All Rights Reserved.
+
+#pragma once
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <deque>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "rs/core/types.h"
+
+// Remembers world positions per label, to tell whether a position is close to one seen before.
+//
+// Two positions are close when they are less than radius apart on every axis. The positions are
+// hashed into cubic cells of radius size, so a close position is in the same cell or one of its
+// 26 neighbours, and a lookup costs the same however many positions are remembered. Positions that
+// weren't seen again for ttl are forgotten, and so are the least recently seen ones beyond
+// max_entries. Not thread safe.
+class spatial_index
+{
+public:
+    typedef std::chrono::steady_clock clock;
+
+    // A ttl of zero keeps positions until max_entries is reached
+    explicit spatial_index(float radius, clock::duration ttl = clock::duration::zero(), size_t max_entries = 4096) :
+        m_radius(radius), m_ttl(ttl), m_max_entries(max_entries), m_next_id(0) {}
+
+    // Returns true if point is close to a remembered position of the same label, which counts as
+    // seen again. Otherwise remembers point and returns false.
+    bool find_or_insert(const rs::core::point3dF32& point, const std::string& label = std::string(),
+                        clock::time_point now = clock::now())
+    {
+        expire(now);
+
+        // Positions without a cell are never close to anything
+        if (!std::isfinite(point.x) || !std::isfinite(point.y) || !std::isfinite(point.z))
+        {
+            return false;
+        }
+
+        cell_map& cells = m_labels[label];
+        int64_t x = cell_of(point.x), y = cell_of(point.y), z = cell_of(point.z);
+        for (int64_t dx = -1; dx <= 1; ++dx)
+        {
+            for (int64_t dy = -1; dy <= 1; ++dy)
+            {
+                for (int64_t dz = -1; dz <= 1; ++dz)
+                {
+                    auto cell = cells.find(cell_key(x + dx, y + dy, z + dz));
+                    if (cell == cells.end())
+                    {
+                        continue;
+                    }
+                    for (auto& position : cell->second)
+                    {
+                        if (std::fabs(point.x - position.point.x) < m_radius &&
+                            std::fabs(point.y - position.point.y) < m_radius &&
+                            std::fabs(point.z - position.point.z) < m_radius)
+                        {
+                            touch(position.id, now);
+                            return true;
+                        }
+                    }
+                }
+            }
+        }
+
+        uint64_t id = m_next_id++;
+        uint64_t key = cell_key(x, y, z);
+        cells[key].push_back({id, point});
+        m_entries[id] = {&cells, key, now};
+        m_expiry.push_back({id, now});
+        while (m_entries.size() > m_max_entries && !m_expiry.empty())
+        {
+            evict_oldest();
+        }
+        return false;
+    }
+
+    size_t size() const
+    {
+        return m_entries.size();
+    }
+
+    void clear()
+    {
+        m_labels.clear();
+        m_entries.clear();
+        m_expiry.clear();
+    }
+
+private:
+    struct position
+    {
+        uint64_t id;
+        rs::core::point3dF32 point;
+    };
+
+    typedef std::unordered_map<uint64_t, std::vector<position>> cell_map;
+
+    struct entry
+    {
+        cell_map* cells;          // of the label, the maps of m_labels are never erased but by clear()
+        uint64_t cell;
+        clock::time_point last_seen;
+    };
+
+    // Positions in the order they were last seen. Seeing a position again adds a newer record and
+    // leaves the old one behind, which is skipped when it comes up.
+    struct expiry_record
+    {
+        uint64_t id;
+        clock::time_point seen;
+    };
+
+    // 21 bits per axis, a million cells either way of the origin
+    static const int64_t cell_limit = (1 << 20) - 1;
+
+    int64_t cell_of(float coordinate) const
+    {
+        double cell = std::floor(coordinate / m_radius);
+        return static_cast<int64_t>(std::max(std::min(cell, static_cast<double>(cell_limit)),
+                                             static_cast<double>(-cell_limit)));
+    }
+
+    static uint64_t cell_key(int64_t x, int64_t y, int64_t z)
+    {
+        const uint64_t mask = (uint64_t(1) << 21) - 1;
+        return (static_cast<uint64_t>(x) & mask) << 42 | (static_cast<uint64_t>(y) & mask) << 21 |
+               (static_cast<uint64_t>(z) & mask);
+    }
+
+    void touch(uint64_t id, clock::time_point now)
+    {
+        // Without a ttl only the insertion order is needed, for max_entries
+        if (m_ttl == clock::duration::zero())
+        {
+            return;
+        }
+        m_entries[id].last_seen = now;
+        m_expiry.push_back({id, now});
+    }
+
+    void expire(clock::time_point now)
+    {
+        if (m_ttl == clock::duration::zero())
+        {
+            return;
+        }
+        while (!m_expiry.empty() && now - m_expiry.front().seen >= m_ttl)
+        {
+            evict_oldest();
+        }
+    }
+
+    // Removes the position of the oldest record, unless it was seen again since
+    void evict_oldest()
+    {
+        expiry_record record = m_expiry.front();
+        m_expiry.pop_front();
+        auto found = m_entries.find(record.id);
+        if (found == m_entries.end() || found->second.last_seen != record.seen)
+        {
+            return;
+        }
+
+        cell_map& cells = *found->second.cells;
+        auto cell = cells.find(found->second.cell);
+        auto& positions = cell->second;
+        for (size_t i = 0; i < positions.size(); ++i)
+        {
+            if (positions[i].id == record.id)
+            {
+                positions[i] = positions.back();
+                positions.pop_back();
+                break;
+            }
+        }
+        if (positions.empty())
+        {
+            cells.erase(cell);
+        }
+        m_entries.erase(found);
+    }
+
+    float m_radius;
+    clock::duration m_ttl;
+    size_t m_max_entries;
+    uint64_t m_next_id;
+    std::unordered_map<std::string, cell_map> m_labels;
+    std::unordered_map<uint64_t, entry> m_entries;
+    std::deque<expiry_record> m_expiry;
+};
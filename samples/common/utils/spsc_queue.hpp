@@ -0,0 +1,120 @@
+// License: Apache 2.0. See LICENSE file in root directory.
+// Copyright(c) 2017 Intel Corporation. All Rights Reserved.
+
+#pragma once
+
+#include <atomic>
+#include <memory>
+#include <cstddef>
+#include <utility>
+
+// Bounded lock-free queue for exactly one producer thread and one consumer thread.
+// The capacity is rounded up to a power of two. Pushing into a full queue fails instead
+// of blocking, so the producer (usually a camera callback) never waits for the consumer.
+template<typename T>
+class spsc_queue
+{
+public:
+    explicit spsc_queue(size_t capacity) :
+        m_capacity(round_up_to_power_of_two(capacity)),
+        m_mask(m_capacity - 1),
+        m_buffer(new T[m_capacity]),
+        m_head(0),
+        m_tail(0)
+    {
+    }
+
+    spsc_queue(const spsc_queue&) = delete;
+    spsc_queue& operator=(const spsc_queue&) = delete;
+
+    // Producer side
+    bool try_push(const T& item)
+    {
+        const size_t tail = m_tail.load(std::memory_order_relaxed);
+        if (tail - m_head.load(std::memory_order_acquire) == m_capacity)
+        {
+            return false;
+        }
+        m_buffer[tail & m_mask] = item;
+        m_tail.store(tail + 1, std::memory_order_release);
+        return true;
+    }
+
+    bool try_push(T&& item)
+    {
+        const size_t tail = m_tail.load(std::memory_order_relaxed);
+        if (tail - m_head.load(std::memory_order_acquire) == m_capacity)
+        {
+            return false;
+        }
+        m_buffer[tail & m_mask] = std::move(item);
+        m_tail.store(tail + 1, std::memory_order_release);
+        return true;
+    }
+
+    // Consumer side: returns the oldest item without removing it, or nullptr if empty
+    T* front()
+    {
+        const size_t head = m_head.load(std::memory_order_relaxed);
+        if (head == m_tail.load(std::memory_order_acquire))
+        {
+            return nullptr;
+        }
+        return &m_buffer[head & m_mask];
+    }
+
+    // Consumer side: removes the item returned by front()
+    void pop()
+    {
+        m_head.store(m_head.load(std::memory_order_relaxed) + 1, std::memory_order_release);
+    }
+
+    bool try_pop(T& item)
+    {
+        T* head = front();
+        if (!head)
+        {
+            return false;
+        }
+        item = std::move(*head);
+        pop();
+        return true;
+    }
+
+    // Approximate when called concurrently with push/pop
+    size_t size() const
+    {
+        return m_tail.load(std::memory_order_acquire) - m_head.load(std::memory_order_acquire);
+    }
+
+    bool empty() const
+    {
+        return size() == 0;
+    }
+
+    size_t capacity() const
+    {
+        return m_capacity;
+    }
+
+private:
+    static size_t round_up_to_power_of_two(size_t value)
+    {
+        size_t result = 1;
+        while (result < value)
+        {
+            result <<= 1;
+        }
+        return result;
+    }
+
+    const size_t m_capacity;
+    const size_t m_mask;
+    std::unique_ptr<T[]> m_buffer;
+
+    // Keep the indices on separate cache lines so producer and consumer don't false-share.
+    // Padding instead of alignas, since over-aligned new is not available before C++17.
+    std::atomic<size_t> m_head;
+    char m_padding[64 - sizeof(std::atomic<size_t>)];
+    std::atomic<size_t> m_tail;
+};
@@ -0,0 +1,963 @@
+// License: Apache 2.0. See LICENSE file in root directory.
+// Copyright(c) 2017 Intel Corporation. All Rights Reserved.
+
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstring>
+#include <fstream>
+#include <memory>
+#include <mutex>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "frame_source.hpp"
+
+// Recording of camera streams (color, depth, fisheye, infrared) and IMU samples.
+//
+// File layout:
+//   recording_file_header    streams, calibration
+//   chunk ...                recording_chunk_header + payload padded to 8 bytes, in arrival order
+//   recording_index_entry ...  one per chunk, sorted by timestamp
+//   recording_footer
+//
+// Chunks are only appended, so a recording whose recorder was killed is still readable: without
+// a footer the reader rebuilds the index by walking the chunks. Playback maps the file and hands
+// out images that point into the mapping, without copying the pixels.
+
+static const int recording_max_streams = 8;
+static_assert((int)rs::core::stream_type::max <= recording_max_streams, "recording_file_header has too few stream slots");
+
+static const char recording_file_magic[8] = { 'R', 'S', 'R', 'E', 'C', '0', '0', '1' };
+static const char recording_footer_magic[8] = { 'R', 'S', 'R', 'E', 'C', 'I', 'D', 'X' };
+static const uint32_t recording_chunk_magic = 0x4b4e4843;    // "CHNK"
+static const uint32_t recording_version = 2;      // 2 added the motion extrinsics
+
+enum recording_chunk_kind : uint32_t
+{
+    recording_chunk_image = 1,
+    recording_chunk_motion = 2
+};
+
+struct recording_stream_info
+{
+    uint32_t enabled;
+    uint32_t fps;
+    rs::core::image_info info;          // pitch is width * pixel size, rows are stored packed
+    rs::core::intrinsics intrinsics;
+};
+
+struct recording_file_header
+{
+    char magic[8];
+    uint32_t version;
+    uint32_t header_size;
+    char device_name[64];
+    recording_stream_info streams[recording_max_streams];
+    rs::core::extrinsics extrinsics[recording_max_streams][recording_max_streams];     // [from][to]
+    uint32_t motion_enabled;
+    uint32_t reserved;
+    rs::core::motion_device_intrinsics accel_intrinsics;
+    rs::core::motion_device_intrinsics gyro_intrinsics;
+    rs::core::extrinsics motion_extrinsics[recording_max_streams];     // from the motion module
+};
+
+struct recording_chunk_header
+{
+    uint32_t magic;
+    uint32_t kind;              // recording_chunk_kind
+    int32_t stream;             // stream_type of an image, motion_type of a motion sample
+    uint32_t size;              // payload size without the padding
+    double timestamp;
+    uint64_t frame_number;
+    int32_t timestamp_domain;
+    uint32_t reserved;
+};
+
+struct recording_index_entry
+{
+    double timestamp;
+    uint64_t offset;            // of the chunk header
+    uint64_t frame_number;
+    int32_t stream;
+    uint32_t kind;
+};
+
+struct recording_footer
+{
+    uint64_t index_offset;
+    uint64_t entry_count;
+    char magic[8];
+};
+
+inline bool operator<(const recording_index_entry& a, const recording_index_entry& b)
+{
+    return a.timestamp < b.timestamp;
+}
+
+// Appends chunks to a recording. The write calls are thread safe.
+class recording_writer
+{
+public:
+    recording_writer() : m_offset(0) {}
+
+    ~recording_writer()
+    {
+        close();
+    }
+
+    bool open(const std::string& path, const recording_file_header& header)
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_buffer.resize(1 << 20);
+        m_file.rdbuf()->pubsetbuf(m_buffer.data(), m_buffer.size());
+        m_file.open(path, std::ios::binary | std::ios::trunc);
+        if (!m_file)
+        {
+            return false;
+        }
+        m_header = header;
+        memcpy(m_header.magic, recording_file_magic, sizeof(m_header.magic));
+        m_header.version = recording_version;
+        m_header.header_size = sizeof(recording_file_header);
+        m_file.write(reinterpret_cast<const char*>(&m_header), sizeof(m_header));
+        m_offset = sizeof(m_header);
+        m_index.clear();
+        return (bool)m_file;
+    }
+
+    bool is_open() const
+    {
+        return m_file.is_open();
+    }
+
+    void write_image(const rs::core::image_interface* image)
+    {
+        const int stream = (int)image->query_stream_type();
+        const rs::core::image_info info = image->query_info();
+        const rs::core::image_info& recorded = m_header.streams[stream].info;
+        const int row_size = recorded.pitch;
+        if (info.width != recorded.width || info.height != recorded.height || info.format != recorded.format)
+        {
+            return;
+        }
+
+        std::lock_guard<std::mutex> lock(m_mutex);
+        if (!m_file.is_open())
+        {
+            return;
+        }
+        begin_chunk(recording_chunk_image, stream, image->query_time_stamp(), image->query_frame_number(),
+                    (int32_t)image->query_time_stamp_domain(), row_size * info.height);
+        const char* data = static_cast<const char*>(image->query_data());
+        if (info.pitch == row_size)
+        {
+            m_file.write(data, row_size * info.height);
+        }
+        else
+        {
+            for (int y = 0; y < info.height; ++y)
+            {
+                m_file.write(data + y * info.pitch, row_size);
+            }
+        }
+        end_chunk(row_size * info.height);
+    }
+
+    void write_motion(const rs::core::motion_sample& sample)
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        if (!m_file.is_open())
+        {
+            return;
+        }
+        begin_chunk(recording_chunk_motion, (int32_t)sample.type, sample.timestamp, sample.frame_number,
+                    (int32_t)rs::core::timestamp_domain::microcontroller, sizeof(sample.data));
+        m_file.write(reinterpret_cast<const char*>(sample.data), sizeof(sample.data));
+        end_chunk(sizeof(sample.data));
+    }
+
+    // Copies a chunk of another recording, the payload must match the stream in the header
+    void write_chunk(const recording_chunk_header& chunk, const void* payload)
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        if (!m_file.is_open())
+        {
+            return;
+        }
+        begin_chunk(chunk.kind, chunk.stream, chunk.timestamp, chunk.frame_number, chunk.timestamp_domain, chunk.size);
+        m_file.write(static_cast<const char*>(payload), chunk.size);
+        end_chunk(chunk.size);
+    }
+
+    // Writes the index and the footer
+    bool close()
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        if (!m_file.is_open())
+        {
+            return false;
+        }
+        // Samples of different streams arrive slightly out of order
+        std::stable_sort(m_index.begin(), m_index.end());
+        recording_footer footer = {};
+        footer.index_offset = m_offset;
+        footer.entry_count = m_index.size();
+        memcpy(footer.magic, recording_footer_magic, sizeof(footer.magic));
+        m_file.write(reinterpret_cast<const char*>(m_index.data()), m_index.size() * sizeof(recording_index_entry));
+        m_file.write(reinterpret_cast<const char*>(&footer), sizeof(footer));
+        bool ok = (bool)m_file;
+        m_file.close();
+        return ok;
+    }
+
+private:
+    void begin_chunk(uint32_t kind, int32_t stream, double timestamp, uint64_t frame_number, int32_t domain, uint32_t size)
+    {
+        recording_chunk_header chunk = {};
+        chunk.magic = recording_chunk_magic;
+        chunk.kind = kind;
+        chunk.stream = stream;
+        chunk.size = size;
+        chunk.timestamp = timestamp;
+        chunk.frame_number = frame_number;
+        chunk.timestamp_domain = domain;
+        m_file.write(reinterpret_cast<const char*>(&chunk), sizeof(chunk));
+
+        recording_index_entry entry = { timestamp, m_offset, frame_number, stream, kind };
+        m_index.push_back(entry);
+    }
+
+    void end_chunk(uint32_t size)
+    {
+        static const char padding[8] = {};
+        const uint32_t padded = (size + 7) & ~7u;
+        m_file.write(padding, padded - size);
+        m_offset += sizeof(recording_chunk_header) + padded;
+    }
+
+    std::mutex m_mutex;
+    std::vector<char> m_buffer;
+    std::ofstream m_file;
+    recording_file_header m_header;
+    uint64_t m_offset;
+    std::vector<recording_index_entry> m_index;
+};
+
+// Read only, memory mapped recording. Throws std::runtime_error if the file can't be read, or if
+// an entry of its index points to a chunk that isn't complete in the file.
+class recording_reader
+{
+public:
+    explicit recording_reader(const std::string& path) :
+        m_data(nullptr),
+        m_size(0),
+        m_entries(nullptr),
+        m_entry_count(0),
+        m_chunks_end(0),
+        m_complete(false)
+    {
+        int fd = ::open(path.c_str(), O_RDONLY);
+        if (fd < 0)
+        {
+            throw std::runtime_error("cannot open recording " + path);
+        }
+        struct stat st;
+        if (fstat(fd, &st) != 0 || st.st_size < (off_t)sizeof(recording_file_header))
+        {
+            ::close(fd);
+            throw std::runtime_error("not a recording: " + path);
+        }
+        m_size = st.st_size;
+        void* data = mmap(nullptr, m_size, PROT_READ, MAP_PRIVATE, fd, 0);
+        ::close(fd);
+        if (data == MAP_FAILED)
+        {
+            throw std::runtime_error("cannot map recording " + path);
+        }
+        m_data = static_cast<const uint8_t*>(data);
+
+        const recording_file_header& file_header = header();
+        if (memcmp(file_header.magic, recording_file_magic, sizeof(file_header.magic)) != 0 ||
+            file_header.version != recording_version || file_header.header_size != sizeof(recording_file_header))
+        {
+            munmap(const_cast<uint8_t*>(m_data), m_size);
+            throw std::runtime_error("not a recording or unsupported version: " + path);
+        }
+        if (!load_index())
+        {
+            rebuild_index();
+        }
+        else if (!is_valid_index())
+        {
+            munmap(const_cast<uint8_t*>(m_data), m_size);
+            throw std::runtime_error("corrupt recording index: " + path);
+        }
+    }
+
+    ~recording_reader()
+    {
+        munmap(const_cast<uint8_t*>(m_data), m_size);
+    }
+
+    recording_reader(const recording_reader&) = delete;
+    recording_reader& operator=(const recording_reader&) = delete;
+
+    const recording_file_header& header() const
+    {
+        return *reinterpret_cast<const recording_file_header*>(m_data);
+    }
+
+    // False if the recording had no index and it was rebuilt from the chunks
+    bool is_complete() const
+    {
+        return m_complete;
+    }
+
+    size_t entry_count() const
+    {
+        return m_entry_count;
+    }
+
+    const recording_index_entry& entry(size_t i) const
+    {
+        return m_entries[i];
+    }
+
+    const recording_chunk_header& chunk(size_t i) const
+    {
+        return *reinterpret_cast<const recording_chunk_header*>(m_data + m_entries[i].offset);
+    }
+
+    const void* payload(size_t i) const
+    {
+        return m_data + m_entries[i].offset + sizeof(recording_chunk_header);
+    }
+
+    // Index of the first entry at or after timestamp
+    size_t find(double timestamp) const
+    {
+        recording_index_entry key = {};
+        key.timestamp = timestamp;
+        return std::lower_bound(m_entries, m_entries + m_entry_count, key) - m_entries;
+    }
+
+    double get_begin_timestamp() const
+    {
+        return m_entry_count ? m_entries[0].timestamp : 0.0;
+    }
+
+    double get_end_timestamp() const
+    {
+        return m_entry_count ? m_entries[m_entry_count - 1].timestamp : 0.0;
+    }
+
+private:
+    bool load_index()
+    {
+        if (m_size < sizeof(recording_file_header) + sizeof(recording_footer))
+        {
+            return false;
+        }
+        // A truncated file ends anywhere, copy the footer instead of reading it unaligned
+        recording_footer footer;
+        memcpy(&footer, m_data + m_size - sizeof(recording_footer), sizeof(footer));
+        const uint64_t index_space = m_size - sizeof(recording_footer);
+        if (memcmp(footer.magic, recording_footer_magic, sizeof(footer.magic)) != 0 ||
+            footer.index_offset < sizeof(recording_file_header) || footer.index_offset > index_space ||
+            footer.entry_count > (index_space - footer.index_offset) / sizeof(recording_index_entry) ||
+            footer.index_offset + footer.entry_count * sizeof(recording_index_entry) != index_space ||
+            (footer.index_offset - sizeof(recording_file_header)) % 8 != 0)
+        {
+            return false;
+        }
+        m_entries = reinterpret_cast<const recording_index_entry*>(m_data + footer.index_offset);
+        m_entry_count = footer.entry_count;
+        m_chunks_end = footer.index_offset;
+        m_complete = true;
+        return true;
+    }
+
+    // True if every entry of the index points to a valid chunk before the index, of the same
+    // stream and kind as the entry
+    bool is_valid_index() const
+    {
+        for (size_t i = 0; i < m_entry_count; ++i)
+        {
+            const recording_index_entry& entry = m_entries[i];
+            if (!is_valid_chunk(entry.offset, m_chunks_end))
+            {
+                return false;
+            }
+            const recording_chunk_header& chunk = *reinterpret_cast<const recording_chunk_header*>(m_data + entry.offset);
+            if (chunk.kind != entry.kind || chunk.stream != entry.stream)
+            {
+                return false;
+            }
+        }
+        return true;
+    }
+
+    // True if a chunk that playback can hand out starts at offset and ends at or before end: an
+    // image of a recorded stream with a payload of the recorded size, or a motion sample
+    bool is_valid_chunk(uint64_t offset, uint64_t end) const
+    {
+        if (offset < sizeof(recording_file_header) || (offset - sizeof(recording_file_header)) % 8 != 0 ||
+            offset > end || end - offset < sizeof(recording_chunk_header))
+        {
+            return false;
+        }
+        const recording_chunk_header& chunk = *reinterpret_cast<const recording_chunk_header*>(m_data + offset);
+        const uint64_t padded = (uint64_t(chunk.size) + 7) & ~7ull;
+        if (chunk.magic != recording_chunk_magic || padded > end - offset - sizeof(recording_chunk_header))
+        {
+            return false;
+        }
+        if (chunk.kind == recording_chunk_motion)
+        {
+            return chunk.size >= sizeof(rs::core::motion_sample::data);
+        }
+        if (chunk.kind != recording_chunk_image || chunk.stream < 0 || chunk.stream >= (int)rs::core::stream_type::max)
+        {
+            return false;
+        }
+        const rs::core::image_info& info = header().streams[chunk.stream].info;
+        return info.pitch > 0 && info.height > 0 && chunk.size == uint64_t(info.pitch) * info.height;
+    }
+
+    // Walks the chunks up to the first incomplete or invalid one
+    void rebuild_index()
+    {
+        uint64_t offset = sizeof(recording_file_header);
+        while (is_valid_chunk(offset, m_size))
+        {
+            const recording_chunk_header& chunk = *reinterpret_cast<const recording_chunk_header*>(m_data + offset);
+            recording_index_entry entry = { chunk.timestamp, offset, chunk.frame_number, chunk.stream, chunk.kind };
+            m_rebuilt_index.push_back(entry);
+            offset += sizeof(recording_chunk_header) + ((uint64_t(chunk.size) + 7) & ~7ull);
+        }
+        std::stable_sort(m_rebuilt_index.begin(), m_rebuilt_index.end());
+        m_entries = m_rebuilt_index.data();
+        m_entry_count = m_rebuilt_index.size();
+    }
+
+    const uint8_t* m_data;
+    size_t m_size;
+    const recording_index_entry* m_entries;
+    size_t m_entry_count;
+    uint64_t m_chunks_end;      // offset of the index, chunks of an indexed recording end before it
+    std::vector<recording_index_entry> m_rebuilt_index;
+    bool m_complete;
+};
+
+// Records the samples of another source while passing them on to the callbacks
+class recording_frame_source : public frame_source
+{
+public:
+    recording_frame_source(std::unique_ptr<frame_source> source, const std::string& path) :
+        m_source(std::move(source)),
+        m_path(path),
+        m_header(),
+        m_motion_enabled(false)
+    {
+    }
+
+    ~recording_frame_source()
+    {
+        stop();
+    }
+
+    const char* get_name() const override
+    {
+        return m_source->get_name();
+    }
+
+    bool supports_stream(rs::core::stream_type stream, int width, int height, rs::core::pixel_format format, int fps) override
+    {
+        return pixel_format_size(format) > 0 && m_source->supports_stream(stream, width, height, format, fps);
+    }
+
+    bool enable_stream(rs::core::stream_type stream, int width, int height, rs::core::pixel_format format, int fps) override
+    {
+        if (pixel_format_size(format) == 0 || !m_source->enable_stream(stream, width, height, format, fps))
+        {
+            return false;
+        }
+        recording_stream_info& info = m_header.streams[(int)stream];
+        info.enabled = 1;
+        info.fps = fps;
+        info.info.width = width;
+        info.info.height = height;
+        info.info.format = format;
+        info.info.pitch = width * pixel_format_size(format);
+        return true;
+    }
+
+    void set_image_callback(rs::core::stream_type stream, image_callback callback) override
+    {
+        m_image_callbacks[(int)stream] = callback;
+    }
+
+    bool supports_motion() override
+    {
+        return m_source->supports_motion();
+    }
+
+    void enable_motion(motion_callback callback) override
+    {
+        m_motion_callback = callback;
+        m_motion_enabled = true;
+    }
+
+    rs::core::intrinsics get_intrinsics(rs::core::stream_type stream) override
+    {
+        return m_source->get_intrinsics(stream);
+    }
+
+    rs::core::extrinsics get_extrinsics(rs::core::stream_type from, rs::core::stream_type to) override
+    {
+        return m_source->get_extrinsics(from, to);
+    }
+
+    rs::core::motion_device_intrinsics get_motion_intrinsics(rs::core::motion_type motion) override
+    {
+        return m_source->get_motion_intrinsics(motion);
+    }
+
+    rs::core::extrinsics get_motion_extrinsics(rs::core::stream_type stream) override
+    {
+        return m_source->get_motion_extrinsics(stream);
+    }
+
+    // Throws std::runtime_error if the recording can't be created
+    void start() override
+    {
+        strncpy(m_header.device_name, m_source->get_name(), sizeof(m_header.device_name) - 1);
+        for (int from = 0; from < (int)rs::core::stream_type::max; ++from)
+        {
+            if (!m_header.streams[from].enabled)
+            {
+                continue;
+            }
+            m_header.streams[from].intrinsics = m_source->get_intrinsics((rs::core::stream_type)from);
+            for (int to = 0; to < (int)rs::core::stream_type::max; ++to)
+            {
+                if (m_header.streams[to].enabled)
+                {
+                    m_header.extrinsics[from][to] = m_source->get_extrinsics((rs::core::stream_type)from, (rs::core::stream_type)to);
+                }
+            }
+        }
+        m_header.motion_enabled = m_motion_enabled ? 1 : 0;
+        if (m_motion_enabled)
+        {
+            m_header.accel_intrinsics = m_source->get_motion_intrinsics(rs::core::motion_type::accel);
+            m_header.gyro_intrinsics = m_source->get_motion_intrinsics(rs::core::motion_type::gyro);
+            for (int i = 0; i < (int)rs::core::stream_type::max; ++i)
+            {
+                if (m_header.streams[i].enabled)
+                {
+                    m_header.motion_extrinsics[i] = m_source->get_motion_extrinsics((rs::core::stream_type)i);
+                }
+            }
+        }
+        if (!m_writer.open(m_path, m_header))
+        {
+            throw std::runtime_error("cannot create recording " + m_path);
+        }
+
+        // Every enabled stream is recorded, also the ones nobody consumes
+        for (int i = 0; i < (int)rs::core::stream_type::max; ++i)
+        {
+            if (!m_header.streams[i].enabled)
+            {
+                continue;
+            }
+            image_callback on_image = m_image_callbacks[i];
+            m_source->set_image_callback((rs::core::stream_type)i, [this, on_image](rs::core::image_interface* image)
+            {
+                m_writer.write_image(image);
+                if (on_image)
+                {
+                    on_image(image);
+                }
+            });
+        }
+        if (m_motion_enabled)
+        {
+            motion_callback on_motion = m_motion_callback;
+            m_source->enable_motion([this, on_motion](const rs::core::motion_sample& sample)
+            {
+                m_writer.write_motion(sample);
+                if (on_motion)
+                {
+                    on_motion(sample);
+                }
+            });
+        }
+        std::cout << "Recording to " << m_path << std::endl;
+        m_source->start();
+    }
+
+    void stop() override
+    {
+        m_source->stop();
+        if (m_writer.is_open() && !m_writer.close())
+        {
+            std::cerr << "error: failed to write recording " << m_path << std::endl;
+        }
+    }
+
+    bool is_streaming() override
+    {
+        return m_source->is_streaming();
+    }
+
+    bool is_real_time() const override
+    {
+        return m_source->is_real_time();
+    }
+
+    rs::device* get_device() override
+    {
+        return m_source->get_device();
+    }
+
+private:
+    std::unique_ptr<frame_source> m_source;
+    const std::string m_path;
+    recording_file_header m_header;
+    recording_writer m_writer;
+    image_callback m_image_callbacks[(int)rs::core::stream_type::max];
+    motion_callback m_motion_callback;
+    bool m_motion_enabled;
+};
+
+struct playback_config
+{
+    playback_config() :
+        speed(1.0),
+        loop(false)
+    {
+    }
+
+    double speed;   // 1 is real time, 0.5 half speed, 0 as fast as the images are consumed
+    bool loop;      // restart at the beginning at the end of the recording
+};
+
+// Plays a recording back as if it were the camera. Images point into the mapped file.
+//
+// Looping keeps timestamps and frame numbers increasing, each pass is shifted by the length
+// of the recording. seek() jumps to a recorded timestamp, so timestamps go back on a backward seek.
+class playback_frame_source : public frame_source
+{
+public:
+    // Throws std::runtime_error if the file isn't a recording
+    explicit playback_frame_source(const std::string& path, const playback_config& config = playback_config()) :
+        m_reader(std::make_shared<recording_reader>(path)),
+        m_speed(config.speed),
+        m_loop(config.loop),
+        m_streaming(false),
+        m_motion_enabled(false),
+        m_seek_pending(false),
+        m_seek_timestamp(0.0),
+        m_speed_changed(false),
+        m_position(m_reader->get_begin_timestamp())
+    {
+        for (auto& enabled : m_enabled)
+        {
+            enabled = false;
+        }
+        if (!m_reader->is_complete())
+        {
+            std::cerr << "warning: recording " << path << " has no index, it was not closed properly" << std::endl;
+        }
+    }
+
+    ~playback_frame_source()
+    {
+        stop();
+    }
+
+    const char* get_name() const override
+    {
+        return m_reader->header().device_name;
+    }
+
+    // Only the recorded modes are supported, at any frame rate
+    bool supports_stream(rs::core::stream_type stream, int width, int height, rs::core::pixel_format format, int fps) override
+    {
+        if ((int)stream >= (int)rs::core::stream_type::max)
+        {
+            return false;
+        }
+        const recording_stream_info& recorded = m_reader->header().streams[(int)stream];
+        return recorded.enabled && recorded.info.width == width && recorded.info.height == height && recorded.info.format == format;
+    }
+
+    bool enable_stream(rs::core::stream_type stream, int width, int height, rs::core::pixel_format format, int fps) override
+    {
+        if (!supports_stream(stream, width, height, format, fps))
+        {
+            return false;
+        }
+        m_enabled[(int)stream] = true;
+        return true;
+    }
+
+    void set_image_callback(rs::core::stream_type stream, image_callback callback) override
+    {
+        m_image_callbacks[(int)stream] = callback;
+    }
+
+    bool supports_motion() override
+    {
+        return m_reader->header().motion_enabled != 0;
+    }
+
+    void enable_motion(motion_callback callback) override
+    {
+        m_motion_callback = callback;
+        m_motion_enabled = true;
+    }
+
+    rs::core::intrinsics get_intrinsics(rs::core::stream_type stream) override
+    {
+        return m_reader->header().streams[(int)stream].intrinsics;
+    }
+
+    rs::core::extrinsics get_extrinsics(rs::core::stream_type from, rs::core::stream_type to) override
+    {
+        return m_reader->header().extrinsics[(int)from][(int)to];
+    }
+
+    rs::core::motion_device_intrinsics get_motion_intrinsics(rs::core::motion_type motion) override
+    {
+        return motion == rs::core::motion_type::accel ? m_reader->header().accel_intrinsics : m_reader->header().gyro_intrinsics;
+    }
+
+    rs::core::extrinsics get_motion_extrinsics(rs::core::stream_type stream) override
+    {
+        return m_reader->header().motion_extrinsics[(int)stream];
+    }
+
+    void start() override
+    {
+        if (m_streaming)
+        {
+            return;
+        }
+        m_streaming = true;
+        m_thread = std::thread(&playback_frame_source::run, this);
+    }
+
+    void stop() override
+    {
+        m_streaming = false;
+        if (m_thread.joinable())
+        {
+            m_thread.join();
+        }
+    }
+
+    bool is_streaming() override
+    {
+        return m_streaming;
+    }
+
+    bool is_real_time() const override
+    {
+        return m_speed.load() > 0.0;
+    }
+
+    // Continues playback at the first sample at or after the recorded timestamp
+    void seek(double timestamp)
+    {
+        std::lock_guard<std::mutex> lock(m_control_mutex);
+        m_seek_timestamp = timestamp;
+        m_seek_pending = true;
+    }
+
+    // 1 is real time, 0 as fast as the images are consumed
+    void set_speed(double speed)
+    {
+        std::lock_guard<std::mutex> lock(m_control_mutex);
+        m_speed = speed;
+        m_speed_changed = true;
+    }
+
+    // Recorded timestamp of the last sample played
+    double get_position() const
+    {
+        return m_position;
+    }
+
+    const recording_reader& get_reader() const
+    {
+        return *m_reader;
+    }
+
+private:
+    // Keeps the mapping alive while a played image is in use
+    class mapping_releaser : public rs::core::release_interface
+    {
+    public:
+        explicit mapping_releaser(std::shared_ptr<const recording_reader> reader) : m_reader(std::move(reader)) {}
+
+        int release() const override
+        {
+            delete this;
+            return 0;
+        }
+
+    private:
+        std::shared_ptr<const recording_reader> m_reader;
+    };
+
+    bool wanted(const recording_index_entry& entry) const
+    {
+        if (entry.kind == recording_chunk_image)
+        {
+            return entry.stream >= 0 && entry.stream < (int)rs::core::stream_type::max &&
+                   m_enabled[entry.stream] && m_image_callbacks[entry.stream];
+        }
+        return entry.kind == recording_chunk_motion && m_motion_enabled && m_motion_callback;
+    }
+
+    void run()
+    {
+        const size_t count = m_reader->entry_count();
+        const double begin = m_reader->get_begin_timestamp();
+        // Length of one pass, with one average sample interval so passes don't overlap
+        const double pass_length = count > 1 ? (m_reader->get_end_timestamp() - begin) * count / (count - 1) : 1.0;
+        uint64_t frame_span = 0;
+        for (size_t i = 0; i < count; ++i)
+        {
+            frame_span = std::max(frame_span, m_reader->entry(i).frame_number + 1);
+        }
+
+        size_t i = 0;
+        uint64_t pass = 0;
+        double anchor_timestamp = begin;
+        auto anchor_time = std::chrono::steady_clock::now();
+
+        while (m_streaming)
+        {
+            {
+                std::lock_guard<std::mutex> lock(m_control_mutex);
+                if (m_seek_pending)
+                {
+                    i = m_reader->find(m_seek_timestamp);
+                    anchor_timestamp = m_seek_timestamp;
+                    anchor_time = std::chrono::steady_clock::now();
+                    m_seek_pending = false;
+                }
+                else if (m_speed_changed)
+                {
+                    // Pace from the last sample played
+                    anchor_timestamp = m_position;
+                    anchor_time = std::chrono::steady_clock::now();
+                }
+                m_speed_changed = false;
+            }
+            if (i >= count)
+            {
+                if (!m_loop || count == 0)
+                {
+                    break;
+                }
+                i = 0;
+                ++pass;
+                anchor_timestamp -= pass_length;
+            }
+
+            const recording_index_entry& entry = m_reader->entry(i++);
+            if (!wanted(entry))
+            {
+                continue;
+            }
+
+            const double speed = m_speed;
+            if (speed > 0.0)
+            {
+                std::this_thread::sleep_until(anchor_time + std::chrono::microseconds((int64_t)((entry.timestamp - anchor_timestamp) * 1000.0 / speed)));
+            }
+            m_position = entry.timestamp;
+            play(i - 1, entry.timestamp + pass * pass_length, entry.frame_number + pass * frame_span);
+        }
+        m_streaming = false;
+    }
+
+    void play(size_t index, double timestamp, uint64_t frame_number)
+    {
+        const recording_chunk_header& chunk = m_reader->chunk(index);
+        if (chunk.kind == recording_chunk_motion)
+        {
+            rs::core::motion_sample sample = {};
+            sample.type = (rs::core::motion_type)chunk.stream;
+            sample.timestamp = timestamp;
+            sample.frame_number = frame_number;
+            memcpy(sample.data, m_reader->payload(index), sizeof(sample.data));
+            m_motion_callback(sample);
+            return;
+        }
+
+        rs::core::image_info info = m_reader->header().streams[chunk.stream].info;
+        auto image = rs::core::image_interface::create_instance_from_raw_data(
+                         &info,
+                         rs::core::image_interface::image_data_with_data_releaser(m_reader->payload(index), new mapping_releaser(m_reader)),
+                         (rs::core::stream_type)chunk.stream,
+                         rs::core::image_interface::flag::any,
+                         timestamp,
+                         frame_number,
+                         (rs::core::timestamp_domain)chunk.timestamp_domain);
+        m_image_callbacks[chunk.stream](image);
+        image->release();
+    }
+
+    std::shared_ptr<recording_reader> m_reader;
+    std::atomic<double> m_speed;
+    const bool m_loop;
+    std::atomic<bool> m_streaming;
+    bool m_enabled[(int)rs::core::stream_type::max];
+    image_callback m_image_callbacks[(int)rs::core::stream_type::max];
+    motion_callback m_motion_callback;
+    bool m_motion_enabled;
+    std::mutex m_control_mutex;
+    bool m_seek_pending;
+    double m_seek_timestamp;
+    bool m_speed_changed;
+    std::atomic<double> m_position;
+    std::thread m_thread;
+};
+
+// Copies the samples of a recording between two recorded timestamps into a new recording.
+// Returns the number of samples copied.
+inline size_t cut_recording(const recording_reader& reader, const std::string& path, double begin_timestamp, double end_timestamp)
+{
+    recording_writer writer;
+    if (!writer.open(path, reader.header()))
+    {
+        throw std::runtime_error("cannot create recording " + path);
+    }
+    size_t copied = 0;
+    for (size_t i = reader.find(begin_timestamp); i < reader.entry_count() && reader.entry(i).timestamp <= end_timestamp; ++i)
+    {
+        writer.write_chunk(reader.chunk(i), reader.payload(i));
+        ++copied;
+    }
+    if (!writer.close())
+    {
+        throw std::runtime_error("failed to write recording " + path);
+    }
+    return copied;
+}
@@ -0,0 +1,154 @@
+// License: Apache 2.0. See LICENSE file in root directory.
+// Copyright(c) 2017 Intel Corporation. All Rights Reserved.
+
+#pragma once
+
+#include <atomic>
+#include <cmath>
+#include <cstdint>
+#include <limits>
+#include <mutex>
+
+// Summary of a streaming_stats instance at one point in time
+struct stats_snapshot
+{
+    uint64_t count;
+    double mean;
+    double stddev;
+    double min;
+    double max;
+    double p50;
+    double p90;
+    double p99;
+};
+
+// Constant-memory running statistics: Welford mean/variance, min/max and a fixed log-scale
+// histogram for percentiles. record() doesn't allocate and can be called from several threads;
+// the histogram is updated with atomics and the moments under a mutex, which is held for a few
+// arithmetic operations only.
+//
+// The histogram covers [min_value, min_value * 2^octaves) with sub_buckets buckets per octave,
+// so percentiles are accurate to about 2^(1/sub_buckets) relative error (~9% with 8 sub-buckets).
+// Values below the range (including zero and negative values) go to the first bucket, values
+// above it to the last.
+class streaming_stats
+{
+public:
+    static const int octaves = 24;
+    static const int sub_buckets = 8;
+    static const int bucket_count = octaves * sub_buckets;
+
+    explicit streaming_stats(double min_value = 0.01) :
+        m_min_value(min_value),
+        m_count(0),
+        m_mean(0.0),
+        m_m2(0.0),
+        m_min(std::numeric_limits<double>::max()),
+        m_max(std::numeric_limits<double>::lowest())
+    {
+        for (int i = 0; i < bucket_count; ++i)
+        {
+            m_buckets[i] = 0;
+        }
+    }
+
+    streaming_stats(const streaming_stats&) = delete;
+    streaming_stats& operator=(const streaming_stats&) = delete;
+
+    void record(double value)
+    {
+        m_buckets[bucket_index(value)].fetch_add(1, std::memory_order_relaxed);
+
+        std::lock_guard<std::mutex> lock(m_mutex);
+        ++m_count;
+        double delta = value - m_mean;
+        m_mean += delta / m_count;
+        m_m2 += delta * (value - m_mean);
+        if (value < m_min)
+        {
+            m_min = value;
+        }
+        if (value > m_max)
+        {
+            m_max = value;
+        }
+    }
+
+    stats_snapshot snapshot() const
+    {
+        stats_snapshot s = {};
+
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            s.count = m_count;
+            s.mean = m_mean;
+            s.stddev = m_count > 1 ? std::sqrt(m_m2 / m_count) : 0.0;
+            s.min = m_count ? m_min : 0.0;
+            s.max = m_count ? m_max : 0.0;
+        }
+
+        s.p50 = percentile(0.50);
+        s.p90 = percentile(0.90);
+        s.p99 = percentile(0.99);
+        return s;
+    }
+
+    // Approximate value below which the given fraction (0..1) of the samples fall
+    double percentile(double fraction) const
+    {
+        uint64_t counts[bucket_count];
+        uint64_t total = 0;
+        for (int i = 0; i < bucket_count; ++i)
+        {
+            counts[i] = m_buckets[i].load(std::memory_order_relaxed);
+            total += counts[i];
+        }
+        if (total == 0)
+        {
+            return 0.0;
+        }
+
+        uint64_t rank = static_cast<uint64_t>(std::ceil(fraction * total));
+        if (rank == 0)
+        {
+            rank = 1;
+        }
+        uint64_t seen = 0;
+        for (int i = 0; i < bucket_count; ++i)
+        {
+            seen += counts[i];
+            if (seen >= rank)
+            {
+                return bucket_value(i);
+            }
+        }
+        return bucket_value(bucket_count - 1);
+    }
+
+private:
+    int bucket_index(double value) const
+    {
+        if (!(value > m_min_value))
+        {
+            return 0;
+        }
+        int index = static_cast<int>(std::log2(value / m_min_value) * sub_buckets);
+        return index < bucket_count ? index : bucket_count - 1;
+    }
+
+    // Geometric middle of the bucket
+    double bucket_value(int index) const
+    {
+        return m_min_value * std::exp2((index + 0.5) / sub_buckets);
+    }
+
+    const double m_min_value;
+    std::atomic<uint64_t> m_buckets[bucket_count];
+
+    mutable std::mutex m_mutex;
+    uint64_t m_count;
+    double m_mean;
+    double m_m2;
+    double m_min;
+    double m_max;
+};
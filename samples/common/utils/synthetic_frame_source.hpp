@@ -0,0 +1,385 @@
+// License: Apache 2.0. See LICENSE file in root directory.
+// Copyright(c) 2017 Intel Corporation. All Rights Reserved.
+
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <cstring>
+#include <thread>
+
+#include "frame_source.hpp"
+
+struct synthetic_source_config
+{
+    synthetic_source_config() :
+        speed(1.0),
+        start_timestamp_ms(1000.0),
+        duration_ms(0.0),
+        accel_rate(250),
+        gyro_rate(200),
+        seed(1)
+    {
+    }
+
+    double speed;               // 1 is real time, 2 twice as fast, 0 as fast as the images are consumed
+    double start_timestamp_ms;  // timestamp of the first samples
+    double duration_ms;         // stream time after which the source stops, 0 to run until stop()
+    int accel_rate;             // samples per second
+    int gyro_rate;
+    uint32_t seed;              // seeds the image textures
+};
+
+// Deterministic stand-in for the camera. Every enabled stream runs at exactly its frame rate,
+// with timestamps in milliseconds on the shared (microcontroller) clock domain and consecutive
+// frame numbers, so two runs with the same configuration produce the same samples:
+//  - color: gradient with a square moving across it
+//  - depth: floor-like ramp from 1 to 3 m with a box at 0.8 m moving across it
+//  - fisheye / infrared: fixed noise texture panning sideways, so trackers find features
+//  - accel: gravity plus a small sway, gyro: slow rotation rates
+// All samples come from one thread in timestamp order.
+class synthetic_frame_source : public frame_source
+{
+public:
+    explicit synthetic_frame_source(const synthetic_source_config& config = synthetic_source_config()) :
+        m_config(config),
+        m_streaming(false)
+    {
+    }
+
+    ~synthetic_frame_source()
+    {
+        stop();
+    }
+
+    const char* get_name() const override
+    {
+        return "Synthetic ZR300";
+    }
+
+    bool supports_stream(rs::core::stream_type stream, int width, int height, rs::core::pixel_format format, int fps) override
+    {
+        return (int)stream < (int)rs::core::stream_type::max && width > 0 && height > 0 && fps > 0 && pixel_format_size(format) > 0;
+    }
+
+    bool enable_stream(rs::core::stream_type stream, int width, int height, rs::core::pixel_format format, int fps) override
+    {
+        if (!supports_stream(stream, width, height, format, fps))
+        {
+            return false;
+        }
+        stream_state& state = m_streams[(int)stream];
+        state.enabled = true;
+        state.info.width = width;
+        state.info.height = height;
+        state.info.format = format;
+        state.info.pitch = width * pixel_format_size(format);
+        state.fps = fps;
+        return true;
+    }
+
+    void set_image_callback(rs::core::stream_type stream, image_callback callback) override
+    {
+        m_streams[(int)stream].callback = callback;
+    }
+
+    bool supports_motion() override
+    {
+        return true;
+    }
+
+    void enable_motion(motion_callback callback) override
+    {
+        m_motion_callback = callback;
+    }
+
+    rs::core::intrinsics get_intrinsics(rs::core::stream_type stream) override
+    {
+        const stream_state& state = m_streams[(int)stream];
+        rs::core::intrinsics intrinsics = {};
+        intrinsics.width = state.info.width;
+        intrinsics.height = state.info.height;
+        intrinsics.ppx = state.info.width / 2.0f;
+        intrinsics.ppy = state.info.height / 2.0f;
+        if (stream == rs::core::stream_type::fisheye)
+        {
+            // ~165 degree field of view, f-theta model like the ZR300 fisheye
+            intrinsics.fx = intrinsics.fy = state.info.width * 0.27f;
+            intrinsics.model = rs::core::distortion_type::distortion_ftheta;
+            intrinsics.coeffs[0] = 0.92f;
+        }
+        else
+        {
+            // ~60 degree horizontal field of view
+            intrinsics.fx = intrinsics.fy = state.info.width * 0.87f;
+            intrinsics.model = rs::core::distortion_type::none;
+        }
+        return intrinsics;
+    }
+
+    rs::core::extrinsics get_extrinsics(rs::core::stream_type from, rs::core::stream_type to) override
+    {
+        // Sensors side by side on the x axis, all facing the same way
+        rs::core::extrinsics extrinsics = {};
+        extrinsics.rotation[0] = extrinsics.rotation[4] = extrinsics.rotation[8] = 1.0f;
+        extrinsics.translation[0] = sensor_offset_m(from) - sensor_offset_m(to);
+        return extrinsics;
+    }
+
+    rs::core::motion_device_intrinsics get_motion_intrinsics(rs::core::motion_type motion) override
+    {
+        rs::core::motion_device_intrinsics intrinsics = {};
+        for (int i = 0; i < 3; ++i)
+        {
+            intrinsics.data[i][i] = 1.0f;
+            intrinsics.noise_variances[i] = motion == rs::core::motion_type::accel ? 1e-4f : 1e-6f;
+            intrinsics.bias_variances[i] = motion == rs::core::motion_type::accel ? 1e-6f : 1e-8f;
+        }
+        return intrinsics;
+    }
+
+    rs::core::extrinsics get_motion_extrinsics(rs::core::stream_type stream) override
+    {
+        // The IMU sits with the depth sensor
+        return get_extrinsics(rs::core::stream_type::depth, stream);
+    }
+
+    void start() override
+    {
+        if (m_streaming)
+        {
+            return;
+        }
+        m_streaming = true;
+        m_thread = std::thread(&synthetic_frame_source::run, this);
+    }
+
+    void stop() override
+    {
+        m_streaming = false;
+        if (m_thread.joinable())
+        {
+            m_thread.join();
+        }
+    }
+
+    bool is_streaming() override
+    {
+        return m_streaming;
+    }
+
+    bool is_real_time() const override
+    {
+        return m_config.speed > 0.0;
+    }
+
+private:
+    struct stream_state
+    {
+        stream_state() : enabled(false), fps(0), info() {}
+
+        bool enabled;
+        int fps;
+        rs::core::image_info info;
+        image_callback callback;
+    };
+
+    // Frees the pixels of a synthetic image when the image is released
+    class buffer_releaser : public rs::core::release_interface
+    {
+    public:
+        explicit buffer_releaser(uint8_t* data) : m_data(data) {}
+
+        int release() const override
+        {
+            delete[] m_data;
+            delete this;
+            return 0;
+        }
+
+    private:
+        uint8_t* m_data;
+    };
+
+    static const int source_count = (int)rs::core::stream_type::max + 2;
+
+    static float sensor_offset_m(rs::core::stream_type stream)
+    {
+        switch (stream)
+        {
+        case rs::core::stream_type::color:
+            return 0.025f;
+        case rs::core::stream_type::infrared2:
+            return 0.07f;
+        case rs::core::stream_type::fisheye:
+            return -0.03f;
+        default:
+            return 0.0f;
+        }
+    }
+
+    // Period in ms of source index i: the image streams, then accel and gyro
+    double period_ms(int i) const
+    {
+        if (i < (int)rs::core::stream_type::max)
+        {
+            return m_streams[i].enabled && m_streams[i].callback ? 1000.0 / m_streams[i].fps : 0.0;
+        }
+        if (!m_motion_callback)
+        {
+            return 0.0;
+        }
+        int rate = i == (int)rs::core::stream_type::max ? m_config.accel_rate : m_config.gyro_rate;
+        return rate > 0 ? 1000.0 / rate : 0.0;
+    }
+
+    void run()
+    {
+        uint64_t counts[source_count] = {};
+        const auto start_time = std::chrono::steady_clock::now();
+
+        while (m_streaming)
+        {
+            // Next sample in timestamp order, ties go to the lower index. Timestamps are
+            // computed from the sample count so they don't drift.
+            int next = -1;
+            double next_offset_ms = 0.0;
+            for (int i = 0; i < source_count; ++i)
+            {
+                double period = period_ms(i);
+                if (period <= 0.0)
+                {
+                    continue;
+                }
+                double offset_ms = counts[i] * period;
+                if (next < 0 || offset_ms < next_offset_ms)
+                {
+                    next = i;
+                    next_offset_ms = offset_ms;
+                }
+            }
+            if (next < 0 || (m_config.duration_ms > 0.0 && next_offset_ms >= m_config.duration_ms))
+            {
+                break;
+            }
+
+            if (m_config.speed > 0.0)
+            {
+                std::this_thread::sleep_until(start_time + std::chrono::microseconds((int64_t)(next_offset_ms * 1000.0 / m_config.speed)));
+            }
+
+            const double timestamp = m_config.start_timestamp_ms + next_offset_ms;
+            if (next < (int)rs::core::stream_type::max)
+            {
+                emit_image((rs::core::stream_type)next, counts[next], timestamp);
+            }
+            else
+            {
+                emit_motion(next == (int)rs::core::stream_type::max ? rs::core::motion_type::accel : rs::core::motion_type::gyro,
+                            counts[next], timestamp);
+            }
+            ++counts[next];
+        }
+        m_streaming = false;
+    }
+
+    void emit_image(rs::core::stream_type stream, uint64_t frame_number, double timestamp)
+    {
+        stream_state& state = m_streams[(int)stream];
+        rs::core::image_info info = state.info;
+        uint8_t* data = new uint8_t[info.pitch * info.height];
+        fill_image(info, frame_number, data);
+
+        auto image = rs::core::image_interface::create_instance_from_raw_data(
+                         &info,
+                         rs::core::image_interface::image_data_with_data_releaser(data, new buffer_releaser(data)),
+                         stream,
+                         rs::core::image_interface::flag::any,
+                         timestamp,
+                         frame_number,
+                         rs::core::timestamp_domain::microcontroller);
+        state.callback(image);
+        image->release();
+    }
+
+    void emit_motion(rs::core::motion_type type, uint64_t frame_number, double timestamp)
+    {
+        const double t = (timestamp - m_config.start_timestamp_ms) / 1000.0;
+        rs::core::motion_sample sample = {};
+        sample.type = type;
+        sample.timestamp = timestamp;
+        sample.frame_number = frame_number;
+        if (type == rs::core::motion_type::accel)
+        {
+            sample.data[0] = (float)(0.05 * std::sin(2.0 * M_PI * 0.5 * t));
+            sample.data[1] = -9.81f;
+            sample.data[2] = (float)(0.05 * std::cos(2.0 * M_PI * 0.5 * t));
+        }
+        else
+        {
+            sample.data[0] = (float)(0.01 * std::sin(2.0 * M_PI * 0.2 * t));
+            sample.data[1] = (float)(0.05 * std::sin(2.0 * M_PI * 0.1 * t));
+            sample.data[2] = 0.0f;
+        }
+        m_motion_callback(sample);
+    }
+
+    // Deterministic texture value of a pixel
+    uint8_t texture(int x, int y) const
+    {
+        uint32_t h = (uint32_t)x * 73856093u ^ (uint32_t)y * 19349663u ^ m_config.seed * 83492791u;
+        h ^= h >> 13;
+        h *= 0x5bd1e995u;
+        h ^= h >> 15;
+        return (uint8_t)h;
+    }
+
+    void fill_image(const rs::core::image_info& info, uint64_t frame_number, uint8_t* data) const
+    {
+        const int w = info.width;
+        const int h = info.height;
+        const int size = pixel_format_size(info.format);
+        // Square/box moving across the image, once every 4 seconds at 30 fps
+        const int box = std::max(8, h / 6);
+        const int box_x = (int)((frame_number * 4) % (uint64_t)std::max(1, w - box));
+        const int box_y = h / 2 - box / 2;
+
+        for (int y = 0; y < h; ++y)
+        {
+            uint8_t* row = data + y * info.pitch;
+            for (int x = 0; x < w; ++x)
+            {
+                const bool in_box = x >= box_x && x < box_x + box && y >= box_y && y < box_y + box;
+                uint8_t* pixel = row + x * size;
+                if (info.format == rs::core::pixel_format::z16)
+                {
+                    uint16_t depth_mm = in_box ? 800 : (uint16_t)(3000 - 2000 * y / h);
+                    memcpy(pixel, &depth_mm, sizeof(depth_mm));
+                }
+                else if (size >= 3)
+                {
+                    pixel[0] = in_box ? 255 : (uint8_t)(x * 255 / w);
+                    pixel[1] = in_box ? 255 : (uint8_t)(y * 255 / h);
+                    pixel[2] = in_box ? 255 : (uint8_t)(frame_number * 2);
+                    if (size == 4)
+                    {
+                        pixel[3] = 255;
+                    }
+                }
+                else
+                {
+                    // Fisheye and infrared: panning texture
+                    memset(pixel, texture(x + (int)frame_number, y), size);
+                }
+            }
+        }
+    }
+
+    const synthetic_source_config m_config;
+    stream_state m_streams[(int)rs::core::stream_type::max];
+    motion_callback m_motion_callback;
+    std::atomic<bool> m_streaming;
+    std::thread m_thread;
+};
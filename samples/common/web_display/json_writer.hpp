@@ -0,0 +1,536 @@
+// License: Apache 2.0. See LICENSE file in root directory.
+// Copyright(c) 2017 Intel Corporation. All Rights Reserved.
+
+#pragma once
+
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <memory>
+#include <mutex>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+namespace web_display
+{
+
+// Appends JSON to a string as it is written, without building a document first.
+//
+// Numbers are written in the shortest form that reads back to the same value, independent of the
+// locale; floats are formatted as floats, so 0.88f is written as 0.88 and not as the double it
+// widens to. NaN and infinity have no JSON form and are written as null.
+//
+// The digit searches of the common magnitudes start at 6 significant digits for floats and 15 for
+// doubles: every shorter decimal that reads back lies closer to the value than half a step of that
+// many digits, so it is the rounding to 6 (or 15) digits with the trailing zeros dropped.
+class json_writer
+{
+public:
+    explicit json_writer(std::string& out) : m_out(out), m_depth(0), m_after_key(false)
+    {
+        m_first[0] = true;
+    }
+
+    json_writer& begin_object()
+    {
+        separator();
+        m_out += '{';
+        push();
+        return *this;
+    }
+
+    json_writer& end_object()
+    {
+        pop();
+        m_out += '}';
+        return *this;
+    }
+
+    json_writer& begin_array()
+    {
+        separator();
+        m_out += '[';
+        push();
+        return *this;
+    }
+
+    json_writer& end_array()
+    {
+        pop();
+        m_out += ']';
+        return *this;
+    }
+
+    json_writer& key(const char* name)
+    {
+        separator();
+        append_string(name);
+        m_out += ':';
+        m_after_key = true;
+        return *this;
+    }
+
+    json_writer& value(const std::string& text)
+    {
+        separator();
+        append_string(text.c_str(), text.size());
+        return *this;
+    }
+
+    json_writer& value(const char* text)
+    {
+        separator();
+        append_string(text);
+        return *this;
+    }
+
+    json_writer& value(bool flag)
+    {
+        separator();
+        m_out += flag ? "true" : "false";
+        return *this;
+    }
+
+    json_writer& value(int number)
+    {
+        return value(static_cast<long long>(number));
+    }
+
+    json_writer& value(unsigned int number)
+    {
+        return value(static_cast<unsigned long long>(number));
+    }
+
+    json_writer& value(long number)
+    {
+        return value(static_cast<long long>(number));
+    }
+
+    json_writer& value(unsigned long number)
+    {
+        return value(static_cast<unsigned long long>(number));
+    }
+
+    json_writer& value(long long number)
+    {
+        separator();
+        if (number < 0)
+        {
+            m_out += '-';
+            append_unsigned(0 - static_cast<uint64_t>(number));
+        }
+        else
+        {
+            append_unsigned(static_cast<uint64_t>(number));
+        }
+        return *this;
+    }
+
+    json_writer& value(unsigned long long number)
+    {
+        separator();
+        append_unsigned(number);
+        return *this;
+    }
+
+    json_writer& value(float number)
+    {
+        separator();
+        append_float(number);
+        return *this;
+    }
+
+    json_writer& value(double number)
+    {
+        separator();
+        append_double(number);
+        return *this;
+    }
+
+    json_writer& null()
+    {
+        separator();
+        m_out += "null";
+        return *this;
+    }
+
+    template<typename T>
+    json_writer& field(const char* name, const T& v)
+    {
+        key(name);
+        return value(v);
+    }
+
+    // name: [values[0], ..., values[count - 1]]
+    template<typename T>
+    json_writer& array(const char* name, const T* values, size_t count)
+    {
+        key(name);
+        begin_array();
+        for (size_t i = 0; i < count; ++i)
+        {
+            value(values[i]);
+        }
+        return end_array();
+    }
+
+private:
+    static const int max_depth = 16;
+
+    void separator()
+    {
+        if (m_after_key)
+        {
+            m_after_key = false;
+            return;
+        }
+        if (!m_first[m_depth])
+        {
+            m_out += ',';
+        }
+        m_first[m_depth] = false;
+    }
+
+    void push()
+    {
+        if (++m_depth == max_depth)
+        {
+            throw std::length_error("json_writer: nesting too deep");
+        }
+        m_first[m_depth] = true;
+    }
+
+    void pop()
+    {
+        --m_depth;
+    }
+
+    void append_unsigned(uint64_t number)
+    {
+        char digits[20];
+        int count = 0;
+        do
+        {
+            digits[count++] = static_cast<char>('0' + number % 10);
+            number /= 10;
+        }
+        while (number);
+        while (count)
+        {
+            m_out += digits[--count];
+        }
+    }
+
+    // printf formats with the decimal separator of the locale, JSON always uses a point
+    void append_number(const char* text, int length)
+    {
+        for (int i = 0; i < length; ++i)
+        {
+            m_out += text[i] == ',' ? '.' : text[i];
+        }
+    }
+
+    void append_float(float number)
+    {
+        if (!std::isfinite(number))
+        {
+            m_out += "null";
+            return;
+        }
+        if (number == 0.0f)
+        {
+            m_out += std::signbit(number) ? "-0" : "0";
+            return;
+        }
+        if (append_float_digits(number))
+        {
+            return;
+        }
+        char text[32];
+        int length = 0;
+        for (int precision = 1; precision <= 9; ++precision)
+        {
+            length = std::snprintf(text, sizeof(text), "%.*g", precision, number);
+            if (std::strtof(text, nullptr) == number)
+            {
+                break;
+            }
+        }
+        append_number(text, length);
+    }
+
+    // Finds the fewest significant digits that read back as number with double arithmetic, which
+    // holds every float and every power of ten used here exactly. Returns false for magnitudes
+    // outside of that range, which are left to printf.
+    bool append_float_digits(float number)
+    {
+        static const double powers[] = { 1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, 1e10, 1e11,
+                                         1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22 };
+        double value = std::fabs(static_cast<double>(number));
+        if (value < 1e-12 || value >= 1e12)
+        {
+            return false;
+        }
+
+        // value is d.ddd * 10^exponent, log10 may be off by one next to a power of ten
+        int exponent = static_cast<int>(std::floor(std::log10(value)));
+        if (exponent >= 0 ? value >= powers[exponent + 1] : value * powers[-exponent - 1] >= 1.0)
+        {
+            ++exponent;
+        }
+        else if (exponent >= 0 ? value < powers[exponent] : value * powers[-exponent] < 1.0)
+        {
+            --exponent;
+        }
+
+        for (int precision = 6; precision <= 9; ++precision)
+        {
+            // digits = value / 10^(exponent - precision + 1), rounded
+            int scale = exponent - precision + 1;
+            double scaled = scale >= 0 ? value / powers[scale] : value * powers[-scale];
+            uint64_t digits = static_cast<uint64_t>(scaled + 0.5);
+            // Only a division by a power of ten can round the decimal
+            double decimal = scale >= 0 ? digits * powers[scale] : digits / powers[-scale];
+            if (!reads_back_as(decimal, scale >= 0, value))
+            {
+                continue;
+            }
+
+            int digits_exponent = exponent;
+            if (digits == static_cast<uint64_t>(powers[precision]))
+            {
+                // Rounded up to the next power of ten
+                digits /= 10;
+                ++digits_exponent;
+            }
+            if (number < 0)
+            {
+                m_out += '-';
+            }
+            append_digits(digits, precision, digits_exponent);
+            return true;
+        }
+        return false;
+    }
+
+    // Whether decimal, which may be rounded to the double closest to it unless exact, reads back as
+    // the float value. A rounded decimal reads back as the float closest to it, unless the double
+    // lies exactly between two floats, where the decimal itself could be on either side.
+    static bool reads_back_as(double decimal, bool exact, double value)
+    {
+        float rounded = static_cast<float>(decimal);
+        if (rounded != static_cast<float>(value))
+        {
+            return false;
+        }
+        double error = decimal - rounded;
+        if (exact || error == 0.0)
+        {
+            return true;
+        }
+        float neighbour = std::nextafter(rounded, error > 0 ? HUGE_VALF : -HUGE_VALF);
+        return std::fabs(error) != std::fabs(neighbour - decimal);
+    }
+
+    // Writes digits, which has count digits and stands for d.ddd * 10^exponent, like %g does
+    void append_digits(uint64_t digits, int count, int exponent)
+    {
+        while (count > 1 && digits % 10 == 0)
+        {
+            digits /= 10;
+            --count;
+        }
+        char text[20];
+        for (int i = count - 1; i >= 0; --i)
+        {
+            text[i] = static_cast<char>('0' + digits % 10);
+            digits /= 10;
+        }
+
+        if (exponent < -4 || exponent >= 9)
+        {
+            m_out += text[0];
+            if (count > 1)
+            {
+                m_out += '.';
+                m_out.append(text + 1, count - 1);
+            }
+            m_out += exponent < 0 ? "e-" : "e+";
+            int magnitude = exponent < 0 ? -exponent : exponent;
+            if (magnitude < 10)
+            {
+                m_out += '0';
+            }
+            append_unsigned(static_cast<uint64_t>(magnitude));
+        }
+        else if (exponent < 0)
+        {
+            m_out += "0.";
+            m_out.append(static_cast<size_t>(-exponent - 1), '0');
+            m_out.append(text, count);
+        }
+        else if (exponent + 1 >= count)
+        {
+            m_out.append(text, count);
+            m_out.append(static_cast<size_t>(exponent + 1 - count), '0');
+        }
+        else
+        {
+            m_out.append(text, exponent + 1);
+            m_out += '.';
+            m_out.append(text + exponent + 1, count - exponent - 1);
+        }
+    }
+
+    void append_double(double number)
+    {
+        if (!std::isfinite(number))
+        {
+            m_out += "null";
+            return;
+        }
+        char text[32];
+        int length = 0;
+        for (int precision = 15; precision <= 17; ++precision)
+        {
+            length = std::snprintf(text, sizeof(text), "%.*g", precision, number);
+            if (std::strtod(text, nullptr) == number)
+            {
+                break;
+            }
+        }
+        append_number(text, length);
+    }
+
+    void append_string(const char* text)
+    {
+        append_string(text, std::char_traits<char>::length(text));
+    }
+
+    void append_string(const char* text, size_t length)
+    {
+        static const char hex[] = "0123456789abcdef";
+        m_out += '"';
+        for (size_t i = 0; i < length; ++i)
+        {
+            unsigned char c = static_cast<unsigned char>(text[i]);
+            switch (c)
+            {
+            case '"':  m_out += "\\\""; break;
+            case '\\': m_out += "\\\\"; break;
+            case '\b': m_out += "\\b"; break;
+            case '\f': m_out += "\\f"; break;
+            case '\n': m_out += "\\n"; break;
+            case '\r': m_out += "\\r"; break;
+            case '\t': m_out += "\\t"; break;
+            default:
+                if (c < 0x20)
+                {
+                    m_out += "\\u00";
+                    m_out += hex[c >> 4];
+                    m_out += hex[c & 0xf];
+                }
+                else
+                {
+                    m_out += static_cast<char>(c);
+                }
+            }
+        }
+        m_out += '"';
+    }
+
+    std::string& m_out;
+    int m_depth;
+    bool m_first[max_depth];
+    bool m_after_key;
+};
+
+// Reuses the strings JSON messages are written to. A buffer goes back to the pool when the last
+// reference to it is dropped, which is after the transporter sent the message, so in steady
+// state messages are written without allocating.
+class json_buffer_pool
+{
+public:
+    explicit json_buffer_pool(size_t max_buffers = 16, size_t buffer_capacity = 1024) :
+        m_state(std::make_shared<state>())
+    {
+        m_state->max_buffers = max_buffers;
+        m_state->buffer_capacity = buffer_capacity;
+        m_state->allocated = 0;
+    }
+
+    std::shared_ptr<std::string> acquire()
+    {
+        std::string* buffer = nullptr;
+        {
+            std::lock_guard<std::mutex> lock(m_state->mutex);
+            if (!m_state->free.empty())
+            {
+                buffer = m_state->free.back();
+                m_state->free.pop_back();
+            }
+            else
+            {
+                ++m_state->allocated;
+            }
+        }
+        if (!buffer)
+        {
+            buffer = new std::string();
+            buffer->reserve(m_state->buffer_capacity);
+        }
+
+        // The buffers hold on to the pool state, so they can be released after the pool is gone
+        std::shared_ptr<state> pool_state = m_state;
+        return std::shared_ptr<std::string>(buffer, [pool_state](std::string* released)
+        {
+            pool_state->release(released);
+        });
+    }
+
+    // Buffers allocated so far, the rest of the acquired ones were reused
+    uint64_t get_allocated() const
+    {
+        std::lock_guard<std::mutex> lock(m_state->mutex);
+        return m_state->allocated;
+    }
+
+private:
+    struct state
+    {
+        ~state()
+        {
+            for (auto buffer : free)
+            {
+                delete buffer;
+            }
+        }
+
+        void release(std::string* buffer)
+        {
+            buffer->clear();
+            {
+                std::lock_guard<std::mutex> lock(mutex);
+                // Don't keep buffers that grew for an unusually large message
+                if (free.size() < max_buffers && buffer->capacity() <= 64 * buffer_capacity)
+                {
+                    free.push_back(buffer);
+                    return;
+                }
+            }
+            delete buffer;
+        }
+
+        std::mutex mutex;
+        std::vector<std::string*> free;
+        size_t max_buffers;
+        size_t buffer_capacity;
+        uint64_t allocated;
+    };
+
+    std::shared_ptr<state> m_state;
+};
+
+}
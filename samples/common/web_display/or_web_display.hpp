@@ -8,66 +8,68 @@
 #include <iostream>
 #include <iomanip>
 #include <sys/stat.h>
-#include <json/json.hpp>
 
 #include "or_data_interface.h"
 #include "or_configuration_interface.h"
 
 #include "transporter_proxy.hpp"
+#include "web_messages.hpp"
+#include "spatial_index.hpp"
+#include "affine_transform.hpp"
+#include "or_label_table.hpp"
 
 using namespace std;
 using namespace cv;
 using namespace rs::core;
 using namespace rs::object_recognition;
-using nlohmann::json;
 
 namespace web_display
 {
 
-struct pose_compare
-{
-    bool operator()(const rs::core::point3dF32 &lhs, const rs::core::point3dF32 &rhs) const
-    {
-        return lhs.x < rhs.x || lhs.z < rhs.z;
-    }
-};
-
-
 class or_web_display
 {
 public:
-    or_web_display(const char *path, int port, bool jpeg)
+    or_web_display(const char *path, int port, bool jpeg) : m_map_objects(map_object_distance)
     {
         m_transporter_proxy = &(transporter_proxy::getInstance(path, port, jpeg));
     }
 
+    // Objects on the map that weren't recognized again for ttl are forgotten, and sent to the map
+    // again when they are. With a ttl of zero they are only forgotten beyond max_objects.
+    void set_map_object_expiry(std::chrono::steady_clock::duration ttl, size_t max_objects = 4096)
+    {
+        m_map_objects = spatial_index(map_object_distance, ttl, max_objects);
+    }
+
     void on_or_update(uchar* pose_data,
                       localization_data *localization_data, int array_size,
                       or_configuration_interface *or_configuration)
     {
         if (array_size == 0 || !localization_data) return;
 
-        json filter_OR_data = construct_or_json(pose_data, localization_data, array_size, or_configuration,
-                                     true);
-        m_transporter_proxy->send_json_data(filter_OR_data);
+        // Both messages are written from the same objects: the filtered one only has the objects
+        // that aren't on the map yet, the unfiltered one all of them
+        std::vector<size_t> new_objects;
+        auto OR_data = construct_or_objects(pose_data, localization_data, array_size, or_configuration,
+                                            new_objects);
+        m_transporter_proxy->send_json_message([&](json_writer& writer)
+        {
+            write_or_objects_message(writer, true, OR_data, &new_objects);
+        });
 
-        auto unfilter_OR_data = construct_or_json(pose_data, localization_data, array_size, or_configuration,
-                                false);
-        m_transporter_proxy->send_json_data(unfilter_OR_data);
+        m_transporter_proxy->send_json_message([&](json_writer& writer)
+        {
+            write_or_objects_message(writer, false, OR_data);
+        });
 
     }
 
     void on_object_list(vector<string> obj_name_list)
     {
-        json result_json;
-        json &l = result_json["list"];
-        for (unsigned int i = 0; i < obj_name_list.size(); i++)
+        m_transporter_proxy->send_json_message([&](json_writer& writer)
         {
-            l += obj_name_list[i];
-        }
-        result_json["type"] = "object_recognition_label_list";
-
-        m_transporter_proxy->send_json_data(result_json);
+            write_label_list_message(writer, obj_name_list);
+        });
     }
 
     void on_object_localization_data(localization_data *localization_data,
@@ -77,8 +79,11 @@ public:
         {
             return;
         }
-        auto unfilter_OR_data = construct_localization_json(localization_data, array_size, or_configuration);
-        m_transporter_proxy->send_json_data(unfilter_OR_data);
+        auto unfilter_OR_data = construct_localization_objects(localization_data, array_size, or_configuration, nullptr);
+        m_transporter_proxy->send_json_message([&](json_writer& writer)
+        {
+            write_localization_message(writer, unfilter_OR_data);
+        });
 
     }
 
@@ -87,9 +92,12 @@ public:
     {
         if (array_size == 0 || !recognition_data) return;
 
-
-        auto unfilter_OR_data = construct_recognition_json(recognition_data, array_size, or_configuration);
-        m_transporter_proxy->send_json_data(unfilter_OR_data);
+        const std::string& objName = m_labels.get(or_configuration).name(recognition_data[0].label);
+        float confidence = recognition_data[0].probability;
+        m_transporter_proxy->send_json_message([&](json_writer& writer)
+        {
+            write_recognition_message(writer, objName, confidence);
+        });
 
     }
 
@@ -99,9 +107,24 @@ public:
     {
         if (array_size == 0 || (!localization_data && !tracking_data))
             return;
-        auto unfilter_OR_data = construct_tracking_json(localization_data, tracking_data, or_configuration,
-                                array_size, is_localize, objects_names);
-        m_transporter_proxy->send_json_data(unfilter_OR_data);
+
+        if (is_localize)
+        {
+            auto objects = construct_localization_objects(localization_data, array_size, or_configuration, &objects_names);
+            m_transporter_proxy->send_json_message([&](json_writer& writer)
+            {
+                write_localization_message(writer, objects);
+            });
+        }
+        else
+        {
+            auto objects = construct_tracking_objects(tracking_data, array_size, objects_names);
+            cout << endl;
+            m_transporter_proxy->send_json_message([&](json_writer& writer)
+            {
+                write_tracking_message(writer, objects);
+            });
+        }
 
     }
 
@@ -114,16 +137,22 @@ public:
 
 private:
     transporter_proxy *m_transporter_proxy;
-
-    json construct_or_json(uchar* pose_data,
-                                  rs::object_recognition::localization_data *localization_data, int array_size,
-                                  rs::object_recognition::or_configuration_interface *or_configuration,
-                                  bool needFilter)
+    or_label_table_cache m_labels;
+
+    // The confident objects with their world pose. The indices of the objects that aren't close to
+    // an object sent before are added to new_objects, and those objects are remembered.
+    std::vector<or_object_message> construct_or_objects(uchar* pose_data,
+            rs::object_recognition::localization_data *localization_data, int array_size,
+            rs::object_recognition::or_configuration_interface *or_configuration,
+            std::vector<size_t> &new_objects)
     {
-        json obj_list_json;
+        const or_label_table& labels = m_labels.get(or_configuration);
+        std::vector<or_object_message> objects;
+        std::vector<rs::core::point3dF32> centers;
+        objects.reserve(array_size);
+        centers.reserve(array_size);
         for (int i = 0; i < array_size; i++)
         {
-            string objName = or_configuration->query_object_name_by_id(localization_data[i].label);
             float confidence = localization_data[i].probability;
 
             if (confidence < 0.80)
@@ -131,255 +160,85 @@ private:
                 continue;
             }
 
-            rs::core::rect rect = localization_data[i].roi;
+            or_object_message object;
+            object.label = &labels.name(localization_data[i].label);
+            object.confidence = confidence;
+            object.roi = localization_data[i].roi;
+            objects.push_back(std::move(object));
             auto center = localization_data[i].object_center;
+            centers.push_back({center.coordinates.x, center.coordinates.y, center.coordinates.z});
+        }
 
-            rs::core::point3dF32 actual_pose = camera_to_world_coordinates(pose_data, center.coordinates.x, center.coordinates.y,
-                                               center.coordinates.z);
-
-            // We got object's real center and its name, now lets do a filter before send to UI.
-            if (needFilter && filter_objects_based_on_pose(actual_pose, objName))
-            {
-                //since this object already in the display list, filter it out
-                continue;
-            }
-
-            float *or_pose = new float[3];
-            or_pose[0] = actual_pose.x;
-            or_pose[1] = actual_pose.y;
-            or_pose[2] = actual_pose.z;
+        // Transform the centers of all objects from the camera position to the "world coordinates"
+        affine_transform::from_pose(reinterpret_cast<const float*>(pose_data), 0.001f)
+        .apply(centers.data(), centers.data(), centers.size());
 
-            // Construct json
-            json value;
-            //label and confidence
-            value["label"] = objName;
-            value["confidence"] = confidence;
+        for (size_t i = 0; i < objects.size(); i++)
+        {
+            objects[i].position[0] = centers[i].x;
+            objects[i].position[1] = centers[i].y;
+            objects[i].position[2] = centers[i].z;
 
-            // pose
-            json &p = value["pose"];
-            for (int i = 0; i < 3; i++)
+            // We got object's real center and its name, now lets do a filter before send to UI.
+            // Objects already in the display list are left out of the filtered message.
+            if (!filter_objects_based_on_pose(centers[i], *objects[i].label))
             {
-                p += or_pose[i];
+                new_objects.push_back(i);
             }
-
-            json &r = value["rectangle"];
-            r += rect.x;
-            r += rect.y;
-            r += rect.width;
-            r += rect.height;
-
-            // Put json obj to the json list
-            obj_list_json += value;
         }
 
-        json result_json;
-        result_json["Object_result"] = obj_list_json;
-        if (needFilter)
-        {
-            result_json["type"] = "object_recognition";
-        }
-        else
-        {
-            result_json["type"] = "unfilter_object_recognition";
-        }
-
-        return result_json;
+        return objects;
     }
 
-    json construct_localization_json(rs::object_recognition::localization_data *localization_data,
-                                            int array_size, or_configuration_interface *or_configuration)
+    // Localized objects with their center in camera coordinates, the labels are also added to
+    // objects_names if it is given. The labels of the objects point into the label table.
+    std::vector<or_object_message> construct_localization_objects(rs::object_recognition::localization_data *localization_data,
+            int array_size, or_configuration_interface *or_configuration,
+            vector<string>* objects_names)
     {
-        json obj_list_json;
+        const or_label_table& labels = m_labels.get(or_configuration);
+        std::vector<or_object_message> objects(array_size);
         for (int i = 0; i < array_size; i++)
         {
-            string objName = or_configuration->query_object_name_by_id(localization_data[i].label);
-            float confidence = localization_data[i].probability;
-            rs::core::rect rect = localization_data[i].roi;
-
-            float *center_coord = new float[3];
-            center_coord[0] = localization_data[i].object_center.coordinates.x;
-            center_coord[1] = localization_data[i].object_center.coordinates.y;
-            center_coord[2] = localization_data[i].object_center.coordinates.z;
-
-            // Construct json
-            json value;
-
-            // Label and confidence
-            value["label"] = objName;
-            value["confidence"] = confidence;
-
-            // Pose
-            json &p = value["centerCoord"];
-            for (int i = 0; i < 3; i++)
+            or_object_message& object = objects[i];
+            object.label = &labels.name(localization_data[i].label);
+            if (objects_names)
             {
-                p += center_coord[i];
+                objects_names->emplace_back(*object.label);
             }
-
-            json &r = value["rectangle"];
-            r += rect.x;
-            r += rect.y;
-            r += rect.width;
-            r += rect.height;
-
-            // Put json obj to the json list
-            obj_list_json += value;
-
+            object.confidence = localization_data[i].probability;
+            object.position[0] = localization_data[i].object_center.coordinates.x;
+            object.position[1] = localization_data[i].object_center.coordinates.y;
+            object.position[2] = localization_data[i].object_center.coordinates.z;
+            object.roi = localization_data[i].roi;
         }
 
-        json result_json;
-
-        if (array_size == 0)
-        {
-            result_json["type"] = "object_localization_none";
-        }
-        else
-        {
-            result_json["Object_result"] = obj_list_json;
-            result_json["type"] = "object_localization";
-        }
-
-        return result_json;
+        return objects;
     }
 
-    json construct_recognition_json(recognition_data *recognition_data,
-                                           int array_size, or_configuration_interface *or_configuration)
+    std::vector<or_object_message> construct_tracking_objects(tracking_data *tracking_data, int array_size,
+            const vector<string> &objects_names)
     {
-        json obj_list_json;
-        std::string objName = or_configuration->query_object_name_by_id(
-                                  recognition_data[0].label);
-        float confidence = recognition_data[0].probability;
-
-        //Construct json
-        json value;
-
-        // Label and Confidence
-        value["label"] = objName;
-        value["confidence"] = confidence;
-
-        // Put json obj to the json list
-        obj_list_json += value;
-
-        json result_json;
-        result_json["Object_result"] = obj_list_json;
-        result_json["type"] = "object_recognition";
-
-        return result_json;
-    }
-
-    json construct_tracking_json(localization_data *localization_data,
-                                        tracking_data *tracking_data,
-                                        or_configuration_interface *or_configuration,
-                                        int array_size, bool is_localize, vector<string> &objects_names)
-    {
-        json obj_list_json;
-
-        // Construct json
-        json result_json;
-
-        if (is_localize)
-        {
-            for (int i = 0; i < array_size; i++)
-            {
-                string objName = or_configuration->query_object_name_by_id(localization_data[i].label);
-                objects_names.emplace_back(objName);
-                float confidence = localization_data[i].probability;
-                rs::core::rect rect = localization_data[i].roi;
-
-                float *center_coord = new float[3];
-                center_coord[0] = localization_data[i].object_center.coordinates.x;
-                center_coord[1] = localization_data[i].object_center.coordinates.y;
-                center_coord[2] = localization_data[i].object_center.coordinates.z;
-
-                // Construct json
-                json value;
-
-                // Label and confidence
-                value["label"] = objName;
-                value["confidence"] = confidence;
-
-                // Pose
-                json &p = value["centerCoord"];
-                for (int i = 0; i < 3; i++)
-                {
-                    p += center_coord[i];
-                }
-
-                json &r = value["rectangle"];
-                r += rect.x;
-                r += rect.y;
-                r += rect.width;
-                r += rect.height;
-
-                // Put json obj to the json list
-                obj_list_json += value;
-            }
-            result_json["type"] = "object_localization";
-        }
-        else
+        std::vector<or_object_message> objects(array_size);
+        for (int i = 0; i < array_size; i++)
         {
-            for (int i = 0; i < array_size; i++)
-            {
-                // Construct json
-                json value;
-                string objName = objects_names[i];
-
-                value["label"] = objName;
-                json &r = value["rectangle"];
-                r += tracking_data[i].roi.x;
-                r += tracking_data[i].roi.y;
-                r += tracking_data[i].roi.width;
-                r += tracking_data[i].roi.height;
-                // Put json obj to the json list
-                obj_list_json += value;
-            }
-            cout << endl;
-            result_json["type"] = "object_tracking";
+            objects[i].label = &objects_names[i];
+            objects[i].confidence = 0.0f;
+            objects[i].roi = tracking_data[i].roi;
         }
 
-
-        result_json["Object_result"] = obj_list_json;
-        return result_json;
+        return objects;
     }
 
-    // Transform coordinates from the camera current position to the "world coordinates"
-    rs::core::point3dF32 camera_to_world_coordinates(
-        uchar* pose_data, float x, float y, float z)
-    {
-        cv::Mat poseMat(4, 4, CV_32FC1, pose_data);
-        cv::Mat_<float> cameraPtMat(4, 1);
-        cameraPtMat(0, 0) = x / 1000;  // mm -> meters
-        cameraPtMat(1, 0) = y / 1000;  // mm -> meters
-        cameraPtMat(2, 0) = z / 1000;  // mm -> meters
-        cameraPtMat(3, 0) = 1.0f;
-
-        cv::Mat_<float> worldPtMat = poseMat * cameraPtMat;
-
-        rs::core::point3dF32 world_pt;
-        world_pt.x = worldPtMat(0, 0);
-        world_pt.y = worldPtMat(1, 0);
-        world_pt.z = worldPtMat(2, 0);
-
-        return world_pt;
-    }
+    // Objects of the same label closer than this on every axis, in meters, are the same object
+    static constexpr float map_object_distance = 0.5f;
 
     // Drop the new obj if it's already in the list
-    map<rs::core::point3dF32, string, pose_compare> m_pose_objects_map;
+    spatial_index m_map_objects;
 
-    bool filter_objects_based_on_pose(rs::core::point3dF32 obj_center, string obj_label)
+    bool filter_objects_based_on_pose(const rs::core::point3dF32 &obj_center, const string &obj_label)
     {
-        for (auto const &ent : m_pose_objects_map)
-        {
-            if (abs(obj_center.x - ent.first.x) < 0.5 && abs(obj_center.y - ent.first.y) < 0.5
-                    && abs(obj_center.z - ent.first.z) < 0.5)
-            {
-                // Filter it out
-                return true;
-            }
-
-        }
-        m_pose_objects_map[obj_center] = obj_label;
-
-        return false;
+        return m_map_objects.find_or_insert(obj_center, obj_label);
     }
 };
 
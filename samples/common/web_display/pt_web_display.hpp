@@ -9,69 +9,141 @@
 #include <string>
 #include <vector>
 #include <map>
+#include <deque>
+#include <mutex>
 #include <sys/stat.h>
 
-#include <json/json.hpp>
 #include <opencv2/opencv.hpp>
 
 #include "person_tracking_video_module_factory.h"
 
 #include "transporter_proxy.hpp"
+#include "web_messages.hpp"
+#include "spatial_index.hpp"
+#include "affine_transform.hpp"
+#include "pt_snapshot.hpp"
 
 using namespace std;
 using namespace rs::person_tracking;
 using namespace Intel::RealSense::PersonTracking;
-using nlohmann::json;
 
 namespace web_display
 {
-struct PoseCompare
-{
-    bool operator()(const rs::core::point3dF32 &lhs, const rs::core::point3dF32 &rhs) const
-    {
-        return lhs.x < rhs.x || lhs.z < rhs.z;
-    }
-};
-
+// The tracking, head pose and gesture messages are overlays of the color image of their frame.
+// When the color images are sent from another thread than the one processing the frames, call
+// set_overlay_frame() with the frame number of the color image before the overlays of a frame and
+// pass the frame number to on_rgb_frame(). The overlays then go out right after their image, and
+// the ones of images that weren't sent are dropped.
 class pt_web_display
 {
 public:
-    pt_web_display(const char *path, int port, bool jpeg)
+    pt_web_display(const char *path, int port, bool jpeg) :
+        m_person_poses(person_pose_distance),
+        m_ordered_overlays(false),
+        m_overlay_frame(0),
+        m_has_sent_frame(false),
+        m_sent_frame(0)
     {
         m_transporter_proxy = &(transporter_proxy::getInstance(path, port, jpeg));
     }
 
+    // Person poses that weren't seen again for ttl are forgotten, and sent again when they are.
+    // With a ttl of zero they are only forgotten beyond max_poses.
+    void set_person_pose_expiry(std::chrono::steady_clock::duration ttl, size_t max_poses = 4096)
+    {
+        m_person_poses = spatial_index(person_pose_distance, ttl, max_poses);
+    }
+
     void on_pt_update(uchar* pose_data, rs::person_tracking::person_tracking_video_module_interface* ptModule)
     {
-        json value;
-        if(ConstructPTJson(pose_data, ptModule, value))
+        extract_pt_snapshot(ptModule, m_snapshot, pt_snapshot_tracking);
+        on_pt_update(pose_data, m_snapshot);
+    }
+
+    void on_pt_update(uchar* pose_data, const pt_snapshot &snapshot)
+    {
+        std::vector<pt_person_message> persons;
+        if(ConstructPTPersons(pose_data, snapshot, persons))
         {
-            m_transporter_proxy->send_json_data(value);
+            m_transporter_proxy->send_json_message([&](json_writer& writer)
+            {
+                write_persons_message(writer, "person_tracking_data", persons, false, 0);
+            });
         }
     }
 
-    void on_PT_tracking_update(rs::person_tracking::person_tracking_video_module_interface* ptModule, int cumulative_total)
+    // The recognition ids come from recognition_cache, which the caller locks the module with.
+    // Without a cache they aren't sent: registering every person on every frame stalls the frame loop.
+    void on_PT_tracking_update(rs::person_tracking::person_tracking_video_module_interface* ptModule, int cumulative_total,
+                               pt_recognition_cache* recognition_cache = nullptr)
     {
-        auto json_to_send = ConstructPtTrackingJson(ptModule, cumulative_total);
-        m_transporter_proxy->send_json_data(json_to_send);
+        extract_pt_snapshot(ptModule, m_snapshot, recognition_cache ? pt_snapshot_recognition : pt_snapshot_tracking, recognition_cache);
+        on_PT_tracking_update(m_snapshot, cumulative_total);
     }
 
     void on_PT_tracking_update(rs::person_tracking::person_tracking_video_module_interface* ptModule)
     {
-        auto json_to_send = ConstructPtTrackingJson(ptModule, 0);
-        m_transporter_proxy->send_json_data(json_to_send);
+        on_PT_tracking_update(ptModule, 0);
+    }
+
+    // snapshot has the recognition ids if it was extracted with pt_snapshot_recognition
+    void on_PT_tracking_update(const pt_snapshot &snapshot, int cumulative_total)
+    {
+        auto persons = ConstructPtTrackingPersons(snapshot);
+        send_overlay([&](json_writer& writer)
+        {
+            // Without people the message is an empty result
+            if (persons.empty())
+            {
+                writer.null();
+                return;
+            }
+            write_persons_message(writer, "person_tracking", persons, true, cumulative_total);
+        });
     }
 
     void on_pt_head_pose_update(rs::person_tracking::person_tracking_video_module_interface* ptModule)
     {
-        auto json_to_send = ConstructPtHeadPosePersonOrientationJson(ptModule);
-        m_transporter_proxy->send_json_data(json_to_send);
+        extract_pt_snapshot(ptModule, m_snapshot, pt_snapshot_head);
+        on_pt_head_pose_update(m_snapshot);
+    }
+
+    // snapshot must be extracted with pt_snapshot_head
+    void on_pt_head_pose_update(const pt_snapshot &snapshot)
+    {
+        pt_head_pose_message person;
+        bool found = ConstructPtHeadPose(snapshot, person);
+        send_overlay([&](json_writer& writer)
+        {
+            if (!found)
+            {
+                writer.null();
+                return;
+            }
+            write_head_pose_message(writer, person);
+        });
     }
 
     void on_pt_pointing_gesture_update(rs::person_tracking::person_tracking_video_module_interface* ptModule)
     {
-        auto json_to_send = ConstructPtPointingGestureJson(ptModule);
-        m_transporter_proxy->send_json_data(json_to_send);
+        extract_pt_snapshot(ptModule, m_snapshot, pt_snapshot_gestures);
+        on_pt_pointing_gesture_update(m_snapshot);
+    }
+
+    // snapshot must be extracted with pt_snapshot_gestures
+    void on_pt_pointing_gesture_update(const pt_snapshot &snapshot)
+    {
+        pt_gesture_message person;
+        bool found = ConstructPtPointingGesture(snapshot, person);
+        send_overlay([&](json_writer& writer)
+        {
+            if (!found)
+            {
+                writer.null();
+                return;
+            }
+            write_gesture_message(writer, person);
+        });
 
     }
     void on_rgb_frame(uint64_t ts_micros, int width, int height, const void* data)
@@ -79,6 +151,31 @@ public:
         m_transporter_proxy->on_rgb_frame(ts_micros, width, height, data);
     }
 
+    // Sends the color image of frame_number followed by the overlays of that frame
+    void on_rgb_frame(uint64_t ts_micros, int width, int height, const void* data, uint64_t frame_number)
+    {
+        std::lock_guard<std::mutex> lock(m_overlay_mutex);
+        m_transporter_proxy->on_rgb_frame(ts_micros, width, height, data);
+        m_has_sent_frame = true;
+        m_sent_frame = frame_number;
+        while (!m_overlays.empty() && m_overlays.front().first <= frame_number)
+        {
+            if (m_overlays.front().first == frame_number)
+            {
+                m_transporter_proxy->send_json_data_after_images(m_overlays.front().second);
+            }
+            m_overlays.pop_front();
+        }
+    }
+
+    // The overlays sent until the next call belong to the color image of frame_number
+    void set_overlay_frame(uint64_t frame_number)
+    {
+        std::lock_guard<std::mutex> lock(m_overlay_mutex);
+        m_ordered_overlays = true;
+        m_overlay_frame = frame_number;
+    }
+
     void set_control_callbacks(display_controls controls)
     {
         m_transporter_proxy->set_control_callbacks(controls);
@@ -87,315 +184,160 @@ public:
 private:
     transporter_proxy *m_transporter_proxy;
 
-    json ConstructPtTrackingJson(
-        person_tracking_video_module_interface *ptModule, int cumulative_total)
+    // Overlays of frames whose image wasn't sent yet, oldest first
+    static const size_t max_pending_overlays = 16;
+    std::mutex m_overlay_mutex;
+    std::deque<std::pair<uint64_t, std::shared_ptr<std::string>>> m_overlays;
+    bool m_ordered_overlays;
+    uint64_t m_overlay_frame;
+    bool m_has_sent_frame;
+    uint64_t m_sent_frame;
+
+    template<typename Write>
+    void send_overlay(Write write)
     {
-        json obj_list_json;
-        Intel::RealSense::PersonTracking::PersonTrackingData *trackingData = ptModule->QueryOutput();
-
-        for (int index = 0; index < trackingData->QueryNumberOfPeople(); index++)
+        std::unique_lock<std::mutex> lock(m_overlay_mutex);
+        if (!m_ordered_overlays)
         {
-            Intel::RealSense::PersonTracking::PersonTrackingData::Person *personData = nullptr;
-            personData = trackingData->QueryPersonData(
-                             Intel::RealSense::PersonTracking::PersonTrackingData::ACCESS_ORDER_BY_INDEX, index);
+            lock.unlock();
+            m_transporter_proxy->send_json_message(write);
+            return;
+        }
 
-            if (personData)
+        std::shared_ptr<std::string> msg = m_transporter_proxy->make_json_message(write);
+        if (m_has_sent_frame && m_sent_frame >= m_overlay_frame)
+        {
+            // The image is out already, or was dropped for a newer one
+            if (m_sent_frame == m_overlay_frame)
             {
-                Intel::RealSense::PersonTracking::PersonTrackingData::PersonTracking *personTrackingData = personData->QueryTracking();
-                Intel::RealSense::PersonTracking::PersonTrackingData::BoundingBox2D box = personTrackingData->Query2DBoundingBox();
-                Intel::RealSense::PersonTracking::PersonTrackingData::PointCombined centerMass = personTrackingData->QueryCenterMass();
-
-                int id = personTrackingData->QueryId();
-
-                // Construct json
-                json value;
-                // person id
-                value["pid"] = id;
-
-                value["cumulative_total"] = cumulative_total;
-
-                value["person_bounding_box"]["x"] = box.rect.x;
-                value["person_bounding_box"]["y"] = box.rect.y;
-                value["person_bounding_box"]["w"] = box.rect.w;
-                value["person_bounding_box"]["h"] = box.rect.h;
-
-                value["center_mass_image"]["x"] = centerMass.image.point.x;
-                value["center_mass_image"]["y"] = centerMass.image.point.y;
-
-                value["center_mass_world"]["x"] = centerMass.world.point.x;
-                value["center_mass_world"]["y"] = centerMass.world.point.y;
-                value["center_mass_world"]["z"] = centerMass.world.point.z;
-
-                if (ptModule->QueryConfiguration()->QueryRecognition()->IsEnabled()){
-                     // Get recognition ID from person data
-                     PersonTrackingData::PersonRecognition* recognition = personData->QueryRecognition();
-                     int32_t outputRecognitionId;
-                     int32_t outputTrackingId;
-                     int32_t outDescriptorId;
-                     auto status = recognition->RegisterUser(&outputRecognitionId, &outputTrackingId, &outDescriptorId);
-
-                     if (status == PersonTrackingData::PersonRecognition::RegistrationSuccessful)
-                     {
-                         std::cout << "Registered person: " << outputRecognitionId << std::endl;
-                         int rid = outputRecognitionId;
-                         // Send rid to browser
-                         value["rid"] = rid;
-                     }
-                     else if (status == PersonTrackingData::PersonRecognition::RegistrationFailedAlreadyRegistered)
-                     {
-                         int rid = outputRecognitionId;
-                         // Send rid to browser
-                         value["rid"] = rid;
-                     }
-                 }
-                // Put json obj to the json list
-                obj_list_json += value;
+                m_transporter_proxy->send_json_data_after_images(std::move(msg));
             }
+            return;
         }
-
-        if (trackingData->QueryNumberOfPeople())
+        if (m_overlays.size() == max_pending_overlays)
         {
-            json result_json;
-            result_json["Object_result"] = obj_list_json;
-            result_json["type"] = "person_tracking";
-
-            return result_json;
+            m_overlays.pop_front();
         }
-
-        return obj_list_json;
+        m_overlays.emplace_back(m_overlay_frame, std::move(msg));
     }
 
-    json ConstructPtHeadPosePersonOrientationJson(
-        person_tracking_video_module_interface *ptModule)
-    {
-        json obj_list_json;
-        Intel::RealSense::PersonTracking::PersonTrackingData *trackingData = ptModule->QueryOutput();
+    // The persons of the last frame, for the overloads that take the module
+    pt_snapshot m_snapshot;
 
-        if (trackingData->QueryNumberOfPeople() > 0)
+    // The persons with their bounding box and center of mass
+    std::vector<pt_person_message> ConstructPtTrackingPersons(const pt_snapshot &snapshot)
+    {
+        std::vector<pt_person_message> persons;
+        persons.reserve(snapshot.size());
+        for (int index = 0; index < snapshot.size(); index++)
         {
-            Intel::RealSense::PersonTracking::PersonTrackingData::Person *personData = nullptr;
-            personData = trackingData->QueryPersonData(
-                             Intel::RealSense::PersonTracking::PersonTrackingData::ACCESS_ORDER_BY_INDEX, 0);
-
-            if (personData)
+            pt_person_message person = ConstructPerson(snapshot, index);
+            if ((snapshot.fields & pt_snapshot_recognition) && snapshot.recognition_ids[index] >= 0)
             {
-                Intel::RealSense::PersonTracking::PersonTrackingData::PoseEulerAngles headAngles;
-                auto headBoundingBox = personData->QueryTracking()->QueryHeadBoundingBox();
-                // Construct json
-                json value;
-
-                // person id
-                value["pid"] = personData->QueryTracking()->QueryId();
-                if (headBoundingBox.confidence)
-                {
-                    value["head_bounding_box"]["x"] = headBoundingBox.rect.x;
-                    value["head_bounding_box"]["y"] = headBoundingBox.rect.y;
-                    value["head_bounding_box"]["w"] = headBoundingBox.rect.w;
-                    value["head_bounding_box"]["h"] = headBoundingBox.rect.h;
-                }
-
-                // Print head pose (pitch, roll, yaw)
-                if (personData->QueryFace()->QueryHeadPose(headAngles))
-                {
-                    value["head_pose"]["pitch"] = headAngles.pitch;
-                    value["head_pose"]["roll"] = headAngles.roll;
-                    value["head_pose"]["yaw"] = headAngles.yaw;
-                }
-
-
-                // Put json obj to the json list
-                obj_list_json += value;
+                // Send rid to browser
+                person.has_rid = true;
+                person.rid = snapshot.recognition_ids[index];
             }
-
-            json result_json;
-            result_json["Object_result"] = obj_list_json;
-            result_json["type"] = "person_tracking";
-
-            return result_json;
+            persons.push_back(person);
         }
 
-        return obj_list_json;
-
+        return persons;
     }
 
-    json ConstructPtPointingGestureJson(
-        person_tracking_video_module_interface *ptModule)
+    // The head of the first person, false if there is nobody
+    bool ConstructPtHeadPose(const pt_snapshot &snapshot, pt_head_pose_message &person)
     {
-        json obj_list_json;
-        Intel::RealSense::PersonTracking::PersonTrackingData *trackingData = ptModule->QueryOutput();
-
-        if (trackingData->QueryNumberOfPeople() > 0)
-        {
-            Intel::RealSense::PersonTracking::PersonTrackingData::Person *personData = nullptr;
-            personData = trackingData->QueryPersonData(
-                             Intel::RealSense::PersonTracking::PersonTrackingData::ACCESS_ORDER_BY_INDEX, 0);
-
-            if (personData)
-            {
-                Intel::RealSense::PersonTracking::PersonTrackingData::PersonGestures *personGestures = personData->QueryGestures();
-                Intel::RealSense::PersonTracking::PersonTrackingData::BoundingBox2D box = personData->QueryTracking()->Query2DBoundingBox();
-
-                // Construct json
-                json value;
-
-                value["pid"] = personData->QueryTracking()->QueryId();
-
-                value["person_bounding_box"]["x"] = box.rect.x;
-                value["person_bounding_box"]["y"] = box.rect.y;
-                value["person_bounding_box"]["w"] = box.rect.w;
-                value["person_bounding_box"]["h"] = box.rect.h;
-
-                if (personGestures)
-                {
-                    if (personGestures->IsPointing() && personGestures->QueryPointingInfo().confidence > 0)
-                    {
-                        value["gesture_color_coordinates"]["origin"]["x"] = personGestures->QueryPointingInfo().colorPointingData.origin.x;
-                        value["gesture_color_coordinates"]["origin"]["y"] = personGestures->QueryPointingInfo().colorPointingData.origin.y;
+        if (snapshot.size() <= 0 || !(snapshot.fields & pt_snapshot_head))
+            return false;
 
-                        value["gesture_color_coordinates"]["direction"]["x"] = personGestures->QueryPointingInfo().colorPointingData.direction.x;
-                        value["gesture_color_coordinates"]["direction"]["y"] = personGestures->QueryPointingInfo().colorPointingData.direction.y;
+        // person id
+        person.pid = snapshot.ids[0];
+        person.has_head_box = snapshot.has_head_box[0] != 0;
+        std::copy(snapshot.head_boxes.begin(), snapshot.head_boxes.begin() + 4, person.head_box);
 
-                        value["gesture_world_coordinates"]["origin"]["x"] = personGestures->QueryPointingInfo().worldPointingData.origin.x;
-                        value["gesture_world_coordinates"]["origin"]["y"] = personGestures->QueryPointingInfo().worldPointingData.origin.y;
-                        value["gesture_world_coordinates"]["origin"]["z"] = personGestures->QueryPointingInfo().worldPointingData.origin.z;
+        // Head pose (pitch, roll, yaw)
+        person.has_head_pose = snapshot.has_head_pose[0] != 0;
+        person.pitch = snapshot.head_poses[0];
+        person.roll = snapshot.head_poses[1];
+        person.yaw = snapshot.head_poses[2];
 
-                        value["gesture_world_coordinates"]["direction"]["x"] = personGestures->QueryPointingInfo().worldPointingData.direction.x;
-                        value["gesture_world_coordinates"]["direction"]["y"] = personGestures->QueryPointingInfo().worldPointingData.direction.y;
-                        value["gesture_world_coordinates"]["direction"]["z"] = personGestures->QueryPointingInfo().worldPointingData.direction.z;
-                    }
-                }
+        return true;
+    }
 
-                // Put json obj to the json list
-                obj_list_json += value;
-            }
+    // The pointing gesture of the first person, false if there is nobody
+    bool ConstructPtPointingGesture(const pt_snapshot &snapshot, pt_gesture_message &person)
+    {
+        if (snapshot.size() <= 0 || !(snapshot.fields & pt_snapshot_gestures))
+            return false;
 
-            json result_json;
-            result_json["Object_result"] = obj_list_json;
-            result_json["type"] = "person_tracking";
+        person.pid = snapshot.ids[0];
+        std::copy(snapshot.boxes.begin(), snapshot.boxes.begin() + 4, person.box);
 
-            return result_json;
-        }
+        person.pointing = snapshot.pointing[0] != 0;
+        std::copy(snapshot.pointing_color.begin(), snapshot.pointing_color.begin() + 2, person.color_origin);
+        std::copy(snapshot.pointing_color.begin() + 2, snapshot.pointing_color.begin() + 4, person.color_direction);
+        std::copy(snapshot.pointing_world.begin(), snapshot.pointing_world.begin() + 3, person.world_origin);
+        std::copy(snapshot.pointing_world.begin() + 3, snapshot.pointing_world.begin() + 6, person.world_direction);
 
-        return obj_list_json;
+        return true;
     }
 
-    bool ConstructPTJson(uchar* pose_data,
-                         person_tracking_video_module_interface *ptModule,
-                         json &result_json)
+    // The persons with their world pose, which is left out for persons that were sent before
+    bool ConstructPTPersons(uchar* pose_data, const pt_snapshot &snapshot,
+                            std::vector<pt_person_message> &persons)
     {
-        json obj_list_json;
-
-        Intel::RealSense::PersonTracking::PersonTrackingData *trackingData = ptModule->QueryOutput();
-
-        if (trackingData->QueryNumberOfPeople() <= 0)
+        if (snapshot.size() <= 0)
             return false;
 
-        for (int index = 0; index < trackingData->QueryNumberOfPeople(); index++)
+        std::vector<rs::core::point3dF32> centers;
+        centers.reserve(snapshot.size());
+        for (int index = 0; index < snapshot.size(); index++)
         {
-            Intel::RealSense::PersonTracking::PersonTrackingData::Person *personData = nullptr;
-            personData = trackingData->QueryPersonData(
-                             Intel::RealSense::PersonTracking::PersonTrackingData::ACCESS_ORDER_BY_INDEX, index);
+            pt_person_message person = ConstructPerson(snapshot, index);
+            centers.push_back({person.center_mass_world[0], person.center_mass_world[1], person.center_mass_world[2]});
+            persons.push_back(person);
+        }
 
-            if (personData)
+        // Convert the centers of all persons to world coordinates
+        affine_transform::from_pose(reinterpret_cast<const float*>(pose_data), 0.001f)
+        .apply(centers.data(), centers.data(), centers.size());
+
+        for (size_t i = 0; i < persons.size(); i++)
+        {
+            // Filter out exist person data
+            if (!filter_person_based_on_pose(centers[i]))
             {
-                Intel::RealSense::PersonTracking::PersonTrackingData::PersonTracking *personTrackingData = personData->QueryTracking();
-                Intel::RealSense::PersonTracking::PersonTrackingData::BoundingBox2D box = personTrackingData->Query2DBoundingBox();
-                Intel::RealSense::PersonTracking::PersonTrackingData::PointCombined centerMass = personTrackingData->QueryCenterMass();
-
-                // Convert to world coordinate
-                rs::core::point3dF32 actual_pose = camera_to_world_coordinates(pose_data,
-                                                   centerMass.world.point.x,
-                                                   centerMass.world.point.y,
-                                                   centerMass.world.point.z);
-
-                // Construct json
-                json value;
-
-                // Filter out exist person data
-                if (!filter_person_based_on_pose(actual_pose))
-                {
-                    float *pt_pose = new float[3];
-                    pt_pose[0] = actual_pose.x;
-                    pt_pose[1] = actual_pose.y;
-                    pt_pose[2] = actual_pose.z;
-
-                    //pose
-                    json &p = value["pose"];
-                    for (int i = 0; i < 3; i++)
-                    {
-                        p += pt_pose[i];
-                    }
-                }
-
-                int id = personTrackingData->QueryId();
-                // person id
-                value["pid"] = id;
-
-                value["person_bounding_box"]["x"] = box.rect.x;
-                value["person_bounding_box"]["y"] = box.rect.y;
-                value["person_bounding_box"]["w"] = box.rect.w;
-                value["person_bounding_box"]["h"] = box.rect.h;
-
-                value["center_mass_image"]["x"] = centerMass.image.point.x;
-                value["center_mass_image"]["y"] = centerMass.image.point.y;
-
-                value["center_mass_world"]["x"] = centerMass.world.point.x;
-                value["center_mass_world"]["y"] = centerMass.world.point.y;
-                value["center_mass_world"]["z"] = centerMass.world.point.z;
-
-                //put json obj to the json list
-                obj_list_json += value;
+                persons[i].has_pose = true;
+                persons[i].pose[0] = centers[i].x;
+                persons[i].pose[1] = centers[i].y;
+                persons[i].pose[2] = centers[i].z;
             }
-
         }
 
-        result_json["Object_result"] = obj_list_json;
-        result_json["type"] = "person_tracking_data";
-
         return true;
     }
 
-    // Transform coordinates from the camera current position to the "world coordinates"
-    rs::core::point3dF32 camera_to_world_coordinates(
-        uchar* pose_data, float x, float y, float z)
+    // Id, bounding box and center of mass of a person
+    pt_person_message ConstructPerson(const pt_snapshot &snapshot, int index)
     {
-        cv::Mat poseMat(4, 4, CV_32FC1, pose_data);
-        cv::Mat_<float> cameraPtMat(4, 1);
-        cameraPtMat(0, 0) = x / 1000;  // mm -> meters
-        cameraPtMat(1, 0) = y / 1000;  // mm -> meters
-        cameraPtMat(2, 0) = z / 1000;  // mm -> meters
-        cameraPtMat(3, 0) = 1.0f;
-
-        cv::Mat_<float> worldPtMat = poseMat * cameraPtMat;
-
-        rs::core::point3dF32 world_pt;
-        world_pt.x = worldPtMat(0, 0);
-        world_pt.y = worldPtMat(1, 0);
-        world_pt.z = worldPtMat(2, 0);
-
-        return world_pt;
+        pt_person_message person = {};
+        person.pid = snapshot.ids[index];
+        std::copy(snapshot.boxes.begin() + 4 * index, snapshot.boxes.begin() + 4 * index + 4, person.box);
+        std::copy(snapshot.center_mass_image.begin() + 2 * index, snapshot.center_mass_image.begin() + 2 * index + 2,
+                  person.center_mass_image);
+        std::copy(snapshot.center_mass_world.begin() + 3 * index, snapshot.center_mass_world.begin() + 3 * index + 3,
+                  person.center_mass_world);
+        return person;
     }
 
+    // Poses closer than this on every axis, in meters, were sent already
+    static constexpr float person_pose_distance = 0.5f;
 
+    spatial_index m_person_poses;
 
-    vector<rs::core::point3dF32> m_person_pose_set;
-
-    bool filter_person_based_on_pose(rs::core::point3dF32 new_person_pose)
+    bool filter_person_based_on_pose(const rs::core::point3dF32 &new_person_pose)
     {
-        for (rs::core::point3dF32 &pose: m_person_pose_set)
-        {
-            if (abs(new_person_pose.x - pose.x) < 0.5 && abs(new_person_pose.y - pose.y) < 0.5
-                    && abs(new_person_pose.z - pose.z) < 0.5)
-            {
-                // Filter it out
-                return true;
-            }
-
-        }
-        m_person_pose_set.push_back(new_person_pose);
-
-        return false;
-
+        return m_person_poses.find_or_insert(new_person_pose);
     }
 
     std::string orientation_to_string(
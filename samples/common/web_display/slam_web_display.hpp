@@ -16,11 +16,11 @@
 #include <sys/stat.h>
 
 #include "transporter_proxy.hpp"
+#include "web_messages.hpp"
 
 using namespace std;
 using namespace rs::core;
 using namespace rs::slam;
-using nlohmann::json;
 
 namespace web_display
 {
@@ -40,25 +40,28 @@ public:
 
     void on_reset_competed()
     {
-        json msg;
-        msg["type"] = "event";
-        msg["event"] = "on_reset_completed";
-
-        m_transporter_proxy->send_json_data(msg);
+        m_transporter_proxy->send_json_message([&](json_writer& writer)
+        {
+            write_event_message(writer, "on_reset_completed");
+        });
     }
 
     void on_pose(int tracking, float* pose)
     {
-        json msg;
-        msg["type"] = "tracking";
-        msg["tracking"] = tracking;
-        json& p = msg["pose"];
-        for (int i = 0; i < 12; i++)
+        m_transporter_proxy->send_json_message([&](json_writer& writer)
         {
-            p += pose[i];
-        }
-        m_transporter_proxy->send_json_data(msg);
+            write_pose_message(writer, tracking, pose);
+        });
+
+    }
 
+    // High-rate pose propagated with IMU data between SLAM updates, timestamps in ms
+    void on_predicted_pose(int tracking, double timestamp, double anchor_timestamp, const float* pose)
+    {
+        m_transporter_proxy->send_json_message([&](json_writer& writer)
+        {
+            write_predicted_pose_message(writer, tracking, timestamp, anchor_timestamp, pose);
+        });
     }
 
     void on_occupancy(float scale, int size, const int* data)
@@ -70,14 +73,19 @@ public:
     void on_fps(const char* type, float fisheye, float depth,
                 float accelerometer, float gyroscope)
     {
-        json msg;
-        msg["type"] = "fps";
-        msg["fps"]["type"] = type;
-        msg["fps"]["fisheye"] = fisheye;
-        msg["fps"]["depth"] = depth;
-        msg["fps"]["accelerometer"] = accelerometer;
-        msg["fps"]["gyroscope"] = gyroscope;
-        m_transporter_proxy->send_json_data(msg);
+        m_transporter_proxy->send_json_message([&](json_writer& writer)
+        {
+            write_fps_message(writer, type, fisheye, depth, accelerometer, gyroscope);
+        });
+    }
+
+    // Latency percentiles of one pipeline stage, in ms
+    void on_latency(const std::string& stage, const latency_snapshot& latency)
+    {
+        m_transporter_proxy->send_json_message([&](json_writer& writer)
+        {
+            write_latency_message(writer, stage, latency);
+        });
     }
 
     void on_fisheye_frame(uint64_t ts_micros, int width, int height,
@@ -5,8 +5,12 @@
 #define _GNU_SOURCE
 #endif
 #include "transporter.hpp"
+#include "pipeline_trace.hpp"
 #include <seasocks/Logger.h>
+#include <seasocks/PageHandler.h>
 #include <seasocks/PrintfLogger.h>
+#include <seasocks/Request.h>
+#include <seasocks/Response.h>
 #include <seasocks/Server.h>
 #include <seasocks/StringUtil.h>
 #include <seasocks/WebSocket.h>
@@ -17,6 +21,7 @@
 #include <set>
 #include <thread>
 #include <condition_variable>
+#include <vector>
 
 #include <stdio.h>
 #include <unistd.h>
@@ -48,6 +53,7 @@ class WsTransporter : public Transporter
     unique_ptr<Server> server;
     shared_ptr<Logger> logger;
     shared_ptr<WebSocket::Handler> websocket_handler;
+    shared_ptr<PageHandler> text_page_handler;
 
     // thread synchronization stuff
     mutex mut;
@@ -69,6 +75,31 @@ class WsTransporter : public Transporter
     };
     friend class SocksHandler;
 
+    // Serves dynamically generated text pages (e.g. metrics) next to the static UI files
+    class TextPageHandler: public PageHandler
+    {
+    public:
+        shared_ptr<Response> handle(const Request& request) override
+        {
+            if (request.verb() != Request::Get)
+            {
+                return Response::unhandled();
+            }
+            string uri = request.getRequestUri();
+            uri = uri.substr(0, uri.find('?'));
+            for (auto& page : pages)
+            {
+                if (page.first == uri)
+                {
+                    return Response::textResponse(page.second());
+                }
+            }
+            return Response::unhandled();
+        }
+
+        vector<pair<string, function<string()>>> pages;
+    };
+
 
     // wait for started_cond
     void wait_for_server_status(bool expectedStatus)
@@ -98,6 +129,15 @@ public:
         return server_available;
     }
 
+    void add_text_page(const std::string& uri, std::function<std::string()> content) override
+    {
+        if (!text_page_handler)
+        {
+            text_page_handler.reset(new TextPageHandler());
+        }
+        static_cast<TextPageHandler*>(text_page_handler.get())->pages.emplace_back(uri, content);
+    }
+
     // Returns IP address according to preference
     // 0=nothing,  1=lo,  2=others,  3=wl,  4=en
 
@@ -187,6 +227,10 @@ public:
             server->addWebSocketHandler("/",
                                         websocket_handler,
                                         true);  //allow cross orgin
+            if (text_page_handler)
+            {
+                server->addPageHandler(text_page_handler);
+            }
             server->serve(serverPath, websocketPort);
             notify_server_status(false);
         });
@@ -239,6 +283,7 @@ public:
 
         server->execute([this, shared_buf, size]
         {
+            TRACE_SPAN("websocket_send", -1, "binary");
             for (WebSocket* ws : connections)
             {
                 ws->send(shared_buf.get(), size);
@@ -253,12 +298,18 @@ public:
     }
 
     void send_data_string(std::string string) override
+    {
+        send_data_string(std::make_shared<const std::string>(std::move(string)));
+    }
+
+    void send_data_string(std::shared_ptr<const std::string> string) override
     {
         server->execute([this, string]
         {
+            TRACE_SPAN("websocket_send", -1, "json");
             for (WebSocket* ws : connections)
             {
-                ws->send(string);
+                ws->send(*string);
             }
         });
     }
@@ -3,6 +3,7 @@
 
 #pragma once
 
+#include <functional>
 #include <memory>
 #include <string>
 #include <stdint.h>
@@ -25,6 +26,10 @@ public:
     virtual void send_data(const iovector* iov, const int count) = 0;
     virtual void send_data(void *data, size_t len) = 0;
     virtual void send_data_string(std::string string) = 0;
+    // Sends the text in string, which must not change until the transporter drops its reference
+    virtual void send_data_string(std::shared_ptr<const std::string> string) = 0;
+    // Serves the text returned by content on GET requests for uri, must be called before connect()
+    virtual void add_text_page(const std::string& uri, std::function<std::string()> content) = 0;
     virtual ~Transporter() = default;
 };
 
@@ -9,7 +9,11 @@
 
 #include "transporter.hpp"
 #include "jpeg.hpp"
+#include "json_writer.hpp"
 #include "concurrency.hpp"
+#include "latency_histogram.hpp"
+#include "metrics_registry.hpp"
+#include "pipeline_trace.hpp"
 
 using namespace std;
 using namespace transport;
@@ -89,9 +93,38 @@ public:
         transporter->disconnect();
     }
 
-    void send_json_data(json msg)
+    // Calls write with a writer on a pooled buffer and moves the message to the transporter, the
+    // buffer goes back to the pool after the message was sent
+    template<typename Write>
+    void send_json_message(Write write)
     {
-        transporter->send_data_string(msg.dump());//Dump converts JSON object to string format
+        send_json_data(make_json_message(write));
+    }
+
+    // The message write writes, on a pooled buffer
+    template<typename Write>
+    std::shared_ptr<std::string> make_json_message(Write write)
+    {
+        std::shared_ptr<std::string> msg = json_buffers.acquire();
+        web_display::json_writer writer(*msg);
+        write(writer);
+        return msg;
+    }
+
+    void send_json_data(std::shared_ptr<std::string> msg)
+    {
+        count_sent(JsonMessage, msg->size());
+        transporter->send_data_string(std::move(msg));
+    }
+
+    // Sends the message from the image thread, after the images passed to on_rgb_frame() and
+    // on_fisheye_frame() before it
+    void send_json_data_after_images(std::shared_ptr<std::string> msg)
+    {
+        image_queue.add([this, msg]()
+        {
+            send_json_data(msg);
+        });
     }
 
     void set_control_callbacks(display_controls controls)
@@ -171,6 +204,7 @@ public:
             {(void *)tiles, sizeof(int) * count * 3}
         };
 
+        count_sent(MsgType::MapUpdate, sizeof(map) + sizeof(int) * count * 3);
         transporter->send_data(iov, 2);
     }
 
@@ -188,6 +222,7 @@ public:
 
         unacked_messages[MsgType::FishEye]++;
 
+        const int64_t received_ns = latency_clock_ns();
         static const int scale_f = 2;
         const auto format = CompressionUtils::Format::RAW8;
         shared_ptr<char> scale_buf(new char[(width/scale_f+1) * (height/scale_f+1)]);
@@ -212,8 +247,11 @@ public:
             if (use_jpeg)
             {
                 md.format = MsgImageFormat::Jpeg;
+                TRACE_SPAN("jpeg_encode", -1, "fisheye");
+                const int64_t encode_start_ns = latency_clock_ns();
                 image_sz = jpeg_compressor.compress(scale_buf.get(), format, md.width, md.height,
                                                     comp_buf);
+                encode_seconds[MsgType::FishEye]->observe((latency_clock_ns() - encode_start_ns) / 1e9);
                 image_buf = comp_buf;
             }
 
@@ -222,7 +260,9 @@ public:
                 {&md, sizeof(MsgImage)},
                 {image_buf, image_sz}
             };
+            count_sent(MsgType::FishEye, sizeof(MsgImage) + image_sz);
             transporter->send_data(iov, 2);
+            send_latency.record_since(received_ns);
             std::this_thread::yield();
         });
     }
@@ -231,6 +271,7 @@ public:
     void on_rgb_frame(uint64_t ts_micros, int width,
                       int height, const void* data)
     {
+        const int64_t received_ns = latency_clock_ns();
         int scale_f = 2;
         if(width == 320)
         {
@@ -270,8 +311,11 @@ public:
             if (use_jpeg)
             {
                 md.format = MsgImageFormat::Jpeg;
+                TRACE_SPAN("jpeg_encode", -1, "rgb");
+                const int64_t encode_start_ns = latency_clock_ns();
                 image_sz = jpeg_compressor.compress(scale_buf.get(), format, md.width, md.height,
                                                     comp_buf);
+                encode_seconds[MsgType::RGB]->observe((latency_clock_ns() - encode_start_ns) / 1e9);
                 image_buf = comp_buf;
             }
 
@@ -280,24 +324,56 @@ public:
                 {&md, sizeof(MsgImage)},
                 {image_buf, image_sz}
             };
+            count_sent(MsgType::RGB, sizeof(MsgImage) + image_sz);
             transporter->send_data(iov, 2);
+            send_latency.record_since(received_ns);
             std::this_thread::yield();
         });
     }
 
 
 private:
-    transporter_proxy(const char* path, int port, bool jpeg)
+    transporter_proxy(const char* path, int port, bool jpeg) :
+        send_latency(latency_registry::get_instance().get_histogram("frame->websocket"))
     {
         // Construct
         use_jpeg = jpeg;
         transporter = make_transporter(*this, path, port);
         jpeg_compressor.set_quality(80);
 
+        register_metrics();
+
+        // Prometheus scrape endpoint next to the UI
+        transporter->add_text_page("/metrics", []()
+        {
+            return metrics_registry::get_instance().render_prometheus();
+        });
+
         // SStart transport
         start();
     }
 
+    void register_metrics()
+    {
+        static const char* type_names[MaxType] = { "json", "map", "fisheye", "rgb", "pt", "or" };
+        static const std::vector<double> encode_bounds = { 0.001, 0.002, 0.005, 0.01, 0.02, 0.05, 0.1 };
+        auto& registry = metrics_registry::get_instance();
+        for (int i = 0; i < MaxType; i++)
+        {
+            metric_labels labels = { { "type", type_names[i] } };
+            sent_messages[i] = &registry.get_counter("rs_transport_messages_total", "Messages sent to the web clients", labels);
+            sent_bytes[i] = &registry.get_counter("rs_transport_bytes_total", "Bytes sent to the web clients", labels);
+            encode_seconds[i] = &registry.get_histogram("rs_encode_seconds", "Time to JPEG encode a frame for the web clients",
+                                                        encode_bounds, labels);
+        }
+    }
+
+    void count_sent(int type, size_t bytes)
+    {
+        sent_messages[type]->inc();
+        sent_bytes[type]->inc(bytes);
+    }
+
     void start()
     {
         for (int i = 0; i < MaxType; i++) unacked_messages[i] = 0;
@@ -306,10 +382,20 @@ private:
     }
 
     std::unique_ptr<Transporter> transporter;
+    web_display::json_buffer_pool json_buffers;
     ConcurrencyUtils::WorkQueue image_queue;
     CompressionUtils::JpegCompressor jpeg_compressor;
     bool use_jpeg;
 
+    // Time from a frame being handed to the display until it is sent
+    latency_histogram& send_latency;
+
+    // Encode and transport metrics per message type, JsonMessage for JSON messages
+    static const int JsonMessage = 0;
+    metric_counter* sent_messages[MaxType];
+    metric_counter* sent_bytes[MaxType];
+    metric_histogram* encode_seconds[MaxType];
+
     // Server stuff
     display_controls control_callbacks;
 
@@ -0,0 +1,299 @@
+// License: Apache 2.0. See LICENSE file in root directory.
+// Copyright(c) 2017 Intel Corporation. All Rights Reserved.
+
+#pragma once
+
+#include <string>
+#include <vector>
+
+#include "rs/core/types.h"
+
+#include "json_writer.hpp"
+#include "latency_histogram.hpp"
+
+// The JSON messages of the web displays, written from typed results with json_writer. The
+// displays copy what they send out of the SDK outputs into these structs, so the messages can be
+// written, and benchmarked, without the SDK modules.
+namespace web_display
+{
+
+// An object found by object recognition
+struct or_object_message
+{
+    const std::string* label;  // not owned, e.g. a name in the or_label_table
+    float confidence;
+    float position[3];        // world pose or camera center coordinates, depending on the message
+    rs::core::rect roi;
+};
+
+// A person found by person tracking
+struct pt_person_message
+{
+    int pid;
+    bool has_rid;
+    int rid;                  // recognition id, if has_rid
+    bool has_pose;
+    float pose[3];            // world pose, if has_pose
+    int box[4];               // x, y, w, h
+    float center_mass_image[2];
+    float center_mass_world[3];
+};
+
+struct pt_head_pose_message
+{
+    int pid;
+    bool has_head_box;
+    int head_box[4];          // x, y, w, h
+    bool has_head_pose;
+    float pitch;
+    float roll;
+    float yaw;
+};
+
+struct pt_gesture_message
+{
+    int pid;
+    int box[4];               // x, y, w, h
+    bool pointing;
+    float color_origin[2];
+    float color_direction[2];
+    float world_origin[3];
+    float world_direction[3];
+};
+
+inline void write_rectangle(json_writer& writer, const rs::core::rect& roi)
+{
+    const int rectangle[] = { roi.x, roi.y, roi.width, roi.height };
+    writer.array("rectangle", rectangle, 4);
+}
+
+inline void write_xy(json_writer& writer, const char* name, const float* point)
+{
+    writer.key(name).begin_object().field("x", point[0]).field("y", point[1]).end_object();
+}
+
+inline void write_xyz(json_writer& writer, const char* name, const float* point)
+{
+    writer.key(name).begin_object().field("x", point[0]).field("y", point[1]).field("z", point[2]).end_object();
+}
+
+inline void write_box(json_writer& writer, const char* name, const int* box)
+{
+    writer.key(name).begin_object().field("x", box[0]).field("y", box[1]).field("w", box[2]).field("h", box[3]).end_object();
+}
+
+// "object_recognition" (deduplicated objects for the map) or "unfilter_object_recognition", with
+// the objects at the indices in selection or with all of them
+inline void write_or_objects_message(json_writer& writer, bool filtered, const std::vector<or_object_message>& objects,
+                                     const std::vector<size_t>* selection = nullptr)
+{
+    writer.begin_object();
+    writer.field("type", filtered ? "object_recognition" : "unfilter_object_recognition");
+    writer.key("Object_result").begin_array();
+    size_t count = selection ? selection->size() : objects.size();
+    for (size_t i = 0; i < count; ++i)
+    {
+        const or_object_message& object = objects[selection ? (*selection)[i] : i];
+        writer.begin_object();
+        writer.field("label", *object.label).field("confidence", object.confidence);
+        writer.array("pose", object.position, 3);
+        write_rectangle(writer, object.roi);
+        writer.end_object();
+    }
+    writer.end_array();
+    writer.end_object();
+}
+
+// "object_localization", or "object_localization_none" without results
+inline void write_localization_message(json_writer& writer, const std::vector<or_object_message>& objects)
+{
+    writer.begin_object();
+    if (objects.empty())
+    {
+        writer.field("type", "object_localization_none");
+        writer.end_object();
+        return;
+    }
+    writer.field("type", "object_localization");
+    writer.key("Object_result").begin_array();
+    for (auto& object : objects)
+    {
+        writer.begin_object();
+        writer.field("label", *object.label).field("confidence", object.confidence);
+        writer.array("centerCoord", object.position, 3);
+        write_rectangle(writer, object.roi);
+        writer.end_object();
+    }
+    writer.end_array();
+    writer.end_object();
+}
+
+inline void write_recognition_message(json_writer& writer, const std::string& label, float confidence)
+{
+    writer.begin_object();
+    writer.field("type", "object_recognition");
+    writer.key("Object_result").begin_array();
+    writer.begin_object().field("label", label).field("confidence", confidence).end_object();
+    writer.end_array();
+    writer.end_object();
+}
+
+// "object_tracking": labels and tracked rois
+inline void write_tracking_message(json_writer& writer, const std::vector<or_object_message>& objects)
+{
+    writer.begin_object();
+    writer.field("type", "object_tracking");
+    writer.key("Object_result").begin_array();
+    for (auto& object : objects)
+    {
+        writer.begin_object();
+        writer.field("label", *object.label);
+        write_rectangle(writer, object.roi);
+        writer.end_object();
+    }
+    writer.end_array();
+    writer.end_object();
+}
+
+inline void write_label_list_message(json_writer& writer, const std::vector<std::string>& labels)
+{
+    writer.begin_object();
+    writer.field("type", "object_recognition_label_list");
+    writer.key("list").begin_array();
+    for (auto& label : labels)
+    {
+        writer.value(label);
+    }
+    writer.end_array();
+    writer.end_object();
+}
+
+// "person_tracking" with the cumulative person count, or "person_tracking_data" with world poses
+inline void write_persons_message(json_writer& writer, const char* type, const std::vector<pt_person_message>& persons,
+                                  bool with_cumulative_total, int cumulative_total)
+{
+    writer.begin_object();
+    writer.field("type", type);
+    writer.key("Object_result").begin_array();
+    for (auto& person : persons)
+    {
+        writer.begin_object();
+        writer.field("pid", person.pid);
+        if (with_cumulative_total)
+        {
+            writer.field("cumulative_total", cumulative_total);
+        }
+        if (person.has_rid)
+        {
+            writer.field("rid", person.rid);
+        }
+        if (person.has_pose)
+        {
+            writer.array("pose", person.pose, 3);
+        }
+        write_box(writer, "person_bounding_box", person.box);
+        write_xy(writer, "center_mass_image", person.center_mass_image);
+        write_xyz(writer, "center_mass_world", person.center_mass_world);
+        writer.end_object();
+    }
+    writer.end_array();
+    writer.end_object();
+}
+
+inline void write_head_pose_message(json_writer& writer, const pt_head_pose_message& person)
+{
+    writer.begin_object();
+    writer.field("type", "person_tracking");
+    writer.key("Object_result").begin_array();
+    writer.begin_object();
+    writer.field("pid", person.pid);
+    if (person.has_head_box)
+    {
+        write_box(writer, "head_bounding_box", person.head_box);
+    }
+    if (person.has_head_pose)
+    {
+        writer.key("head_pose").begin_object();
+        writer.field("pitch", person.pitch).field("roll", person.roll).field("yaw", person.yaw);
+        writer.end_object();
+    }
+    writer.end_object();
+    writer.end_array();
+    writer.end_object();
+}
+
+inline void write_gesture_message(json_writer& writer, const pt_gesture_message& person)
+{
+    writer.begin_object();
+    writer.field("type", "person_tracking");
+    writer.key("Object_result").begin_array();
+    writer.begin_object();
+    writer.field("pid", person.pid);
+    write_box(writer, "person_bounding_box", person.box);
+    if (person.pointing)
+    {
+        writer.key("gesture_color_coordinates").begin_object();
+        write_xy(writer, "origin", person.color_origin);
+        write_xy(writer, "direction", person.color_direction);
+        writer.end_object();
+        writer.key("gesture_world_coordinates").begin_object();
+        write_xyz(writer, "origin", person.world_origin);
+        write_xyz(writer, "direction", person.world_direction);
+        writer.end_object();
+    }
+    writer.end_object();
+    writer.end_array();
+    writer.end_object();
+}
+
+// "tracking" or "predicted_pose": the 3x4 camera pose
+inline void write_pose_message(json_writer& writer, int tracking, const float* pose)
+{
+    writer.begin_object();
+    writer.field("type", "tracking").field("tracking", tracking);
+    writer.array("pose", pose, 12);
+    writer.end_object();
+}
+
+inline void write_predicted_pose_message(json_writer& writer, int tracking, double timestamp, double anchor_timestamp,
+                                         const float* pose)
+{
+    writer.begin_object();
+    writer.field("type", "predicted_pose").field("tracking", tracking);
+    writer.field("timestamp", timestamp).field("anchor_timestamp", anchor_timestamp);
+    writer.array("pose", pose, 12);
+    writer.end_object();
+}
+
+inline void write_fps_message(json_writer& writer, const char* type, float fisheye, float depth,
+                              float accelerometer, float gyroscope)
+{
+    writer.begin_object();
+    writer.field("type", "fps");
+    writer.key("fps").begin_object();
+    writer.field("type", type).field("fisheye", fisheye).field("depth", depth);
+    writer.field("accelerometer", accelerometer).field("gyroscope", gyroscope);
+    writer.end_object();
+    writer.end_object();
+}
+
+inline void write_latency_message(json_writer& writer, const std::string& stage, const latency_snapshot& latency)
+{
+    writer.begin_object();
+    writer.field("type", "latency");
+    writer.key("latency").begin_object();
+    writer.field("stage", stage).field("count", latency.count).field("mean", latency.mean);
+    writer.field("p50", latency.p50).field("p90", latency.p90).field("p99", latency.p99);
+    writer.field("p99.9", latency.p999).field("max", latency.max);
+    writer.end_object();
+    writer.end_object();
+}
+
+inline void write_event_message(json_writer& writer, const char* event)
+{
+    writer.begin_object();
+    writer.field("type", "event").field("event", event);
+    writer.end_object();
+}
+
+}
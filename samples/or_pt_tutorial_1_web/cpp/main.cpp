@@ -6,6 +6,7 @@
 #include <signal.h>
 #include "version.h"
 #include "pt_utils.hpp"
+#include "frame_dispatcher.hpp"
 #include "pt_console_display.hpp"
 #include "pt_web_display.hpp"
 #include "or_console_display.hpp"
@@ -18,16 +19,13 @@ using namespace rs::object_recognition;
 // Version number of the samples
 extern constexpr auto rs_sample_version = concat("VERSION: ",RS_SAMPLE_VERSION_STR);
 
-// Doing the OR processing for a frame can take longer than the frame interval, so we
-// keep track of whether or not we are still processing the last frame.
-bool is_or_processing_frame = false;
 unique_ptr<web_display::pt_web_display> pt_web_view;
 unique_ptr<web_display::or_web_display> or_web_view;
 
 unique_ptr<console_display::pt_console_display> pt_console_view;
 unique_ptr<console_display::or_console_display> or_console_view;
 
-void processing_OR(correlated_sample_set or_sample_set, or_video_module_impl* impl, or_data_interface* or_data,
+void processing_OR(correlated_sample_set& or_sample_set, or_video_module_impl* impl, or_data_interface* or_data,
                    or_configuration_interface* or_configuration)
 {
     rs::core::status st;
@@ -39,7 +37,6 @@ void processing_OR(correlated_sample_set or_sample_set, or_video_module_impl* im
     st = impl->process_sample_set(or_sample_set);
     if (st != rs::core::status_no_error)
     {
-        is_or_processing_frame = false;
         return;
     }
 
@@ -48,7 +45,6 @@ void processing_OR(correlated_sample_set or_sample_set, or_video_module_impl* im
     st = or_data->query_localization_result(&localization_data, array_size);
     if (st != rs::core::status_no_error)
     {
-        is_or_processing_frame = false;
         return;
     }
 
@@ -58,8 +54,6 @@ void processing_OR(correlated_sample_set or_sample_set, or_video_module_impl* im
         or_console_view->on_object_localization_data(localization_data, array_size, or_configuration);
         or_web_view->on_object_localization_data(localization_data, array_size, or_configuration);
     }
-
-    is_or_processing_frame = false;
 }
 
 int main(int argc,char* argv[])
@@ -115,49 +109,44 @@ int main(int argc,char* argv[])
     pt_web_view = move(web_display::make_pt_web_display(sample_name, 8000, true));
 
 
-    cout << endl << "-------- Press Esc key to exit --------" << endl << endl;
-
-    while (!pt_utils.user_request_exit())
+    // Every frame is captured once and handed to both modules. Doing the OR processing for a frame
+    // can take longer than the frame interval, so it runs on its own thread and always picks up the
+    // newest frame, while person tracking runs on every frame in the capture loop.
+    frame_dispatcher dispatcher;
+    dispatcher.add_worker("object recognition", [&](correlated_sample_set& or_sample_set)
+    {
+        processing_OR(or_sample_set, &impl, or_data, or_configuration);
+    });
+    dispatcher.add_consumer([&](correlated_sample_set& pt_sample_set)
     {
-        //Get next frame
-        rs::core::correlated_sample_set* sample_set = pt_utils.get_sample_set(colorInfo,depthInfo);
-        rs::core::correlated_sample_set* sample_set_pt = pt_utils.get_sample_set(colorInfo,depthInfo);
-
-        //Increment reference count of images at sample set
-        for (int i = 0; i < static_cast<uint8_t>(rs::core::stream_type::max); ++i)
-        {
-            if (sample_set_pt->images[i] != nullptr)
-            {
-                sample_set_pt->images[i]->add_ref();
-            }
-        }
-
         //Draw Color frames
-        auto colorImage = (*sample_set)[rs::core::stream_type::color];
+        auto colorImage = pt_sample_set[rs::core::stream_type::color];
         pt_web_view->on_rgb_frame(10, colorImage->query_info().width, colorImage->query_info().height, colorImage->query_data());
 
-        //Run OR in a separate thread. Update GUI with the result
-        if (!is_or_processing_frame)         // If we aren't already processing or for a frame:
-        {
-            is_or_processing_frame = true;
-            std::thread recognition_thread(processing_OR, *sample_set,
-                                           &impl, or_data, or_configuration);
-            recognition_thread.detach();
-        }
-
         //Run Person Tracking
-        if (ptModule->process_sample_set(*sample_set_pt) != rs::core::status_no_error)
+        if (ptModule->process_sample_set(pt_sample_set) != rs::core::status_no_error)
         {
             cerr << "error : failed to process sample" << endl;
-            continue;
+            return;
         }
 
         //Update GUI with PT result
         pt_console_view->on_person_info_update(ptModule);
         pt_web_view->on_PT_tracking_update(ptModule);
+    });
+
+    cout << endl << "-------- Press Esc key to exit --------" << endl << endl;
+
+    while (!pt_utils.user_request_exit())
+    {
+        //Get next frame
+        rs::core::correlated_sample_set* sample_set = pt_utils.get_sample_set(colorInfo,depthInfo);
 
+        //Run OR and person tracking on it, and update GUI with the results
+        dispatcher.dispatch(*sample_set);
     }
 
+    dispatcher.stop();
     pt_utils.stop_camera();
     actualModuleConfig.projection->release();
 
@@ -1,8 +1,10 @@
 // License: Apache 2.0. See LICENSE file in root directory.
 // Copyright(c) 2017 Intel Corporation. All Rights Reserved.
 
-#include <thread>
+#include <algorithm>
+#include <atomic>
 #include <iostream>
+#include <mutex>
 #include "version.h"
 #include "or_utils.hpp"
 #include "or_console_display.hpp"
@@ -14,131 +16,169 @@ using namespace rs::object_recognition;
 // Version number of the samples
 extern constexpr auto rs_sample_version = concat("VERSION: ",RS_SAMPLE_VERSION_STR);
 
-std::vector<std::string> objects_names;
+// Localize again after this many frames, to pick up objects that came into view
+const int localization_interval = 30;
+
+// A fresh localization overlapping a tracked object by at least this much is the same object
+const float same_object_overlap = 0.3f;
+
+struct tracked_object
+{
+    std::string name;
+    rs::core::rect roi;
+};
+
 image_info colorInfo, depthInfo;
-bool is_localize=true;
-bool is_tracking=false;
 
-// Doing the OR processing for a frame can take longer than the frame interval, so we
-// keep track of whether or not we are still processing the last frame.
-bool is_or_processing_frame = false;
-bool is_exit = false;
+// The objects the tracker follows, in the order of its rois. Guarded by objects_mutex, which is
+// also held while the tracker rois are updated so the generation matches the objects.
+std::mutex objects_mutex;
+std::vector<tracked_object> objects;
+uint64_t objects_generation = 0;
 
-unique_ptr<console_display::or_console_display>    console_view;
+// Set by the result handlers, read by the main loop
+std::atomic<bool> is_tracking(false);
+std::atomic<bool> tracking_requested(false);
+std::atomic<bool> localization_requested(false);
 
-// Use a queue to hold the sample set waiting for processing
-blocking_queue<correlated_sample_set*> sample_set_queue;
+unique_ptr<console_display::or_console_display>    console_view;
 
-// After the localization has done we track the found objects
-void setTracking(const image_info& colorInfo, or_configuration_interface* or_configuration,
-                 const localization_data* localization_data, const int array_size)
+// Intersection over union of two rois
+float overlap(const rs::core::rect& a, const rs::core::rect& b)
 {
-    // Change mode to tracking
-    or_configuration->set_recognition_mode(rs::object_recognition::recognition_mode::TRACKING);
-
-    // Prepare rois for tracking
-    rs::core::rect* trackingRois = new rs::core::rect[array_size];
-    for (int i = 0; i< array_size; i++)
+    int width = std::min(a.x + a.width, b.x + b.width) - std::max(a.x, b.x);
+    int height = std::min(a.y + a.height, b.y + b.height) - std::max(a.y, b.y);
+    if (width <= 0 || height <= 0)
     {
-
-        rs::core::rect roi= {localization_data[i].roi.x,localization_data[i].roi.y,
-                             localization_data[i].roi.width,localization_data[i].roi.height
-                            };
-        trackingRois[i] =roi;
+        return 0.0f;
     }
+    float intersection = static_cast<float>(width) * height;
+    return intersection / (static_cast<float>(a.width) * a.height + static_cast<float>(b.width) * b.height - intersection);
+}
 
-    // Set the rois
-    or_configuration->set_tracking_rois(trackingRois, array_size);
-    delete[] trackingRois;
-    status st = or_configuration->apply_changes();
-    if (st != rs::core::status_no_error)
-        exit(1);
-
-    // Set the state accordingly
-    is_localize = false;
-    is_tracking = true;
+// The tracker doesn't report a confidence, an object is lost when its roi collapses or leaves the image
+bool is_lost(const rs::core::rect& roi)
+{
+    return roi.width <= 0 || roi.height <= 0 ||
+           roi.x + roi.width <= 0 || roi.y + roi.height <= 0 ||
+           roi.x >= static_cast<int>(colorInfo.width) || roi.y >= static_cast<int>(colorInfo.height);
 }
 
-// Run object tracking and sending result to view
-void run_object_tracking(or_video_module_impl* impl, or_data_interface* or_data,
-                         or_configuration_interface* or_configuration)
+// Called with objects_mutex held: passes the objects to the tracker without waiting for it
+void update_tracker(or_engine_pool& tracker)
 {
-    rs::core::status st;
+    std::vector<rs::core::rect> rois;
+    for (auto& object : objects)
+    {
+        rois.push_back(object.roi);
+    }
+    if (tracker.update_tracking_rois(rois.data(), static_cast<int>(rois.size())) == rs::core::status_no_error)
+    {
+        objects_generation = tracker.query_tracking_generation();
+    }
+}
 
-    // Declare data structure and size for results
-    localization_data* localization_data = nullptr;
-    rs::object_recognition::tracking_data* tracking_data = nullptr;
-    int array_size=0;
+// Merges the objects of a background localization into the tracked ones. Objects that are tracked
+// already keep their tracked roi, which is newer than the localized frame; new objects are added.
+void on_localization_result(or_frame_result& result, or_engine_pool& localizer, or_engine_pool& tracker)
+{
+    if (result.status != rs::core::status_no_error || result.localization.empty())
+    {
+        return;
+    }
 
-    correlated_sample_set* or_sample_set = nullptr;
+    std::vector<std::string> names;
+    console_view->on_object_tracking_data(result.localization.data(), nullptr, localizer.get_configuration(),
+                                          static_cast<int>(result.localization.size()), true, names);
 
-    while(!is_exit && (or_sample_set = sample_set_queue.pop()) != NULL)
+    std::lock_guard<std::mutex> lock(objects_mutex);
+    size_t tracked_count = objects.size();
+    for (size_t i = 0; i < result.localization.size(); ++i)
     {
-        if (is_localize || is_tracking)
+        rs::core::rect roi = result.localization[i].roi;
+        auto same = std::find_if(objects.begin(), objects.begin() + tracked_count, [&](const tracked_object& object)
+        {
+            return overlap(object.roi, roi) >= same_object_overlap;
+        });
+        if (same != objects.begin() + tracked_count)
         {
-            // Run object localization or tracking processing
-            st = impl->process_sample_set(*or_sample_set);
+            same->name = names[i];
+        }
+        else
+        {
+            objects.push_back({names[i], roi});
+        }
+    }
 
-            // Recycle sample set after processing complete
-            if((*or_sample_set)[stream_type::color])
-                (*or_sample_set)[stream_type::color]->release();
-            if((*or_sample_set)[stream_type::depth])
-                (*or_sample_set)[stream_type::depth]->release();
+    if (is_tracking)
+    {
+        update_tracker(tracker);
+    }
+    else
+    {
+        // The main loop switches the tracker to tracking mode
+        tracking_requested = true;
+    }
+}
 
-            (*or_sample_set)[stream_type::color] = nullptr;
-            (*or_sample_set)[stream_type::depth] = nullptr;
+// Displays the tracked objects and drops the lost ones, which triggers a localization
+void on_tracking_result(or_frame_result& result, or_engine_pool& tracker)
+{
+    std::lock_guard<std::mutex> lock(objects_mutex);
 
-            if (st != rs::core::status_no_error)
-            {
-                is_or_processing_frame = false;
-                return;
-            }
+    // Frames tracked with rois that were replaced since don't match the objects any more
+    if (result.status != rs::core::status_no_error || result.tracking_generation != objects_generation ||
+        result.tracking.size() != objects.size())
+    {
+        return;
+    }
 
-            if (is_localize)
-            {
-                // Retrieve localization data from the or_data object
-                st = or_data->query_localization_result(&localization_data, array_size);
-                if (st != rs::core::status_no_error)
-                {
-                    is_or_processing_frame = false;
-                    return;
-                }
-            }
-            else
-            {
-                // Retrieve tracking data from the or_data object
-                st = or_data->query_tracking_result(&tracking_data, array_size);
-                if (st != rs::core::status_no_error)
-                {
-                    is_or_processing_frame = false;
-                    return;
-                }
-            }
+    std::vector<std::string> names;
+    for (size_t i = 0; i < objects.size(); ++i)
+    {
+        objects[i].roi = result.tracking[i].roi;
+        names.push_back(objects[i].name);
+    }
 
-            if (is_localize)
-            {
-                if (localization_data && array_size != 0)
-                {
-                    console_view->on_object_tracking_data(localization_data, tracking_data,
-                                                          or_configuration, array_size, is_localize, objects_names);
-
-                    // After localization has done we want to track the found objects.
-                    setTracking(colorInfo, or_configuration, localization_data, array_size);
-                }
-            }
-            else
-            {
-                // Display the top bounding boxes with object name and probability
-                if (tracking_data)
-                {
-                    console_view->on_object_tracking_data(localization_data, tracking_data,
-                                                          or_configuration, array_size, is_localize, objects_names);
-                }
-            }
-        }
+    // Display the top bounding boxes with object name
+    if (!result.tracking.empty())
+    {
+        console_view->on_object_tracking_data(nullptr, result.tracking.data(), tracker.get_configuration(),
+                                              static_cast<int>(result.tracking.size()), false, names);
+    }
 
-        is_or_processing_frame = false;
+    auto lost = std::remove_if(objects.begin(), objects.end(), [](const tracked_object& object)
+    {
+        return is_lost(object.roi);
+    });
+    if (lost != objects.end())
+    {
+        objects.erase(lost, objects.end());
+        update_tracker(tracker);
     }
+    if (objects.size() < names.size() || objects.empty())
+    {
+        localization_requested = true;
+    }
+}
+
+// Starts tracking the localized objects, the tracker has no frames yet so this doesn't wait
+void setTracking(or_engine_pool& tracker)
+{
+    std::lock_guard<std::mutex> lock(objects_mutex);
+    std::vector<rs::core::rect> rois;
+    for (auto& object : objects)
+    {
+        rois.push_back(object.roi);
+    }
+
+    // Change mode to tracking
+    status st = tracker.start_tracking(rois.data(), static_cast<int>(rois.size()));
+    if (st != rs::core::status_no_error)
+        exit(1);
+
+    objects_generation = tracker.query_tracking_generation();
+    is_tracking = true;
 }
 
 int main(int argc,char* argv[])
@@ -154,38 +194,72 @@ int main(int argc,char* argv[])
     // Start the camera
     or_utils.init_camera(colorInfo,depthInfo,impl,&or_data,&or_configuration, true);
 
-    // Change mode to localization
-    or_configuration->set_recognition_mode(recognition_mode::LOCALIZATION);
-    // Set the localization mechanism to use CNN
-    or_configuration->set_localization_mechanism(localization_mechanism::CNN);
-    // Ignore all objects under 0.7 probability (confidence)
-    or_configuration->set_recognition_confidence(0.7);
+    // Tracking takes less than a frame interval and runs on every frame on one OR engine. Localization
+    // takes several frame intervals, it runs in the background on the other engines
+    // (RS_SAMPLES_OR_ENGINES - 1, at least 1) every localization_interval frames, or as soon as
+    // an object is lost, and its results are merged into the tracked objects.
+    or_engine_pool tracker;
+    st = tracker.init(impl, or_data, or_configuration, or_utils.get_actual_module_config(), 1);
+    if (st != rs::core::status_no_error)
+        return 1;
 
-    st = or_configuration->apply_changes();
+    or_engine_pool localizer;
+    st = localizer.init(or_utils.get_actual_module_config(), std::max<size_t>(or_engine_pool::default_engine_count() - 1, 1));
+    if (st != rs::core::status_no_error)
+        return 1;
+
+    // Change mode to localization
+    st = localizer.configure(recognition_mode::LOCALIZATION, [](or_configuration_interface* configuration)
+    {
+        // Set the localization mechanism to use CNN
+        configuration->set_localization_mechanism(localization_mechanism::CNN);
+        // Ignore all objects under 0.7 probability (confidence)
+        configuration->set_recognition_confidence(0.7);
+    });
     if (st != rs::core::status_no_error)
         return 1;
 
+    localizer.set_result_handler([&](or_frame_result& result)
+    {
+        on_localization_result(result, localizer, tracker);
+    });
+    tracker.set_result_handler([&](or_frame_result& result)
+    {
+        on_tracking_result(result, tracker);
+    });
+
     cout << endl << "-------- Press Esc key to exit --------" << endl << endl;
 
-    // Start background thread to run recognition processing
-    std::thread recognition_thread(run_object_tracking,
-                                   &impl, or_data, or_configuration);
-    recognition_thread.detach();
+    // Start the engine threads that run recognition processing
+    tracker.start();
+    localizer.start();
 
-    while (!(is_exit = or_utils.user_request_exit()))
+    int frames_since_localization = 0;
+    while (!or_utils.user_request_exit())
     {
         // Get the sample set from the camera
         rs::core::correlated_sample_set* sample_set = or_utils.get_sample_set(colorInfo,depthInfo);
 
-        if(!is_or_processing_frame)
+        if (!is_tracking && tracking_requested)
+        {
+            setTracking(tracker);
+        }
+
+        // Track every frame, the engines hold the images
+        if (is_tracking)
         {
-            is_or_processing_frame = true;
+            tracker.submit(*sample_set);
+        }
 
-            // Increase image reference to hold for library processing
-            (*sample_set)[rs::core::stream_type::color]->add_ref();
-            (*sample_set)[rs::core::stream_type::depth]->add_ref();
-            // Push the sample set to queue
-            sample_set_queue.push(sample_set);
+        // Localize until there is something to track, then now and then in the background
+        ++frames_since_localization;
+        if (!is_tracking || localization_requested || frames_since_localization >= localization_interval)
+        {
+            if (localizer.submit(*sample_set))
+            {
+                frames_since_localization = 0;
+                localization_requested = false;
+            }
         }
 
         // Display color image
@@ -193,7 +267,13 @@ int main(int argc,char* argv[])
         console_view->render_color_frames(colorImage);
     }
 
-    // Close the camera
+    // Stop the engines and close the camera
+    localizer.stop();
+    tracker.stop();
+    cout << "Tracking:" << endl;
+    tracker.print_stats();
+    cout << "Localization:" << endl;
+    localizer.print_stats();
     or_utils.stop_camera();
     cout << "-------- Stopping --------" << endl;
 
@@ -1,6 +1,9 @@
 // License: Apache 2.0. See LICENSE file in root directory.
 // Copyright(c) 2017 Intel Corporation. All Rights Reserved.
 
+#include <atomic>
+#include <condition_variable>
+#include <mutex>
 #include <thread>
 #include <iostream>
 #include "version.h"
@@ -23,9 +26,22 @@ bool select_flag = false;
 bool startTracking = false;
 cv::Point point1, point2;
 
-// Doing the OR processing for a frame can take longer than the frame interval, so we
-// keep track of whether or not we are still processing the last frame.
-bool is_or_processing_frame = false;
+// The mouse callback runs on the render thread of the GUI, the tracking thread applies the
+// selected roi (under tracking_mutex) before its next frame
+std::atomic<bool> roi_selected(false);
+rs::core::rect selected_roi;
+std::vector<gui_display::gui_overlay> selection_overlay;
+
+// Frames per second of the window, independent of the tracking rate
+const double gui_refresh_rate = 30;
+
+// Doing the OR processing for a frame can take longer than the frame interval, so tracking runs
+// on its own thread. The main loop posts every frame to the window and hands a frame to the
+// tracking thread whenever it isn't still processing the last one.
+std::atomic<bool> is_or_processing_frame(false);
+std::mutex tracking_mutex;
+std::condition_variable tracking_wake;
+rs::core::correlated_sample_set tracking_sample_set = {};   // the frame handed to the tracking thread
 bool is_exit = false;
 
 unique_ptr<console_display::or_console_display>    console_view;
@@ -51,7 +67,8 @@ void mouseHandler(int event, int x, int y, int flags, void* param)
         roi.y = std::min(point1.y,point2.y);
         roi.width = std::abs(point1.x-point2.x);
         roi.height = std::abs(point1.y-point2.y);
-        gui_view->draw_rect_no_text(cv::Point(roi.x,roi.y),roi.width,roi.height, 5);
+        selection_overlay.assign(1, { cv::Rect(roi.x, roi.y, roi.width, roi.height), 5, std::string() });
+        gui_view->post_overlays(selection_overlay, gui_display::gui_overlay_selection);
 
     }
 
@@ -67,17 +84,15 @@ void mouseHandler(int event, int x, int y, int flags, void* param)
         roi.y = std::min(point1.y,point2.y);
         roi.width = std::abs(point1.x-point2.x);
         roi.height = std::abs(point1.y-point2.y);
+        selection_overlay.clear();
+        gui_view->post_overlays(selection_overlay, gui_display::gui_overlay_selection);
 
-        rs::object_recognition::or_configuration_interface* ptr = reinterpret_cast<rs::object_recognition::or_configuration_interface*>(param);
-
-        //set the chosen tracking roi
-        ptr->set_tracking_rois(&roi,1);
-        rs::core::status st =ptr->apply_changes();
-
-        if (st != rs::core::status_no_error)
-            exit(1);
-
-        startTracking=true;
+        //the tracking thread sets the chosen tracking roi
+        {
+            std::lock_guard<std::mutex> lock(tracking_mutex);
+            selected_roi = roi;
+        }
+        roi_selected = true;
         select_flag = false;
     }
 
@@ -92,8 +107,6 @@ void run_object_tracking(rs::core::correlated_sample_set* or_sample_set, or_vide
     rs::object_recognition::tracking_data* tracking_data = nullptr;
     int array_size=0;
 
-    gui_view->set_color_image((*or_sample_set)[rs::core::stream_type::color]);
-
     // Run object localization or tracking processing
     st = impl->process_sample_set(*or_sample_set);
     // Recycle sample set after processing complete
@@ -121,8 +134,7 @@ void run_object_tracking(rs::core::correlated_sample_set* or_sample_set, or_vide
 
 
     // display the top bounding boxes with object name and probablity
-    gui_view->draw_results(tracking_data, array_size);
-    gui_view->show_results();
+    gui_view->post_results(tracking_data, array_size);
 
     is_or_processing_frame = false;
 
@@ -134,6 +146,40 @@ void run_object_tracking(rs::core::correlated_sample_set* or_sample_set, or_vide
     }
 }
 
+// Tracks the frames the main loop hands over, until is_exit
+void run_tracking_thread(or_video_module_impl* impl, or_data_interface* or_data, or_configuration_interface* or_configuration)
+{
+    while (true)
+    {
+        rs::core::correlated_sample_set or_sample_set = {};
+        rs::core::rect roi;
+        bool new_roi;
+        {
+            std::unique_lock<std::mutex> lock(tracking_mutex);
+            tracking_wake.wait(lock, [] { return is_exit || tracking_sample_set[stream_type::color]; });
+            if (is_exit)
+            {
+                return;
+            }
+            std::swap(or_sample_set, tracking_sample_set);
+            new_roi = roi_selected.exchange(false);
+            roi = selected_roi;
+        }
+
+        //set the tracking roi selected with the mouse
+        if (new_roi)
+        {
+            or_configuration->set_tracking_rois(&roi,1);
+            if (or_configuration->apply_changes() != rs::core::status_no_error)
+            {
+                cerr << "error: failed to set the tracking roi" << endl;
+            }
+        }
+
+        run_object_tracking(&or_sample_set, impl, or_data, or_configuration);
+    }
+}
+
 
 
 int main(int argc,char* argv[])
@@ -163,17 +209,24 @@ int main(int argc,char* argv[])
     if (st != rs::core::status_no_error)
         return 1;
 
-    gui_view->initialize(colorInfo,"Tracking");
-    cv::setMouseCallback(gui_view->get_win_name(),mouseHandler,or_configuration);
+    gui_view->initialize(colorInfo,"Tracking",gui_refresh_rate);
+    gui_view->set_mouse_callback(mouseHandler,nullptr);
 
     cout << endl << "-------- Press Esc key to exit --------" << endl << endl;
 
+    std::thread tracking_thread(run_tracking_thread, &impl, or_data, or_configuration);
 
     while (!or_utils.user_request_exit())
     {
         // Get the sample set from the camera
         rs::core::correlated_sample_set* sample_set = or_utils.get_sample_set(colorInfo,depthInfo);
-        gui_view->set_color_image((*sample_set)[rs::core::stream_type::color]);
+        gui_view->post_color_image((*sample_set)[rs::core::stream_type::color]);
+
+        //track once a roi was selected with the mouse
+        if (roi_selected)
+        {
+            startTracking = true;
+        }
 
         //if tracking already set and no processing now
         if(startTracking && !is_or_processing_frame)
@@ -184,14 +237,33 @@ int main(int argc,char* argv[])
             (*sample_set)[rs::core::stream_type::color]->add_ref();
             (*sample_set)[rs::core::stream_type::depth]->add_ref();
 
-            run_object_tracking(sample_set, &impl, or_data, or_configuration);
-
+            {
+                std::lock_guard<std::mutex> lock(tracking_mutex);
+                tracking_sample_set = *sample_set;
+            }
+            tracking_wake.notify_one();
         }
-        gui_view->show_results();
 
     }
 
-    // Close the camera
+    // Stop tracking, a frame the tracking thread didn't take yet is released here
+    {
+        std::lock_guard<std::mutex> lock(tracking_mutex);
+        is_exit = true;
+    }
+    tracking_wake.notify_one();
+    tracking_thread.join();
+    for (auto image : tracking_sample_set.images)
+    {
+        if (image)
+        {
+            image->release();
+        }
+    }
+
+    // Close the window and the camera
+    gui_view->stop_rendering();
+    gui_view->print_render_stats();
     or_utils.stop_camera();
     cout << "-------- Stopping --------" << endl;
 
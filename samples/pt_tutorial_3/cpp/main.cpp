@@ -48,6 +48,12 @@ int main(int argc, char** argv)
     // Start the camera
     pt_utils.start_camera();
 
+    // Display color images on the output thread, while the next frame is processed
+    pt_utils.set_output_handler([&](rs::core::correlated_sample_set& sampleSet)
+    {
+        console_view->render_color_frames(sampleSet[rs::core::stream_type::color]);
+    });
+
     cout << endl << "-------- Press Esc key to exit --------" << endl << endl;
 
     while(!pt_utils.user_request_exit())
@@ -77,8 +83,7 @@ int main(int argc, char** argv)
         console_view->on_person_pointing_gesture_info_update(ptModule);
 
         // Display color image
-        auto colorImage = sampleSet[rs::core::stream_type::color];
-        console_view->render_color_frames(colorImage);
+        pt_utils.output_frame(sampleSet);
 
         // Release color and depth image
         sampleSet.images[static_cast<uint8_t>(rs::core::stream_type::color)]->release();
@@ -87,6 +92,7 @@ int main(int argc, char** argv)
     }
 
     pt_utils.stop_camera();
+    pt_utils.print_pipeline_stats();
     actualModuleConfig.projection->release();
     cout << "-------- Stopping --------" << endl;
     return 0;
@@ -74,6 +74,16 @@ int main(int argc, char** argv)
     // Create and start remote(Web) view
     web_view = move(web_display::make_pt_web_display(sample_name, 8000, true));
 
+    // Send color images to the GUI on the output thread, while the next frame is processed. The
+    // overlays of a frame follow its image, see set_overlay_frame().
+    // Sending dummy time stamp of 10.
+    pt_utils.set_output_handler([&](rs::core::correlated_sample_set& sampleSet)
+    {
+        auto colorImage = sampleSet[rs::core::stream_type::color];
+        web_view->on_rgb_frame(10, colorImage->query_info().width, colorImage->query_info().height, colorImage->query_data(),
+                               colorImage->query_frame_number());
+    });
+
     cout << endl << "-------- Press Esc key to exit --------" << endl << endl;
 
     while(!pt_utils.user_request_exit())
@@ -94,11 +104,9 @@ int main(int argc, char** argv)
             continue;
         }
 
-        auto colorImage = sampleSet[rs::core::stream_type::color];
-
-        // Sending dummy timestamp of 10
         // Display GUI, pointing gesture info
-        web_view->on_rgb_frame(10, colorImage->query_info().width, colorImage->query_info().height, colorImage->query_data());
+        pt_utils.output_frame(sampleSet);
+        web_view->set_overlay_frame(sampleSet[rs::core::stream_type::color]->query_frame_number());
 
         // Start tracking the first person detected in the frame
         set_tracking(ptModule);
@@ -112,6 +120,7 @@ int main(int argc, char** argv)
     }
 
     pt_utils.stop_camera();
+    pt_utils.print_pipeline_stats();
     actualModuleConfig.projection->release();
     cout << "-------- Stopping --------" << endl;
     return 0;
@@ -10,6 +10,7 @@
 #include "pt_utils.hpp"
 #include "pt_console_display.hpp"
 #include "pt_web_display.hpp"
+#include "pt_recognition_database.hpp"
 
 using namespace std;
 
@@ -18,47 +19,6 @@ unique_ptr<console_display::pt_console_display>    console_view;
 
 const std::string dbPath("./person_recognition_id.db");
 
-void LoadDatabase(Intel::RealSense::PersonTracking::PersonTrackingConfiguration* ptConfiguration)
-{
-    cout << endl << "loading recognition id database: \033[4;36m" + dbPath << "\033[0m" << endl << endl;
-    auto database = ptConfiguration->QueryRecognition()->QueryDatabase();
-    auto dbUtils = ptConfiguration->QueryRecognition()->QueryDatabaseUtilities();
-
-    std::filebuf fb;
-    if (!fb.open (dbPath, std::ios::in | std::ios::binary))
-    {
-        throw  std::runtime_error("failed to open database file");
-    }
-    std::istream is(&fb);
-    is.seekg(0, std::ios::end);
-    int size = is.tellg();
-    is.seekg(0, std::ios::beg);
-    std::vector<char> buffer(size);
-    is.read(buffer.data(), buffer.size());
-    fb.close();
-    if(!dbUtils->DeserializeDatabase(database, (unsigned char*)buffer.data(), (int)buffer.size()))
-    {
-        throw std::runtime_error("fail to load database");
-    }
-}
-
-
-void saveDatabase(Intel::RealSense::PersonTracking::PersonTrackingConfiguration* ptConfiguration)
-{
-    cout << endl << "save recognition id to database: \033[4;36m" + dbPath << "\033[0m" << endl << endl;
-    auto db = ptConfiguration->QueryRecognition()->QueryDatabase();
-    auto dbUtils = ptConfiguration->QueryRecognition()->QueryDatabaseUtilities();
-
-    const size_t dbSize = dbUtils->GetDatabaseMemorySize(db);
-    std::vector<uint8_t> buffer(dbSize, 0);
-    int32_t writtenSize;
-    dbUtils->SerializeDatabase(db, buffer.data(), (int32_t)buffer.size(), &writtenSize);
-
-    std::ofstream out(dbPath, std::ios::binary);
-    out.write((char*)buffer.data(), buffer.size());
-}
-
-
 int main(int argc, char** argv)
 {
     pt_utils pt_utils;
@@ -88,6 +48,16 @@ int main(int argc, char** argv)
         return -1;
     }
 
+    // Register new people with person recognition in the background. Everything that uses the
+    // module below locks it through the cache, so the worker only runs between frames.
+    pt_recognition_cache recognitionCache(ptModule);
+
+    // Save and load the recognition ids in the background, the database is copied between frames
+    pt_recognition_database recognitionDatabase(dbPath, ptModule->QueryConfiguration(), [&]()
+    {
+        return recognitionCache.lock_module();
+    });
+
     // Start the camera
     pt_utils.start_camera();
 
@@ -113,6 +83,8 @@ int main(int argc, char** argv)
             std::cout << "pt_tutorial_4_web main:  Invalid person ID " << toTrack << endl;
         }
 
+        auto moduleLock = recognitionCache.lock_module();
+
         // -1 means don't focus on any person, just display all
         // Otherwise it should be a number in toTrack, and that is the person ID
         Intel::RealSense::PersonTracking::PersonTrackingData *trackingData = ptModule->QueryOutput();
@@ -129,21 +101,30 @@ int main(int argc, char** argv)
             needsToResetTracking = true;
         }
 
-        // Save person recognition id to database
-        auto config = ptModule->QueryConfiguration();
-        saveDatabase(config);
+        // Save person recognition id to database, the worker copies it once the module is free
+        recognitionDatabase.save();
     };
     controls.loading_rid_db = [&]()
     {
-        // Load recognition id database
-        auto config = ptModule->QueryConfiguration();
-        LoadDatabase(config);
+        // Load recognition id database, it is applied before the next frame
+        recognitionDatabase.load();
     };
 
     // Set control callback to remote display
     web_view->set_control_callbacks(controls);
 
+    // Send color images to the GUI on the output thread, while the next frame is processed. The
+    // overlays of a frame follow its image, see set_overlay_frame().
+    // Sending dummy time stamp of 10.
+    pt_utils.set_output_handler([&](rs::core::correlated_sample_set& sampleSet)
+    {
+        auto colorImage = sampleSet[rs::core::stream_type::color];
+        web_view->on_rgb_frame(10, colorImage->query_info().width, colorImage->query_info().height, colorImage->query_data(),
+                               colorImage->query_frame_number());
+    });
+
     cout << endl << "-------- Press Esc key to exit --------" << endl << endl;
+    pt_snapshot snapshot;
     while(!pt_utils.user_request_exit())
     {
         rs::core::correlated_sample_set sampleSet = {};
@@ -156,20 +137,24 @@ int main(int argc, char** argv)
             continue;
         }
 
-        // Process frame
-        if (ptModule->process_sample_set(sampleSet) != rs::core::status_no_error)
+        // Process frame and copy its people, the recognition ids come from the cache
         {
-            cerr << "Error : Failed to process sample" << endl;
-            continue;
+            auto moduleLock = recognitionCache.lock_module();
+            recognitionDatabase.apply_loaded(ptModule->QueryConfiguration());
+            if (ptModule->process_sample_set(sampleSet) != rs::core::status_no_error)
+            {
+                cerr << "Error : Failed to process sample" << endl;
+                continue;
+            }
+            extract_pt_snapshot(ptModule, snapshot, pt_snapshot_recognition, &recognitionCache);
         }
 
-        auto colorImage = sampleSet[rs::core::stream_type::color];
-
-        // Sending dummy time stamp of 10.
         // Display number of persons in the current frame and cumulative total in the GUI.
-        web_view->on_rgb_frame(10, colorImage->query_info().width, colorImage->query_info().height, colorImage->query_data());
-        cumulativeTotal = console_view->on_person_count_update(ptModule);
-        web_view->on_PT_tracking_update(ptModule, cumulativeTotal);
+        // Both displays read the people from one copy of the PT output.
+        pt_utils.output_frame(sampleSet);
+        web_view->set_overlay_frame(sampleSet[rs::core::stream_type::color]->query_frame_number());
+        cumulativeTotal = console_view->on_person_count_update(snapshot);
+        web_view->on_PT_tracking_update(snapshot, cumulativeTotal);
 
         // Release color and depth image
         sampleSet.images[static_cast<uint8_t>(rs::core::stream_type::color)]->release();
@@ -177,12 +162,16 @@ int main(int argc, char** argv)
 
         if (needsToResetTracking)
         {
+            auto moduleLock = recognitionCache.lock_module();
             ptModule->QueryOutput()->ResetTracking();
             needsToResetTracking = false;
         }
     }
 
+    recognitionCache.stop();
+    recognitionDatabase.stop();
     pt_utils.stop_camera();
+    pt_utils.print_pipeline_stats();
     actualModuleConfig.projection->release();
     cout << "-------- Stopping --------" << endl;
     return 0;
@@ -93,7 +93,18 @@ int main(int argc, char** argv)
 
 
 
+    // Send color images to the GUI on the output thread, while the next frame is processed. The
+    // overlays of a frame follow its image, see set_overlay_frame().
+    // Sending dummy time stamp of 10.
+    pt_utils.set_output_handler([&](rs::core::correlated_sample_set& sampleSet)
+    {
+        auto colorImage = sampleSet[rs::core::stream_type::color];
+        web_view->on_rgb_frame(10, colorImage->query_info().width, colorImage->query_info().height, colorImage->query_data(),
+                               colorImage->query_frame_number());
+    });
+
     cout << endl << "-------- Press Esc key to exit --------" << endl << endl;
+    pt_snapshot snapshot;
     while(!pt_utils.user_request_exit())
     {
         rs::core::correlated_sample_set sampleSet = {};
@@ -113,13 +124,13 @@ int main(int argc, char** argv)
             continue;
         }
 
-        auto colorImage = sampleSet[rs::core::stream_type::color];
-
-        // Sending dummy time stamp of 10.
         // Display number of persons in the current frame and cumulative total in the GUI.
-        web_view->on_rgb_frame(10, colorImage->query_info().width, colorImage->query_info().height, colorImage->query_data());
-        cumulativeTotal = console_view->on_person_count_update(ptModule);
-        web_view->on_PT_tracking_update(ptModule, cumulativeTotal);
+        // Both displays read the people from one copy of the PT output.
+        pt_utils.output_frame(sampleSet);
+        web_view->set_overlay_frame(sampleSet[rs::core::stream_type::color]->query_frame_number());
+        extract_pt_snapshot(ptModule, snapshot, pt_snapshot_tracking);
+        cumulativeTotal = console_view->on_person_count_update(snapshot);
+        web_view->on_PT_tracking_update(snapshot, cumulativeTotal);
 
         // Release color and depth image
         sampleSet.images[static_cast<uint8_t>(rs::core::stream_type::color)]->release();
@@ -133,6 +144,7 @@ int main(int argc, char** argv)
     }
 
     pt_utils.stop_camera();
+    pt_utils.print_pipeline_stats();
     actualModuleConfig.projection->release();
     cout << "-------- Stopping --------" << endl;
     return 0;
@@ -0,0 +1,144 @@
+// License: Apache 2.0. See LICENSE file in root directory.
+// Copyright(c) 2017 Intel Corporation. All Rights Reserved.
+
+#include <chrono>
+#include <iostream>
+#include <thread>
+#include <rs_sdk.h>
+
+#include "open_frame_source.hpp"
+#include "version.h"
+
+using namespace std;
+using namespace rs::core;
+
+// Version number of the samples
+extern constexpr auto rs_sample_version = concat("VERSION: ",RS_SAMPLE_VERSION_STR);
+
+static const char* stream_names[] = { "depth", "color", "infrared", "infrared2", "fisheye" };
+
+void print_usage()
+{
+    cout << "usage:" << endl
+         << "  rs_recording_tool record <file> <seconds>             record color, depth, fisheye and IMU" << endl
+         << "  rs_recording_tool info <file>                         streams, sample counts and duration" << endl
+         << "  rs_recording_tool cut <in> <out> <begin> <end>        copy the seconds [begin, end] of <in> to <out>" << endl
+         << "The recorded source is selected with RS_SAMPLES_FRAME_SOURCE, the camera if it isn't set." << endl;
+}
+
+int record(const string& path, double seconds)
+{
+    context ctx;
+    unique_ptr<frame_source> camera = open_frame_source(ctx);
+    if (!camera)
+    {
+        cerr << "error: there are no RealSense devices connected" << endl;
+        return 1;
+    }
+    recording_frame_source source(move(camera), path);
+
+    // The ZR300 modes the samples use
+    struct { stream_type stream; int width, height; pixel_format format; } modes[] =
+    {
+        { stream_type::color, 640, 480, pixel_format::rgb8 },
+        { stream_type::depth, 320, 240, pixel_format::z16 },
+        { stream_type::fisheye, 640, 480, pixel_format::raw8 },
+    };
+    for (auto& mode : modes)
+    {
+        if (source.supports_stream(mode.stream, mode.width, mode.height, mode.format, 30))
+        {
+            source.enable_stream(mode.stream, mode.width, mode.height, mode.format, 30);
+            cout << "enabling " << stream_names[(int)mode.stream] << " " << mode.width << "x" << mode.height << "x30" << endl;
+        }
+    }
+    if (source.supports_motion())
+    {
+        source.enable_motion(nullptr);
+        cout << "enabling IMU" << endl;
+    }
+
+    source.start();
+    auto end = chrono::steady_clock::now() + chrono::milliseconds((int64_t)(seconds * 1000));
+    while (source.is_streaming() && chrono::steady_clock::now() < end)
+    {
+        this_thread::sleep_for(chrono::milliseconds(10));
+    }
+    source.stop();
+    return 0;
+}
+
+int info(const string& path)
+{
+    recording_reader reader(path);
+    const recording_file_header& header = reader.header();
+
+    size_t images[recording_max_streams] = {};
+    size_t motion = 0;
+    for (size_t i = 0; i < reader.entry_count(); ++i)
+    {
+        const recording_index_entry& entry = reader.entry(i);
+        if (entry.kind == recording_chunk_image && entry.stream >= 0 && entry.stream < recording_max_streams)
+        {
+            images[entry.stream]++;
+        }
+        else if (entry.kind == recording_chunk_motion)
+        {
+            motion++;
+        }
+    }
+
+    double duration = (reader.get_end_timestamp() - reader.get_begin_timestamp()) / 1000.0;
+    cout << path << ": " << header.device_name << ", " << duration << " s from timestamp " << reader.get_begin_timestamp()
+         << (reader.is_complete() ? "" : " (not closed properly, index rebuilt)") << endl;
+    for (int i = 0; i < (int)stream_type::max; ++i)
+    {
+        const recording_stream_info& stream = header.streams[i];
+        if (stream.enabled)
+        {
+            cout << "  " << stream_names[i] << ": " << stream.info.width << "x" << stream.info.height << "x" << stream.fps
+                 << ", " << images[i] << " frames" << endl;
+        }
+    }
+    if (header.motion_enabled)
+    {
+        cout << "  IMU: " << motion << " samples" << endl;
+    }
+    return 0;
+}
+
+int cut(const string& in, const string& out, double begin, double end)
+{
+    recording_reader reader(in);
+    double start = reader.get_begin_timestamp();
+    size_t copied = cut_recording(reader, out, start + begin * 1000.0, start + end * 1000.0);
+    cout << "Copied " << copied << " samples to " << out << endl;
+    return 0;
+}
+
+int main(int argc, char* argv[])
+{
+    string command = argc > 1 ? argv[1] : "";
+    try
+    {
+        if (command == "record" && argc == 4)
+        {
+            return record(argv[2], atof(argv[3]));
+        }
+        if (command == "info" && argc == 3)
+        {
+            return info(argv[2]);
+        }
+        if (command == "cut" && argc == 6)
+        {
+            return cut(argv[2], argv[3], atof(argv[4]), atof(argv[5]));
+        }
+    }
+    catch (const exception& e)
+    {
+        cerr << "error: " << e.what() << endl;
+        return 1;
+    }
+    print_usage();
+    return 1;
+}
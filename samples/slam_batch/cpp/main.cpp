@@ -0,0 +1,383 @@
+// License: Apache 2.0. See LICENSE file in root directory.
+// Copyright(c) 2017 Intel Corporation. All Rights Reserved.
+
+//
+// slam_batch: Runs SLAM over recordings made with recording_tool, without a display and without
+// pacing the playback to the camera rate. Samples are passed to SLAM in timestamp order as fast
+// as SLAM keeps up with them, and none are dropped. For each recording the camera trajectory and
+// the final occupancy map are written, and the throughput, wall time and peak memory are reported.
+// Several recordings are processed in parallel, one process per recording.
+//
+
+#include <algorithm>
+#include <condition_variable>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <map>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include <sys/resource.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include <librealsense/rs.hpp>
+#include <rs_sdk.h>
+#include <librealsense/slam/slam.h>
+
+#include <opencv2/core/core.hpp>
+#include <opencv2/highgui/highgui.hpp>
+
+#include "version.h"
+#include "slam_utils.hpp"
+#include "stream_recording.hpp"
+
+using namespace std;
+using namespace rs::core;
+using namespace rs::slam;
+
+// Version number of the samples
+extern constexpr auto rs_sample_version = concat("VERSION: ",RS_SAMPLE_VERSION_STR);
+
+struct batch_options
+{
+    batch_options() : jobs(0), max_in_flight(2), output_dir(".") {}
+
+    int jobs;               // parallel processes, 0 for one per core
+    int max_in_flight;      // fisheye frames passed to SLAM that it hasn't output yet
+    string output_dir;
+};
+
+//--------------------------------------------------------------------------------------
+// Writes the trajectory and lets the feeding thread know how far SLAM got
+//--------------------------------------------------------------------------------------
+
+class batch_event_handler : public video_module_interface::processing_event_handler
+{
+public:
+    explicit batch_event_handler(const string& trajectory_path) :
+        m_trajectory(trajectory_path),
+        m_outputs(0)
+    {
+        m_trajectory << "timestamp_ms,frame,tracking,r00,r01,r02,tx,r10,r11,r12,ty,r20,r21,r22,tz" << endl;
+        m_trajectory << fixed << setprecision(6);
+    }
+
+    bool is_open() const
+    {
+        return (bool)m_trajectory;
+    }
+
+    void module_output_ready(video_module_interface* sender, correlated_sample_set* sample)
+    {
+        slam* slam_module = dynamic_cast<slam*>(sender);
+        image_interface* fisheye = sample->images[(int)stream_type::fisheye];
+
+        PoseMatrix4f pose;
+        slam_module->get_camera_pose(pose);
+        m_trajectory << (fisheye ? fisheye->query_time_stamp() : 0.0) << ","
+                     << (fisheye ? fisheye->query_frame_number() : 0) << ","
+                     << tracking_accuracy_to_string(slam_module->get_tracking_accuracy());
+        for (int i = 0; i < 12; ++i)
+        {
+            m_trajectory << "," << pose.m_data[i];
+        }
+        m_trajectory << "\n";
+
+        {
+            lock_guard<mutex> lock(m_mutex);
+            ++m_outputs;
+        }
+        m_output_ready.notify_one();
+    }
+
+    // Waits until SLAM has output at least count frames, false on timeout
+    bool wait_for_outputs(uint64_t count, chrono::milliseconds timeout)
+    {
+        unique_lock<mutex> lock(m_mutex);
+        return m_output_ready.wait_for(lock, timeout, [this, count] { return m_outputs >= count; });
+    }
+
+    uint64_t get_outputs()
+    {
+        lock_guard<mutex> lock(m_mutex);
+        return m_outputs;
+    }
+
+private:
+    ofstream m_trajectory;
+    mutex m_mutex;
+    condition_variable m_output_ready;
+    uint64_t m_outputs;
+};
+
+//--------------------------------------------------------------------------------------
+// One recording
+//--------------------------------------------------------------------------------------
+
+string base_name(const string& path)
+{
+    string name = path.substr(path.find_last_of('/') + 1);
+    return name.substr(0, name.find_last_of('.'));
+}
+
+long peak_rss_kb(int who)
+{
+    struct rusage usage;
+    getrusage(who, &usage);
+    return usage.ru_maxrss;
+}
+
+// Configures the source and SLAM with the recorded calibration, false if the recording lacks a stream SLAM needs
+bool configure(playback_frame_source& source, slam& slam_module, int& fisheye_frame_rate)
+{
+    video_module_interface::supported_module_config supported_config = {};
+    if (slam_module.query_supported_module_config(0, supported_config) < status_no_error)
+    {
+        cerr << "error: failed to query the first supported module configuration" << endl;
+        return false;
+    }
+    if (!check_source_for_slam(&source, supported_config) || !configure_camera_for_slam(&source, supported_config))
+    {
+        return false;
+    }
+    fisheye_frame_rate = supported_config[stream_type::fisheye].frame_rate;
+
+    video_module_interface::actual_module_config slam_config = get_slam_config(&source, supported_config);
+    if (slam_module.set_module_config(slam_config) < status_no_error)
+    {
+        cerr << "error: failed to set the SLAM configuration" << endl;
+        return false;
+    }
+    return true;
+}
+
+int process_recording(const string& path, const batch_options& options)
+{
+    const auto start_time = chrono::steady_clock::now();
+    const string prefix = options.output_dir + "/" + base_name(path);
+
+    playback_config config;
+    config.speed = 0;
+    unique_ptr<playback_frame_source> source;
+    try
+    {
+        source.reset(new playback_frame_source(path, config));
+    }
+    catch (const exception& e)
+    {
+        cerr << "error: " << e.what() << endl;
+        return 1;
+    }
+
+    unique_ptr<slam> slam_module(new rs::slam::slam());
+    slam_module->set_occupancy_map_resolution(0.025);
+    batch_event_handler event_handler(prefix + "_trajectory.csv");
+    if (!event_handler.is_open())
+    {
+        cerr << "error: cannot write " << prefix << "_trajectory.csv" << endl;
+        return 1;
+    }
+    slam_module->register_event_handler(&event_handler);
+
+    int fisheye_frame_rate = 30;
+    if (!configure(*source, *slam_module, fisheye_frame_rate))
+    {
+        return 1;
+    }
+
+    // The playback thread delivers the samples of all streams in timestamp order and passes them
+    // straight to SLAM. Before each fisheye frame it waits until SLAM is at most max_in_flight frames
+    // behind, which keeps SLAM busy without letting its input queue overflow. SLAM that keeps up
+    // outputs a frame per frame period, a frame it gives no output for within a few periods more
+    // than it may be behind was dropped.
+    const chrono::milliseconds output_timeout((options.max_in_flight + 2) * 1000 / max(fisheye_frame_rate, 1));
+    uint64_t fed_images[2] = {};
+    uint64_t fed_motion = 0;
+    uint64_t skipped = 0;       // fisheye frames SLAM gave no output for
+    for (stream_type stream : { stream_type::fisheye, stream_type::depth })
+    {
+        source->set_image_callback(stream, [&, stream](image_interface* image)
+        {
+            if (stream == stream_type::fisheye)
+            {
+                uint64_t expected = fed_images[0] - skipped;
+                uint64_t target = expected > (uint64_t)options.max_in_flight ? expected - options.max_in_flight : 0;
+                if (!event_handler.wait_for_outputs(target, output_timeout))
+                {
+                    // SLAM dropped frames, don't wait for them again. It may have output them since.
+                    const uint64_t outputs = event_handler.get_outputs();
+                    skipped += target - min(target, outputs);
+                }
+            }
+            correlated_sample_set sample_set = {};
+            sample_set[stream] = image;
+            if (slam_module->process_sample_set(sample_set) < status_no_error)
+            {
+                cerr << "error: failed to process image sample" << endl;
+            }
+            fed_images[stream == stream_type::fisheye ? 0 : 1]++;
+        });
+    }
+    source->enable_motion([&](const motion_sample& sample)
+    {
+        correlated_sample_set sample_set = {};
+        sample_set[sample.type] = sample;
+        if (slam_module->process_sample_set(sample_set) < status_no_error)
+        {
+            cerr << "error: failed to process motion sample" << endl;
+        }
+        ++fed_motion;
+    });
+
+    cout << path << ": processing " << (source->get_reader().get_end_timestamp() - source->get_reader().get_begin_timestamp()) / 1000.0
+         << " s of recording" << endl;
+    const auto feed_start_time = chrono::steady_clock::now();
+    source->start();
+    while (source->is_streaming() && keep_running)
+    {
+        this_thread::sleep_for(chrono::milliseconds(100));
+    }
+    source->stop();
+
+    // Let SLAM finish the queued frames
+    slam_module->flush_resources();
+    const double feed_seconds = chrono::duration<double>(chrono::steady_clock::now() - feed_start_time).count();
+    slam_module->unregister_event_handler(&event_handler);
+    slam_module->save_occupancy_map_as_ppm(prefix + "_occupancy.ppm", true);
+
+    const uint64_t outputs = event_handler.get_outputs();
+    const double wall_seconds = chrono::duration<double>(chrono::steady_clock::now() - start_time).count();
+    cout << fixed << setprecision(2)
+         << path << ": " << outputs << " poses from " << fed_images[0] << " fisheye, " << fed_images[1] << " depth frames and "
+         << fed_motion << " IMU samples" << endl
+         << path << ": " << (feed_seconds > 0 ? outputs / feed_seconds : 0.0) << " frames/s, wall time " << wall_seconds << " s, peak RSS "
+         << peak_rss_kb(RUSAGE_SELF) / 1024.0 << " MB" << (skipped ? ", " + to_string(skipped) + " frames without output" : "") << endl
+         << path << ": wrote " << prefix << "_trajectory.csv and " << prefix << "_occupancy.ppm" << endl;
+    return keep_running ? 0 : 1;
+}
+
+//--------------------------------------------------------------------------------------
+// Several recordings, one process each
+//--------------------------------------------------------------------------------------
+
+int process_recordings(const vector<string>& paths, const batch_options& options)
+{
+    const int jobs = options.jobs > 0 ? options.jobs : max(1u, thread::hardware_concurrency());
+    const auto start_time = chrono::steady_clock::now();
+    map<pid_t, size_t> running;
+    vector<int> exit_codes(paths.size(), -1);
+    vector<long> peak_rss(paths.size(), 0);
+    size_t next = 0;
+
+    while (next < paths.size() || !running.empty())
+    {
+        while (next < paths.size() && (int)running.size() < jobs && keep_running)
+        {
+            cout.flush();
+            pid_t pid = fork();
+            if (pid == 0)
+            {
+                _exit(process_recording(paths[next], options));
+            }
+            if (pid < 0)
+            {
+                cerr << "error: fork failed" << endl;
+                exit_codes[next++] = 1;
+                continue;
+            }
+            running[pid] = next++;
+        }
+        if (running.empty())
+        {
+            break;
+        }
+
+        int status = 0;
+        struct rusage usage;
+        pid_t pid = wait4(-1, &status, 0, &usage);
+        if (pid < 0)
+        {
+            // Interrupted by Ctrl-C, the children get it too
+            continue;
+        }
+        auto job = running.find(pid);
+        if (job == running.end())
+        {
+            continue;
+        }
+        exit_codes[job->second] = WIFEXITED(status) ? WEXITSTATUS(status) : 1;
+        peak_rss[job->second] = usage.ru_maxrss;
+        running.erase(job);
+    }
+
+    const double wall_seconds = chrono::duration<double>(chrono::steady_clock::now() - start_time).count();
+    int failed = 0;
+    cout << endl << "---------------------------------------------------------------------------------------------" << endl;
+    for (size_t i = 0; i < paths.size(); ++i)
+    {
+        const char* result = exit_codes[i] == 0 ? "ok" : exit_codes[i] < 0 ? "not run" : "failed";
+        failed += exit_codes[i] != 0;
+        cout << left << setw(60) << paths[i] << setw(10) << result << "peak RSS " << fixed << setprecision(1) << peak_rss[i] / 1024.0 << " MB" << endl;
+    }
+    cout << paths.size() - failed << " of " << paths.size() << " recordings processed in " << setprecision(2) << wall_seconds
+         << " s with " << jobs << " processes" << endl;
+    return failed ? 1 : 0;
+}
+
+void print_usage()
+{
+    cout << "usage: rs_slam_batch [-j <processes>] [-o <output directory>] [-f <max frames in flight>] <recording>..." << endl
+         << "Writes <output directory>/<recording>_trajectory.csv and <recording>_occupancy.ppm for each recording." << endl;
+}
+
+int main(int argc, char* argv[])
+{
+    // Handle Ctrl-C
+    install_signal_handler();
+
+    batch_options options;
+    vector<string> paths;
+    for (int i = 1; i < argc; ++i)
+    {
+        string arg = argv[i];
+        if ((arg == "-j" || arg == "-o" || arg == "-f") && i + 1 < argc)
+        {
+            string value = argv[++i];
+            if (arg == "-j")
+            {
+                options.jobs = atoi(value.c_str());
+            }
+            else if (arg == "-o")
+            {
+                options.output_dir = value;
+            }
+            else
+            {
+                options.max_in_flight = max(1, atoi(value.c_str()));
+            }
+        }
+        else if (!arg.empty() && arg[0] == '-')
+        {
+            print_usage();
+            return 1;
+        }
+        else
+        {
+            paths.push_back(arg);
+        }
+    }
+    if (paths.empty())
+    {
+        print_usage();
+        return 1;
+    }
+
+    if (paths.size() == 1)
+    {
+        return process_recording(paths[0], options);
+    }
+    return process_recordings(paths, options);
+}
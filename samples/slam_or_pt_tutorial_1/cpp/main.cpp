@@ -63,13 +63,13 @@ int main(int argc, char* argv[])
     module_manager.set_person_tracking_enabled(para.pt_enabled);
     module_manager.config_modules();
 
-    // Initialize camera manager
-    if (!Camera_manager::has_camera())
+    // Initialize camera manager, with the camera or the source selected by RS_SAMPLES_FRAME_SOURCE
+    Camera_manager camera_manager(&module_manager);
+    if (!camera_manager.get_frame_source())
     {
         cout << "Error: There are no RealSense devices connected." << endl << "Please connect a RealSense device and restart the application" << endl;
         return -1;
     }
-    Camera_manager camera_manager(&module_manager);
     camera_manager.set_camera_configer((camera_config_interface*)&module_manager);
 
     // Initialize module manager
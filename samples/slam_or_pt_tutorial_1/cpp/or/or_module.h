@@ -17,6 +17,7 @@
 #include "or_data_interface.h"
 #include "or_configuration_interface.h"
 #include "or_video_module_impl.h"
+#include "frame_source.hpp"
 
 #include "../module_result_listener.h"
 
@@ -41,11 +42,11 @@ public:
     {}
 
     rs::core::status init_OR(
-        video_module_interface::supported_module_config& cfg, rs::device* dev)
+        video_module_interface::supported_module_config& cfg, frame_source* source)
     {
         rs::core::status st = rs::core::status_no_error;
         m_frame_number=0;
-        m_dev = dev;
+        m_source = source;
 
         // Handling color image info (for later using)
         colorInfo.height = cfg.image_streams_configs[(int)rs::stream::color].size.height;
@@ -54,31 +55,25 @@ public:
         colorInfo.pitch = colorInfo.width * 3;
 
         // Get the extrisics parameters from the camera
-        rs::extrinsics ext  = m_dev->get_extrinsics(rs::stream::depth, rs::stream::color);
-        rs::core::extrinsics core_ext;
+        rs::core::extrinsics core_ext = m_source->get_extrinsics(stream_type::depth, stream_type::color);
 
         // Get color intrinsics
-        rs::intrinsics colorInt = m_dev->get_stream_intrinsics(rs::stream::color);
-        rs::core::intrinsics core_colorInt;
+        rs::core::intrinsics core_colorInt = m_source->get_intrinsics(stream_type::color);
 
         // Get depth intrinsics
-        rs::intrinsics depthInt = m_dev->get_stream_intrinsics(rs::stream::depth);
-        rs::core::intrinsics core_depthInt;
+        rs::core::intrinsics core_depthInt = m_source->get_intrinsics(stream_type::depth);
 
         // After getting all parameters from the camera we need to set the actual_module_config
         rs::core::video_module_interface::actual_module_config actualConfig;
 
         // 1. copy the extrinsics
-        memcpy(&actualConfig.image_streams_configs[(int)rs::stream::color].extrinsics, &ext, sizeof(rs::extrinsics));
-        core_ext =  rs::utils::convert_extrinsics(ext);
+        actualConfig.image_streams_configs[(int)rs::stream::color].extrinsics = core_ext;
 
         // 2. copy the color intrinsics
-        memcpy(&actualConfig.image_streams_configs[(int)rs::stream::color].intrinsics, &colorInt, sizeof(rs::intrinsics));
-        core_colorInt = rs::utils::convert_intrinsics (colorInt);
+        actualConfig.image_streams_configs[(int)rs::stream::color].intrinsics = core_colorInt;
 
         // 3. copy the depth intrinsics
-        memcpy(&actualConfig.image_streams_configs[(int)rs::stream::depth].intrinsics, &depthInt, sizeof(rs::intrinsics));
-        core_depthInt = rs::utils::convert_intrinsics(depthInt);
+        actualConfig.image_streams_configs[(int)rs::stream::depth].intrinsics = core_depthInt;
 
 
         // Handling projection
@@ -171,7 +166,7 @@ public:
         return m_frame_number;
     }
 
-    int query_supported_config(rs::device* device,
+    int query_supported_config(frame_source* source,
                                video_module_interface::supported_module_config& supported_config)
     {
         int i = 0;
@@ -272,7 +267,7 @@ protected:
     ORMode m_mode;
     bool m_stopped;
 
-    rs::device* m_dev;
+    frame_source* m_source;
     rs::core::correlated_sample_set* m_sample_set;
     void* m_color_buffer;
     int m_frame_number;
@@ -15,6 +15,7 @@
 #include <signal.h>
 
 #include "slam.h"
+#include "frame_source.hpp"
 
 #define ESC_KEY 27
 
@@ -145,10 +146,10 @@ inline rs::source get_source_type(rs::core::video_module_interface::supported_mo
     return active_sources;
 }
 
-inline bool check_motion_sensor_capability_if_required(rs::device *device, rs::source requestedSource)
+inline bool check_motion_sensor_capability_if_required(frame_source* source, rs::source requestedSource)
 {
     if(requestedSource == rs::source::all_sources || rs::source::motion_data == requestedSource)
-        return device->supports(rs::capabilities::motion_events);
+        return source->supports_motion();
     return true;
 }
 
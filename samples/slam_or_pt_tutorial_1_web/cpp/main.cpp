@@ -19,33 +19,42 @@ typedef struct running_para
     bool slam_enabled;
     bool or_enabled;
     bool pt_enabled;
+    std::string latency_log;
+    std::string trace_file;
 } running_para;
 
 void parse_args(int argc, char* argv[], running_para& para)
 {
-    if(argc == 1)
+    for (int i = 1; i < argc; i++)
     {
-        para.enable_all();
-    }
-    else
-    {
-        for (int i = 1; i < argc; i++)
+        std::string arg(argv[i]);
+        if(arg == "-slam")
+        {
+            para.slam_enabled = true;
+        }
+        else if(arg == "-or")
+        {
+            para.or_enabled = true;
+        }
+        else if(arg == "-pt")
+        {
+            para.pt_enabled = true;
+        }
+        else if(arg == "-latency_log" && i + 1 < argc)
+        {
+            para.latency_log = argv[++i];
+        }
+        else if(arg == "-trace" && i + 1 < argc)
         {
-            std::string arg(argv[i]);
-            if(arg == "-slam")
-            {
-                para.slam_enabled = true;
-            }
-            else if(arg == "-or")
-            {
-                para.or_enabled = true;
-            }
-            else if(arg == "-pt")
-            {
-                para.pt_enabled = true;
-            }
+            para.trace_file = argv[++i];
         }
     }
+
+    // Run all modules unless some were selected
+    if(!para.slam_enabled && !para.or_enabled && !para.pt_enabled)
+    {
+        para.enable_all();
+    }
 }
 
 int main(int argc, char* argv[])
@@ -60,15 +69,23 @@ int main(int argc, char* argv[])
     module_manager.set_slam_enabled(para.slam_enabled);
     module_manager.set_object_recognition_enabled(para.or_enabled);
     module_manager.set_person_tracking_enabled(para.pt_enabled);
+    if(!para.latency_log.empty())
+    {
+        module_manager.set_latency_log(para.latency_log);
+    }
+    if(!para.trace_file.empty())
+    {
+        start_pipeline_trace(para.trace_file);
+    }
     module_manager.config_modules();
 
-    // Initialize camera manager
-    if (!Camera_manager::has_camera())
+    // Initialize camera manager, with the camera or the source selected by RS_SAMPLES_FRAME_SOURCE
+    Camera_manager camera_manager(&module_manager);
+    if (!camera_manager.get_frame_source())
     {
         cout << "Error: There are no RealSense devices connected." << endl << "Please connect a RealSense device and restart the application" << endl;
         return -1;
     }
-    Camera_manager camera_manager(&module_manager);
     camera_manager.set_camera_configer((camera_config_interface*)&module_manager);
 
     // Initialize module manager
@@ -80,6 +97,7 @@ int main(int argc, char* argv[])
 
     // Start sample loop
     module_manager.run();
+    trace_recorder::get_instance().dump();
 
     return 0;
 }
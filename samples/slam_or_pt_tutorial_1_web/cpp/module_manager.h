@@ -12,19 +12,33 @@
 #include "pt/pt_module.h"
 #include "slam/slam_module.h"
 #include "module_result_listener.h"
+#include "open_frame_source.hpp"
+#include "metrics_registry.hpp"
+#include "pipeline_trace.hpp"
 
 using namespace std;
 using namespace rs::core;
 
+inline const char* stream_name(const stream_type stream)
+{
+    static const char* names[] = { "depth", "color", "infrared", "infrared2", "fisheye" };
+    return (int)stream >= 0 && (int)stream < 5 ? names[(int)stream] : "other";
+}
+
 class camera_data_listener
 {
 public:
     camera_data_listener() {}
     virtual ~camera_data_listener() {}
 
-    virtual void on_camera_device(rs::device* dev) = 0;
+    // The camera, or the source standing in for it, nullptr if there is none
+    virtual void on_frame_source(frame_source* source) = 0;
     virtual void on_image_update(const stream_type stream, image_interface* image) = 0;
-    virtual void on_motion_update(const motion_type motionType, correlated_sample_set& sample_set) = 0;
+    // Called with a timestamp-ordered batch of accel and gyro samples
+    virtual void on_motion_batch(const imu_sample* samples, size_t count) = 0;
+    // The batcher of the motion samples. The listener flushes it after stopping the source, so the
+    // last partial batch is delivered.
+    virtual void on_imu_batcher(imu_batcher* batcher) = 0;
 };
 
 class camera_config_interface
@@ -44,27 +58,13 @@ public:
     Camera_manager(camera_data_listener* listener)
     {
         m_camera_listener = listener;
-        m_ctx.reset(new rs::context());
-        if (m_ctx->get_device_count() == 0)
-        {
-            // This class does not handle absence of camera. Callers should check for camera first by calling
-            // Camera_manager::has_camera()
-            cout << "Error: There are no RealSense devices connected." << endl << "Please connect a RealSense device and restart the application" << endl;
-            m_camera_device = nullptr;
-        }
-        else
-        {
-            m_camera_device = m_ctx->get_device(0);
-        }
+        m_ctx.reset(new rs::core::context());
 
-        m_camera_listener->on_camera_device(m_camera_device);
-    }
+        // The camera, or the source selected by RS_SAMPLES_FRAME_SOURCE. This class does not handle
+        // absence of camera, callers should check get_frame_source() first.
+        m_source = open_frame_source(*m_ctx);
 
-    static bool has_camera()
-    {
-        std::unique_ptr<rs::context> ctx;
-        ctx.reset(new rs::context());
-        return ctx->get_device_count() > 0;
+        m_camera_listener->on_frame_source(m_source.get());
     }
 
     void start_camera()
@@ -79,7 +79,6 @@ public:
         active_sources = get_source_type(m_common_camera_config);
 
         camera_data_listener* camera_data_listener = m_camera_listener;
-        map<stream_type, function<void(rs::frame)>> stream_callback_per_stream;
 
         for(int i = 0; i < (int) stream_type::max; ++i)
         {
@@ -104,88 +103,81 @@ public:
                 continue;
             }
 
-            rs::format stream_format = rs::format::any;
+            pixel_format stream_format = pixel_format::any;
             if(stream == stream_type::depth)
             {
-                stream_format = rs::format::z16;
+                stream_format = pixel_format::z16;
             }
             else
             {
                 if(stream == stream_type::fisheye)
                 {
-                    stream_format = rs::format::raw8;
+                    stream_format = pixel_format::raw8;
                 }
                 if(stream == stream_type::color)
                 {
-                    stream_format = rs::format::rgb8;
+                    stream_format = pixel_format::rgb8;
                 }
             }
-            rs::stream librealsense_stream = rs::utils::convert_stream_type(stream);
-            m_camera_device->enable_stream(librealsense_stream, supported_stream_config.size.width,
-                                           supported_stream_config.size.height, stream_format, supported_stream_config.frame_rate);
+            m_source->enable_stream(stream, supported_stream_config.size.width,
+                                    supported_stream_config.size.height, stream_format, supported_stream_config.frame_rate);
 
             bool slam_enabled = m_camera_configer->is_slam_enabled();
 
-            stream_callback_per_stream[stream] = [=](rs::frame frame)
+            m_source->set_image_callback(stream, [=](image_interface* image)
             {
-                const auto timestampDomain = frame.get_frame_timestamp_domain();
-                if(slam_enabled && stream != stream_type::color && rs::timestamp_domain::microcontroller != timestampDomain)
+                TRACE_SPAN("camera_callback", image->query_frame_number(), stream_name(stream));
+
+                if(slam_enabled && stream != stream_type::color && timestamp_domain::microcontroller != image->query_time_stamp_domain())
                 {
-                    cerr << "error: Junk time stamp in stream:" << (int)(stream)<< "\twith frame counter:" << frame.get_frame_number() << endl;
+                    cerr << "error: Junk time stamp in stream:" << (int)(stream)<< "\twith frame counter:" << image->query_frame_number() << endl;
                     return;
                 }
 
-                auto image = image_interface::create_instance_from_librealsense_frame(
-                                 frame, image_interface::flag::any);
-
+                // The source releases the image after the callback, the listener add_ref()s what it keeps
                 if(camera_data_listener)
                 {
                     camera_data_listener->on_image_update(stream, image);
                 }
 
-                image->release();
-
-            };
+                if(stream == stream_type::fisheye && m_imu_batcher)
+                {
+                    m_imu_batcher->mark_frame();
+                }
 
-            m_camera_device->set_frame_callback(librealsense_stream, stream_callback_per_stream[stream]);
+            });
 
         }
 
-        m_camera_device->set_option(rs::option::fisheye_strobe, 1);
-        m_camera_device->set_option(rs::option::fisheye_external_trigger, 1);
-
         // Define callback to the motion events and set it, the callback lifetime assumes the module is available.
-        function<void(rs::motion_data)> motion_callback;
-        function<void(rs::timestamp_data)> timestamp_callback;
         if(is_motion_stream_requested(active_sources))
         {
-            motion_callback = [camera_data_listener](rs::motion_data entry)
+            // IMU samples are delivered in batches, flushed with each fisheye frame
+            m_imu_batcher.reset(new imu_batcher([camera_data_listener](const imu_sample* samples, size_t count)
             {
-                motion_type motionType = rs_to_sdk_motion_type(entry.timestamp_data.source_id);
-                if(motionType != motion_type::max)
+                if(camera_data_listener)
                 {
-                    correlated_sample_set sample_set = {};
-                    sample_set[motionType].timestamp = entry.timestamp_data.timestamp;
-                    sample_set[motionType].type = motionType;
-                    sample_set[motionType].frame_number = entry.timestamp_data.frame_number;
-                    sample_set[motionType].data[0] = entry.axes[0];
-                    sample_set[motionType].data[1] = entry.axes[1];
-                    sample_set[motionType].data[2] = entry.axes[2];
-
-                    if(camera_data_listener)
-                    {
-                        camera_data_listener->on_motion_update(motionType, sample_set);
-                    }
-
+                    camera_data_listener->on_motion_batch(samples, count);
                 }
-            };
+            }));
 
-            timestamp_callback = [](rs::timestamp_data entry)
+            imu_batcher* batcher = m_imu_batcher.get();
+            if(camera_data_listener)
             {
+                camera_data_listener->on_imu_batcher(batcher);
+            }
+            m_source->enable_motion([batcher](const motion_sample& entry)
+            {
+                imu_sample sample;
+                sample.timestamp = entry.timestamp;
+                sample.type = entry.type;
+                sample.frame_number = entry.frame_number;
+                sample.data[0] = entry.data[0];
+                sample.data[1] = entry.data[1];
+                sample.data[2] = entry.data[2];
 
-            };
-
-            m_camera_device->enable_motion_tracking(motion_callback, timestamp_callback);
+                batcher->add(sample);
+            });
 
         }
         else
@@ -193,16 +185,22 @@ public:
             cout << "Motion not enabled" << endl;
         }
 
-        // Enable auto exposure for color stream
-        m_camera_device->set_option(rs::option::color_enable_auto_exposure, 1);
+        if(rs::device* device = m_source->get_device())
+        {
+            device->set_option(rs::option::fisheye_strobe, 1);
+            device->set_option(rs::option::fisheye_external_trigger, 1);
+
+            // Enable auto exposure for color stream
+            device->set_option(rs::option::color_enable_auto_exposure, 1);
 
-        // Enable auto exposure for IR camera stream
-        m_camera_device->set_option(rs::option::r200_lr_auto_exposure_enabled, 1);
+            // Enable auto exposure for IR camera stream
+            device->set_option(rs::option::r200_lr_auto_exposure_enabled, 1);
 
-        // Enable auto exposure for fisheye camera stream
-        m_camera_device->set_option(rs::option::fisheye_color_auto_exposure, 1);
+            // Enable auto exposure for fisheye camera stream
+            device->set_option(rs::option::fisheye_color_auto_exposure, 1);
+        }
 
-        m_camera_device->start(active_sources);
+        m_source->start();
 
     }
 
@@ -216,30 +214,44 @@ public:
         m_camera_configer = camera_configer;
     }
 
-    rs::device* get_camera_device()
+    frame_source* get_frame_source()
     {
-        return m_camera_device;
+        return m_source.get();
     }
 
 private:
     camera_data_listener* m_camera_listener;
     camera_config_interface* m_camera_configer;
-    std::unique_ptr<rs::context> m_ctx;
-    rs::device *m_camera_device;
+    std::unique_ptr<rs::core::context> m_ctx;
+    std::unique_ptr<frame_source> m_source;
     rs::source active_sources;
+    std::unique_ptr<imu_batcher> m_imu_batcher;
 };
 
 class Module_manager : public camera_data_listener, camera_config_interface
 {
 public:
     Module_manager() : m_bOR_enabled(false), m_bPT_enalbed(false),
-        m_bSLAM_enabled(false), m_stopped(false)
+        m_bSLAM_enabled(false), m_stopped(false), m_imu_batcher(nullptr)
+    {
+        auto& registry = metrics_registry::get_instance();
+        for(int i = 0; i < (int)stream_type::max; i++)
+        {
+            m_frames_metric[i] = &registry.get_counter("rs_camera_frames_total", "Frames received from the camera",
+                                                       { { "stream", stream_name((stream_type)i) } });
+        }
+        m_accel_metric = &registry.get_counter("rs_camera_frames_total", "Frames received from the camera", { { "stream", "accel" } });
+        m_gyro_metric = &registry.get_counter("rs_camera_frames_total", "Frames received from the camera", { { "stream", "gyro" } });
+    }
+
+    void on_frame_source(frame_source* source) override
     {
+        m_source = source;
     }
 
-    void on_camera_device(rs::device* dev) override
+    void on_imu_batcher(imu_batcher* batcher) override
     {
-        m_device = dev;
+        m_imu_batcher = batcher;
     }
 
     video_module_interface::supported_module_config query_requested_camera_config() override
@@ -256,16 +268,19 @@ public:
     {
         if(m_stopped) return;
 
+        TRACE_SPAN("on_image_update", image->query_frame_number(), stream_name(stream));
+        m_frames_metric[(int)stream]->inc();
+
+        if(stream == stream_type::depth)
+        {
+            m_module_listener.on_depth_frame_arrived(image->query_frame_number());
+        }
+
         // slam
         if(m_bSLAM_enabled && m_slam_module->get_is_initialized() && stream != stream_type::color)
         {
-            correlated_sample_set sample_set = {};
-            sample_set[stream] = image;
             m_slam_module->update_input_stream(stream, 1);
-            if(m_slam_module->process_sample_set_async(sample_set) < status_no_error)
-            {
-                cerr << "error: failed to process sample" << endl;
-            }
+            m_slam_module->process_image_async(stream, image);
         }
 
         if(stream == stream_type::depth || stream == stream_type::color)
@@ -313,15 +328,24 @@ public:
 
     }
 
-    void on_motion_update(const motion_type motionType, correlated_sample_set& sample_set) override
+    void on_motion_batch(const imu_sample* samples, size_t count) override
     {
         if(m_stopped || !m_bSLAM_enabled || !m_slam_module->get_is_initialized()) return;
-        m_slam_module->update_input_stream(motionType, 1);
 
-        if(m_slam_module->process_sample_set_async(sample_set) < status_no_error)
+        int accelCount = 0;
+        for(size_t i = 0; i < count; ++i)
         {
-            cerr<<"error : failed to process sample" << endl;
+            if(samples[i].type == motion_type::accel)
+            {
+                ++accelCount;
+            }
         }
+        m_slam_module->update_input_stream(motion_type::accel, accelCount);
+        m_slam_module->update_input_stream(motion_type::gyro, (int)count - accelCount);
+        m_accel_metric->inc(accelCount);
+        m_gyro_metric->inc(count - accelCount);
+
+        m_slam_module->process_motion_batch_async(samples, count);
     }
 
     void set_slam_enabled(bool enabled)
@@ -339,6 +363,11 @@ public:
         m_bPT_enalbed = enabled;
     }
 
+    void set_latency_log(const string& path)
+    {
+        m_module_listener.set_latency_log(path);
+    }
+
     void config_modules()
     {
         // Create MW wraps
@@ -373,7 +402,7 @@ public:
         // Query camera config based on MWs enable situation
         if(m_bSLAM_enabled)
         {
-            if(m_slam_module->query_supported_config(m_device, m_common_camera_config) == -1)
+            if(m_slam_module->query_supported_config(m_source, m_common_camera_config) == -1)
             {
                 cerr << "init slam failed" << endl;
                 return -1;
@@ -401,7 +430,7 @@ public:
         else if (m_bOR_enabled)
         {
             // Set color stream config from OR module
-            if(m_or_module->query_supported_config(m_device, m_common_camera_config) == -1)
+            if(m_or_module->query_supported_config(m_source, m_common_camera_config) == -1)
             {
                 cout << "error: no common config found for PT and OR" << endl;
                 return -1;
@@ -409,7 +438,7 @@ public:
         }
         else if (m_bPT_enalbed)
         {
-            if(m_pt_module->query_supported_config(m_device, m_common_camera_config) == -1)
+            if(m_pt_module->query_supported_config(m_source, m_common_camera_config) == -1)
             {
                 cout << "error: no common config found for PT" << endl;
                 return -1;
@@ -441,12 +470,12 @@ public:
         if(m_bOR_enabled)
         {
             m_or_module->set_or_mode(or_module::ORMode::OR_LOCALIZATION);
-            m_or_module->init_OR(m_common_camera_config, m_device);
+            m_or_module->init_OR(m_common_camera_config, m_source);
         }
 
         if(m_bPT_enalbed)
         {
-            m_pt_module->init_pt(m_common_camera_config, m_device);
+            m_pt_module->init_pt(m_common_camera_config, m_source);
         }
 
         cout << endl << "-------- Press Esc key to exit --------" << endl << endl;
@@ -474,6 +503,14 @@ public:
     void stop()
     {
         cout << endl << "Stopping..." << endl << endl;
+
+        // Stop the camera first, no callbacks run after this. The samples still in the IMU batch
+        // are then passed to SLAM before the modules stop.
+        m_source->stop();
+        if(m_imu_batcher)
+        {
+            m_imu_batcher->flush();
+        }
         m_stopped = true;
 
         // Stop all modules
@@ -492,7 +529,6 @@ public:
             m_slam_module->stop();
         }
 
-        rs::source active_sources = get_source_type(m_common_camera_config);
         // Waiting all background work thread complete
         while((m_bPT_enalbed && m_pt_module->get_pt_running()) || (m_bOR_enabled && m_or_module->get_or_running()))
         {
@@ -502,8 +538,7 @@ public:
         // Release sample set images after work thread completed
         release_images();
 
-        // Stop Camera device
-        m_device->stop(active_sources);
+        m_module_listener.stop();
 
         // Recycle resources
         if(m_bOR_enabled)
@@ -559,7 +594,13 @@ private:
     correlated_sample_set m_or_sample_set;
     correlated_sample_set m_pt_sample_set;
 
-    rs::device *m_device;
+    frame_source* m_source;
+    imu_batcher* m_imu_batcher;
 
     video_module_interface::supported_module_config m_common_camera_config;
+
+    // Camera input counters, looked up once so the callbacks don't take the registry lock
+    metric_counter* m_frames_metric[(int)stream_type::max];
+    metric_counter* m_accel_metric;
+    metric_counter* m_gyro_metric;
 };
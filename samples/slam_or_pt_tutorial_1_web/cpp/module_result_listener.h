@@ -22,6 +22,8 @@
 #include "slam_web_display.hpp"
 #include "or_web_display.hpp"
 #include "pt_web_display.hpp"
+#include "latency_histogram.hpp"
+#include "metrics_registry.hpp"
 
 using namespace std;
 using namespace rs::core;
@@ -55,8 +57,33 @@ public:
 class module_consumer : public module_result_listener_interface
 {
 public:
-    module_consumer() : ui_request_stop(false), ui_request_restart(false)
+    module_consumer() : ui_request_stop(false), ui_request_restart(false),
+        m_slam_latency(latency_registry::get_instance().get_histogram("camera->slam")),
+        m_or_latency(latency_registry::get_instance().get_histogram("frame->or")),
+        m_pt_latency(latency_registry::get_instance().get_histogram("frame->pt")),
+        m_last_slam_depth_frame(-1)
     {
+        static const char* tracking_names[] = { "failed", "low", "medium", "high" };
+        auto& registry = metrics_registry::get_instance();
+        for(int i = 0; i < 4; i++)
+        {
+            m_slam_poses_metric[i] = &registry.get_counter("rs_slam_poses_total", "Camera poses reported by SLAM",
+                                                           { { "tracking", tracking_names[i] } });
+        }
+        m_or_recognition_metric = &registry.get_counter("rs_or_results_total", "Object recognition results", { { "kind", "recognition" } });
+        m_or_localization_metric = &registry.get_counter("rs_or_results_total", "Object recognition results", { { "kind", "localization" } });
+        m_pt_results_metric = &registry.get_counter("rs_pt_results_total", "Person tracking results");
+    }
+
+    // Called from the depth stream callback, latencies of all modules are measured from here
+    void on_depth_frame_arrived(int depth_frame_number)
+    {
+        m_depth_arrivals.record_arrival(depth_frame_number);
+    }
+
+    void set_latency_log(const string& path)
+    {
+        m_latency_reporter.set_log_file(path);
     }
 
     ~module_consumer() {}
@@ -70,6 +97,9 @@ public:
                                        recognition_data* recognition_data,int array_size,
                                        or_configuration_interface* or_configuration) override
     {
+        m_depth_arrivals.record_latency(or_sample_set[stream_type::depth]->query_frame_number(), m_or_latency);
+        m_or_recognition_metric->inc();
+
         //display localization_data
         if(recognition_data && array_size != 0)
         {
@@ -90,6 +120,8 @@ public:
                                          or_configuration_interface* or_configuration) override
     {
         int depth_frame_number = or_sample_set[stream_type::depth]->query_frame_number();
+        m_depth_arrivals.record_latency(depth_frame_number, m_or_latency);
+        m_or_localization_metric->inc();
         if(array_size != 0 && m_frame_pose_map.find(depth_frame_number) != m_frame_pose_map.end())
         {
             PoseMatrix4f cameraPose = m_frame_pose_map[depth_frame_number];
@@ -126,6 +158,8 @@ public:
     void on_person_tracking_finished(correlated_sample_set& pt_sample_set, rs::person_tracking::person_tracking_video_module_interface* ptModule)
     {
         int depth_frame_number = pt_sample_set[stream_type::depth]->query_frame_number();
+        m_depth_arrivals.record_latency(depth_frame_number, m_pt_latency);
+        m_pt_results_metric->inc();
         if(m_frame_pose_map.find(depth_frame_number) != m_frame_pose_map.end())
         {
             PoseMatrix4f cameraPose = m_frame_pose_map[depth_frame_number];
@@ -149,6 +183,18 @@ public:
 
     void on_slam_pose_update(tracking_accuracy tracking, PoseMatrix4f& cameraPose, int depth_frame_number) override
     {
+        if((int)tracking >= 0 && (int)tracking < 4)
+        {
+            m_slam_poses_metric[(int)tracking]->inc();
+        }
+
+        // The depth frame number repeats for poses computed without a new depth frame
+        if(depth_frame_number != m_last_slam_depth_frame)
+        {
+            m_depth_arrivals.record_latency(depth_frame_number, m_slam_latency);
+            m_last_slam_depth_frame = depth_frame_number;
+        }
+
         std::list<int>::iterator findIter = std::find(m_waiting_pose_frame_list.begin(),
                                             m_waiting_pose_frame_list.end(), depth_frame_number);
 
@@ -210,6 +256,18 @@ public:
         controls.stop = stop_callback;
 
         slam_web_view->set_control_callbacks(controls);
+
+        // Export latency percentiles of every stage to the console, the web view and the log file if set
+        m_latency_reporter.set_stage_callback([this](const string& stage, const latency_snapshot& latency)
+        {
+            slam_web_view->on_latency(stage, latency);
+        });
+        m_latency_reporter.start();
+    }
+
+    void stop()
+    {
+        m_latency_reporter.stop();
     }
 
 
@@ -254,4 +312,17 @@ private:
 
     map<int, PoseMatrix4f> m_frame_pose_map;
     list<int> m_waiting_pose_frame_list;
+
+    frame_arrival_tracker m_depth_arrivals;
+    latency_histogram& m_slam_latency;
+    latency_histogram& m_or_latency;
+    latency_histogram& m_pt_latency;
+    int m_last_slam_depth_frame;
+    latency_reporter m_latency_reporter;
+
+    // Indexed by tracking_accuracy
+    metric_counter* m_slam_poses_metric[4];
+    metric_counter* m_or_recognition_metric;
+    metric_counter* m_or_localization_metric;
+    metric_counter* m_pt_results_metric;
 };
@@ -7,6 +7,7 @@
 #include "or_data_interface.h"
 #include "or_configuration_interface.h"
 #include "or_video_module_impl.h"
+#include "frame_source.hpp"
 #include <opencv2/core.hpp>
 #include <memory>
 #include <thread>
@@ -14,6 +15,7 @@
 #include <future>
 
 #include "../module_result_listener.h"
+#include "pipeline_trace.hpp"
 
 using namespace std;
 using namespace rs::core;
@@ -38,12 +40,12 @@ public:
 
     }
     rs::core::status init_OR(
-        video_module_interface::supported_module_config& cfg, rs::device* dev)
+        video_module_interface::supported_module_config& cfg, frame_source* source)
 
     {
         rs::core::status st = rs::core::status_no_error;
         m_frame_number=0;
-        m_dev = dev;
+        m_source = source;
 
         // Handling color image info (for later using)
         colorInfo.height = cfg.image_streams_configs[(int)rs::stream::color].size.height;
@@ -52,31 +54,25 @@ public:
         colorInfo.pitch = colorInfo.width * 3;
 
         // Get the extrisics parameters from the camera
-        rs::extrinsics ext  = m_dev->get_extrinsics(rs::stream::depth, rs::stream::color);
-        rs::core::extrinsics core_ext;
+        rs::core::extrinsics core_ext = m_source->get_extrinsics(stream_type::depth, stream_type::color);
 
         // Get color intrinsics
-        rs::intrinsics colorInt = m_dev->get_stream_intrinsics(rs::stream::color);
-        rs::core::intrinsics core_colorInt;
+        rs::core::intrinsics core_colorInt = m_source->get_intrinsics(stream_type::color);
 
         // Get depth intrinsics
-        rs::intrinsics depthInt = m_dev->get_stream_intrinsics(rs::stream::depth);
-        rs::core::intrinsics core_depthInt;
+        rs::core::intrinsics core_depthInt = m_source->get_intrinsics(stream_type::depth);
 
         // After getting all parameters from the camera we need to set the actual_module_config
         rs::core::video_module_interface::actual_module_config actualConfig;
 
         // 1. copy the extrinsics
-        memcpy(&actualConfig.image_streams_configs[(int)rs::stream::color].extrinsics, &ext, sizeof(rs::extrinsics));
-        core_ext =  rs::utils::convert_extrinsics(ext);
+        actualConfig.image_streams_configs[(int)rs::stream::color].extrinsics = core_ext;
 
         // 2. copy the color intrinsics
-        memcpy(&actualConfig.image_streams_configs[(int)rs::stream::color].intrinsics, &colorInt, sizeof(rs::intrinsics));
-        core_colorInt = rs::utils::convert_intrinsics (colorInt);
+        actualConfig.image_streams_configs[(int)rs::stream::color].intrinsics = core_colorInt;
 
         // 3. copy the depth intrinsics
-        memcpy(&actualConfig.image_streams_configs[(int)rs::stream::depth].intrinsics, &depthInt, sizeof(rs::intrinsics));
-        core_depthInt = rs::utils::convert_intrinsics(depthInt);
+        actualConfig.image_streams_configs[(int)rs::stream::depth].intrinsics = core_depthInt;
 
 
         // Handling projection
@@ -169,7 +165,7 @@ public:
         return m_frame_number;
     }
 
-    int query_supported_config(rs::device* device,
+    int query_supported_config(frame_source* source,
                                video_module_interface::supported_module_config& supported_config)
     {
         int i = 0;
@@ -270,7 +266,7 @@ protected:
     ORMode m_mode = OR_RECOGNITION;
     bool m_stopped;
 
-    rs::device* m_dev;
+    frame_source* m_source;
     rs::core::correlated_sample_set* m_sample_set;
     void* m_color_buffer;
     int m_frame_number;
@@ -320,6 +316,8 @@ protected:
         // Declare data structure and size for results
         rs::object_recognition::recognition_data* recognition_data = nullptr;
         int array_size = 0;
+        TRACE_THREAD_NAME("or worker");
+        TRACE_SPAN("or_recognition", (*m_sample_set)[stream_type::depth]->query_frame_number(), "depth");
         {
             st = or_impl.process_sample_set(*m_sample_set);
 
@@ -351,6 +349,8 @@ protected:
         // Declare data structure and size for results
         rs::object_recognition::localization_data* localization_data = nullptr;
         int array_size=0;
+        TRACE_THREAD_NAME("or worker");
+        TRACE_SPAN("or_localization", (*m_sample_set)[stream_type::depth]->query_frame_number(), "depth");
 
         // After the sample is ready we can process the frame as well
         st = or_impl.process_sample_set(*m_sample_set);
@@ -17,6 +17,8 @@
 #include <signal.h>
 #include "rs_sdk.h"
 #include "person_tracking_video_module_factory.h"
+#include "pipeline_trace.hpp"
+#include "frame_source.hpp"
 
 namespace RS = Intel::RealSense;
 using namespace RS::PersonTracking;
@@ -26,9 +28,8 @@ using namespace rs::core;
 class PT_module
 {
 public:
-    PT_module(module_result_listener_interface* module_listener) :  lastPersonCount(0),
-        totalPersonIncrements(0), prevPeopleInFrame(-1), prevPeopleTotal(-1),
-        id_set(nullptr), pt_initialized(false), pt_is_running(false), m_stopped(false),
+    PT_module(module_result_listener_interface* module_listener) :
+        pt_initialized(false), pt_is_running(false), m_stopped(false),
         m_module_listener(module_listener)
     {
         dataDir = get_data_files_path();
@@ -40,15 +41,15 @@ public:
     }
 
     int init_pt(rs::core::video_module_interface::supported_module_config& cfg,
-                rs::device* device)
+                frame_source* source)
     {
         // Configure camera and get parameters for person tracking video module
-        auto actualModuleConfig = ConfigureCamera(device, cfg);
+        auto actualModuleConfig = ConfigureCamera(source, cfg);
 
         // Configure projection
-        rs::core::intrinsics color_intrin = rs::utils::convert_intrinsics(device->get_stream_intrinsics(rs::stream::color));
-        rs::core::intrinsics depth_intrin = rs::utils::convert_intrinsics(device->get_stream_intrinsics(rs::stream::depth));
-        rs::core::extrinsics extrinsics = rs::utils::convert_extrinsics(device->get_extrinsics(rs::stream::depth, rs::stream::color));
+        rs::core::intrinsics color_intrin = source->get_intrinsics(stream_type::color);
+        rs::core::intrinsics depth_intrin = source->get_intrinsics(stream_type::depth);
+        rs::core::extrinsics extrinsics = source->get_extrinsics(stream_type::depth, stream_type::color);
         actualModuleConfig.projection = rs::core::projection_interface::create_instance(&color_intrin, &depth_intrin, &extrinsics);
 
         // Enabling Person head pose and orientation
@@ -81,7 +82,7 @@ public:
         return true;
     }
 
-    int query_supported_config(rs::device* device,
+    int query_supported_config(frame_source* source,
                                video_module_interface::supported_module_config& supported_config)
     {
         supported_config.image_streams_configs[(int)rs::stream::color].size.width = 640;
@@ -121,6 +122,8 @@ public:
 
     void pt_worker()
     {
+        TRACE_THREAD_NAME("pt worker");
+        TRACE_SPAN("pt_process", (*m_sample_set)[stream_type::depth]->query_frame_number(), "depth");
         // Process frame
         if (ptModule->process_sample_set(*m_sample_set) != rs::core::status_no_error)
         {
@@ -133,25 +136,6 @@ public:
         pt_is_running = false;
     }
 
-    set<int>* get_persion_ids(PersonTrackingData* trackingData)
-    {
-        set<int>* id_set = new set<int>;
-        for (int index = 0; index < trackingData->QueryNumberOfPeople(); ++index)
-        {
-            PersonTrackingData::Person* personData = trackingData->QueryPersonData(
-                        Intel::RealSense::PersonTracking::PersonTrackingData::ACCESS_ORDER_BY_INDEX, index);
-
-            if (personData)
-            {
-                PersonTrackingData::PersonTracking* personTrackingData = personData->QueryTracking();
-
-                int id = personTrackingData->QueryId();
-                id_set->insert(id);
-            }
-        }
-        return id_set;
-    }
-
     wstring get_data_files_path()
     {
         struct stat stat_struct;
@@ -171,7 +155,7 @@ public:
     }
 
     rs::core::video_module_interface::actual_module_config ConfigureCamera (
-        rs::device* device,
+        frame_source* source,
         rs::core::video_module_interface::supported_module_config& cfg)
     {
         rs::core::video_module_interface::actual_module_config actualModuleConfig = {};
@@ -182,7 +166,6 @@ public:
                                                          };
         for (auto &stream : possible_streams)
         {
-            rs::stream librealsenseStream = rs::utils::convert_stream_type(stream);
             auto &supported_stream_config = cfg[stream];
             int width = supported_stream_config.size.width;
             int height = supported_stream_config.size.height;
@@ -192,10 +175,8 @@ public:
             actualStreamConfig.size.width = width;
             actualStreamConfig.size.height = height;
             actualStreamConfig.frame_rate = frame_rate;
-            actualStreamConfig.intrinsics = rs::utils::convert_intrinsics(
-                                                device->get_stream_intrinsics(librealsenseStream));
-            actualStreamConfig.extrinsics = rs::utils::convert_extrinsics(
-                                                device->get_extrinsics(rs::stream::depth, librealsenseStream));
+            actualStreamConfig.intrinsics = source->get_intrinsics(stream);
+            actualStreamConfig.extrinsics = source->get_extrinsics(stream_type::depth, stream);
             actualStreamConfig.is_enabled = true;
         }
         return actualModuleConfig;
@@ -256,12 +237,6 @@ private:
     wstring dataDir;
     unique_ptr<rs::person_tracking::person_tracking_video_module_interface> ptModule;
 
-    int lastPersonCount;
-    int totalPersonIncrements;
-    int prevPeopleInFrame;
-    int prevPeopleTotal;
-    set<int> *id_set;
-
     bool pt_initialized;
     bool pt_is_running;
     bool m_stopped;
@@ -8,6 +8,7 @@
 #include "rs_sdk.h"
 #include "slam.h"
 #include "utils.h"
+#include "slam_feeder.hpp"
 
 #include <opencv2/core/core.hpp>
 #include <opencv2/highgui/highgui.hpp>
@@ -46,19 +47,23 @@ public:
     std::shared_ptr<occupancy_map> occ_map;
 
     slam_event_handler(module_result_listener_interface* listener, stream_stats& pst)
-        : m_module_listener(listener), processStreamStats(pst)
+        : m_module_listener(listener)
     {
+        // The SLAM output is the only producer of the tracking stats
+        for(int i = 0; i < stream_stats::stream_count; ++i)
+        {
+            m_processMeters[i] = &pst.register_stream((stream_stats::stream_id)i);
+        }
     }
 
     void report_timestamp_fps(correlated_sample_set * sample)
     {
-        add_stream_samples(processStreamStats, rs::core::stream_type::fisheye, 1);
-        add_stream_samples(processStreamStats, rs::core::stream_type::depth,
-                           (sample->images[(int)rs::core::stream_type::depth]) ? 1 : 0);
-        add_motion_sensor_samples(processStreamStats, rs::core::motion_type::accel,
-                                  (int)sample->motion_samples[(int)rs::core::motion_type::accel].frame_number);
-        add_motion_sensor_samples(processStreamStats, rs::core::motion_type::gyro,
-                                  (int)sample->motion_samples[(int)rs::core::motion_type::gyro].frame_number);
+        m_processMeters[stream_stats::fisheye_stream]->add_sample();
+        m_processMeters[stream_stats::depth_stream]->add_samples((sample->images[(int)rs::core::stream_type::depth]) ? 1 : 0);
+        m_processMeters[stream_stats::accelerometer_stream]->add_samples(
+            (int)sample->motion_samples[(int)rs::core::motion_type::accel].frame_number);
+        m_processMeters[stream_stats::gyroscope_stream]->add_samples(
+            (int)sample->motion_samples[(int)rs::core::motion_type::gyro].frame_number);
     }
 
     void module_output_ready(rs::core::video_module_interface * sender, correlated_sample_set * sample)
@@ -111,7 +116,7 @@ public:
 
 private:
     module_result_listener_interface* m_module_listener;
-    stream_stats& processStreamStats;
+    rate_meter* m_processMeters[stream_stats::stream_count];
     float occupancy_res = -1;
     int m_current_depth_frame_id = -1;
 };
@@ -124,6 +129,11 @@ public:
         : m_module_listener(module_listener), m_slam(new rs::slam::slam()),
           m_initialized(false), actual_slam_config( {})
     {
+        // Module_manager reports the input of every stream through update_input_stream()
+        for(int i = 0; i < stream_stats::stream_count; ++i)
+        {
+            m_inputMeters[i] = &inputStreamStats.register_stream((stream_stats::stream_id)i);
+        }
     }
 
     void display_stats_data()
@@ -143,16 +153,21 @@ public:
     void stop()
     {
         m_initialized = false;
+        if(m_feeder)
+        {
+            m_feeder->stop();
+            m_feeder->print_stats();
+        }
         m_slam->reset_config();
 
         cout << "Saving occupancy map to disk..." << endl;
         m_slam->save_occupancy_map_as_ppm("occupancy.ppm", true);
     }
 
-    int query_supported_config(rs::device* device,
+    int query_supported_config(frame_source* source,
                                video_module_interface::supported_module_config& supported_config)
     {
-        m_dev = device;
+        m_source = source;
 
         clear_streams(supported_config);
 
@@ -162,9 +177,9 @@ public:
             return -1;
         }
 
-        auto device_name = device->get_name();
-        auto is_current_device_valid = (strcmp(device_name, supported_config.device_name) == 0);
-        if (!is_current_device_valid)
+        // A synthetic or recorded source stands in for the supported camera
+        auto is_current_device_valid = (strcmp(source->get_name(), supported_config.device_name) == 0);
+        if (!is_current_device_valid && source->get_device())
         {
             cerr<<"error : current device is not supported by the current supported module configuration" << endl;
             return -1;
@@ -173,7 +188,7 @@ public:
         memcpy(actual_slam_config.device_info.name, supported_config.device_name, std::strlen(supported_config.device_name));
 
         rs::source active_sources = get_source_type(supported_config);
-        if(!check_motion_sensor_capability_if_required(device, active_sources))
+        if(!check_motion_sensor_capability_if_required(source, active_sources))
         {
             cerr<<"error : current device is not supported motion events" << endl;
             return -1;
@@ -194,14 +209,12 @@ public:
                 continue;
             }
 
-            rs::stream librealsense_stream = rs::utils::convert_stream_type(stream);
-
             video_module_interface::actual_image_stream_config &actual_stream_config = actual_slam_config[stream];
             actual_slam_config[stream].size.width = supported_stream_config.size.width;
             actual_slam_config[stream].size.height= supported_stream_config.size.height;
             actual_stream_config.frame_rate = supported_stream_config.frame_rate;
 
-            actual_stream_config.intrinsics = rs::utils::convert_intrinsics(m_dev->get_stream_intrinsics(librealsense_stream));
+            actual_stream_config.intrinsics = m_source->get_intrinsics(stream);
             actual_stream_config.is_enabled = true;
 
         }
@@ -213,18 +226,13 @@ public:
             actual_slam_config[motion_type::accel].is_enabled = true;
             actual_slam_config[motion_type::gyro].is_enabled = true;
 
-            auto _motion_intrinsics = m_dev->get_motion_intrinsics();
-            actual_slam_config[motion_type::accel].intrinsics =
-                rs::utils::convert_motion_device_intrinsics(_motion_intrinsics.acc);
-            actual_slam_config[motion_type::gyro].intrinsics =
-                rs::utils::convert_motion_device_intrinsics(_motion_intrinsics.gyro);
+            actual_slam_config[motion_type::accel].intrinsics = m_source->get_motion_intrinsics(motion_type::accel);
+            actual_slam_config[motion_type::gyro].intrinsics = m_source->get_motion_intrinsics(motion_type::gyro);
         }
 
-        actual_slam_config[stream_type::fisheye].extrinsics_motion = rs::utils::convert_extrinsics(
-                    m_dev->get_motion_extrinsics_from(rs::stream::fisheye));
+        actual_slam_config[stream_type::fisheye].extrinsics_motion = m_source->get_motion_extrinsics(stream_type::fisheye);
 
-        actual_slam_config[stream_type::fisheye].extrinsics = rs::utils::convert_extrinsics(
-                    m_dev->get_extrinsics(rs::stream::depth, rs::stream::fisheye));
+        actual_slam_config[stream_type::fisheye].extrinsics = m_source->get_extrinsics(stream_type::depth, stream_type::fisheye);
 
     }
 
@@ -246,14 +254,30 @@ public:
         slam_tracking_event_handler* trackingEventHandler = new slam_tracking_event_handler(m_module_listener);
         m_slam->register_tracking_event_handler(trackingEventHandler);
 
+        // Camera callbacks only queue their samples; the feeder thread passes them to SLAM in timestamp order
+        m_feeder.reset(new slam_feeder(m_slam.get()));
+        m_feeder->start();
+
         m_initialized = true;
 
         return 0;
     }
 
-    status process_sample_set_async(correlated_sample_set& sample_set)
+    // Queues an image for SLAM, takes its own reference on the image
+    bool process_image_async(stream_type stream, image_interface* image)
     {
-        return m_slam->process_sample_set(sample_set);
+        return m_feeder->enqueue_image(stream, image);
+    }
+
+    bool process_motion_async(const motion_sample& sample)
+    {
+        return m_feeder->enqueue_motion(sample);
+    }
+
+    // Queues a timestamp-ordered batch of IMU samples, returns the number accepted
+    size_t process_motion_batch_async(const imu_sample* samples, size_t count)
+    {
+        return m_feeder->enqueue_motion_batch(samples, count);
     }
 
     void restart()
@@ -261,26 +285,24 @@ public:
         m_slam->restart();
     }
 
-    stream_stats get_input_stream_stats()
+    const stream_stats& get_input_stream_stats() const
     {
         return inputStreamStats;
     }
 
-    stream_stats get_process_stream_stats()
+    const stream_stats& get_process_stream_stats() const
     {
         return processStreamStats;
     }
 
-
-
     void update_input_stream(stream_type stream, int count)
     {
-        add_stream_samples(inputStreamStats, stream, count);
+        m_inputMeters[stream == stream_type::depth ? stream_stats::depth_stream : stream_stats::fisheye_stream]->add_samples(count);
     }
 
     void update_input_stream(motion_type motionType, int count)
     {
-        add_motion_sensor_samples(inputStreamStats, motionType, count);
+        m_inputMeters[motionType == motion_type::accel ? stream_stats::accelerometer_stream : stream_stats::gyroscope_stream]->add_samples(count);
     }
 
     void get_camera_pose(PoseMatrix4f& pose)
@@ -296,10 +318,12 @@ public:
 private:
     module_result_listener_interface* m_module_listener;
     std::unique_ptr<slam> m_slam;
+    std::unique_ptr<slam_feeder> m_feeder;
     bool m_initialized;
     video_module_interface::actual_module_config actual_slam_config;
 
     stream_stats processStreamStats;
     stream_stats inputStreamStats;
-    rs::device* m_dev;
+    rate_meter* m_inputMeters[stream_stats::stream_count];
+    frame_source* m_source;
 };
@@ -24,6 +24,7 @@
 
 #include "version.h"
 #include "slam_utils.hpp"
+#include "open_frame_source.hpp"
 
 using namespace std;
 using namespace rs::core;
@@ -87,15 +88,17 @@ int main (int argc, char* argv[])
     install_signal_handler();
 
     //--------------------------------------------------------------------------------------
-    // Setup a librealsense context and camera device
+    // Setup a librealsense context and camera device, or the source selected by RS_SAMPLES_FRAME_SOURCE
     //--------------------------------------------------------------------------------------
 
     std::unique_ptr<context_interface> context;
+    std::unique_ptr<frame_source> source;
     if (argc<2)
     {
         // Create a regular context for streaming live data from the camera
         context.reset(new rs::core::context());
-        if(context->get_device_count() == 0)
+        source = open_frame_source(*context);
+        if(!source)
         {
             cout << "Error: Device is null." << "There are no RealSense devices connected." << endl << "Please connect a RealSense device and restart the application" << endl;
             return -1;
@@ -110,10 +113,9 @@ int main (int argc, char* argv[])
             cerr<<"error : can't open file" << endl;
             return -1;
         }
+        source.reset(new device_frame_source(context->get_device(0)));
     }
 
-    rs::device *device = context->get_device(0);
-
     //--------------------------------------------------------------------------------------
     // Setup an instance of the SLAM module
     //--------------------------------------------------------------------------------------
@@ -137,20 +139,9 @@ int main (int argc, char* argv[])
         return false;
     }
 
-    // Check to make sure the current device name (ex: Intel RealSense ZR300) is one that the SLAM module supports
-    auto device_name = device->get_name();
-    auto is_current_device_valid = (strcmp(device_name, supported_slam_config.device_name) == 0);
-    if (!is_current_device_valid)
-    {
-        cerr<<"error : current device is not supported by the current module configuration" << endl;
-        return -1;
-    }
-
-    // Check to make sure that the current device supports motion data
-    rs::source active_sources = get_source_type(supported_slam_config);
-    if(!check_motion_sensor_capability_if_required(device, active_sources))
+    // Check to make sure the source is the camera SLAM supports, or stands in for it, and delivers motion data
+    if (!check_source_for_slam(source.get(), supported_slam_config))
     {
-        cerr<<"error : current device does not support motion events" << endl; // If you get this, unplug and reconnect the camera
         return -1;
     }
 
@@ -158,19 +149,27 @@ int main (int argc, char* argv[])
     // Configure the camera device for SLAM
     //--------------------------------------------------------------------------------------
 
-    configure_camera_for_slam(device, supported_slam_config);
+    if (!configure_camera_for_slam(source.get(), supported_slam_config))
+    {
+        return -1;
+    }
 
     stream_stats inputStreamStats; // Not used in this example
-    set_callback_for_image_stream(device, stream_type::fisheye, slam, inputStreamStats);
-    set_callback_for_image_stream(device, stream_type::depth, slam, inputStreamStats);
-    set_callback_for_motion_streams(device, slam, inputStreamStats);
+
+    // Camera callbacks only queue their samples; the feeder thread passes them to SLAM in timestamp order
+    // IMU samples are batched per fisheye frame, so SLAM input overhead doesn't scale with the IMU rate
+    slam_feeder slamFeeder(slam.get());
+    imu_batcher imuBatcher(make_slam_imu_consumer(slamFeeder, inputStreamStats));
+    set_callback_for_image_stream(source.get(), stream_type::fisheye, slamFeeder, inputStreamStats, &imuBatcher);
+    set_callback_for_image_stream(source.get(), stream_type::depth, slamFeeder, inputStreamStats);
+    set_callback_for_motion_streams(source.get(), imuBatcher);
 
     //--------------------------------------------------------------------------------------
     // Set the SLAM configuration
     //--------------------------------------------------------------------------------------
 
     // Construct the SLAM configuration using a handy helper function
-    video_module_interface::actual_module_config slam_config = get_slam_config(device, slam, supported_slam_config);
+    video_module_interface::actual_module_config slam_config = get_slam_config(source.get(), supported_slam_config);
 
     if(slam->set_module_config(slam_config) < status_no_error)
     {
@@ -190,14 +189,15 @@ int main (int argc, char* argv[])
     //--------------------------------------------------------------------------------------
 
     cout << endl << "Starting SLAM..." << endl;
-    device->start(active_sources);
+    slamFeeder.start();
+    source->start();
 
     //--------------------------------------------------------------------------------------
     // Run until a key is pressed
     //--------------------------------------------------------------------------------------
 
     cout << "Press Esc key to exit" << endl;
-    while(!is_key_pressed() && device->is_streaming())
+    while(!is_key_pressed() && source->is_streaming())
     {
         std::this_thread::sleep_for(std::chrono::milliseconds(500));
     }
@@ -209,8 +209,11 @@ int main (int argc, char* argv[])
     //--------------------------------------------------------------------------------------
 
     cout << endl << "Stopping..." << endl;
+    source->stop();
+    imuBatcher.flush();     // no motion callbacks run after the source stopped, pass the last samples to SLAM
+    slamFeeder.stop();
+    slamFeeder.print_stats();
     slam->flush_resources();
-    device->stop(active_sources);
 
     //--------------------------------------------------------------------------------------
     // Save the occupancy map to disk
@@ -10,6 +10,7 @@
 
 #include "slam_web_display.hpp"
 #include "slam_utils.hpp"
+#include "open_frame_source.hpp"
 #include "version.h"
 
 using namespace std;
@@ -24,6 +25,9 @@ unique_ptr<web_display::slam_web_display>  web_view;
 stream_stats inputStreamStats;
 stream_stats processStreamStats;
 
+// Propagates the SLAM pose with IMU data between SLAM updates
+pose_predictor posePredictor;
+
 class slam_tracking_event_handler : public tracking_event_handler
 {
 public:
@@ -48,15 +52,36 @@ public:
 class slam_event_handler : public video_module_interface::processing_event_handler
 {
 public:
-    slam_event_handler() {}
+    slam_event_handler() :
+        m_slam_latency(latency_registry::get_instance().get_histogram("camera->slam"))
+    {
+        // The SLAM output is the only producer of the tracking stats
+        for (int i = 0; i < stream_stats::stream_count; i++)
+        {
+            m_processMeters[i] = &processStreamStats.register_stream((stream_stats::stream_id)i);
+        }
+
+        static const char* trackingNames[] = { "failed", "low", "medium", "high" };
+        for (int i = 0; i < 4; i++)
+        {
+            m_posesMetric[i] = &metrics_registry::get_instance().get_counter("rs_slam_poses_total", "Camera poses reported by SLAM",
+                               { { "tracking", trackingNames[i] } });
+        }
+    }
     ~slam_event_handler() = default;
 
+    // The feeder remembers when each fisheye frame arrived, to measure the latency up to the SLAM output
+    void set_feeder(const slam_feeder* feeder)
+    {
+        m_feeder = feeder;
+    }
+
     void report_timestamp_fps(correlated_sample_set * sample)
     {
-        add_stream_samples(processStreamStats, rs::core::stream_type::fisheye, 1);
-        add_stream_samples(processStreamStats, rs::core::stream_type::depth, (sample->images[(int)rs::core::stream_type::depth]) ? 1 : 0);
-        add_motion_sensor_samples(processStreamStats, rs::core::motion_type::accel, (int)sample->motion_samples[(int)rs::core::motion_type::accel].frame_number);
-        add_motion_sensor_samples(processStreamStats, rs::core::motion_type::gyro, (int)sample->motion_samples[(int)rs::core::motion_type::gyro].frame_number);
+        m_processMeters[stream_stats::fisheye_stream]->add_sample();
+        m_processMeters[stream_stats::depth_stream]->add_samples((sample->images[(int)rs::core::stream_type::depth]) ? 1 : 0);
+        m_processMeters[stream_stats::accelerometer_stream]->add_samples((int)sample->motion_samples[(int)rs::core::motion_type::accel].frame_number);
+        m_processMeters[stream_stats::gyroscope_stream]->add_samples((int)sample->motion_samples[(int)rs::core::motion_type::gyro].frame_number);
     }
 
     void module_output_ready(video_module_interface* sender,
@@ -64,6 +89,12 @@ public:
     {
         report_timestamp_fps(sample);
 
+        if (m_feeder)
+        {
+            m_feeder->get_fisheye_arrivals().record_latency(
+                sample->images[(int)rs::core::stream_type::fisheye]->query_frame_number(), m_slam_latency);
+        }
+
         slam* slam_module = dynamic_cast<slam*>(sender);
 
         // 1. Camera pose update
@@ -71,6 +102,17 @@ public:
         slam_module->get_camera_pose(pose);
         auto trackingAccuracy = slam_module->get_tracking_accuracy();
         web_view->on_pose((int)(trackingAccuracy), pose.m_data);
+        if ((int)trackingAccuracy >= 0 && (int)trackingAccuracy < 4)
+        {
+            m_posesMetric[(int)trackingAccuracy]->inc();
+        }
+
+        // Re-anchor the IMU pose prediction on the new SLAM pose
+        if (trackingAccuracy != tracking_accuracy::failed)
+        {
+            auto pose_fisheye = sample->images[(int)rs::core::stream_type::fisheye];
+            posePredictor.on_slam_pose(pose_fisheye->query_time_stamp(), pose.m_data, (int)(trackingAccuracy));
+        }
 
         if (!occupancy)
         {
@@ -98,10 +140,29 @@ public:
 private:
     shared_ptr<occupancy_map> occupancy;
     float occupancy_res = -1;
+    const slam_feeder* m_feeder = nullptr;
+    latency_histogram& m_slam_latency;
+    rate_meter* m_processMeters[stream_stats::stream_count];
+    metric_counter* m_posesMetric[4];
 };
 
 int main(int argc, char* argv[])
 {
+    // Optional CSV log of the latency percentiles: -latency_log <file>
+    // Optional Chrome trace of the pipeline stages: -trace <file>
+    string latency_log_path;
+    for (int i = 1; i + 1 < argc; i++)
+    {
+        if (string(argv[i]) == "-latency_log")
+        {
+            latency_log_path = argv[i + 1];
+        }
+        else if (string(argv[i]) == "-trace")
+        {
+            start_pipeline_trace(argv[i + 1]);
+        }
+    }
+
     // Create and start remote(Web) view
     string sample_name = argv[0];
     web_view = move(web_display::make_slam_web_display(sample_name, 8000, true));
@@ -110,18 +171,17 @@ int main(int argc, char* argv[])
     install_signal_handler();
 
     //--------------------------------------------------------------------------------------
-    // Setup a librealsense context and device
+    // Setup a context and the camera, or the source selected by RS_SAMPLES_FRAME_SOURCE
     //--------------------------------------------------------------------------------------
 
-    std::unique_ptr<rs::context> context(new rs::context());
-    if(context->get_device_count() == 0)
+    rs::core::context context;
+    std::unique_ptr<frame_source> source = open_frame_source(context);
+    if(!source)
     {
         cout << "Error: Device is null. " << "There are no RealSense devices connected." << endl << "Please connect a RealSense device and restart the application" << endl;
         return -1;
     }
 
-    rs::device *device = context->get_device(0);
-
     //--------------------------------------------------------------------------------------
     // Setup an instance of the SLAM module
     //--------------------------------------------------------------------------------------
@@ -149,20 +209,9 @@ int main(int argc, char* argv[])
         return false;
     }
 
-    // Check to make sure the current device name (ex: Intel RealSense ZR300) is one that the SLAM module supports
-    auto device_name = device->get_name();
-    auto is_current_device_valid = (strcmp(device_name, supported_slam_config.device_name) == 0);
-    if (!is_current_device_valid)
+    // Check to make sure the source is the camera SLAM supports, or stands in for it, and delivers motion data
+    if (!check_source_for_slam(source.get(), supported_slam_config))
     {
-        cerr<<"error : current device is not supported by the current module configuration" << endl;
-        return -1;
-    }
-
-    // Check to make sure that the current device supports motion data
-    rs::source active_sources = get_source_type(supported_slam_config);
-    if(!check_motion_sensor_capability_if_required(device, active_sources))
-    {
-        cerr<<"error : current device does not support motion events" << endl; // if you get this, unplug and reconnect the camera
         return -1;
     }
 
@@ -170,18 +219,30 @@ int main(int argc, char* argv[])
     // Configure the camera for SLAM
     //--------------------------------------------------------------------------------------
 
-    configure_camera_for_slam(device, supported_slam_config);
+    if (!configure_camera_for_slam(source.get(), supported_slam_config))
+    {
+        return -1;
+    }
 
-    stream_stats inputStreamStats; // Not used in this example
-    set_callback_for_image_stream(device, stream_type::fisheye, slam, inputStreamStats);
-    set_callback_for_image_stream(device, stream_type::depth, slam, inputStreamStats);
-    set_callback_for_motion_streams(device, slam, inputStreamStats);
+    // Camera callbacks only queue their samples; the feeder thread passes them to SLAM in timestamp order
+    // IMU samples are batched per fisheye frame, so SLAM input overhead doesn't scale with the IMU rate
+    slam_feeder slamFeeder(slam.get());
+    slamEventHandler.set_feeder(&slamFeeder);
+    imu_batcher imuBatcher(make_slam_imu_consumer(slamFeeder, inputStreamStats));
+    set_callback_for_image_stream(source.get(), stream_type::fisheye, slamFeeder, inputStreamStats, &imuBatcher);
+    set_callback_for_image_stream(source.get(), stream_type::depth, slamFeeder, inputStreamStats);
+    set_callback_for_motion_streams(source.get(), imuBatcher, &posePredictor);
 
     //--------------------------------------------------------------------------------------
     // Construct the SLAM configuration using a handy helper function
     //--------------------------------------------------------------------------------------
 
-    video_module_interface::actual_module_config slam_config = get_slam_config(device, slam, supported_slam_config);
+    video_module_interface::actual_module_config slam_config = get_slam_config(source.get(), supported_slam_config);
+
+    // The pose predictor uses the same motion calibration as SLAM. The fisheye to motion module
+    // rotation is column-major, so read as row-major it is the motion module to fisheye rotation.
+    posePredictor.set_motion_intrinsics(slam_config[motion_type::accel].intrinsics, slam_config[motion_type::gyro].intrinsics);
+    posePredictor.set_imu_to_camera_rotation(source->get_motion_extrinsics(stream_type::fisheye).rotation);
 
     //--------------------------------------------------------------------------------------
     // Set the SLAM configuration
@@ -197,7 +258,8 @@ int main(int argc, char* argv[])
     // Start streaming data from the camera
     //--------------------------------------------------------------------------------------
     cout << endl << "-------- Starting SLAM.  Press Esc key to exit --------" << endl << endl;
-    device->start(active_sources);
+    slamFeeder.start();
+    source->start();
 
     //--------------------------------------------------------------------------------------
     // Set up the remote display
@@ -229,11 +291,39 @@ int main(int argc, char* argv[])
                          stats.get_gyroscope_fps());
     };
 
+    // Send every new predicted pose on the high-rate pose channel, waking up only when one is published
+    atomic_bool stop_pose_channel { false };
+    thread pose_channel([&]()
+    {
+        uint32_t last_version = 0;
+        while (!stop_pose_channel)
+        {
+            predicted_pose predicted;
+            if (posePredictor.wait_for_update(last_version, chrono::milliseconds(100)) &&
+                    posePredictor.get_latest(predicted, &last_version))
+            {
+                web_view->on_predicted_pose(predicted.tracking, predicted.timestamp, predicted.anchor_timestamp, predicted.pose);
+            }
+        }
+    });
+
+    // Export latency percentiles of every stage to the console, the web view and optionally a file
+    latency_reporter latencyReporter;
+    if (!latency_log_path.empty())
+    {
+        latencyReporter.set_log_file(latency_log_path);
+    }
+    latencyReporter.set_stage_callback([](const string& stage, const latency_snapshot& latency)
+    {
+        web_view->on_latency(stage, latency);
+    });
+    latencyReporter.start();
+
     //--------------------------------------------------------------------------------------
     // Run until a key is pressed
     //--------------------------------------------------------------------------------------
 
-    while (!is_key_pressed() && device->is_streaming())
+    while (!is_key_pressed() && source->is_streaming())
     {
         this_thread::sleep_for(chrono::milliseconds(500));
         send_fps_stats("input", inputStreamStats);
@@ -245,8 +335,15 @@ int main(int argc, char* argv[])
     //--------------------------------------------------------------------------------------
 
     cout << endl << "Stopping..." << endl;
+    stop_pose_channel = true;
+    pose_channel.join();
+    source->stop();
+    imuBatcher.flush();     // no motion callbacks run after the source stopped, pass the last samples to SLAM
+    slamFeeder.stop();
+    slamFeeder.print_stats();
+    latencyReporter.stop();
     slam->flush_resources();
-    device->stop(active_sources);
+    trace_recorder::get_instance().dump();
 
     return 0;
 }
@@ -0,0 +1,498 @@
+// License: Apache 2.0. See LICENSE file in root directory.
+// Copyright(c) 2017 Intel Corporation. All Rights Reserved.
+
+//
+// web_json_benchmark: Times serializing each JSON message type of the web displays, the way they
+// did it before with a nlohmann::json document (build the document, pass it by value, dump it to a
+// string and copy the string into the send task) and the way they do it now with json_writer (write
+// to a pooled buffer and move it to the send task). It first checks that both produce the same
+// message.
+//
+
+#include <chrono>
+#include <cmath>
+#include <cstdlib>
+#include <functional>
+#include <iomanip>
+#include <iostream>
+#include <memory>
+#include <random>
+#include <string>
+#include <vector>
+
+#include <json/json.hpp>
+
+#include "json_writer.hpp"
+#include "web_messages.hpp"
+
+using namespace std;
+using namespace web_display;
+using nlohmann::json;
+
+struct message_benchmark
+{
+    string name;
+    function<json()> build_document;                 // before: the nlohmann::json document
+    function<void(json_writer& writer)> write;       // now: json_writer
+};
+
+// The synthetic results the messages are made of
+struct benchmark_data
+{
+    vector<or_object_message> objects;
+    vector<string> labels;
+    vector<pt_person_message> persons;
+    pt_head_pose_message head_pose;
+    pt_gesture_message gesture;
+    float pose[12];
+    latency_snapshot latency;
+};
+
+benchmark_data make_data()
+{
+    mt19937 rng(7);
+    uniform_real_distribution<float> unit(0.0f, 1.0f);
+    uniform_real_distribution<float> meters(-5.0f, 5.0f);
+    uniform_int_distribution<int> pixels(0, 640);
+
+    benchmark_data data;
+    const char* names[] = { "chair", "table", "monitor", "person", "keyboard", "cup", "bottle", "laptop" };
+    for (auto name : names)
+    {
+        data.labels.push_back(name);
+    }
+    for (int i = 0; i < 5; ++i)
+    {
+        or_object_message object;
+        object.label = &data.labels[i];
+        object.confidence = unit(rng);
+        for (auto& coordinate : object.position) coordinate = meters(rng);
+        object.roi = { pixels(rng), pixels(rng), pixels(rng), pixels(rng) };
+        data.objects.push_back(object);
+    }
+    for (int i = 0; i < 3; ++i)
+    {
+        pt_person_message person = {};
+        person.pid = i;
+        person.has_rid = i == 0;
+        person.rid = 100 + i;
+        person.has_pose = i != 2;
+        for (auto& coordinate : person.pose) coordinate = meters(rng);
+        for (auto& coordinate : person.box) coordinate = pixels(rng);
+        for (auto& coordinate : person.center_mass_image) coordinate = static_cast<float>(pixels(rng));
+        for (auto& coordinate : person.center_mass_world) coordinate = meters(rng) * 1000;
+        data.persons.push_back(person);
+    }
+    data.head_pose = { 1, true, { pixels(rng), pixels(rng), pixels(rng), pixels(rng) }, true, meters(rng), meters(rng), meters(rng) };
+    data.gesture.pid = 1;
+    for (auto& coordinate : data.gesture.box) coordinate = pixels(rng);
+    data.gesture.pointing = true;
+    for (auto& coordinate : data.gesture.color_origin) coordinate = static_cast<float>(pixels(rng));
+    for (auto& coordinate : data.gesture.color_direction) coordinate = unit(rng);
+    for (auto& coordinate : data.gesture.world_origin) coordinate = meters(rng);
+    for (auto& coordinate : data.gesture.world_direction) coordinate = unit(rng);
+    for (auto& coordinate : data.pose) coordinate = meters(rng);
+    data.latency = { 12345, 4.25, 3.9, 6.1, 9.75, 14.2, 22.5 };
+    return data;
+}
+
+// The documents the displays used to build
+json rectangle_document(const rs::core::rect& roi)
+{
+    json r;
+    r += roi.x;
+    r += roi.y;
+    r += roi.width;
+    r += roi.height;
+    return r;
+}
+
+json objects_document(const vector<or_object_message>& objects, const char* type, const char* position_key,
+                      bool with_confidence, bool with_position)
+{
+    json obj_list_json;
+    for (auto& object : objects)
+    {
+        json value;
+        value["label"] = *object.label;
+        if (with_confidence)
+        {
+            value["confidence"] = object.confidence;
+        }
+        if (with_position)
+        {
+            json& p = value[position_key];
+            for (int i = 0; i < 3; i++)
+            {
+                p += object.position[i];
+            }
+        }
+        value["rectangle"] = rectangle_document(object.roi);
+        obj_list_json += value;
+    }
+    json result_json;
+    result_json["Object_result"] = obj_list_json;
+    result_json["type"] = type;
+    return result_json;
+}
+
+json persons_document(const vector<pt_person_message>& persons, const char* type, bool with_cumulative_total)
+{
+    json obj_list_json;
+    for (auto& person : persons)
+    {
+        json value;
+        if (person.has_pose)
+        {
+            json& p = value["pose"];
+            for (int i = 0; i < 3; i++)
+            {
+                p += person.pose[i];
+            }
+        }
+        value["pid"] = person.pid;
+        if (with_cumulative_total)
+        {
+            value["cumulative_total"] = 42;
+        }
+        value["person_bounding_box"]["x"] = person.box[0];
+        value["person_bounding_box"]["y"] = person.box[1];
+        value["person_bounding_box"]["w"] = person.box[2];
+        value["person_bounding_box"]["h"] = person.box[3];
+        value["center_mass_image"]["x"] = person.center_mass_image[0];
+        value["center_mass_image"]["y"] = person.center_mass_image[1];
+        value["center_mass_world"]["x"] = person.center_mass_world[0];
+        value["center_mass_world"]["y"] = person.center_mass_world[1];
+        value["center_mass_world"]["z"] = person.center_mass_world[2];
+        if (person.has_rid)
+        {
+            value["rid"] = person.rid;
+        }
+        obj_list_json += value;
+    }
+    json result_json;
+    result_json["Object_result"] = obj_list_json;
+    result_json["type"] = type;
+    return result_json;
+}
+
+vector<message_benchmark> make_benchmarks(const benchmark_data& data)
+{
+    vector<message_benchmark> benchmarks;
+
+    benchmarks.push_back({ "OR objects (5)", [&]()
+    {
+        return objects_document(data.objects, "object_recognition", "pose", true, true);
+    }, [&](json_writer& writer)
+    {
+        write_or_objects_message(writer, true, data.objects);
+    } });
+
+    benchmarks.push_back({ "OR localization (5)", [&]()
+    {
+        return objects_document(data.objects, "object_localization", "centerCoord", true, true);
+    }, [&](json_writer& writer)
+    {
+        write_localization_message(writer, data.objects);
+    } });
+
+    benchmarks.push_back({ "OR tracking (5)", [&]()
+    {
+        return objects_document(data.objects, "object_tracking", nullptr, false, false);
+    }, [&](json_writer& writer)
+    {
+        write_tracking_message(writer, data.objects);
+    } });
+
+    benchmarks.push_back({ "OR label list (8)", [&]()
+    {
+        json result_json;
+        json& l = result_json["list"];
+        for (auto& label : data.labels)
+        {
+            l += label;
+        }
+        result_json["type"] = "object_recognition_label_list";
+        return result_json;
+    }, [&](json_writer& writer)
+    {
+        write_label_list_message(writer, data.labels);
+    } });
+
+    benchmarks.push_back({ "PT tracking (3)", [&]()
+    {
+        vector<pt_person_message> persons = data.persons;
+        for (auto& person : persons) person.has_pose = false;
+        return persons_document(persons, "person_tracking", true);
+    }, [&](json_writer& writer)
+    {
+        vector<pt_person_message> persons = data.persons;
+        for (auto& person : persons) person.has_pose = false;
+        write_persons_message(writer, "person_tracking", persons, true, 42);
+    } });
+
+    benchmarks.push_back({ "PT world poses (3)", [&]()
+    {
+        vector<pt_person_message> persons = data.persons;
+        for (auto& person : persons) person.has_rid = false;
+        return persons_document(persons, "person_tracking_data", false);
+    }, [&](json_writer& writer)
+    {
+        vector<pt_person_message> persons = data.persons;
+        for (auto& person : persons) person.has_rid = false;
+        write_persons_message(writer, "person_tracking_data", persons, false, 0);
+    } });
+
+    benchmarks.push_back({ "PT head pose", [&]()
+    {
+        const pt_head_pose_message& person = data.head_pose;
+        json value;
+        value["pid"] = person.pid;
+        value["head_bounding_box"]["x"] = person.head_box[0];
+        value["head_bounding_box"]["y"] = person.head_box[1];
+        value["head_bounding_box"]["w"] = person.head_box[2];
+        value["head_bounding_box"]["h"] = person.head_box[3];
+        value["head_pose"]["pitch"] = person.pitch;
+        value["head_pose"]["roll"] = person.roll;
+        value["head_pose"]["yaw"] = person.yaw;
+        json obj_list_json;
+        obj_list_json += value;
+        json result_json;
+        result_json["Object_result"] = obj_list_json;
+        result_json["type"] = "person_tracking";
+        return result_json;
+    }, [&](json_writer& writer)
+    {
+        write_head_pose_message(writer, data.head_pose);
+    } });
+
+    benchmarks.push_back({ "PT pointing gesture", [&]()
+    {
+        const pt_gesture_message& person = data.gesture;
+        json value;
+        value["pid"] = person.pid;
+        value["person_bounding_box"]["x"] = person.box[0];
+        value["person_bounding_box"]["y"] = person.box[1];
+        value["person_bounding_box"]["w"] = person.box[2];
+        value["person_bounding_box"]["h"] = person.box[3];
+        value["gesture_color_coordinates"]["origin"]["x"] = person.color_origin[0];
+        value["gesture_color_coordinates"]["origin"]["y"] = person.color_origin[1];
+        value["gesture_color_coordinates"]["direction"]["x"] = person.color_direction[0];
+        value["gesture_color_coordinates"]["direction"]["y"] = person.color_direction[1];
+        value["gesture_world_coordinates"]["origin"]["x"] = person.world_origin[0];
+        value["gesture_world_coordinates"]["origin"]["y"] = person.world_origin[1];
+        value["gesture_world_coordinates"]["origin"]["z"] = person.world_origin[2];
+        value["gesture_world_coordinates"]["direction"]["x"] = person.world_direction[0];
+        value["gesture_world_coordinates"]["direction"]["y"] = person.world_direction[1];
+        value["gesture_world_coordinates"]["direction"]["z"] = person.world_direction[2];
+        json obj_list_json;
+        obj_list_json += value;
+        json result_json;
+        result_json["Object_result"] = obj_list_json;
+        result_json["type"] = "person_tracking";
+        return result_json;
+    }, [&](json_writer& writer)
+    {
+        write_gesture_message(writer, data.gesture);
+    } });
+
+    benchmarks.push_back({ "SLAM pose", [&]()
+    {
+        json msg;
+        msg["type"] = "tracking";
+        msg["tracking"] = 3;
+        json& p = msg["pose"];
+        for (int i = 0; i < 12; i++)
+        {
+            p += data.pose[i];
+        }
+        return msg;
+    }, [&](json_writer& writer)
+    {
+        write_pose_message(writer, 3, data.pose);
+    } });
+
+    benchmarks.push_back({ "SLAM predicted pose", [&]()
+    {
+        json msg;
+        msg["type"] = "predicted_pose";
+        msg["tracking"] = 3;
+        msg["timestamp"] = 1234567.125;
+        msg["anchor_timestamp"] = 1234550.5;
+        json& p = msg["pose"];
+        for (int i = 0; i < 12; i++)
+        {
+            p += data.pose[i];
+        }
+        return msg;
+    }, [&](json_writer& writer)
+    {
+        write_predicted_pose_message(writer, 3, 1234567.125, 1234550.5, data.pose);
+    } });
+
+    benchmarks.push_back({ "SLAM fps", [&]()
+    {
+        json msg;
+        msg["type"] = "fps";
+        msg["fps"]["type"] = "input";
+        msg["fps"]["fisheye"] = 29.97f;
+        msg["fps"]["depth"] = 29.5f;
+        msg["fps"]["accelerometer"] = 249.8f;
+        msg["fps"]["gyroscope"] = 199.9f;
+        return msg;
+    }, [&](json_writer& writer)
+    {
+        write_fps_message(writer, "input", 29.97f, 29.5f, 249.8f, 199.9f);
+    } });
+
+    benchmarks.push_back({ "SLAM latency", [&]()
+    {
+        json msg;
+        msg["type"] = "latency";
+        msg["latency"]["stage"] = "frame->slam";
+        msg["latency"]["count"] = data.latency.count;
+        msg["latency"]["mean"] = data.latency.mean;
+        msg["latency"]["p50"] = data.latency.p50;
+        msg["latency"]["p90"] = data.latency.p90;
+        msg["latency"]["p99"] = data.latency.p99;
+        msg["latency"]["p99.9"] = data.latency.p999;
+        msg["latency"]["max"] = data.latency.max;
+        return msg;
+    }, [&](json_writer& writer)
+    {
+        write_latency_message(writer, "frame->slam", data.latency);
+    } });
+
+    return benchmarks;
+}
+
+// Same structure and values; numbers are compared as floats, the document widened them to double
+bool same_message(const json& expected, const json& actual)
+{
+    if (expected.is_number() && actual.is_number())
+    {
+        return static_cast<float>(expected.get<double>()) == static_cast<float>(actual.get<double>());
+    }
+    if (expected.type() != actual.type())
+    {
+        return false;
+    }
+    if (expected.is_object())
+    {
+        // Same key count and every expected key in actual, so actual has no other keys
+        if (expected.size() != actual.size())
+        {
+            return false;
+        }
+        for (auto it = expected.begin(); it != expected.end(); ++it)
+        {
+            auto found = actual.find(it.key());
+            if (found == actual.end() || !same_message(it.value(), *found))
+            {
+                return false;
+            }
+        }
+        return true;
+    }
+    if (expected.is_array())
+    {
+        if (expected.size() != actual.size())
+        {
+            return false;
+        }
+        for (size_t i = 0; i < expected.size(); ++i)
+        {
+            if (!same_message(expected[i], actual[i]))
+            {
+                return false;
+            }
+        }
+        return true;
+    }
+    return expected == actual;
+}
+
+// What the display and transporter used to do after building the document
+size_t send_document(json msg)
+{
+    string data = msg.dump();
+    string captured = data;
+    return captured.size();
+}
+
+size_t send_buffer(shared_ptr<string> msg)
+{
+    shared_ptr<const string> captured = move(msg);
+    return captured->size();
+}
+
+int main(int argc, char* argv[])
+{
+    int iterations = argc > 1 ? atoi(argv[1]) : 100000;
+    if (iterations <= 0)
+    {
+        cout << "usage: rs_web_json_benchmark [iterations]" << endl;
+        return -1;
+    }
+
+    benchmark_data data = make_data();
+    vector<message_benchmark> benchmarks = make_benchmarks(data);
+    json_buffer_pool pool;
+
+    bool all_same = true;
+    for (auto& benchmark : benchmarks)
+    {
+        string written;
+        json_writer writer(written);
+        benchmark.write(writer);
+        if (!same_message(benchmark.build_document(), json::parse(written)))
+        {
+            cout << benchmark.name << ": the messages differ" << endl
+                 << "  before: " << benchmark.build_document().dump() << endl
+                 << "  now:    " << written << endl;
+            all_same = false;
+        }
+    }
+    if (!all_same)
+    {
+        return 1;
+    }
+
+    cout << iterations << " messages of each type" << endl << endl;
+    cout << left << setw(24) << "message" << right << setw(14) << "before (ns)" << setw(12) << "now (ns)"
+         << setw(10) << "speedup" << setw(16) << "bytes before" << setw(12) << "bytes now" << endl;
+
+    typedef chrono::steady_clock clock;
+    size_t sink = 0;
+    for (auto& benchmark : benchmarks)
+    {
+        size_t bytes_before = 0;
+        auto begin = clock::now();
+        for (int i = 0; i < iterations; ++i)
+        {
+            json document = benchmark.build_document();
+            bytes_before = send_document(document);
+            sink += bytes_before;
+        }
+        double before_ns = chrono::duration<double, nano>(clock::now() - begin).count() / iterations;
+
+        size_t bytes_now = 0;
+        begin = clock::now();
+        for (int i = 0; i < iterations; ++i)
+        {
+            shared_ptr<string> buffer = pool.acquire();
+            json_writer writer(*buffer);
+            benchmark.write(writer);
+            bytes_now = send_buffer(move(buffer));
+            sink += bytes_now;
+        }
+        double now_ns = chrono::duration<double, nano>(clock::now() - begin).count() / iterations;
+
+        cout << left << setw(24) << benchmark.name << right << fixed << setprecision(0)
+             << setw(14) << before_ns << setw(12) << now_ns << setprecision(1) << setw(9) << before_ns / now_ns << "x"
+             << setw(16) << bytes_before << setw(12) << bytes_now << endl;
+    }
+
+    cout << endl << pool.get_allocated() << " message buffers allocated" << (sink ? "" : " ") << endl;
+    return 0;
+}